@@ -123,6 +123,7 @@ void ay_reset(ay_t *ay)
 {
 	ay->reg[ay_rn_mcioen] = 0x3f;
 	ay->noise_cnt = 0;
+	ay->noise_rng = 1;
 }
 
 /** Initialize AY emulation.
@@ -215,9 +216,12 @@ int ay_get_sample(ay_t *ay)
 		 * Generate new sample.
 		 *
 		 * we don't have to generate skipped samples so just
-		 * generate the last one
+		 * generate the last one. The noise generator is a 17-bit
+		 * LFSR, so that the output is deterministic.
 		 */
-		ay->noise_smp = (rand() & 0x8000) ? 1 : 0;
+		ay->noise_rng = (ay->noise_rng >> 1) |
+		    (((ay->noise_rng ^ (ay->noise_rng >> 3)) & 1) << 16);
+		ay->noise_smp = ay->noise_rng & 1;
 		ay->noise_cnt = cnt % period;
 	} else {
 		ay->noise_cnt = cnt;
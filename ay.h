@@ -83,6 +83,8 @@ typedef struct {
 	uint8_t  env_smp[ay_nchan];
 	uint16_t noise_cnt;
 	uint8_t  noise_smp;
+	/** Noise generator shift register (17 bits) */
+	uint32_t noise_rng;
 	uint32_t d_clocks;
 
 	void (*ioport_write)(void *, uint8_t);
@@ -0,0 +1,323 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Batch mode
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Batch mode
+ *
+ * Headless jobs listed in a manifest are run in parallel, each in its
+ * own process started from the freshly initialized machine.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "headless.h"
+#include "snap.h"
+#include "sys_all.h"
+#include "tape/deck.h"
+
+/** Default interval of screen hashes in fields */
+#define BATCH_HASH_FIELDS 50
+/** Maximum length of manifest line */
+#define BATCH_LINE_MAX 1024
+
+/** Batch job */
+typedef struct {
+	/** Machine (each job process has its own copy) */
+	zx_machine_t *zx;
+	/** Manifest line number */
+	unsigned line;
+	/** Snapshot file or @c NULL */
+	char *snap;
+	/** Tape file or @c NULL */
+	char *tape;
+	/** Number of fields to run */
+	unsigned long fields;
+	/** Job output */
+	FILE *out;
+	/** Job ID */
+	long id;
+	/** Job is running */
+	bool running;
+} batch_job_t;
+
+/** Free batch jobs.
+ *
+ * @param jobs Array of jobs
+ * @param njobs Number of jobs
+ */
+static void batch_free(batch_job_t *jobs, size_t njobs)
+{
+	size_t i;
+
+	for (i = 0; i < njobs; i++) {
+		free(jobs[i].snap);
+		free(jobs[i].tape);
+		if (jobs[i].out != NULL)
+			fclose(jobs[i].out);
+	}
+
+	free(jobs);
+}
+
+/** Load batch manifest.
+ *
+ * Each line of the manifest describes one job: the number of fields
+ * to run followed by a snapshot file, a tape file or both. Without
+ * a snapshot the tape is loaded with LOAD "" in 48K BASIC. Empty lines
+ * and lines starting with '#' are ignored.
+ *
+ * @param fname Manifest file name
+ * @param rjobs Place to store pointer to array of jobs
+ * @param rnjobs Place to store number of jobs
+ * @return Zero on success, -1 on error
+ */
+static int batch_load(const char *fname, batch_job_t **rjobs,
+    size_t *rnjobs)
+{
+	FILE *f;
+	char buf[BATCH_LINE_MAX];
+	batch_job_t *jobs = NULL;
+	batch_job_t *njobs;
+	batch_job_t *job;
+	size_t cnt = 0;
+	unsigned line = 0;
+	char *tok;
+	char **dest;
+	char *endp;
+
+	f = fopen(fname, "rt");
+	if (f == NULL) {
+		printf("Cannot open manifest '%s'.\n", fname);
+		return -1;
+	}
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		++line;
+		tok = strtok(buf, " \t\r\n");
+		if (tok == NULL || tok[0] == '#')
+			continue;
+
+		njobs = realloc(jobs, (cnt + 1) * sizeof(batch_job_t));
+		if (njobs == NULL)
+			goto error;
+		jobs = njobs;
+		job = &jobs[cnt++];
+		memset(job, 0, sizeof(batch_job_t));
+		job->line = line;
+
+		job->fields = strtoul(tok, &endp, 0);
+		if (*endp != '\0' || job->fields == 0) {
+			printf("%s:%u: Invalid number of fields '%s'.\n",
+			    fname, line, tok);
+			goto error;
+		}
+
+		while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+			dest = tape_deck_is_tape_file(tok) ? &job->tape : &job->snap;
+			if (*dest != NULL) {
+				printf("%s:%u: Too many files.\n", fname, line);
+				goto error;
+			}
+
+			*dest = strdup(tok);
+			if (*dest == NULL)
+				goto error;
+		}
+
+		if (job->snap == NULL && job->tape == NULL) {
+			printf("%s:%u: Missing snapshot or tape.\n", fname,
+			    line);
+			goto error;
+		}
+	}
+
+	fclose(f);
+	*rjobs = jobs;
+	*rnjobs = cnt;
+	return 0;
+error:
+	fclose(f);
+	batch_free(jobs, cnt);
+	return -1;
+}
+
+/** Run batch job.
+ *
+ * Runs in its own process, so that each job starts from the freshly
+ * initialized machine.
+ *
+ * @param arg Job (batch_job_t *)
+ * @return Exit status (as for headless_run())
+ */
+static int batch_job(void *arg)
+{
+	batch_job_t *job = (batch_job_t *)arg;
+
+	hl_fields = job->fields;
+	hl_tape = job->tape;
+
+	if (job->snap != NULL && zx_load_snap(job->zx, job->snap) < 0) {
+		printf("Error loading snapshot '%s'.\n", job->snap);
+		return 1;
+	}
+
+	return headless_run(job->zx, job->snap == NULL);
+}
+
+/** Print report of finished batch job.
+ *
+ * @param job Job
+ * @param status Exit status of the job
+ */
+static void batch_report(batch_job_t *job, int status)
+{
+	char buf[256];
+	size_t nr;
+
+	printf("[%u] %lu fields%s%s%s%s\n", job->line, job->fields,
+	    job->snap != NULL ? " " : "", job->snap != NULL ? job->snap : "",
+	    job->tape != NULL ? " " : "", job->tape != NULL ? job->tape : "");
+
+	rewind(job->out);
+	while ((nr = fread(buf, 1, sizeof(buf), job->out)) > 0)
+		fwrite(buf, 1, nr, stdout);
+
+	printf("[%u] Exit status %d\n\n", job->line, status);
+	fclose(job->out);
+	job->out = NULL;
+}
+
+/** Run batch of headless jobs.
+ *
+ * Jobs from the manifest are run in parallel, each in its own process
+ * (machine instance). Reports are printed as jobs finish.
+ *
+ * @param zx Machine (freshly initialized)
+ * @param manifest Manifest file name
+ * @param maxjobs Maximum number of jobs running at the same time
+ *                (zero or less for the number of host CPUs)
+ * @return Exit status: 0 if all jobs finished with status 0, 1 otherwise
+ */
+int batch_run(zx_machine_t *zx, const char *manifest, int maxjobs)
+{
+	batch_job_t *jobs;
+	batch_job_t *job;
+	size_t njobs;
+	size_t next;
+	size_t i;
+	int running;
+	unsigned failed;
+	uint64_t t0;
+	long id;
+	int status;
+	int rc;
+
+	if (batch_load(manifest, &jobs, &njobs) < 0)
+		return 1;
+
+	if (maxjobs <= 0)
+		maxjobs = sys_ncpus();
+	if (hl_hash_fields == 0)
+		hl_hash_fields = BATCH_HASH_FIELDS;
+
+	/* Output files would be shared by all jobs */
+	hl_dump_scr = NULL;
+	hl_dump_img = NULL;
+	hl_dump_wav = NULL;
+	hl_dump_cpu = NULL;
+
+	t0 = sys_time_usec();
+	next = 0;
+	running = 0;
+	failed = 0;
+
+	while (next < njobs || running > 0) {
+		if (next < njobs && running < maxjobs) {
+			job = &jobs[next++];
+			job->zx = zx;
+			job->out = tmpfile();
+			if (job->out == NULL) {
+				printf("[%u] Error creating temporary file.\n",
+				    job->line);
+				++failed;
+				continue;
+			}
+
+			rc = sys_job_start(batch_job, job, job->out,
+			    &job->id);
+			if (rc == ENOTSUP) {
+				printf("Batch mode is not supported on this "
+				    "platform.\n");
+				batch_free(jobs, njobs);
+				return 1;
+			}
+
+			if (rc != 0) {
+				printf("[%u] Error starting job.\n", job->line);
+				fclose(job->out);
+				job->out = NULL;
+				++failed;
+				continue;
+			}
+
+			job->running = true;
+			++running;
+			continue;
+		}
+
+		if (sys_job_wait(&id, &status) != 0)
+			break;
+
+		for (i = 0; i < njobs; i++) {
+			if (jobs[i].running && jobs[i].id == id)
+				break;
+		}
+
+		if (i >= njobs)
+			continue;
+
+		jobs[i].running = false;
+		--running;
+		if (status != 0)
+			++failed;
+		batch_report(&jobs[i], status);
+	}
+
+	printf("Batch finished: %zu jobs, %u failed (%.3f s, %d parallel).\n",
+	    njobs, failed, (sys_time_usec() - t0) / 1000000.0, maxjobs);
+	batch_free(jobs, njobs);
+	return failed != 0 ? 1 : 0;
+}
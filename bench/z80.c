@@ -0,0 +1,299 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Z80 CPU benchmark
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Z80 CPU benchmark.
+ *
+ * Runs compute-bound kernels on a bare CPU with flat 64K memory, once
+ * with the interpreter and once with translation to native code
+ * enabled, and prints the emulated clock rate for each. Without Z80JIT
+ * both runs use the interpreter.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../z80.h"
+
+/** Number of T-states per run (one second at 3.5 MHz) */
+#define BENCH_Z80_TSTATES (200 * 17500UL)
+/** Number of runs per kernel and mode, the fastest one counts */
+#define BENCH_Z80_REPEAT 3
+/** Number of T-states between returns from z80_run() (one field) */
+#define BENCH_Z80_FIELD 69888
+
+/** Benchmark machine */
+typedef struct {
+	/** CPU */
+	z80_t z;
+	/** Memory */
+	uint8_t mem[0x10000];
+	/** Page table for reading memory */
+	uint8_t *rdpg[Z80_NPG];
+	/** Page table for writing memory */
+	uint8_t *wrpg[Z80_NPG];
+} bench_z80_t;
+
+/** Benchmark kernel */
+typedef struct {
+	/** Name */
+	const char *name;
+	/** Program (loaded at address zero, loops forever) */
+	const uint8_t *prog;
+	/** Size of program in bytes */
+	size_t size;
+} bench_z80_kernel_t;
+
+/** Machine running the benchmark */
+static bench_z80_t bench_m;
+
+/** 16-bit sum of 16K of data at 8000h, repeated */
+static const uint8_t bench_z80_sum[] = {
+	0xf3,			/* di */
+	0x21, 0x00, 0x80,	/* 1: ld hl, 8000h */
+	0x01, 0x00, 0x40,	/* ld bc, 4000h */
+	0x11, 0x00, 0x00,	/* ld de, 0 */
+	0x7e,			/* 10: ld a, (hl) */
+	0x83,			/* add a, e */
+	0x5f,			/* ld e, a */
+	0x30, 0x01,		/* jr nc, 16 */
+	0x14,			/* inc d */
+	0x23,			/* 16: inc hl */
+	0x0b,			/* dec bc */
+	0x78,			/* ld a, b */
+	0xb1,			/* or c */
+	0x20, 0xf4,		/* jr nz, 10 */
+	0x18, 0xe9		/* jr 1 */
+};
+
+/** Shift-and-add multiplication of byte pairs at 8000h to C000h */
+static const uint8_t bench_z80_mul[] = {
+	0xf3,			/* di */
+	0x21, 0x00, 0x80,	/* 1: ld hl, 8000h */
+	0x7e,			/* 4: ld a, (hl) */
+	0x23,			/* inc hl */
+	0x5e,			/* ld e, (hl) */
+	0x16, 0x00,		/* ld d, 0 */
+	0xe5,			/* push hl */
+	0x21, 0x00, 0x00,	/* ld hl, 0 */
+	0x06, 0x08,		/* ld b, 8 */
+	0x29,			/* 15: add hl, hl */
+	0x17,			/* rla */
+	0x30, 0x01,		/* jr nc, 20 */
+	0x19,			/* add hl, de */
+	0x10, 0xf9,		/* 20: djnz 15 */
+	0xeb,			/* ex de, hl */
+	0xe1,			/* pop hl */
+	0x73,			/* ld (hl), e */
+	0x23,			/* inc hl */
+	0x72,			/* ld (hl), d */
+	0x7c,			/* ld a, h */
+	0xfe, 0xc0,		/* cp 0c0h */
+	0x20, 0xe4,		/* jr nz, 4 */
+	0x18, 0xdf		/* jr 1 */
+};
+
+/** Indexed access, rotations and stores from 8000h to C000h */
+static const uint8_t bench_z80_mix[] = {
+	0xf3,			/* di */
+	0xdd, 0x21, 0x00, 0x80,	/* 1: ld ix, 8000h */
+	0x11, 0x00, 0xc0,	/* ld de, 0c000h */
+	0x06, 0x00,		/* ld b, 0 */
+	0xdd, 0x7e, 0x00,	/* 10: ld a, (ix + 0) */
+	0xdd, 0xae, 0x01,	/* xor (ix + 1) */
+	0xcb, 0x07,		/* rlc a */
+	0xcb, 0x0f,		/* rrc a */
+	0xe6, 0x7f,		/* and 7fh */
+	0x12,			/* ld (de), a */
+	0x13,			/* inc de */
+	0xdd, 0x23,		/* inc ix */
+	0x10, 0xee,		/* djnz 10 */
+	0x18, 0xe6		/* jr 1 */
+};
+
+/** Kernels */
+static const bench_z80_kernel_t bench_z80_kernels[] = {
+	{ "sum", bench_z80_sum, sizeof(bench_z80_sum) },
+	{ "mul", bench_z80_mul, sizeof(bench_z80_mul) },
+	{ "mix", bench_z80_mix, sizeof(bench_z80_mix) }
+};
+
+static void bench_z80_memset8(void *arg, uint16_t addr, uint8_t val)
+{
+	bench_z80_t *m = (bench_z80_t *)arg;
+
+	m->mem[addr] = val;
+}
+
+static uint8_t *bench_z80_mem_direct(void *arg, uint16_t addr, uint16_t len,
+    int write)
+{
+	bench_z80_t *m = (bench_z80_t *)arg;
+
+	if ((uint32_t)addr + len > sizeof(m->mem))
+		return NULL;
+
+	return &m->mem[addr];
+}
+
+static uint8_t bench_z80_in8(void *arg, uint16_t addr)
+{
+	return 0xff;
+}
+
+static void bench_z80_out8(void *arg, uint16_t addr, uint8_t val)
+{
+}
+
+static uint8_t bench_z80_snoop8(void *arg)
+{
+	return 0xff;
+}
+
+static int bench_z80_code_break(void *arg, uint16_t addr)
+{
+	return 0;
+}
+
+static void bench_z80_trace_instr(void *arg)
+{
+}
+
+/** Memory and I/O of the benchmark machine */
+static const z80_ops_t bench_z80_ops = {
+	.memset8 = bench_z80_memset8,
+	.mem_direct = bench_z80_mem_direct,
+	.in8 = bench_z80_in8,
+	.out8 = bench_z80_out8,
+	.snoop8 = bench_z80_snoop8,
+	.code_break = bench_z80_code_break,
+	.trace_instr = bench_z80_trace_instr
+};
+
+/** Get monotonic time in seconds.
+ *
+ * @return Time in seconds
+ */
+static double bench_z80_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** Run kernel once.
+ *
+ * @param m Benchmark machine
+ * @param k Kernel
+ * @param jit Non-zero to translate hot code to native code
+ * @param clock Place to store final clock of the CPU
+ * @return Host time in seconds
+ */
+static double bench_z80_run(bench_z80_t *m, const bench_z80_kernel_t *k,
+    int jit, unsigned long *clock)
+{
+	double start;
+	unsigned i;
+
+	memset(m->mem, 0, sizeof(m->mem));
+	memcpy(m->mem, k->prog, k->size);
+	for (i = 0x8000; i < sizeof(m->mem); i++)
+		m->mem[i] = i * 7 + (i >> 8);
+
+	for (i = 0; i < Z80_NPG; i++) {
+		m->rdpg[i] = m->mem + i * Z80_PG_SIZE;
+		m->wrpg[i] = m->mem + i * Z80_PG_SIZE;
+	}
+
+	z80_init(&m->z, &bench_z80_ops, m, m->rdpg, m->wrpg);
+	z80_reset(&m->z);
+	z80_set_jit(&m->z, jit);
+	for (i = 0; i < Z80_NPG; i++)
+		z80_set_break_page(&m->z, i, 0);
+
+	start = bench_z80_time();
+	while (m->z.clock < BENCH_Z80_TSTATES)
+		z80_run(&m->z, m->z.clock + BENCH_Z80_FIELD);
+
+	*clock = m->z.clock;
+	z80_fini(&m->z);
+	return bench_z80_time() - start;
+}
+
+/** Run kernel in given mode, keeping the fastest of several runs.
+ *
+ * @param k Kernel
+ * @param jit Non-zero to translate hot code to native code
+ * @param clock Place to store final clock of the CPU
+ * @return Emulated clock rate in MHz
+ */
+static double bench_z80_mhz(const bench_z80_kernel_t *k, int jit,
+    unsigned long *clock)
+{
+	double best = 0;
+	double t;
+	int i;
+
+	for (i = 0; i < BENCH_Z80_REPEAT; i++) {
+		t = bench_z80_run(&bench_m, k, jit, clock);
+		if (i == 0 || t < best)
+			best = t;
+	}
+
+	return *clock / best / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long c0, c1;
+	double f0, f1;
+	size_t i;
+
+	z80_init_tables();
+
+	for (i = 0; i < sizeof(bench_z80_kernels) /
+	    sizeof(bench_z80_kernels[0]); i++) {
+		f0 = bench_z80_mhz(&bench_z80_kernels[i], 0, &c0);
+		f1 = bench_z80_mhz(&bench_z80_kernels[i], 1, &c1);
+		printf("%s: interpreter %.1f MHz, native %.1f MHz (%.2fx)\n",
+		    bench_z80_kernels[i].name, f0, f1, f1 / f0);
+		if (c0 != c1) {
+			printf("%s: T-states differ (%lu / %lu)\n",
+			    bench_z80_kernels[i].name, c0, c1);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -42,4 +42,13 @@
 /** Z80 clock ticks per ULA picture field (50 per second) */
 #define ULA_FIELD_TICKS 70000
 
+/*
+ * Clock comparison is calculated in unsigned long. It works as long
+ * as u.long has least 32 bits, and as long
+ * as the clocks don't diverge by more than 2^31 T-states (=~600s).
+ * (Much more than what is needed.)
+ */
+#define CLOCK_LT(a,b) ( (((a)-(b)) >> 31) != 0 )
+#define CLOCK_GE(a,b) ( (((a)-(b)) >> 31) == 0 )
+
 #endif
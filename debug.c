@@ -34,11 +34,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include "debug.h"
-#include "gzx.h"
 #include "memio.h"
 #include "mgfx.h"
 #include "zx_scr.h"
 #include "z80.h"
+#include "zx.h"
 #include "disasm.h"
 #include "reasm.h"
 #include "sys_all.h"
@@ -107,8 +107,10 @@ static void dflag(char *name, int value)
 }
 
 /** Display register summary. */
-static void debbuger_disp_regs(void)
+static void debbuger_disp_regs(debugger_t *dbg)
 {
+	z80s *cpus = &dbg->zx->cpu.cpus;
+
 	mgfx_fillrect(0, 0, scr_xs - 1, scr_ys - 1, 0);
 
 	bgc = 0;
@@ -119,70 +121,72 @@ static void debbuger_disp_regs(void)
 
 	fgc = 5;
 
+	z80_sync_flags(cpus);
 	gmovec(1, 2);
-	dreg("AF", MK_PAIR(cpus.r[rA], cpus.F));
+	dreg("AF", MK_PAIR(cpus->r[rA], cpus->F));
 	gmovec(1, 3);
-	dreg("BC", MK_PAIR(cpus.r[rB], cpus.r[rC]));
+	dreg("BC", MK_PAIR(cpus->r[rB], cpus->r[rC]));
 	gmovec(1, 4);
-	dreg("DE", MK_PAIR(cpus.r[rD], cpus.r[rE]));
+	dreg("DE", MK_PAIR(cpus->r[rD], cpus->r[rE]));
 	gmovec(1, 5);
-	dreg("HL", MK_PAIR(cpus.r[rH], cpus.r[rL]));
+	dreg("HL", MK_PAIR(cpus->r[rH], cpus->r[rL]));
 
 	gmovec(9, 2);
-	dreg("AF'", MK_PAIR(cpus.r_[rA], cpus.F_));
+	dreg("AF'", MK_PAIR(cpus->r_[rA], cpus->F_));
 	gmovec(9, 3);
-	dreg("BC'", MK_PAIR(cpus.r_[rB], cpus.r_[rC]));
+	dreg("BC'", MK_PAIR(cpus->r_[rB], cpus->r_[rC]));
 	gmovec(9, 4);
-	dreg("DE'", MK_PAIR(cpus.r_[rD], cpus.r_[rE]));
+	dreg("DE'", MK_PAIR(cpus->r_[rD], cpus->r_[rE]));
 	gmovec(9, 5);
-	dreg("HL'", MK_PAIR(cpus.r_[rH], cpus.r_[rL]));
+	dreg("HL'", MK_PAIR(cpus->r_[rH], cpus->r_[rL]));
 
 	gmovec(18, 2);
-	dreg("IX", cpus.IX);
+	dreg("IX", cpus->IX);
 	gmovec(18, 3);
-	dreg("IY", cpus.IY);
+	dreg("IY", cpus->IY);
 	gmovec(18, 4);
-	dreg("IR", MK_PAIR(cpus.I, cpus.R));
+	dreg("IR", MK_PAIR(cpus->I, cpus->R));
 	gmovec(18, 5);
-	dreg("SP", cpus.SP);
+	dreg("SP", cpus->SP);
 
 	gmovec(26, 2);
-	dflag("IFF1:", cpus.IFF1);
+	dflag("IFF1:", cpus->IFF1);
 	gmovec(26, 3);
-	dflag("IFF2:", cpus.IFF2);
+	dflag("IFF2:", cpus->IFF2);
 	gmovec(26, 4);
-	dflag("IM:  ", cpus.int_mode);
+	dflag("IM:  ", cpus->int_mode);
 	gmovec(26, 5);
-	dflag("HLT: ", cpus.halted);
+	dflag("HLT: ", cpus->halted);
 
 	gmovec(33, 2);
-	dflag("ILCK:", cpus.int_lock);
+	dflag("ILCK:", cpus->int_lock);
 	gmovec(33, 3);
-	dflag("FA:", cpus.flags_aff);
+	dflag("FA:", cpus->flags_aff);
 	gmovec(33, 4);
-	dreg8("W", cpus.W);
-	if (has_epg) {
+	dreg8("W", cpus->W);
+	if (dbg->zx->mem.has_epg) {
 		gmovec(33, 5);
-		dreg("P", (page_reg << 8) | epg_reg);
-	} else if (has_banksw) {
+		dreg("P", (dbg->zx->mem.page_reg << 8) |
+		    dbg->zx->mem.epg_reg);
+	} else if (dbg->zx->mem.has_banksw) {
 		gmovec(33, 5);
-		dreg8("Pg", page_reg);
+		dreg8("Pg", dbg->zx->mem.page_reg);
 	}
 
 	gmovec(1, 7);
-	dflag("S:", (cpus.F & fS) != 0);
-	dflag("Z:", (cpus.F & fZ) != 0);
-	dflag("H:", (cpus.F & fHC) != 0);
-	dflag("PV:", (cpus.F & fPV) != 0);
-	dflag("N:", (cpus.F & fN) != 0);
-	dflag("C:", (cpus.F & fC) != 0);
+	dflag("S:", (cpus->F & fS) != 0);
+	dflag("Z:", (cpus->F & fZ) != 0);
+	dflag("H:", (cpus->F & fHC) != 0);
+	dflag("PV:", (cpus->F & fPV) != 0);
+	dflag("N:", (cpus->F & fN) != 0);
+	dflag("C:", (cpus->F & fC) != 0);
 
 	gmovec(30, 7);
-	dreg("PC", cpus.PC);
+	dreg("PC", cpus->PC);
 }
 
 /** Display a couple of entries from the top of the stack. */
-static void debugger_disp_stack(void)
+static void debugger_disp_stack(debugger_t *dbg)
 {
 	char buf[5];
 	int i;
@@ -193,7 +197,8 @@ static void debugger_disp_stack(void)
 
 	fgc = 5;
 	for (i = 0; i < 6; i++) {
-		snprintf(buf, 6, " %04X", zx_memget16(cpus.SP + 2 * i));
+		snprintf(buf, 6, " %04X",
+		    zx_memget16(dbg->zx, dbg->zx->cpu.cpus.SP + 2 * i));
 		gputs(buf);
 	}
 }
@@ -213,7 +218,7 @@ static void debugger_disp_memdump(debugger_t *dbg)
 
 		fgc = 5;
 		for (j = 0; j < 8; j++) {
-			b = zx_memget8(dbg->hex_base + 8 * i + j);
+			b = zx_memget8(dbg->zx, dbg->hex_base + 8 * i + j);
 			snprintf(buf, 16, "%02X", b);
 			if (dbg->focus == dbgv_memory)
 				bgc = 8 * i + j == dbg->mem_off ? 1 : 0;
@@ -225,7 +230,7 @@ static void debugger_disp_memdump(debugger_t *dbg)
 		fgc = 4;
 		gmovec(5 + 8 * 3 + 2, HEX_CY + i);
 		for (j = 0; j < 8; j++) {
-			b = zx_memget8(dbg->hex_base + 8 * i + j);
+			b = zx_memget8(dbg->zx, dbg->hex_base + 8 * i + j);
 			gputc(b);
 		}
 	}
@@ -242,7 +247,7 @@ static void debugger_disp_instr(debugger_t *dbg)
 
 	for (i = 0; i < INSTR_LINES; i++) {
 		bgc = 0;
-		if (disasm_org == cpus.PC)
+		if (disasm_org == dbg->zx->cpu.cpus.PC)
 			bgc |= 2;
 		if (dbg->ic_ln == i && dbg->focus == dbgv_disasm)
 			bgc |= 1;
@@ -251,11 +256,11 @@ static void debugger_disp_instr(debugger_t *dbg)
 		gmovec(1, INSTR_CY + i);
 		gputs(buf);
 
-		disasm_instr();
+		disasm_instr(dbg->zx);
 
 		fgc = 5;
 		for (c = xpos; c != disasm_org; c++) {
-			snprintf(buf, 16, "%02X", zx_memget8(c));
+			snprintf(buf, 16, "%02X", zx_memget8(dbg->zx, c));
 			gputs(buf);
 		}
 
@@ -275,7 +280,7 @@ static void debugger_disp_instr(debugger_t *dbg)
 static void instr_next(debugger_t *dbg)
 {
 	disasm_org = dbg->instr_base;
-	disasm_instr();
+	disasm_instr(dbg->zx);
 	dbg->instr_base = disasm_org;
 }
 
@@ -300,7 +305,7 @@ static void instr_prev(debugger_t *dbg)
 	c = 0;
 	do {
 		last = disasm_org;
-		disasm_instr();
+		disasm_instr(dbg->zx);
 		c++;
 	} while (c < BKTRACE && disasm_org != dbg->instr_base);
 
@@ -322,7 +327,7 @@ static uint16_t debugger_get_cursor_addr(debugger_t *dbg)
 
 	disasm_org = dbg->instr_base;
 	for (i = 0; i < dbg->ic_ln; i++)
-		disasm_instr();
+		disasm_instr(dbg->zx);
 
 	return disasm_org;
 }
@@ -357,11 +362,11 @@ static void debugger_stepover(debugger_t *dbg)
 {
 	uint8_t b;
 
-	b = zx_memget8(cpus.PC);
+	b = zx_memget8(dbg->zx, dbg->zx->cpu.cpus.PC);
 	if (b == 0xCD || (b & 0xC7) == 0xC4) {
 		/* CALL or CALL cond */
-		disasm_org = cpus.PC;
-		disasm_instr();
+		disasm_org = dbg->zx->cpu.cpus.PC;
+		disasm_instr(dbg->zx);
 		debugger_run_upto(dbg, disasm_org);
 	} else {
 		debugger_trace(dbg);
@@ -383,11 +388,11 @@ static void debugger_to_cursor(debugger_t *dbg)
 }
 
 /** View spectrum screen without quitting the debugger. */
-static void debugger_view_scr(void)
+static void debugger_view_scr(debugger_t *dbg)
 {
 	wkey_t k;
 
-	zx_scr_disp_fast();
+	zx_scr_disp_fast(dbg->zx);
 	mgfx_updscr();
 	while (1) {
 		mgfx_input_update();
@@ -697,7 +702,7 @@ static void debugger_key_unmod(debugger_t *dbg, wkey_t k)
 		debugger_to_cursor(dbg);
 		break;
 	case WKEY_F11:
-		debugger_view_scr();
+		debugger_view_scr(dbg);
 		break;
 	default:
 		break;
@@ -723,14 +728,14 @@ static void debugger_enter_str(debugger_t *dbg, const char *str)
 		addr = debugger_get_cursor_addr(dbg);
 		rc = reasm_instr(addr, str, buf, sizeof(buf));
 		for (i = 0; i < rc; i++) {
-			zx_memset8(addr + i, buf[i]);
+			zx_memset8(dbg->zx, addr + i, buf[i]);
 		}
 		break;
 	case dbgv_memory:
 		val = (uint16_t)strtoul(str, &eptr, 16);
 		if (str[0] != '\0' && *eptr == '\0') {
 			/* conversion successful */
-			zx_memset8(dbg->hex_base + dbg->mem_off, val);
+			zx_memset8(dbg->zx, dbg->hex_base + dbg->mem_off, val);
 		}
 		break;
 	}
@@ -792,9 +797,9 @@ static void debugger_display(debugger_t *dbg)
 {
 	mgfx_selln(3);
 
-	debbuger_disp_regs();
+	debbuger_disp_regs(dbg);
 	debugger_disp_memdump(dbg);
-	debugger_disp_stack();
+	debugger_disp_stack(dbg);
 	debugger_disp_instr(dbg);
 
 	if (dbg->teline.focus != 0)
@@ -814,7 +819,7 @@ void debugger_run(debugger_t *dbg)
 	dbg->itrap_enabled = false;
 
 	dbg->focus = dbgv_disasm;
-	dbg->instr_base = cpus.PC;
+	dbg->instr_base = dbg->zx->cpu.cpus.PC;
 	dbg->ic_ln = 0;
 	dbg->exit = false;
 
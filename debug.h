@@ -56,7 +56,11 @@ enum {
 	dbgv_limit = dbgv_memory + 1
 };
 
+struct zx_machine;
+
 typedef struct {
+	/** Machine being debugged */
+	struct zx_machine *zx;
 	/** Which debugger view is focused */
 	dbg_view_t focus;
 	/** Which debugger edit function is active */
@@ -67,11 +67,14 @@ char disasm_buf[BUF_SIZE];
 
 static int out_pos;
 
+/** Machine whose memory is being disassembled */
+static zx_machine_t *da_zx;
+
 static int da_getc(void)
 {
 	int b;
 
-	b = zx_memget8(in_pos++);
+	b = zx_memget8(da_zx, in_pos++);
 	disasm_org = in_pos;
 
 	return b;
@@ -276,11 +279,12 @@ static int dec_instr(void)
 	return 0;
 }
 
-int disasm_instr(void)
+int disasm_instr(zx_machine_t *zx)
 {
 	char *ops;
 	int l;
 
+	da_zx = zx;
 	in_pos = disasm_org;
 
 	out_pos = 0;
@@ -0,0 +1,227 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Device event scheduler
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Device event scheduler
+ *
+ * Devices that need to do something at a particular time (produce
+ * an audio sample, sample the tape, end a video field) register an event.
+ * The CPU then runs uninterrupted until the earliest event is due, so the
+ * cost of keeping devices up to date is per event, not per instruction.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include "clock.h"
+#include "evsched.h"
+
+/** Determine if event @a a is due before event @a b.
+ *
+ * @param a First event
+ * @param b Second event
+ * @return @c true iff @a a is due before @a b
+ */
+static bool evsched_before(evsched_event_t *a, evsched_event_t *b)
+{
+	return CLOCK_LT(a->clock, b->clock);
+}
+
+/** Store event at heap position.
+ *
+ * @param sched Event scheduler
+ * @param idx Heap position
+ * @param ev Event
+ */
+static void evsched_set(evsched_t *sched, int idx, evsched_event_t *ev)
+{
+	sched->heap[idx] = ev;
+	ev->idx = idx;
+}
+
+/** Move event towards the top of the heap until heap order is restored.
+ *
+ * @param sched Event scheduler
+ * @param idx Heap position of the event
+ */
+static void evsched_up(evsched_t *sched, int idx)
+{
+	evsched_event_t *ev = sched->heap[idx];
+	int parent;
+
+	while (idx > 0) {
+		parent = (idx - 1) / 2;
+		if (!evsched_before(ev, sched->heap[parent]))
+			break;
+		evsched_set(sched, idx, sched->heap[parent]);
+		idx = parent;
+	}
+
+	evsched_set(sched, idx, ev);
+}
+
+/** Move event towards the bottom of the heap until heap order is restored.
+ *
+ * @param sched Event scheduler
+ * @param idx Heap position of the event
+ */
+static void evsched_down(evsched_t *sched, int idx)
+{
+	evsched_event_t *ev = sched->heap[idx];
+	int child;
+
+	while (true) {
+		child = 2 * idx + 1;
+		if (child >= sched->nev)
+			break;
+		if (child + 1 < sched->nev &&
+		    evsched_before(sched->heap[child + 1], sched->heap[child]))
+			++child;
+		if (!evsched_before(sched->heap[child], ev))
+			break;
+		evsched_set(sched, idx, sched->heap[child]);
+		idx = child;
+	}
+
+	evsched_set(sched, idx, ev);
+}
+
+/** Initialize event scheduler.
+ *
+ * @param sched Event scheduler
+ */
+void evsched_init(evsched_t *sched)
+{
+	sched->nev = 0;
+}
+
+/** Initialize event.
+ *
+ * @param ev Event
+ * @param handler Function called when the event is due
+ * @param arg Argument to @a handler
+ */
+void evsched_event_init(evsched_event_t *ev, void (*handler)(void *),
+    void *arg)
+{
+	ev->clock = 0;
+	ev->handler = handler;
+	ev->arg = arg;
+	ev->idx = -1;
+}
+
+/** Schedule event.
+ *
+ * If the event is already scheduled, it is moved to the new time.
+ *
+ * @param sched Event scheduler
+ * @param ev Event
+ * @param clock Clock value at which the event is due
+ */
+void evsched_at(evsched_t *sched, evsched_event_t *ev, unsigned long clock)
+{
+	if (ev->idx < 0) {
+		assert(sched->nev < EVSCHED_MAX);
+		ev->clock = clock;
+		evsched_set(sched, sched->nev++, ev);
+		evsched_up(sched, ev->idx);
+		return;
+	}
+
+	ev->clock = clock;
+	evsched_up(sched, ev->idx);
+	evsched_down(sched, ev->idx);
+}
+
+/** Cancel event.
+ *
+ * @param sched Event scheduler
+ * @param ev Event (does nothing if it is not scheduled)
+ */
+void evsched_cancel(evsched_t *sched, evsched_event_t *ev)
+{
+	int idx = ev->idx;
+
+	if (idx < 0)
+		return;
+
+	ev->idx = -1;
+	if (--sched->nev == idx)
+		return;
+
+	evsched_set(sched, idx, sched->heap[sched->nev]);
+	evsched_up(sched, idx);
+	evsched_down(sched, sched->heap[idx]->idx);
+}
+
+/** Determine if event is scheduled.
+ *
+ * @param ev Event
+ * @return @c true iff @a ev is scheduled
+ */
+bool evsched_is_scheduled(evsched_event_t *ev)
+{
+	return ev->idx >= 0;
+}
+
+/** Determine the clock value of the earliest event.
+ *
+ * @param sched Event scheduler
+ * @param dflt Value to return if no event is scheduled
+ * @return Clock value at which the earliest event is due
+ */
+unsigned long evsched_next(evsched_t *sched, unsigned long dflt)
+{
+	if (sched->nev == 0)
+		return dflt;
+
+	return sched->heap[0]->clock;
+}
+
+/** Run handlers of all events that are due.
+ *
+ * Events are processed in order of their due time. An event is removed
+ * from the schedule before its handler is called. The handler can
+ * schedule it again, if it is due already, it will be processed
+ * in the same call.
+ *
+ * @param sched Event scheduler
+ * @param clock Current clock value
+ */
+void evsched_dispatch(evsched_t *sched, unsigned long clock)
+{
+	evsched_event_t *ev;
+
+	while (sched->nev > 0 && CLOCK_GE(clock, sched->heap[0]->clock)) {
+		ev = sched->heap[0];
+		evsched_cancel(sched, ev);
+		ev->handler(ev->arg);
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Device event scheduler
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EVSCHED_H
+#define EVSCHED_H
+
+#include <stdbool.h>
+
+/** Maximum number of scheduled events */
+#define EVSCHED_MAX 16
+
+/** Scheduled event */
+typedef struct {
+	/** Clock value at which the event is due */
+	unsigned long clock;
+	/** Handler */
+	void (*handler)(void *);
+	/** Argument to the handler */
+	void *arg;
+	/** Position in the event heap or -1 if not scheduled */
+	int idx;
+} evsched_event_t;
+
+/** Event scheduler
+ *
+ * Keeps scheduled events in a binary min-heap ordered by due time.
+ */
+typedef struct {
+	/** Event heap */
+	evsched_event_t *heap[EVSCHED_MAX];
+	/** Number of scheduled events */
+	int nev;
+} evsched_t;
+
+extern void evsched_init(evsched_t *);
+extern void evsched_event_init(evsched_event_t *, void (*)(void *), void *);
+extern void evsched_at(evsched_t *, evsched_event_t *, unsigned long);
+extern void evsched_cancel(evsched_t *, evsched_event_t *);
+extern bool evsched_is_scheduled(evsched_event_t *);
+extern unsigned long evsched_next(evsched_t *, unsigned long);
+extern void evsched_dispatch(evsched_t *, unsigned long);
+
+#endif
@@ -108,6 +108,11 @@ void fputu16le(FILE *f, uint16_t val) {
   fputu8(f,val>>8);
 }
 
+void fputu32le(FILE *f, uint32_t val) {
+  fputu16le(f,val&0xffff);
+  fputu16le(f,val>>16);
+}
+
 void fputu16be(FILE *f, uint16_t val) {
   fputu8(f,val>>8);
   fputu8(f,val&0xff);
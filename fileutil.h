@@ -49,6 +49,7 @@ unsigned long fsize(FILE *f);
 
 void fputu8(FILE *f, uint8_t val);
 void fputu16le(FILE *f, uint16_t val);
+void fputu32le(FILE *f, uint32_t val);
 void fputu16be(FILE *f, uint16_t val);
 
 #endif
@@ -31,6 +31,8 @@
 
 #undef LOG
 
+#include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -38,19 +40,27 @@
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
+#include "batch.h"
 #include "clock.h"
 #include "memio.h"
 #include "midi.h"
 #include "mgfx.h"
+#include "pace.h"
 #include "fnt.h"
 #include "gzx.h"
+#include "headless.h"
 #include "iorec.h"
+#include "joystick/kempston.h"
 #include "z80.h"
 #include "zx_kbd.h"
 #include "zx_scr.h"
-#include "rs232.h"
+#include "rewind.h"
+#include "runahead.h"
+#include "rzx.h"
 #include "snap.h"
-#include "tape/quick.h"
+#include "state.h"
+#include "strutil.h"
+#include "tape/deck.h"
 #include "ui/display.h"
 #include "ui/fdlg.h"
 #include "ui/font.h"
@@ -65,72 +75,78 @@
 #include "debug.h"
 #include "xmap.h"
 #include "xtrace.h"
-#include "z80g.h"
 #include "zx.h"
 #include "sys_all.h"
 #include "sysmidi.h"
 
-/*
- * Clock comparison is calculated in unsigned long. It works as long
- * as u.long has least 32 bits, and as long
- * as the clocks don't diverge by more than 2^31 T-states (=~600s).
- * (Much more than what is needed.)
- */
-#define CLOCK_LT(a,b) ( (((a)-(b)) >> 31) != 0 )
-#define CLOCK_GE(a,b) ( (((a)-(b)) >> 31) == 0 )
-
 static void zx_scr_save(void);
-static void zx_proc_instr(void);
 
 int scr_no = 0;
 
-FILE *logfi;
+int quit = 0;
 
-static unsigned long disp_t;
+/** Pace emulation to the host clock */
+bool pace_enabled = true;
+/** Host clock pacing */
+static pace_t pace;
 
-int quit = 0;
-int slow_load = 0;
+/** Default rewind buffer memory budget in megabytes */
+#define REWIND_BUDGET_DEF 16
+/** Number of fields between rewind snapshots */
+#define REWIND_INTERVAL 25
+
+/** Rewind buffer memory budget in megabytes (zero to disable rewind) */
+static unsigned long rewind_budget = REWIND_BUDGET_DEF;
+/** Rewind buffer or @c NULL if rewind is disabled */
+static rewind_t *zx_rewind;
 
 /** User interface lock */
 static bool ui_lock = false;
 
-/* Start up working directory */
-/* ... used as base for finding the ROM files */
-char *start_dir;
-
-/** MIDI device specification */
-const char *midi_dev;
-
-/** I/O recording */
-iorec_t *iorec;
+/** Run without user interface, audio output or pacing (batch mode) */
+static bool headless = false;
+
+/** Batch: manifest file */
+static const char *batch_manifest;
+/** Batch: maximum number of jobs running at the same time */
+static int batch_njobs;
+
+/** Machine */
+zx_machine_t *zx0;
+
+/** Collect instruction statistics (-stats) */
+static bool opt_stats;
+/** Record executed addresses (-xmap) */
+static bool opt_xmap;
+/** Log executed instructions (-xtrace) */
+static bool opt_xtrace;
+/** Do not translate hot code to native code (-no-jit) */
+static bool opt_no_jit;
+/** Stop address given (-until-pc) */
+static bool opt_stop_pc_enabled;
+/** Stop address (-until-pc) */
+static uint16_t opt_stop_pc;
+/** Load tapes in real time (-slow-load) */
+static bool opt_slow_load;
+
+/** RZX file to play back */
+static const char *rzx_play_fname;
+/** RZX file to record to */
+static const char *rzx_rec_fname;
 
 int key_lalt_held;
 int key_lshift_held;
 
-static uint8_t tape_smp;
-
 /** Lock down user interface */
 void gzx_ui_lock(void)
 {
 	ui_lock = true;
 }
 
-/** Notify on 48K mode change.
- *
- * 48K mode is on if we're Spectrum 48K (or lower) or if we are Spectrum
- * 128K or higher locked in 48K emulation mode.
- */
-void gzx_notify_mode_48k(bool mode48k)
-{
-	/* Tape needs to know to handle Stop the tape if in 48K mode */
-	if (tape_deck != NULL)
-		tape_deck_set_48k(tape_deck, mode48k);
-}
-
 void gzx_toggle_dbl_ln(void)
 {
 	mgfx_toggle_dbl_ln();
-	zx_scr_disp_fast();
+	zx_scr_disp_fast(zx0);
 }
 
 static void key_unmod(wkey_t *k)
@@ -160,7 +176,7 @@ static void key_unmod(wkey_t *k)
 		hwopts_menu();
 		break;
 	case WKEY_F7:
-		zx_reset();
+		zx_reset(zx0);
 		break;
 	case WKEY_F8:
 		model_menu();
@@ -176,24 +192,25 @@ static void key_unmod(wkey_t *k)
 		mgfx_toggle_fs();
 		break;
 	case WKEY_NPLUS:
-		tape_deck_play(tape_deck);
+		tape_deck_play(zx0->tape_deck);
 		break;
 	case WKEY_NMINUS:
-		tape_deck_stop(tape_deck);
+		tape_deck_stop(zx0->tape_deck);
 		break;
 	case WKEY_NSTAR:
-		tape_deck_rewind(tape_deck);
+		tape_deck_rewind(zx0->tape_deck);
 		break;
 	case WKEY_NSLASH:
-		slow_load = !slow_load;
+		zx0->slow_load = !zx0->slow_load;
+		break;
+	case WKEY_NENTER:
+		zx0->warp_mode = !zx0->warp_mode;
 		break;
-#ifdef XMAP
 	case WKEY_N5:
-		xmap_clear();
+		xmap_clear(zx0);
 		break;
-#endif
 	case WKEY_F12:
-		debugger_run(&dbg);
+		zx_debugger_run(zx0);
 		break;
 	default:
 		break;
@@ -204,13 +221,13 @@ static void key_lalt(wkey_t *k)
 {
 	switch (k->key) {
 	case WKEY_R:
-		if (iorec == NULL)
-			(void) iorec_open("out.ior", &iorec);
+		if (zx0->iorec == NULL)
+			(void) iorec_open("out.ior", &zx0->iorec);
 		break;
 	case WKEY_T:
-		if (iorec != NULL) {
-			iorec_close(iorec);
-			iorec = NULL;
+		if (zx0->iorec != NULL) {
+			iorec_close(zx0->iorec);
+			zx0->iorec = NULL;
 		}
 		break;
 	case WKEY_W:
@@ -219,19 +236,31 @@ static void key_lalt(wkey_t *k)
 		break;
 	case WKEY_E:
 		printf("Stopping audio capture.\n");
-		zx_sound_stop_capture();
+		zx_sound_stop_capture(zx0);
 		break;
 	case WKEY_N:
-		zx_scr_prev_bg();
+		zx_scr_prev_bg(zx0);
 		break;
 	case WKEY_M:
-		zx_scr_next_bg();
+		zx_scr_next_bg(zx0);
 		break;
 	case WKEY_9:
-		zx_scr_mode(0);
+		zx_scr_mode(zx0, 0);
 		break;
 	case WKEY_0:
-		zx_scr_mode(1);
+		zx_scr_mode(zx0, 1);
+		break;
+	case WKEY_B:
+		if (zx_rewind != NULL && zx0->rzx == NULL)
+			(void) rewind_back(zx_rewind);
+		break;
+	case WKEY_X:
+		zx0->xtrace_enabled = !zx0->xtrace_enabled;
+		zx_update_instrumented(zx0);
+		break;
+	case WKEY_S:
+		zx0->stat_enabled = !zx0->stat_enabled;
+		zx_update_instrumented(zx0);
 		break;
 	}
 }
@@ -253,25 +282,25 @@ static void key_joy_state_set(int key, int press)
 {
 	switch (key) {
 	case WKEY_UP:
-		kempston_joy_set_reset(&kjoy0, kempston_up, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_up, press);
 		break;
 	case WKEY_DOWN:
-		kempston_joy_set_reset(&kjoy0, kempston_down, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_down, press);
 		break;
 	case WKEY_LEFT:
-		kempston_joy_set_reset(&kjoy0, kempston_left, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_left, press);
 		break;
 	case WKEY_RIGHT:
-		kempston_joy_set_reset(&kjoy0, kempston_right, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_right, press);
 		break;
 	case WKEY_INS:
-		kempston_joy_set_reset(&kjoy0, kempston_button_1, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_button_1, press);
 		break;
 	case WKEY_DEL:
-		kempston_joy_set_reset(&kjoy0, kempston_button_2, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_button_2, press);
 		break;
 	case WKEY_HOME:
-		kempston_joy_set_reset(&kjoy0, kempston_button_3, press);
+		kempston_joy_set_reset(&zx0->kjoy, kempston_button_3, press);
 		break;
 	}
 }
@@ -303,7 +332,7 @@ static void key_handler(wkey_t *k)
 		return;
 	}
 
-	zx_key_state_set(&keys, k->key, k->press ? 1 : 0);
+	zx_key_state_set(&zx0->keys, k->key, k->press ? 1 : 0);
 	key_joy_state_set(k->key, k->press ? 1 : 0);
 
 	if (k->press && !ui_lock) {
@@ -318,70 +347,18 @@ static void zx_scr_save(void)
 
 	snprintf(name, 32, "scr%04d.bin", scr_no++);
 	f = fopen(name, "wb");
-	fwrite(zxscr, 1, 0x1B00, f);
+	fwrite(zx0->mem.scr, 1, 0x1B00, f);
 	fclose(f);
 }
 
-/** Value was written to AY I/O port.
+/** Initialize the emulator.
  *
- * @param arg Callback argument
- * @param val Value
+ * @return Zero on success, -1 on error
  */
-static void gzx_ay_ioport_write(void *arg, uint8_t val)
-{
-	rs232_write(&rs232, val);
-}
-
-/** Character was sent via RS-232 port */
-static void gzx_rs232_sendchar(void *arg, uint8_t val)
-{
-	midi_port_write(&midi, val);
-}
-
-/** Midi event was sent via MIDI port */
-static void gzx_midi_msg(void *arg, midi_msg_t *msg)
-{
-#ifdef WITH_MIDI
-	sysmidi_send_msg(z80_clock, msg);
-#endif
-}
-
-static unsigned long snd_t, tapp_t;
-
-void zx_reset(void)
-{
-#ifdef XTRACE
-	xtrace_reset();
-#endif
-	if (gpu_is_on()) {
-		gpu_reset();
-		gpu_disable();
-	}
-	zx_scr_reset();
-	z80_reset();
-	ay_reset(&ay0);
-	zx_mem_page_reset();
-}
-
-static int zx_init(void)
+static int gzx_init(void)
 {
 	int rc;
 
-	fprintf(logfi, "Start initialization.\n");
-	//  printf("coreleft:%lu\n",coreleft());
-
-	z80_init_tables();
-
-	/* important! otherwise zx_select_memmodel would crash reallocing */
-	zxrom = NULL;
-	zxram = NULL;
-	zx_select_memmodel(ZXM_48K);
-
-	fprintf(logfi, "Initialize GPU.\n");
-	gpu_init();
-	//  if (gpu_enable() < 0)
-	//    return -1;
-
 	fprintf(logfi, "Load font.\n");
 
 	rc = gloadfont("fonts/font.bin");
@@ -396,68 +373,40 @@ static int zx_init(void)
 		return -1;
 	}
 
-	fprintf(logfi, "Initialize screen.\n");
-	rc = zx_scr_init(0);
-	if (rc < 0) {
-		printf("Error initializing screen.\n");
-		return -1;
-	}
-
-	fprintf(logfi, "Initialize keyboard.\n");
-	zx_keys_init(&keys);
-	if (zx_sound_init() < 0) {
-		printf("Error initializing sound.\n");
-		return -1;
-	}
-
 #ifdef WITH_MIDI
 	if (sysmidi_init(midi_dev) < 0) {
 		printf("Note: MIDI not available.\n");
 	}
 #endif
 
-	fprintf(logfi, "Initialize AY.\n");
-	ay_init(&ay0, ZX_SOUND_TICKS_SMP);
-
-	ay0.ioport_write = gzx_ay_ioport_write;
-	ay0.ioport_write_arg = &ay0;
-
-	rs232_init(&rs232, Z80_CLOCK / MIDI_BAUD);
-	rs232.sendchar = gzx_rs232_sendchar;
-	rs232.sendchar_arg = &rs232;
-
-	midi_port_init(&midi);
-	midi.midi_msg = gzx_midi_msg;
-	midi.midi_msg_arg = &midi;
-
-	kempston_joy_init(&kjoy0);
+	if (zx_create(true, !headless, &zx0) < 0)
+		return -1;
 
-	fprintf(logfi, "Create tape deck.\n");
-	if (tape_deck_create(&tape_deck, ZX_TAPE_TICKS_SMP, true) != 0) {
-		printf("Error creating tape deck.\n");
+	zx0->stat_enabled = opt_stats;
+	zx0->xtrace_enabled = opt_xtrace;
+	zx0->stop_pc_enabled = opt_stop_pc_enabled;
+	zx0->stop_pc = opt_stop_pc;
+	zx0->slow_load = opt_slow_load;
+	if (opt_no_jit)
+		z80_set_jit(&zx0->cpu, 0);
+	if (opt_xmap && xmap_enable(zx0) != 0) {
+		printf("Out of memory.\n");
 		return -1;
 	}
 
-	zx_reset();
-
-	disp_t = 0;
-	snd_t = 0;
-	tapp_t = 0;
-
-	border = 7;
-
-	fprintf(logfi, "Initialization done.\n");
+	zx_code_break_update(zx0);
 	return 0;
 }
 
 static void writestat_i(int i)
 {
+	z80_t *cpu = &zx0->cpu;
 	int j;
 
 	for (j = 0; j < 64; j++) {
 		fprintf(logfi, "0x%02x: %10d, %10d, %10d, %10d\n", j * 4,
-		    z80_getstat(i, 4 * j),  z80_getstat(i, 4 * j + 1),
-		    z80_getstat(i, 4 * j + 2), z80_getstat(i, 4 * j + 3));
+		    z80_getstat(cpu, i, 4 * j),  z80_getstat(cpu, i, 4 * j + 1),
+		    z80_getstat(cpu, i, 4 * j + 2), z80_getstat(cpu, i, 4 * j + 3));
 	}
 }
 
@@ -479,72 +428,47 @@ static void writestat(void)
 	writestat_i(6);
 }
 
-/** Process an instruction and anything that we check for every instruction. */
-static void zx_proc_instr(void)
+/** Wait until the field that has just been emulated is due.
+ *
+ * Decides whether the next field will be drawn, too.
+ */
+static void zx_pace_field(void)
 {
-	if (!gpu_is_on()) {
-		while (CLOCK_LT(zx_scr_get_clock(), z80_clock)) {
-			zx_scr_disp();
-		}
-	} else {
-		while (CLOCK_LT(zx_scr_get_clock(), z80_clock)) {
-			zx_scr_disp_fast();
-		}
+	if (zx0->warp_on || !pace_enabled) {
+		pace_reset(&pace);
+		zx0->field_skip = false;
+		return;
 	}
 
-	if (CLOCK_GE(z80_clock - snd_t, ZX_SOUND_TICKS_SMP)) {
-		zx_sound_smp(ay_get_sample(&ay0) + (tape_smp ? +16 : -16));
-		/* build a new sound sample */
-		snd_t += ZX_SOUND_TICKS_SMP;
-	}
-	if (CLOCK_GE(z80_clock - tapp_t, ZX_TAPE_TICKS_SMP)) {
-		tape_deck_getsmp(tape_deck, &tape_smp);
-		ear = tape_smp;
-		tapp_t += ZX_TAPE_TICKS_SMP;
-	}
-	if (!slow_load) {
-		if (cpus.PC == TAPE_LDBYTES_TRAP && zx_mem_is_48k_basic_rom()) {
-			fprintf(logfi, "Load trapped.\n");
-			tape_quick_ldbytes(tape_deck);
-		}
-		if (cpus.PC == TAPE_SABYTES_TRAP && zx_mem_is_48k_basic_rom()) {
-			fprintf(logfi, "Save trapped!\n");
-			tape_quick_sabytes(tape_deck);
-		}
-	}
-	if (dbg.stop_enabled && cpus.PC == dbg.stop_addr) {
-		debugger_run(&dbg);
-	}
-#ifdef XMAP
-	xmap_mark();
-#endif
-#ifdef XTRACE
-	xtrace_instr();
-#endif
+	zx0->field_skip = !pace_field(&pace);
+}
 
-	if (gpu_is_on())
-		z80_g_execinstr();
-	else
-		z80_execinstr();
-
-	/* Instruction trap? */
-	if (dbg.itrap_enabled) {
-		/*
-		 * Normally we don't want to break into debugger during int_lock
-		 * (i.e. after DD/CB prefix. However, if there are more DD/CB
-		 * prefixes in sequence, we will break into debugger.
-		 */
-		if (!cpus.int_lock || dbg.prev_int_lock)
-			debugger_run(&dbg);
-		dbg.prev_int_lock = cpus.int_lock;
+/** Get argument of a command-line option.
+ *
+ * Exits with an error message if the argument is missing.
+ *
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @param argi Index of the option
+ * @return Option argument
+ */
+static const char *gzx_optarg(int argc, char **argv, int argi)
+{
+	if (argc <= argi + 1) {
+		printf("Option %s missing argument.\n", argv[argi]);
+		exit(1);
 	}
+
+	return argv[argi + 1];
 }
 
 int main(int argc, char **argv)
 {
 	int argi;
-	timer frmt;
+	bool drawn;
+	bool ra;
 	wkey_t k;
+	int rc;
 
 	argi = 1;
 
@@ -552,11 +476,90 @@ int main(int argc, char **argv)
 
 	while (argc > argi && argv[argi][0] == '-') {
 		if (!strcmp(argv[argi], "-midi")) {
-			if (argc <= argi + 1) {
-				printf("Option -midi missing argument.\n");
+			midi_dev = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-latency")) {
+			zx_sound_latency = atoi(gzx_optarg(argc, argv, argi));
+			if (zx_sound_latency <= 0) {
+				printf("Invalid latency '%s'.\n",
+				    argv[argi + 1]);
+				exit(1);
+			}
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-rewind")) {
+			rewind_budget = strtoul(gzx_optarg(argc, argv, argi),
+			    NULL, 0);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-runahead")) {
+			runahead = atoi(gzx_optarg(argc, argv, argi));
+			if (runahead > RUNAHEAD_MAX) {
+				printf("Invalid number of run-ahead fields "
+				    "'%s'.\n", argv[argi + 1]);
 				exit(1);
 			}
-			midi_dev = argv[argi + 1];
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-rzx")) {
+			rzx_play_fname = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-rzx-rec")) {
+			rzx_rec_fname = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-stats")) {
+			opt_stats = true;
+			++argi;
+		} else if (!strcmp(argv[argi], "-xmap")) {
+			opt_xmap = true;
+			++argi;
+		} else if (!strcmp(argv[argi], "-xtrace")) {
+			opt_xtrace = true;
+			++argi;
+		} else if (!strcmp(argv[argi], "-no-jit")) {
+			opt_no_jit = true;
+			++argi;
+		} else if (!strcmp(argv[argi], "-headless")) {
+			headless = true;
+			++argi;
+		} else if (!strcmp(argv[argi], "-batch")) {
+			batch_manifest = gzx_optarg(argc, argv, argi);
+			headless = true;
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-jobs")) {
+			batch_njobs = atoi(gzx_optarg(argc, argv, argi));
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-hash-fields")) {
+			hl_hash_fields = strtoul(gzx_optarg(argc, argv, argi),
+			    NULL, 0);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-fields")) {
+			hl_fields = strtoul(gzx_optarg(argc, argv, argi),
+			    NULL, 0);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-until-pc")) {
+			opt_stop_pc = strtoul(gzx_optarg(argc, argv, argi),
+			    NULL, 0);
+			opt_stop_pc_enabled = true;
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-timeout")) {
+			hl_timeout = atof(gzx_optarg(argc, argv, argi)) *
+			    1000000.0;
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-tape")) {
+			hl_tape = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-slow-load")) {
+			opt_slow_load = true;
+			++argi;
+		} else if (!strcmp(argv[argi], "-dump-scr")) {
+			hl_dump_scr = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-dump-img")) {
+			hl_dump_img = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-dump-wav")) {
+			hl_dump_wav = gzx_optarg(argc, argv, argi);
+			argi += 2;
+		} else if (!strcmp(argv[argi], "-dump-cpu")) {
+			hl_dump_cpu = gzx_optarg(argc, argv, argi);
 			argi += 2;
 		} else {
 			printf("Invalid option '%s'.\n", argv[argi]);
@@ -564,15 +567,14 @@ int main(int argc, char **argv)
 		}
 	}
 
-	uoc = 0;
-	smc = 0;
-
 	logfi = fopen("log.txt", "wt");
 
 	start_dir = sys_getcwd(NULL, 0);
 
-	if (zx_init() < 0)
+	if (gzx_init() < 0)
 		return -1;
+
+	zx_update_instrumented(zx0);
 	/*  slow_load=1; */
 	/*
 	 * if(zx_load_snap(SNAP_NAME1)<0) {
@@ -581,48 +583,90 @@ int main(int argc, char **argv)
 	 * }
 	 */
 
-	if (argc > argi && zx_load_snap(argv[argi]) < 0) {
+	if (batch_manifest != NULL) {
+		rc = batch_run(zx0, batch_manifest, batch_njobs);
+		zx_destroy(zx0);
+		fclose(logfi);
+		return rc;
+	}
+
+	if (argc > argi && zx_load_snap(zx0, argv[argi]) < 0) {
 		printf("Error loading snapshot.\n");
 		return -1;
 	}
 
+	if (zx_rzx_start(zx0, rzx_play_fname, rzx_rec_fname) < 0)
+		return -1;
+
+	if (headless) {
+		rc = headless_run(zx0, hl_tape != NULL && argc <= argi);
+		zx_destroy(zx0);
+		fclose(logfi);
+		return rc;
+	}
+
 	//printf("inited.\n");
 
-	timer_reset(&frmt);
+	pace_init(&pace, (uint64_t)ULA_FIELD_TICKS * 1000000 / Z80_CLOCK);
+
+	if (rewind_budget != 0 && rewind_create(zx0,
+	    rewind_budget * 1024 * 1024, REWIND_INTERVAL, &zx_rewind) != 0) {
+		printf("Error creating rewind buffer.\n");
+		return -1;
+	}
 
 	while (!quit) {
-		if (CLOCK_GE(z80_clock - disp_t, ULA_FIELD_TICKS)) { /* every 50th of a second */
-			disp_t += ULA_FIELD_TICKS;
+		if (zx_dispatch(zx0)) {
 #ifdef WITH_MIDI
-			sysmidi_poll(z80_clock);
+			sysmidi_poll(zx0->cpu.clock);
 #endif
-			mgfx_updscr();
+			ra = runahead_on(zx0);
+			drawn = zx_field_drawn(zx0);
+			zx_pace_field();
+			if (drawn && !ra)
+				mgfx_updscr();
+
+			if (zx_rewind != NULL)
+				rewind_field(zx_rewind);
 
 			mgfx_input_update();
 			while (w_getkey(&k))
 				key_handler(&k);
+			zx_update_warp(zx0);
+
+			if (ra && runahead_on(zx0)) {
+				if (!zx0->field_skip &&
+				    runahead_run(zx0) != 0) {
+					printf("Run-ahead failed, disabling.\n");
+					runahead = 0;
+				} else {
+					/* The canonical timeline is not shown */
+					zx0->field_skip = true;
+				}
+			}
 #ifdef LOG
-			if (cpus.iff1)
+			if (zx0->cpu.cpus.iff1)
 				fprintf(logfi, "interrupt\n");
 #endif
 		}
 
-		zx_proc_instr();
+		zx_exec(zx0);
 	}
 
 	/* Graphics is closed automatically atexit() */
 
-#ifdef XMAP
-	xmap_save();
-#endif
+	if (zx0->xmap_enabled)
+		xmap_save(zx0);
 
-	zx_sound_done();
-	tape_deck_destroy(tape_deck);
-	tape_deck = NULL;
+	rewind_destroy(zx_rewind);
+	zx_rewind = NULL;
 
-	writestat();
+	if (zx0->stat_enabled)
+		writestat();
+	runahead_writestat();
 
-	fprintf(logfi, "\nuoc:%lu\nsmc:%lu\n", uoc, smc);
+	fprintf(logfi, "\nuoc:%lu\nsmc:%lu\n", zx0->cpu.uoc, zx0->cpu.smc);
+	zx_destroy(zx0);
 	fprintf(logfi, "Quitting.\n");
 	fclose(logfi);
 	return 0;
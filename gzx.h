@@ -33,22 +33,14 @@
 #define GZX_H
 
 #include <stdbool.h>
-#include <stdio.h>
-#include "iorec.h"
-
-void zx_reset(void);
+#include "types/zx.h"
 
 void zx_debug_mstep(void);
 void gzx_ui_lock(void);
-void gzx_notify_mode_48k(bool);
 void gzx_toggle_dbl_ln(void);
 
-extern char *start_dir;
-extern FILE *logfi;
+extern zx_machine_t *zx0;
 extern int quit;
-
-extern int slow_load;
-
-extern iorec_t *iorec;
+extern bool pace_enabled;
 
 #endif
@@ -0,0 +1,59 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Hash functions
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hash.h"
+
+/** FNV-1a 32-bit prime */
+#define HASH_FNV1A_PRIME 0x01000193u
+
+/** Compute 32-bit FNV-1a hash.
+ *
+ * The hash can be computed incrementally by passing the result of
+ * the previous call as @a hash.
+ *
+ * @param hash Hash of previous data or HASH_FNV1A_INIT
+ * @param data Data
+ * @param size Size of data in bytes
+ * @return Hash
+ */
+uint32_t hash_fnv1a(uint32_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	while (size-- > 0) {
+		hash ^= *p++;
+		hash *= HASH_FNV1A_PRIME;
+	}
+
+	return hash;
+}
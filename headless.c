@@ -0,0 +1,309 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Headless mode
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Headless mode
+ *
+ * The machine runs without user interface, audio output or pacing until
+ * a field limit, a stop address or a time limit is reached. The results
+ * (screen, CPU state, audio) are then printed or saved to files.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "clock.h"
+#include "hash.h"
+#include "headless.h"
+#include "memio.h"
+#include "mgfx.h"
+#include "sys_all.h"
+#include "tape/deck.h"
+#include "z80.h"
+#include "zx.h"
+#include "zx_kbd.h"
+#include "zx_sound.h"
+
+/** Stop after this many fields (zero for no limit) */
+unsigned long hl_fields;
+/** Wall-clock time limit in microseconds (zero for no limit) */
+uint64_t hl_timeout;
+/** Tape file */
+const char *hl_tape;
+/** File to save screen memory to (SCR format) */
+const char *hl_dump_scr;
+/** File to save final image to (raw, one byte per pixel) */
+const char *hl_dump_img;
+/** File to capture audio to (WAV) */
+const char *hl_dump_wav;
+/** File to save CPU state to (text) */
+const char *hl_dump_cpu;
+/** Print screen hash every this many fields (zero for never) */
+unsigned long hl_hash_fields;
+
+/** First field at which LOAD "" is typed */
+#define AUTOLOAD_FIELD 100
+/** Fields per typed key, held for the first half (the ROM ignores
+ * a repeated key unless released for at least 5 fields) */
+#define AUTOLOAD_KEY_FIELDS 16
+
+/** Keys typing LOAD "" in 48K BASIC */
+static const int autoload_keys[] = {
+	WKEY_J, WKEY_FOOT, WKEY_FOOT, WKEY_ENTER
+};
+
+/** Type LOAD "" after the 48K ROM has started up.
+ *
+ * Called at the start of each field when a tape is
+ * given without a snapshot. With slow loading, the tape is started
+ * after the last key has been released.
+ *
+ * @param zx Machine
+ * @param field Field number
+ */
+static void headless_autoload(zx_machine_t *zx, unsigned long field)
+{
+	unsigned long t;
+	unsigned long i;
+	unsigned long nkeys;
+
+	if (field < AUTOLOAD_FIELD)
+		return;
+
+	nkeys = sizeof(autoload_keys) / sizeof(autoload_keys[0]);
+	t = field - AUTOLOAD_FIELD;
+	i = t / AUTOLOAD_KEY_FIELDS;
+
+	if (i == nkeys && t % AUTOLOAD_KEY_FIELDS == 0 && zx->slow_load)
+		tape_deck_play(zx->tape_deck);
+	if (i >= nkeys)
+		return;
+
+	if (t % AUTOLOAD_KEY_FIELDS == 0)
+		zx_key_state_set(&zx->keys, autoload_keys[i], 1);
+	else if (t % AUTOLOAD_KEY_FIELDS == AUTOLOAD_KEY_FIELDS / 2)
+		zx_key_state_set(&zx->keys, autoload_keys[i], 0);
+}
+
+/** Write data to a file.
+ *
+ * @param fname File name
+ * @param data Data
+ * @param size Size of data in bytes
+ * @return Zero on success, -1 on error
+ */
+static int headless_write_file(const char *fname, const void *data, size_t size)
+{
+	FILE *f;
+
+	f = fopen(fname, "wb");
+	if (f == NULL) {
+		printf("Cannot open '%s' for writing.\n", fname);
+		return -1;
+	}
+
+	if (fwrite(data, 1, size, f) != size) {
+		printf("Error writing '%s'.\n", fname);
+		fclose(f);
+		return -1;
+	}
+
+	if (fclose(f) != 0) {
+		printf("Error writing '%s'.\n", fname);
+		return -1;
+	}
+
+	return 0;
+}
+
+/** Write CPU state in text form.
+ *
+ * @param zx Machine
+ * @param f Output file
+ * @param fields Number of fields emulated
+ */
+static void headless_print_cpu(zx_machine_t *zx, FILE *f,
+    unsigned long fields)
+{
+	z80_t *cpu = &zx->cpu;
+
+	fprintf(f, "AF=%04x BC=%04x DE=%04x HL=%04x\n", z80_getAF(cpu),
+	    z80_getBC(cpu), z80_getDE(cpu), z80_getHL(cpu));
+	fprintf(f, "AF'=%04x BC'=%04x DE'=%04x HL'=%04x\n",
+	    z80_getAF_(cpu), z80_getBC_(cpu), z80_getDE_(cpu),
+	    z80_getHL_(cpu));
+	fprintf(f, "IX=%04x IY=%04x SP=%04x PC=%04x I=%02x R=%02x\n",
+	    cpu->cpus.IX, cpu->cpus.IY, cpu->cpus.SP, cpu->cpus.PC,
+	    cpu->cpus.I, cpu->cpus.R);
+	fprintf(f, "IFF1=%d IFF2=%d IM=%d HALT=%d\n", cpu->cpus.IFF1,
+	    cpu->cpus.IFF2, cpu->cpus.int_mode, cpu->cpus.halted);
+	fprintf(f, "clock=%lu fields=%lu\n", cpu->clock, fields);
+}
+
+/** Save results of a headless run.
+ *
+ * @param zx Machine
+ * @param fields Number of fields emulated
+ * @return Zero on success, -1 on error
+ */
+static int headless_dump(zx_machine_t *zx, unsigned long fields)
+{
+	FILE *f;
+	int rc = 0;
+
+	if (hl_dump_wav != NULL)
+		zx_sound_stop_capture(zx);
+
+	if (hl_dump_scr != NULL &&
+	    headless_write_file(hl_dump_scr, zx->mem.scr, 0x1B00) < 0)
+		rc = -1;
+
+	if (hl_dump_img != NULL) {
+		if (headless_write_file(hl_dump_img, vscr0,
+		    (size_t) scr_xs * scr_ys) < 0)
+			rc = -1;
+		else
+			printf("Image %dx%d saved to '%s'.\n", scr_xs, scr_ys,
+			    hl_dump_img);
+	}
+
+	if (hl_dump_cpu != NULL) {
+		f = fopen(hl_dump_cpu, "wt");
+		if (f == NULL) {
+			printf("Cannot open '%s' for writing.\n", hl_dump_cpu);
+			rc = -1;
+		} else {
+			headless_print_cpu(zx, f, fields);
+			if (fclose(f) != 0)
+				rc = -1;
+		}
+	}
+
+	return rc;
+}
+
+/** Run emulation in headless mode.
+ *
+ * Runs at maximum speed until the field limit, the stop address or
+ * the time limit is reached, then saves the requested results.
+ *
+ * @param zx Machine
+ * @param autoload Type LOAD "" to load the tape
+ * @return Exit status: 0 if stopped by field limit, at the stop
+ *         address or at the end of RZX playback, 1 on error (including
+ *         loss of RZX synchronization), 2 if the time limit was reached
+ */
+int headless_run(zx_machine_t *zx, bool autoload)
+{
+	uint64_t t0;
+	uint64_t usec;
+	unsigned long fields;
+	const char *reason;
+	bool field;
+	int rc;
+
+	if (hl_tape != NULL) {
+		if (tape_deck_open(zx->tape_deck, hl_tape) != 0) {
+			printf("Error opening tape '%s'.\n", hl_tape);
+			return 1;
+		}
+
+		if (!autoload && zx->slow_load)
+			tape_deck_play(zx->tape_deck);
+	}
+
+	if (hl_dump_wav != NULL &&
+	    zx_sound_start_capture(zx, hl_dump_wav) < 0) {
+		printf("Error opening '%s'.\n", hl_dump_wav);
+		return 1;
+	}
+
+	t0 = sys_time_usec();
+	fields = 0;
+	rc = 0;
+
+	while (true) {
+		field = zx_dispatch(zx);
+		if (zx->rzx_rc != 0) {
+			reason = zx->rzx_rc == ENOENT ? "end of RZX" :
+			    "RZX error";
+			rc = zx->rzx_rc == ENOENT ? 0 : 1;
+			break;
+		}
+
+		if (field) {
+			++fields;
+
+			if (hl_hash_fields != 0 && fields % hl_hash_fields == 0) {
+				printf("Field %lu screen hash %08x\n", fields,
+				    hash_fnv1a(HASH_FNV1A_INIT, zx->mem.scr,
+				    0x1B00));
+			}
+
+			if (hl_fields != 0 && fields >= hl_fields) {
+				reason = "field limit";
+				break;
+			}
+
+			if (hl_timeout != 0 && sys_time_usec() - t0 >=
+			    hl_timeout) {
+				reason = "time limit";
+				rc = 2;
+				break;
+			}
+
+			if (autoload)
+				headless_autoload(zx, fields);
+		}
+
+		if (zx->stop_pc_enabled && zx->cpu.cpus.PC == zx->stop_pc) {
+			reason = "stop address";
+			break;
+		}
+
+		zx_exec(zx);
+	}
+
+	usec = sys_time_usec() - t0;
+	printf("Stopped at %s after %lu fields (%.3f s, speed %.1fx).\n",
+	    reason, fields, usec / 1000000.0, usec != 0 ? (double)fields *
+	    ULA_FIELD_TICKS / Z80_CLOCK * 1000000.0 / usec : 0.0);
+	zx_rzx_stop(zx);
+	if (hl_hash_fields != 0)
+		printf("Audio hash %08x\n", zx_sound_hash(zx));
+	headless_print_cpu(zx, stdout, fields);
+
+	if (headless_dump(zx, fields) < 0)
+		rc = 1;
+
+	return rc;
+}
@@ -0,0 +1,677 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Embeddable emulator library
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Embeddable emulator library
+ *
+ * Each library machine owns an emulator machine (zx_machine_t), so any
+ * number of machines can exist at the same time. Different machines can
+ * be used from different threads, except for the checkpoint functions
+ * (checkpoints of all machines share one page pool). The ROM images are
+ * loaded by gzx_lib_init() and shared by all machines, as are RAM banks
+ * with the same contents until a machine writes to them (see memio.c).
+ * This makes creating and cloning machines cheap.
+ *
+ * Checkpoints (e.g. for search or what-if runs) keep RAM and image in
+ * shared copy-on-write pages (see pgshare.c), so identical pages of all
+ * checkpoints are stored only once. The pages of the last checkpoint
+ * saved or restored are kept as the base of the next one. Only RAM pages
+ * that were written to since then (see zx_mem_dirty()) get new shared
+ * pages, so saving a checkpoint costs little more than saving the
+ * machine state without RAM.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "clock.h"
+#include "libgzx.h"
+#include "memio.h"
+#include "mgfx.h"
+#include "pgshare.h"
+#include "snap.h"
+#include "state.h"
+#include "strutil.h"
+#include "sys_all.h"
+#include "tape/deck.h"
+#include "zx.h"
+#include "zx_kbd.h"
+#include "zx_sound.h"
+
+/** Size of checkpoint pages in bytes */
+#define GZX_PG_SIZE 1024
+
+/** Maximum number of audio samples kept per field */
+#define GZX_AUDIO_MAX 1024
+
+/** Emulated machine */
+struct gzx_machine {
+	/** Emulator machine */
+	zx_machine_t *zx;
+	/** Audio samples of the last field (8-bit unsigned, 28 kHz) */
+	uint8_t audio[GZX_AUDIO_MAX];
+	/** Number of audio samples of the last field */
+	size_t naudio;
+	/** RAM pages of the last checkpoint saved or restored (entries are
+	 * @c NULL if unknown) */
+	pgshare_page_t **ram;
+	/** Number of entries in ram */
+	size_t nram;
+	/** Buffer for assembling machine state */
+	uint8_t *state_buf;
+	/** Size of state_buf */
+	size_t state_buf_size;
+};
+
+/** Machine checkpoint */
+struct gzx_checkpoint {
+	/** Saved machine state except for RAM (zx_state_save_mach()) */
+	uint8_t *mach;
+	/** RAM pages */
+	pgshare_page_t **ram;
+	/** Number of RAM pages */
+	size_t nram;
+	/** Image pages */
+	pgshare_page_t **image;
+	/** Number of image pages */
+	size_t nimage;
+	/** Audio samples of the last field */
+	uint8_t audio[GZX_AUDIO_MAX];
+	/** Number of audio samples of the last field */
+	size_t naudio;
+};
+
+/** Shared pages of all checkpoints */
+static pgshare_t *gzx_pages;
+
+/** Receive audio samples from the emulator core.
+ *
+ * @param arg Machine (gzx_machine_t *)
+ * @param smp Samples
+ * @param nsmp Number of samples
+ */
+static void gzx_audio_sink(void *arg, const uint8_t *smp, size_t nsmp)
+{
+	gzx_machine_t *m = (gzx_machine_t *)arg;
+
+	if (nsmp > GZX_AUDIO_MAX - m->naudio)
+		nsmp = GZX_AUDIO_MAX - m->naudio;
+
+	memcpy(m->audio + m->naudio, smp, nsmp);
+	m->naudio += nsmp;
+}
+
+/** Release shared pages.
+ *
+ * @param pages Array of pages (entries can be @c NULL)
+ * @param n Number of entries
+ */
+static void gzx_pages_release(pgshare_page_t **pages, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (pages[i] != NULL)
+			pgshare_release(gzx_pages, pages[i]);
+		pages[i] = NULL;
+	}
+}
+
+/** Forget base pages.
+ *
+ * Called when RAM has been changed bypassing dirty tracking. The next
+ * checkpoint compares all RAM pages.
+ *
+ * @param m Machine
+ */
+static void gzx_base_forget(gzx_machine_t *m)
+{
+	if (m->ram != NULL)
+		gzx_pages_release(m->ram, m->nram);
+}
+
+/** Resize base pages to match the current memory model.
+ *
+ * @param m Machine
+ * @return Zero on success, ENOMEM if out of memory
+ */
+static int gzx_base_resize(gzx_machine_t *m)
+{
+	pgshare_page_t **nram;
+	size_t n;
+
+	n = m->zx->mem.ram_size / GZX_PG_SIZE;
+	if (n == m->nram && m->ram != NULL)
+		return 0;
+
+	nram = calloc(n, sizeof(pgshare_page_t *));
+	if (nram == NULL)
+		return ENOMEM;
+
+	gzx_base_forget(m);
+	free(m->ram);
+	m->ram = nram;
+	m->nram = n;
+	return 0;
+}
+
+/** Get size of the image of a machine.
+ *
+ * @param m Machine
+ * @return Size of image in bytes
+ */
+static size_t gzx_image_size(gzx_machine_t *m)
+{
+	return (size_t) m->zx->video.out.image_w * m->zx->video.out.image_h;
+}
+
+/** Replace shared page.
+ *
+ * @param ppg Place holding page reference (can hold @c NULL)
+ * @param data New page contents
+ * @return Zero on success, ENOMEM if out of memory
+ */
+static int gzx_page_set(pgshare_page_t **ppg, const uint8_t *data)
+{
+	pgshare_page_t *pg;
+	int rc;
+
+	/* Dirty tracking is coarser than shared pages */
+	if (*ppg != NULL && memcmp((*ppg)->data, data, GZX_PG_SIZE) == 0)
+		return 0;
+
+	rc = pgshare_get(gzx_pages, data, &pg);
+	if (rc != 0)
+		return rc;
+
+	if (*ppg != NULL)
+		pgshare_release(gzx_pages, *ppg);
+	*ppg = pg;
+	return 0;
+}
+
+/** Determine if RAM page was written to since the last checkpoint.
+ *
+ * @param m Machine
+ * @param i RAM page number (in units of GZX_PG_SIZE)
+ * @return @c true if the page was written to
+ */
+static bool gzx_ram_dirty(gzx_machine_t *m, size_t i)
+{
+	uint32_t mpg;
+	uint32_t last;
+
+	mpg = (i * GZX_PG_SIZE) >> ZX_MEM_PG_SHIFT;
+	last = ((i + 1) * GZX_PG_SIZE - 1) >> ZX_MEM_PG_SHIFT;
+	while (mpg <= last) {
+		if (zx_mem_dirty(m->zx, mpg++))
+			return true;
+	}
+
+	return false;
+}
+
+/** Free checkpoint structure.
+ *
+ * @param cp Checkpoint
+ */
+static void gzx_checkpoint_free(gzx_checkpoint_t *cp)
+{
+	if (cp->ram != NULL)
+		gzx_pages_release(cp->ram, cp->nram);
+	if (cp->image != NULL)
+		gzx_pages_release(cp->image, cp->nimage);
+	free(cp->ram);
+	free(cp->image);
+	free(cp->mach);
+	free(cp);
+}
+
+/** Initialize library.
+ *
+ * Must be called once before any other library function.
+ *
+ * @param datadir Directory containing the @c roms directory or @c NULL
+ *                for the current directory
+ * @param log Log file or @c NULL to discard log messages
+ * @return Zero on success, ENOMEM if out of memory, EIO if initialization
+ *         failed (e.g. the ROMs cannot be loaded)
+ */
+int gzx_lib_init(const char *datadir, FILE *log)
+{
+	int model;
+	int rc;
+
+	logfi = log != NULL ? log : tmpfile();
+	if (logfi == NULL)
+		return EIO;
+
+	/* ROMs are looked up in start_dir, the working directory is kept */
+	start_dir = datadir != NULL ? strdupl(datadir) : sys_getcwd(NULL, 0);
+	if (start_dir == NULL)
+		return ENOMEM;
+
+	/* Machines are created without reading files */
+	for (model = ZXM_48K; model <= ZXM_PLUS3; model++) {
+		rc = zx_mem_model_load(model);
+		if (rc != 0)
+			return rc;
+	}
+
+	return pgshare_create(GZX_PG_SIZE, &gzx_pages);
+}
+
+/** Create machine.
+ *
+ * The machine starts in the power-on state with an empty tape deck.
+ *
+ * @param model Machine model
+ * @param rm Place to store pointer to new machine
+ * @return Zero on success, EINVAL if @a model is not valid, ENOMEM
+ *         if out of memory, EIO on other error
+ */
+int gzx_machine_create(gzx_model_t model, gzx_machine_t **rm)
+{
+	gzx_machine_t *m;
+	int zxm;
+
+	switch (model) {
+	case gzx_model_48k:
+		zxm = ZXM_48K;
+		break;
+	case gzx_model_128k:
+		zxm = ZXM_128K;
+		break;
+	case gzx_model_plus2:
+		zxm = ZXM_PLUS2;
+		break;
+	case gzx_model_plus2a:
+		zxm = ZXM_PLUS2A;
+		break;
+	case gzx_model_plus3:
+		zxm = ZXM_PLUS3;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	m = calloc(1, sizeof(gzx_machine_t));
+	if (m == NULL)
+		return ENOMEM;
+
+	if (zx_create(false, false, &m->zx) < 0) {
+		free(m);
+		return EIO;
+	}
+
+	zx_sound_set_sink(m->zx, gzx_audio_sink, m);
+
+	if (zxm != ZXM_48K) {
+		if (zx_select_memmodel(m->zx, zxm) < 0) {
+			gzx_machine_destroy(m);
+			return EIO;
+		}
+
+		zx_reset(m->zx);
+	}
+
+	*rm = m;
+	return 0;
+}
+
+/** Destroy machine.
+ *
+ * Checkpoints saved from the machine remain valid.
+ *
+ * @param m Machine
+ */
+void gzx_machine_destroy(gzx_machine_t *m)
+{
+	gzx_base_forget(m);
+	free(m->ram);
+	free(m->state_buf);
+	zx_destroy(m->zx);
+	free(m);
+}
+
+/** Clone machine.
+ *
+ * The new machine continues exactly as @a m would. Both machines share
+ * memory until either writes to it, so a clone costs little time and
+ * memory. A tape inserted in @a m is read again from its file. @a m must
+ * not be used by another thread while it is being cloned.
+ *
+ * @param m Machine
+ * @param rm Place to store pointer to new machine
+ * @return Zero on success, ENOMEM if out of memory, ENOTSUP if the
+ *         machine cannot be cloned (Spec256), EIO on other error
+ */
+int gzx_machine_clone(gzx_machine_t *m, gzx_machine_t **rm)
+{
+	gzx_machine_t *nm;
+	int rc;
+
+	nm = calloc(1, sizeof(gzx_machine_t));
+	if (nm == NULL)
+		return ENOMEM;
+
+	rc = zx_clone(m->zx, &nm->zx);
+	if (rc != 0) {
+		free(nm);
+		return rc == EINVAL ? EIO : rc;
+	}
+
+	zx_sound_set_sink(nm->zx, gzx_audio_sink, nm);
+
+	/* The next field is drawn over the same image */
+	memcpy(nm->zx->video.out.image, m->zx->video.out.image,
+	    gzx_image_size(m));
+	memcpy(nm->audio, m->audio, m->naudio);
+	nm->naudio = m->naudio;
+
+	*rm = nm;
+	return 0;
+}
+
+/** Load snapshot or insert tape.
+ *
+ * Files with extension .tap, .tzx or .wav are inserted into the tape
+ * deck (they are loaded by the ROM, e.g. after typing LOAD ""). Other
+ * files are loaded as snapshots.
+ *
+ * @param m Machine
+ * @param fname File name
+ * @return Zero on success, ENOMEM if out of memory, EIO if the file
+ *         cannot be loaded
+ */
+int gzx_load(gzx_machine_t *m, const char *fname)
+{
+	char *name;
+	int rc;
+
+	if (tape_deck_is_tape_file(fname))
+		return tape_deck_open(m->zx->tape_deck, fname) != 0 ? EIO : 0;
+
+	name = strdupl(fname);
+	if (name == NULL)
+		return ENOMEM;
+
+	rc = zx_load_snap(m->zx, name) < 0 ? EIO : 0;
+	free(name);
+
+	/* Snapshot loading bypasses dirty tracking */
+	gzx_base_forget(m);
+	return rc;
+}
+
+/** Emulate one field (1/50 s).
+ *
+ * @param m Machine
+ * @param in Inputs held during the field or @c NULL for no input
+ * @return Zero on success, error code otherwise
+ */
+int gzx_step_frame(gzx_machine_t *m, const gzx_input_t *in)
+{
+	zx_machine_t *zx = m->zx;
+	int i;
+
+	for (i = 0; i < GZX_KBD_ROWS; i++)
+		zx->keys.kmstate.mask[i] = in != NULL ? in->keys[i] & 0x1f : 0;
+	zx->kjoy.state = in != NULL ? in->kempston : 0;
+
+	m->naudio = 0;
+	zx_run_field(zx);
+	zx_sound_flush(zx);
+	return 0;
+}
+
+/** Get image of the last emulated field.
+ *
+ * The image is valid until the next call to a library function.
+ *
+ * @param m Machine
+ * @param rw Place to store image width
+ * @param rh Place to store image height
+ * @return Image (one palette index per pixel, row by row)
+ */
+const uint8_t *gzx_screen(gzx_machine_t *m, int *rw, int *rh)
+{
+	*rw = m->zx->video.out.image_w;
+	*rh = m->zx->video.out.image_h;
+	return m->zx->video.out.image;
+}
+
+/** Get audio generated during the last emulated field.
+ *
+ * @param m Machine
+ * @param rnsmp Place to store number of samples
+ * @return Samples (8-bit unsigned, mono, 28 kHz)
+ */
+const uint8_t *gzx_audio(gzx_machine_t *m, size_t *rnsmp)
+{
+	*rnsmp = m->naudio;
+	return m->audio;
+}
+
+/** Read byte from machine memory.
+ *
+ * @param m Machine
+ * @param addr Address (as currently paged in)
+ * @param rval Place to store byte value
+ * @return Zero on success, error code otherwise
+ */
+int gzx_peek(gzx_machine_t *m, uint16_t addr, uint8_t *rval)
+{
+	*rval = zx_memget8(m->zx, addr);
+	return 0;
+}
+
+/** Write byte to machine memory.
+ *
+ * Writes to ROM are ignored.
+ *
+ * @param m Machine
+ * @param addr Address (as currently paged in)
+ * @param val Byte value
+ * @return Zero on success, error code otherwise
+ */
+int gzx_poke(gzx_machine_t *m, uint16_t addr, uint8_t val)
+{
+	zx_memset8(m->zx, addr, val);
+	return 0;
+}
+
+/** Save machine checkpoint.
+ *
+ * The checkpoint shares RAM and image pages with other checkpoints
+ * that have the same contents. It remains valid after the machine is
+ * destroyed and can be restored into a new machine.
+ *
+ * @param m Machine
+ * @param rcp Place to store pointer to new checkpoint
+ * @return Zero on success, ENOMEM if out of memory, ENOTSUP if the
+ *         machine state cannot be saved (Spec256)
+ */
+int gzx_checkpoint_save(gzx_machine_t *m, gzx_checkpoint_t **rcp)
+{
+	zx_machine_t *zx = m->zx;
+	gzx_checkpoint_t *cp;
+	uint8_t buf[GZX_PG_SIZE];
+	size_t image_size;
+	size_t off;
+	size_t n;
+	size_t i;
+	int rc;
+
+	rc = gzx_base_resize(m);
+	if (rc != 0)
+		return rc;
+
+	cp = calloc(1, sizeof(gzx_checkpoint_t));
+	if (cp == NULL)
+		return ENOMEM;
+
+	cp->mach = malloc(zx_state_mach_size());
+	image_size = gzx_image_size(m);
+	cp->nimage = (image_size + GZX_PG_SIZE - 1) / GZX_PG_SIZE;
+	cp->ram = calloc(m->nram, sizeof(pgshare_page_t *));
+	cp->image = calloc(cp->nimage, sizeof(pgshare_page_t *));
+	if (cp->mach == NULL || cp->ram == NULL || cp->image == NULL) {
+		rc = ENOMEM;
+		goto error;
+	}
+
+	cp->nram = m->nram;
+
+	rc = zx_state_save_mach(zx, cp->mach, zx_state_mach_size());
+	if (rc != 0)
+		goto error;
+
+	for (i = 0; i < m->nram; i++) {
+		if (m->ram[i] == NULL || gzx_ram_dirty(m, i)) {
+			rc = gzx_page_set(&m->ram[i],
+			    zx_mem_ram_ptr(zx, i * GZX_PG_SIZE));
+			if (rc != 0)
+				goto error;
+		}
+
+		pgshare_ref(m->ram[i]);
+		cp->ram[i] = m->ram[i];
+	}
+
+	for (i = 0; i < cp->nimage; i++) {
+		off = i * GZX_PG_SIZE;
+		n = image_size - off < GZX_PG_SIZE ?
+		    image_size - off : GZX_PG_SIZE;
+		memcpy(buf, zx->video.out.image + off, n);
+		memset(buf + n, 0, GZX_PG_SIZE - n);
+
+		rc = pgshare_get(gzx_pages, buf, &cp->image[i]);
+		if (rc != 0)
+			goto error;
+	}
+
+	memcpy(cp->audio, m->audio, m->naudio);
+	cp->naudio = m->naudio;
+
+	zx_mem_dirty_clear(zx);
+	*rcp = cp;
+	return 0;
+error:
+	gzx_checkpoint_free(cp);
+	return rc;
+}
+
+/** Restore machine checkpoint.
+ *
+ * The tape inserted when the checkpoint was saved must still be
+ * inserted.
+ *
+ * @param m Machine
+ * @param cp Checkpoint
+ * @return Zero on success, ENOMEM if out of memory, EINVAL if the
+ *         checkpoint does not match the tape, other error code on other
+ *         error
+ */
+int gzx_checkpoint_restore(gzx_machine_t *m, gzx_checkpoint_t *cp)
+{
+	zx_machine_t *zx = m->zx;
+	uint8_t *nbuf;
+	size_t image_size;
+	size_t mach_size;
+	size_t size;
+	size_t off;
+	size_t i;
+	int rc;
+
+	/* All machines have images of the same size */
+	image_size = gzx_image_size(m);
+	assert(cp->nimage * GZX_PG_SIZE >= image_size);
+
+	mach_size = zx_state_mach_size();
+	size = mach_size + cp->nram * GZX_PG_SIZE;
+	if (size > m->state_buf_size) {
+		nbuf = realloc(m->state_buf, size);
+		if (nbuf == NULL)
+			return ENOMEM;
+		m->state_buf = nbuf;
+		m->state_buf_size = size;
+	}
+
+	memcpy(m->state_buf, cp->mach, mach_size);
+	for (i = 0; i < cp->nram; i++) {
+		memcpy(m->state_buf + mach_size + i * GZX_PG_SIZE,
+		    cp->ram[i]->data, GZX_PG_SIZE);
+	}
+
+	rc = zx_state_load(zx, m->state_buf, size);
+	if (rc != 0)
+		return rc;
+
+	/* The pages of the checkpoint become the base of the next one */
+	if (gzx_base_resize(m) != 0) {
+		gzx_base_forget(m);
+	} else {
+		for (i = 0; i < m->nram; i++) {
+			pgshare_ref(cp->ram[i]);
+			if (m->ram[i] != NULL)
+				pgshare_release(gzx_pages, m->ram[i]);
+			m->ram[i] = cp->ram[i];
+		}
+	}
+
+	zx_mem_dirty_clear(zx);
+
+	/* The next field is drawn over the image of the checkpoint */
+	for (i = 0; i < cp->nimage; i++) {
+		off = i * GZX_PG_SIZE;
+		memcpy(zx->video.out.image + off, cp->image[i]->data,
+		    image_size - off < GZX_PG_SIZE ?
+		    image_size - off : GZX_PG_SIZE);
+	}
+
+	memcpy(m->audio, cp->audio, cp->naudio);
+	m->naudio = cp->naudio;
+	return 0;
+}
+
+/** Destroy machine checkpoint.
+ *
+ * @param cp Checkpoint
+ */
+void gzx_checkpoint_destroy(gzx_checkpoint_t *cp)
+{
+	gzx_checkpoint_free(cp);
+}
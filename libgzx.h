@@ -0,0 +1,97 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Embeddable emulator library
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Embeddable emulator library.
+ *
+ * This is the public interface of libgzx. It does not depend on any
+ * other GZX header.
+ */
+
+#ifndef LIBGZX_H
+#define LIBGZX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Number of keyboard half-rows */
+#define GZX_KBD_ROWS 8
+
+/** Kempston joystick bits */
+enum {
+	GZX_KEMPSTON_RIGHT = 0x01,
+	GZX_KEMPSTON_LEFT = 0x02,
+	GZX_KEMPSTON_DOWN = 0x04,
+	GZX_KEMPSTON_UP = 0x08,
+	GZX_KEMPSTON_FIRE = 0x10
+};
+
+/** Machine model */
+typedef enum {
+	gzx_model_48k,
+	gzx_model_128k,
+	gzx_model_plus2,
+	gzx_model_plus2a,
+	gzx_model_plus3
+} gzx_model_t;
+
+/** Machine inputs for one field */
+typedef struct {
+	/** Pressed keys of each keyboard half-row (bit set if pressed).
+	 * Row i is selected by address line A(8+i), bit 0 is the outermost
+	 * key (e.g. row 0 is CAPS SHIFT, Z, X, C, V). */
+	uint8_t keys[GZX_KBD_ROWS];
+	/** Kempston joystick state (GZX_KEMPSTON_xxx bits) */
+	uint8_t kempston;
+} gzx_input_t;
+
+/** Emulated machine */
+typedef struct gzx_machine gzx_machine_t;
+
+/** Saved machine state */
+typedef struct gzx_checkpoint gzx_checkpoint_t;
+
+extern int gzx_lib_init(const char *, FILE *);
+extern int gzx_machine_create(gzx_model_t, gzx_machine_t **);
+extern void gzx_machine_destroy(gzx_machine_t *);
+extern int gzx_machine_clone(gzx_machine_t *, gzx_machine_t **);
+extern int gzx_load(gzx_machine_t *, const char *);
+extern int gzx_step_frame(gzx_machine_t *, const gzx_input_t *);
+extern const uint8_t *gzx_screen(gzx_machine_t *, int *, int *);
+extern const uint8_t *gzx_audio(gzx_machine_t *, size_t *);
+extern int gzx_peek(gzx_machine_t *, uint16_t, uint8_t *);
+extern int gzx_poke(gzx_machine_t *, uint16_t, uint8_t);
+extern int gzx_checkpoint_save(gzx_machine_t *, gzx_checkpoint_t **);
+extern int gzx_checkpoint_restore(gzx_machine_t *, gzx_checkpoint_t *);
+extern void gzx_checkpoint_destroy(gzx_checkpoint_t *);
+
+#endif
@@ -29,16 +29,22 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 #include "ay.h"
-#include "gzx.h"
 #include "iorec.h"
 #include "iospace.h"
+#include "joystick/kempston.h"
 #include "memio.h"
+#include "romtrap.h"
+#include "rzx.h"
 #include "sys_all.h"
+#include "video/defs.h"
 #include "video/ulaplus.h"
 #include "z80.h"
 #include "z80g.h"
@@ -46,184 +52,685 @@
 #include "zx_kbd.h"
 #include "zx_scr.h"
 
-uint8_t *zxram, *zxrom;	/* whole memory */
-uint8_t *zxbnk[4];	/* currently switched in banks */
-uint8_t *zxscr;		/* selected screen bank */
-uint8_t border;
-uint8_t spk, mic, ear;
+/*
+ * Dirty RAM tracking: memory pages of RAM that are clean have no entry
+ * in the write page table, so the first write to them goes through
+ * zx_memset8_slow(), which marks them dirty and re-enables fast writes.
+ */
+
+/** Seed for power-on RAM contents */
+#define ZX_RAM_SEED 0x2545f491
+
+/*
+ * Copy-on-write RAM banks: RAM is kept in 16K banks. A bank is either
+ * private to the machine or a shared page of the bank store, which keeps
+ * banks with identical contents only once for all machines (power-on
+ * contents and banks of machines that share memory, see zx_mem_share()).
+ * Shared banks are never written: they have no entry in the write page
+ * table and the first write goes through zx_memset8_slow(), which gives
+ * the machine a private copy of the bank. ROM images are shared the same
+ * way, a machine only gets a private copy of its ROM if it is written
+ * bypassing ROM protection.
+ */
+
+/** Shared RAM banks of all machines */
+static pgshare_t *zx_bank_store;
+/** Lock of the bank store (machines can run in different threads) */
+static atomic_flag zx_bank_busy = ATOMIC_FLAG_INIT;
+/** Power-on contents of each RAM bank (in the bank store) */
+static pgshare_page_t *zx_ram_init_pg[ZX_MEM_RAM_NBNK];
+
+/*
+ * ROM images are read from files the first time a memory model is
+ * loaded and kept in memory, so that switching to that model later
+ * does not depend on the files and cannot fail (see
+ * zx_mem_model_load()).
+ */
+
+/** ROM file (part of the ROM image of a memory model) */
+typedef struct {
+	/** File name relative to start_dir or NULL at the end of the list */
+	const char *fname;
+	/** Offset in the ROM image */
+	uint32_t offs;
+	/** Size in bytes */
+	uint32_t size;
+} zx_rom_file_t;
+
+static const zx_rom_file_t zx_rom_files_48k[] = {
+	{ "roms/zx48.rom", 0x0000, 0x4000 },
+	{ NULL, 0, 0 }
+};
+
+static const zx_rom_file_t zx_rom_files_128k[] = {
+	{ "roms/zx128_0.rom", 0x0000, 0x4000 },
+	{ "roms/zx128_1.rom", 0x4000, 0x4000 },
+	{ NULL, 0, 0 }
+};
+
+static const zx_rom_file_t zx_rom_files_plus2[] = {
+	{ "roms/zxp2_0.rom", 0x0000, 0x4000 },
+	{ "roms/zxp2_1.rom", 0x4000, 0x4000 },
+	{ NULL, 0, 0 }
+};
+
+static const zx_rom_file_t zx_rom_files_plus3[] = {
+	{ "roms/zxp3_0.rom", 0x0000, 0x4000 },
+	{ "roms/zxp3_1.rom", 0x4000, 0x4000 },
+	{ "roms/zxp3_2.rom", 0x8000, 0x4000 },
+	{ "roms/zxp3_3.rom", 0xc000, 0x4000 },
+	{ NULL, 0, 0 }
+};
+
+static const zx_rom_file_t zx_rom_files_zx81[] = {
+	{ "roms/zx81.rom", 0x0000, 0x2000 },
+	{ NULL, 0, 0 }
+};
+
+/** ROM files of each memory model */
+static const zx_rom_file_t *zx_rom_files[ZXM_ZX81 + 1] = {
+	[ZXM_48K] = zx_rom_files_48k,
+	[ZXM_128K] = zx_rom_files_128k,
+	[ZXM_PLUS2] = zx_rom_files_plus2,
+	[ZXM_PLUS2A] = zx_rom_files_plus3,
+	[ZXM_PLUS3] = zx_rom_files_plus3,
+	[ZXM_ZX81] = zx_rom_files_zx81
+};
+
+/** ROM image of each memory model or NULL if not loaded yet */
+static uint8_t *zx_rom_img[ZXM_ZX81 + 1];
+
+/*
+ * Page tables: the address space is divided into ZX_MEM_NPG pages.
+ * Memory is read and written directly through the page tables, except
+ * for pages with no entry in the write page table, which need extra
+ * processing. The tables are updated whenever memory is paged.
+ */
+
+/** Writes to read-only memory go here (shared, never read) */
+static uint8_t zx_mem_discard[ZX_MEM_PG_SIZE];
+/** Memory page that reads as 0xff in ZX81 mode (shared) */
+static uint8_t zx_mem_unmapped[ZX_MEM_PG_SIZE];
+
+static void zx_mem_pg_update(zx_machine_t *);
+
+static FILE *rom_fopen(const char *fname);
+static int rom_load(const zx_rom_file_t *, uint8_t *);
+
+/** Lock the bank store. */
+static void zx_bank_lock(void)
+{
+	while (atomic_flag_test_and_set_explicit(&zx_bank_busy,
+	    memory_order_acquire))
+		;
+}
+
+/** Unlock the bank store. */
+static void zx_bank_unlock(void)
+{
+	atomic_flag_clear_explicit(&zx_bank_busy, memory_order_release);
+}
+
+/** Find RAM offset of a pointer into memory.
+ *
+ * @param zx Machine
+ * @param p Pointer into memory of @a zx
+ * @param roff Place to store offset into RAM (bank number * 16K + offset
+ *             in the bank)
+ * @return @c true if @a p points into RAM, @c false otherwise
+ */
+bool zx_mem_ram_off(zx_machine_t *zx, const uint8_t *p, uint32_t *roff)
+{
+	unsigned b;
+
+	for (b = 0; b < zx->mem.ram_nbnk; b++) {
+		if ((uintptr_t)p - (uintptr_t)zx->mem.ram[b] <
+		    ZX_MEM_BNK_SIZE) {
+			*roff = b * ZX_MEM_BNK_SIZE + (p - zx->mem.ram[b]);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/** Determine if a pointer points into ROM.
+ *
+ * @param zx Machine
+ * @param p Pointer into memory of @a zx
+ * @return @c true if @a p points into ROM
+ */
+static bool zx_mem_is_rom(zx_machine_t *zx, const uint8_t *p)
+{
+	return (uintptr_t)p - (uintptr_t)zx->mem.rom < zx->mem.rom_size;
+}
+
+/** Move switched in banks after memory has moved.
+ *
+ * The page tables need to be updated afterwards.
+ *
+ * @param zx Machine
+ * @param old Old location of memory
+ * @param new New location of memory
+ * @param size Size of memory in bytes
+ */
+static void zx_mem_remap(zx_machine_t *zx, uint8_t *old, uint8_t *new,
+    size_t size)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		if ((uintptr_t)zx->mem.bnk[i] - (uintptr_t)old < size)
+			zx->mem.bnk[i] = new + (zx->mem.bnk[i] - old);
+	}
+
+	if ((uintptr_t)zx->mem.scr - (uintptr_t)old < size)
+		zx->mem.scr = new + (zx->mem.scr - old);
+}
 
-uint32_t ram_size, rom_size;
-int has_banksw, bnk_lock48, has_epg;
-int mem_model;
+/** Allocate private copy of shared memory.
+ *
+ * Running out of memory while the emulated CPU writes cannot be
+ * reported, so it is fatal.
+ *
+ * @param src Shared memory
+ * @param size Size in bytes
+ * @return Private copy
+ */
+static uint8_t *zx_mem_copy(const uint8_t *src, size_t size)
+{
+	uint8_t *p;
+
+	p = malloc(size);
+	if (p == NULL) {
+		printf("Out of memory.\n");
+		abort();
+	}
 
-uint8_t page_reg; /* last data written to the page select port */
-uint8_t epg_reg; /* last data written to the enhanced paging port */
+	memcpy(p, src, size);
+	return p;
+}
+
+/** Give the machine a private copy of a shared RAM bank.
+ *
+ * @param zx Machine
+ * @param b RAM bank number
+ */
+static void zx_mem_bank_unshare(zx_machine_t *zx, unsigned b)
+{
+	uint8_t *old = zx->mem.ram[b];
 
-static int rom_load(char *fname, int bank, uint16_t banksize);
-static int spec_rom_load(char *fname, int bank);
+	zx->mem.ram[b] = zx_mem_copy(old, ZX_MEM_BNK_SIZE);
+
+	zx_bank_lock();
+	pgshare_release(zx_bank_store, zx->mem.ram_pg[b]);
+	zx_bank_unlock();
+	zx->mem.ram_pg[b] = NULL;
+
+	zx_mem_remap(zx, old, zx->mem.ram[b], ZX_MEM_BNK_SIZE);
+	zx_mem_bnk_update(zx);
+}
+
+/** Give the machine a private copy of its ROM. */
+static void zx_mem_rom_unshare(zx_machine_t *zx)
+{
+	uint8_t *old = zx->mem.rom;
+
+	zx->mem.rom = zx_mem_copy(old, zx->mem.rom_size);
+	zx->mem.rom_priv = true;
+
+	zx_mem_remap(zx, old, zx->mem.rom, zx->mem.rom_size);
+	zx_mem_bnk_update(zx);
+}
+
+/** Release all memory banks of the machine. */
+static void zx_mem_banks_release(zx_machine_t *zx)
+{
+	unsigned b;
+
+	zx_bank_lock();
+	for (b = 0; b < zx->mem.ram_nbnk; b++) {
+		if (zx->mem.ram_pg[b] != NULL)
+			pgshare_release(zx_bank_store, zx->mem.ram_pg[b]);
+		else
+			free(zx->mem.ram[b]);
+		zx->mem.ram[b] = NULL;
+		zx->mem.ram_pg[b] = NULL;
+	}
+	zx_bank_unlock();
+	zx->mem.ram_nbnk = 0;
+
+	if (zx->mem.rom_priv)
+		free(zx->mem.rom);
+	zx->mem.rom = NULL;
+	zx->mem.rom_priv = false;
+}
 
 /*
  * memory access routines
  * any wraps as MMIOs should be placed here
  */
 
-uint8_t zx_memget8(uint16_t addr)
+/** Prepare write to RAM.
+ *
+ * A shared bank is made private and the memory page is marked dirty.
+ *
+ * @param p Pointer to the byte that is about to be written
+ * @return Pointer to the byte to write (differs from @a p if the bank
+ *         was shared)
+ */
+static inline uint8_t *zx_ram_write(zx_machine_t *zx, uint8_t *p)
 {
-	if (mem_model == ZXM_ZX81) {
-		if (addr <= 0x7fff)
-			return zxbnk[addr >> 14][addr & 0x1fff];
-		else
-			return 0xff;
-	} else {
-		return zxbnk[addr >> 14][addr & 0x3fff];
+	uint32_t off;
+	uint32_t mpg;
+	unsigned b;
+
+	if (!zx_mem_ram_off(zx, p, &off))
+		return p;
+
+	b = off / ZX_MEM_BNK_SIZE;
+	if (zx->mem.ram_pg[b] != NULL) {
+		zx_mem_bank_unshare(zx, b);
+		p = zx->mem.ram[b] + off % ZX_MEM_BNK_SIZE;
+	}
+
+	mpg = off >> ZX_MEM_PG_SHIFT;
+	if (zx->mem.dirty_map[mpg] == 0) {
+		zx->mem.dirty_map[mpg] = 1;
+		zx_mem_pg_update(zx);
 	}
+
+	return p;
 }
 
-uint8_t zx_imemget8(uint16_t addr)
+/** Determine if memory page of RAM was written to.
+ *
+ * @param mpg Memory page number within RAM
+ * @return @c true if the page was written to since the last call
+ *         to zx_mem_dirty_clear()
+ */
+bool zx_mem_dirty(zx_machine_t *zx, uint32_t mpg)
 {
-	if (mem_model == ZXM_48K) {
-		if (addr < 16384)
-			return zxrom[addr];
-		else
-			return zxram[addr - 16384];
-	} else {
-		return zx_memget8(addr);
+	return zx->mem.dirty_map[mpg] != 0;
+}
+
+/** Mark all RAM clean.
+ *
+ * In ZX81 mode RAM is always considered dirty.
+ */
+void zx_mem_dirty_clear(zx_machine_t *zx)
+{
+	if (zx->mem.model == ZXM_ZX81)
+		return;
+
+	memset(zx->mem.dirty_map, 0, zx->mem.ram_size >> ZX_MEM_PG_SHIFT);
+	zx_mem_pg_update(zx);
+}
+
+/** Get RAM bank for writing, bypassing the page tables.
+ *
+ * The bank is made private if it is shared and all of it is marked
+ * dirty.
+ *
+ * @param zx Machine
+ * @param b RAM bank number
+ * @return RAM bank
+ */
+uint8_t *zx_mem_bank_wr(zx_machine_t *zx, unsigned b)
+{
+	uint32_t mpg;
+
+	if (zx->mem.ram_pg[b] != NULL)
+		zx_mem_bank_unshare(zx, b);
+
+	mpg = b * ZX_MEM_BNK_SIZE >> ZX_MEM_PG_SHIFT;
+	memset(zx->mem.dirty_map + mpg, 1, ZX_MEM_BNK_SIZE >> ZX_MEM_PG_SHIFT);
+	zx_mem_pg_update(zx);
+	return zx->mem.ram[b];
+}
+
+/** Copy contents of the whole RAM.
+ *
+ * @param zx Machine
+ * @param ram Buffer for RAM contents (@c ram_size bytes)
+ */
+void zx_mem_ram_save(zx_machine_t *zx, uint8_t *ram)
+{
+	uint32_t off;
+	uint32_t n;
+
+	for (off = 0; off < zx->mem.ram_size; off += n) {
+		n = zx->mem.ram_size - off < ZX_MEM_BNK_SIZE ?
+		    zx->mem.ram_size - off : ZX_MEM_BNK_SIZE;
+		memcpy(ram + off, zx->mem.ram[off / ZX_MEM_BNK_SIZE], n);
 	}
 }
 
-void zx_memset8(uint16_t addr, uint8_t val)
+/** Replace contents of the whole RAM.
+ *
+ * Only memory pages that differ are copied and marked dirty.
+ *
+ * @param ram New RAM contents (@c ram_size bytes)
+ */
+void zx_mem_ram_restore(zx_machine_t *zx, const uint8_t *ram)
 {
-	if (mem_model == ZXM_ZX81) {
-		if (addr >= 8192 && addr <= 0x7fff)
-			zxbnk[addr >> 14][addr & 0x1fff] = val;
-	} else {
-		if (addr >= 16384 || (epg_reg & 1) != 0) {
-			zxbnk[addr >> 14][addr & 0x3fff] = val;
+	uint32_t mpg;
+	uint32_t off;
+	unsigned b;
+
+	for (mpg = 0; mpg < zx->mem.ram_size >> ZX_MEM_PG_SHIFT; mpg++) {
+		off = mpg << ZX_MEM_PG_SHIFT;
+		if (memcmp(zx_mem_ram_ptr(zx, off), ram + off,
+		    ZX_MEM_PG_SIZE) == 0)
+			continue;
+
+		b = off / ZX_MEM_BNK_SIZE;
+		if (zx->mem.ram_pg[b] != NULL)
+			zx_mem_bank_unshare(zx, b);
+
+		memcpy(zx->mem.ram[b] + off % ZX_MEM_BNK_SIZE, ram + off,
+		    ZX_MEM_PG_SIZE);
+		zx->mem.dirty_map[mpg] = 1;
+	}
+
+	zx_mem_pg_update(zx);
+}
+
+/** Determine write page table entry for a memory page.
+ *
+ * @param i Page number
+ * @param p Pointer to the memory switched in at the page
+ * @return Write page table entry
+ */
+static uint8_t *zx_mem_wrpg(zx_machine_t *zx, int i, uint8_t *p)
+{
+	uint32_t off;
+
+	/* ROM is write-protected unless in all-RAM mode */
+	if (i < 0x4000 >> ZX_MEM_PG_SHIFT && (zx->mem.epg_reg & 1) == 0)
+		return zx_mem_discard;
+
+	/* Displayed screen */
+	if ((uintptr_t)p <= (uintptr_t)zx->mem.scr + ZX_ATTR_END &&
+	    (uintptr_t)p + ZX_MEM_PG_SIZE > (uintptr_t)zx->mem.scr)
+		return NULL;
+
+	/* Clean RAM or shared bank */
+	if (zx_mem_ram_off(zx, p, &off) &&
+	    (zx->mem.dirty_map[off >> ZX_MEM_PG_SHIFT] == 0 ||
+	    zx->mem.ram_pg[off / ZX_MEM_BNK_SIZE] != NULL))
+		return NULL;
+
+	return p;
+}
+
+/** Determine write page table entry for a memory page in ZX81 mode.
+ *
+ * @param i Page number
+ * @param p Pointer to the memory switched in at the page
+ * @return Write page table entry
+ */
+static uint8_t *zx_mem_wrpg_zx81(zx_machine_t *zx, int i, uint8_t *p)
+{
+	uint32_t off;
+
+	if (i < 1 || i >= 4)
+		return zx_mem_discard;
+
+	/* Shared ROM or bank */
+	if (zx_mem_is_rom(zx, p) ? !zx->mem.rom_priv :
+	    zx_mem_ram_off(zx, p, &off) &&
+	    zx->mem.ram_pg[off / ZX_MEM_BNK_SIZE] != NULL)
+		return NULL;
+
+	return p;
+}
+
+/** Update memory page tables. */
+static void zx_mem_pg_update(zx_machine_t *zx)
+{
+	uint8_t *p;
+	int i;
+
+	for (i = 0; i < ZX_MEM_NPG; i++) {
+		if (zx->mem.model == ZXM_ZX81) {
+			/* 8K mirrored in each 16K bank, nothing above 32K */
+			p = zx->mem.bnk[i >> 1];
+			zx->mem.rdpg[i] = (i < 4) ? p : zx->mem.unmapped;
+			zx->mem.wrpg[i] = zx_mem_wrpg_zx81(zx, i, p);
 		} else {
-			// printf("%4x: memory protecion error, write to "
-			//   "0x%04x\n", cpus.PC, addr);
+			p = zx->mem.bnk[i >> 1] + ((i & 1) << ZX_MEM_PG_SHIFT);
+			zx->mem.rdpg[i] = p;
+			zx->mem.wrpg[i] = zx_mem_wrpg(zx, i, p);
+		}
+	}
+}
+
+/** Update page tables of switched in banks.
+ *
+ * Needs to be called whenever @c zxbnk or @c zxscr changes.
+ */
+void zx_mem_bnk_update(zx_machine_t *zx)
+{
+	zx_mem_pg_update(zx);
+	zx_code_break_update(zx);
+}
+
+/** Bring video up to date before writing to the displayed screen.
+ *
+ * @param p Pointer to the byte that is about to be written
+ */
+static inline void zx_scr_write(zx_machine_t *zx, uint8_t *p)
+{
+	if ((uintptr_t)p - (uintptr_t)zx->mem.scr <= ZX_ATTR_END)
+		zx_video_sync(zx);
+}
+
+/** Prepare write to memory that needs extra processing.
+ *
+ * @param p Pointer to the byte that is about to be written
+ * @return Pointer to the byte to write (differs from @a p if the memory
+ *         was shared)
+ */
+static uint8_t *zx_mem_write(zx_machine_t *zx, uint8_t *p)
+{
+	uint32_t off;
+
+	if (zx_mem_is_rom(zx, p)) {
+		if (!zx->mem.rom_priv) {
+			off = p - zx->mem.rom;
+			zx_mem_rom_unshare(zx);
+			p = zx->mem.rom + off;
 		}
+
+		return p;
 	}
+
+	zx_scr_write(zx, p);
+	return zx_ram_write(zx, p);
+}
+
+/** Write byte to memory that needs extra processing.
+ *
+ * Used for memory pages that contain the displayed screen, clean RAM
+ * or shared memory.
+ *
+ * @param addr Address
+ * @param val Byte value
+ */
+void zx_memset8_slow(zx_machine_t *zx, uint16_t addr, uint8_t val)
+{
+	uint8_t *p;
+
+	p = zx->mem.rdpg[addr >> ZX_MEM_PG_SHIFT] +
+	    (addr & (ZX_MEM_PG_SIZE - 1));
+	*zx_mem_write(zx, p) = val;
 }
 
 /** Write byte without ROM protection */
-void zx_memset8f(uint16_t addr, uint8_t val)
+void zx_memset8f(zx_machine_t *zx, uint16_t addr, uint8_t val)
 {
-	zxbnk[addr >> 14][addr & 0x3fff] = val;
+	*zx_mem_write(zx, &zx->mem.bnk[addr >> 14][addr & 0x3fff]) = val;
+}
+
+/** Get pointer for direct access to a range of memory.
+ *
+ * Direct access is only possible if the range lies within one memory bank.
+ * A range that is going to be written also must not be read-only, overlap
+ * the displayed screen. Getting a range for writing can move the memory
+ * bank that contains it (if it was shared), so pointers obtained earlier
+ * to the same bank become stale.
+ *
+ * @param addr Start address
+ * @param len Length of the range
+ * @param write Nonzero if the range is going to be written
+ * @return Pointer to the first byte or NULL if direct access is not possible
+ */
+uint8_t *zx_mem_direct(zx_machine_t *zx, uint16_t addr, uint16_t len,
+    int write)
+{
+	uint8_t *p;
+
+	if (zx->mem.model == ZXM_ZX81 || len == 0 ||
+	    (addr & 0x3fff) + len > 0x4000)
+		return NULL;
+
+	p = &zx->mem.bnk[addr >> 14][addr & 0x3fff];
+	if (write) {
+		if (addr < 16384 && (zx->mem.epg_reg & 1) == 0)
+			return NULL;
+		if ((uintptr_t)p <= (uintptr_t)zx->mem.scr + ZX_ATTR_END &&
+		    (uintptr_t)p + len > (uintptr_t)zx->mem.scr)
+			return NULL;
+
+		p = zx_ram_write(zx, p);
+		zx_ram_write(zx, p + len - 1);
+	}
+
+	return p;
 }
 
-uint16_t zx_memget16(uint16_t addr)
+uint16_t zx_memget16(zx_machine_t *zx, uint16_t addr)
 {
-	return (uint16_t)zx_memget8(addr) + (((uint16_t)zx_memget8(addr + 1)) << 8);
+	return (uint16_t)zx_memget8(zx, addr) +
+	    (((uint16_t)zx_memget8(zx, addr + 1)) << 8);
 }
 
-void zx_memset16(uint16_t addr, uint16_t val)
+void zx_memset16(zx_machine_t *zx, uint16_t addr, uint16_t val)
 {
-	zx_memset8(addr, val & 0xff);
-	zx_memset8(addr + 1, val >> 8);
+	zx_memset8(zx, addr, val & 0xff);
+	zx_memset8(zx, addr + 1, val >> 8);
 }
 
-static void zx_epg_write(uint8_t val)
+static void zx_epg_write(zx_machine_t *zx, uint8_t val)
 {
 	uint8_t memmode;
-	epg_reg = val;
+	zx->mem.epg_reg = val;
 
-	if ((epg_reg & 1) == 0) {
+	if ((zx->mem.epg_reg & 1) == 0) {
 		/* back to normal paging */
-		zxbnk[1] = zxram + 5 * 0x4000;
-		zxbnk[2] = zxram + 2 * 0x4000;
+		zx->mem.bnk[1] = zx->mem.ram[5];
+		zx->mem.bnk[2] = zx->mem.ram[2];
+		zx_mem_bnk_update(zx);
 		return;
 	}
 
 	/* 'enhanced' paging */
-	memmode = (epg_reg >> 1) & 0x03;
+	memmode = (zx->mem.epg_reg >> 1) & 0x03;
 	switch (memmode) {
 	case 0:
-		zxbnk[0] = zxram + 0 * 0x4000;
-		zxbnk[1] = zxram + 1 * 0x4000;
-		zxbnk[2] = zxram + 2 * 0x4000;
-		zxbnk[3] = zxram + 3 * 0x4000;
+		zx->mem.bnk[0] = zx->mem.ram[0];
+		zx->mem.bnk[1] = zx->mem.ram[1];
+		zx->mem.bnk[2] = zx->mem.ram[2];
+		zx->mem.bnk[3] = zx->mem.ram[3];
 		break;
 	case 1:
-		zxbnk[0] = zxram + 4 * 0x4000;
-		zxbnk[1] = zxram + 5 * 0x4000;
-		zxbnk[2] = zxram + 6 * 0x4000;
-		zxbnk[3] = zxram + 7 * 0x4000;
+		zx->mem.bnk[0] = zx->mem.ram[4];
+		zx->mem.bnk[1] = zx->mem.ram[5];
+		zx->mem.bnk[2] = zx->mem.ram[6];
+		zx->mem.bnk[3] = zx->mem.ram[7];
 		break;
 	case 2:
-		zxbnk[0] = zxram + 4 * 0x4000;
-		zxbnk[1] = zxram + 5 * 0x4000;
-		zxbnk[2] = zxram + 6 * 0x4000;
-		zxbnk[3] = zxram + 3 * 0x4000;
+		zx->mem.bnk[0] = zx->mem.ram[4];
+		zx->mem.bnk[1] = zx->mem.ram[5];
+		zx->mem.bnk[2] = zx->mem.ram[6];
+		zx->mem.bnk[3] = zx->mem.ram[3];
 		break;
 	case 3:
-		zxbnk[0] = zxram + 4 * 0x4000;
-		zxbnk[1] = zxram + 7 * 0x4000;
-		zxbnk[2] = zxram + 6 * 0x4000;
-		zxbnk[3] = zxram + 3 * 0x4000;
+		zx->mem.bnk[0] = zx->mem.ram[4];
+		zx->mem.bnk[1] = zx->mem.ram[7];
+		zx->mem.bnk[2] = zx->mem.ram[6];
+		zx->mem.bnk[3] = zx->mem.ram[3];
 		break;
 	}
+
+	zx_mem_bnk_update(zx);
 }
 
-void zx_mem_page_select(uint16_t addr, uint8_t val)
+void zx_mem_page_select(zx_machine_t *zx, uint16_t addr, uint8_t val)
 {
 	uint8_t rom;
 
-	if (!has_banksw || bnk_lock48)
+	if (!zx->mem.has_banksw || zx->mem.bnk_lock48)
 		return;
 
-	if (has_epg) {
+	if (zx->mem.has_epg) {
 		/* with EPG exact port numbers are needed for EPG and PAGESEL */
 		if (addr == ZXPLUS_EPG_PORT) {
-			zx_epg_write(val);
-			if ((epg_reg & 1) != 0)
+			zx_epg_write(zx, val);
+			if ((zx->mem.epg_reg & 1) != 0)
 				return;
 		} else if (addr == ZXPLUS_PAGESEL_PORT) {
-			page_reg = val;
+			zx->mem.page_reg = val;
 		}
 
-		rom = ((page_reg & 0x10) ? 1 : 0) +
-		    ((epg_reg & 0x04) ? 2 : 0);
+		rom = ((zx->mem.page_reg & 0x10) ? 1 : 0) +
+		    ((zx->mem.epg_reg & 0x04) ? 2 : 0);
 	} else {
 		/* for 128K exact PAGESEL port number is not required */
-		page_reg = val;
+		zx->mem.page_reg = val;
 		rom = (val & 0x10) ? 1 : 0;
 	}
 
-	zxbnk[3] = zxram + ((uint32_t)(page_reg & 0x07) << 14); /* RAM select */
-	zxbnk[0] = zxrom + rom * 0x4000;                        /* ROM select */
-	zxscr   = zxram + ((page_reg & 0x08) ? 0x1c000 : 0x14000); /* screen select */
+	/* RAM select */
+	zx->mem.bnk[3] = zx->mem.ram[zx->mem.page_reg & 0x07];
+	/* ROM select */
+	zx->mem.bnk[0] = zx->mem.rom + rom * 0x4000;
+	/* screen select */
+	zx->mem.scr = zx->mem.ram[(zx->mem.page_reg & 0x08) ? 7 : 5];
+	zx_mem_bnk_update(zx);
 	//  printf("bnk select 0x%02x: ram=%d,rom=%d,scr=%d\n",val,val&7,val&0x10,val&0x08);
-	if (page_reg & 0x20) { /* 48k lock */
-		bnk_lock48 = 1;
-		gzx_notify_mode_48k(true);
+	if (zx->mem.page_reg & 0x20) { /* 48k lock */
+		zx->mem.bnk_lock48 = 1;
+		zx_notify_mode_48k(zx, true);
 	}
 }
 
 /* select default banks */
-void zx_mem_page_reset(void)
+void zx_mem_page_reset(zx_machine_t *zx)
 {
-	bnk_lock48 = 0;
-	epg_reg = 0x00;
-	zx_mem_page_select(ZXPLUS_PAGESEL_PORT, 0x07);
+	zx->mem.bnk_lock48 = 0;
+	zx->mem.epg_reg = 0x00;
+	zx_mem_page_select(zx, ZXPLUS_PAGESEL_PORT, 0x07);
 }
 
-/* Return nonzero if 0-0x3fff contains 48K BASIC ROM. */
-int zx_mem_is_48k_basic_rom(void)
+/** Determine which ROM bank contains the 48K BASIC ROM.
+ *
+ * @return ROM bank number or -1 if there is no 48K BASIC ROM
+ */
+int zx_mem_basic48_rom(zx_machine_t *zx)
 {
-	if (!has_banksw)
+	switch (zx->mem.model) {
+	case ZXM_48K:
+		return 0;
+	case ZXM_128K:
+	case ZXM_PLUS2:
 		return 1;
-	if (has_epg) {
-		if ((epg_reg & 1) == 0) {
-			/* only if ROM 3 is paged in */
-			return ((page_reg & 0x10) != 0 && (epg_reg & 0x04) != 0) ? 1 : 0;
-		} else {
-			/* all-RAM mode */
-			return 0;
-		}
-	} else {
-		/* only if ROM 1 is paged in */
-		return (page_reg & 0x10) ? 1 : 0;
+	case ZXM_PLUS2A:
+	case ZXM_PLUS3:
+		return 3;
+	default:
+		return -1;
 	}
 }
 
@@ -233,59 +740,90 @@ int zx_mem_is_48k_basic_rom(void)
  * all wraps should be placed here
  */
 
-uint8_t zx_in8(uint16_t a)
+/** Read from I/O device.
+ *
+ * @param a I/O address
+ * @return Value read
+ */
+static uint8_t zx_in8_dev(zx_machine_t *zx, uint16_t a)
 {
 	//  printf("in 0x%04x\n",a);
 	//  z80_printstatus();
 	//  getchar();
-	if (a == AY_REG_READ_PORT && ay0_enable)
-		return ay_reg_read(&ay0);
+	if (a == AY_REG_READ_PORT && zx->ay_enable)
+		return ay_reg_read(&zx->ay);
 	if ((a & ZX128K_PAGESEL_PORT_MASK) == ZX128K_PAGESEL_PORT_VAL)
 		printf("bnk sw port read!!!!!!\n");
 	switch (a & 0xff) {
 		/* ULA */
 	case ULA_PORT:
-		return zx_key_in(&keys, a >> 8) | 0xa0 | (ear ? 0x40 : 0x00);
+		return zx_key_in(&zx->keys, a >> 8) | 0xa0 |
+		    (zx->mem.ear ? 0x40 : 0x00);
 
 	case KEMPSTON_JOY_A_PORT:
-		if (kjoy0_enable)
-			return kempston_joy_read(&kjoy0);
+		if (zx->kjoy_enable)
+			return kempston_joy_read(&zx->kjoy);
 	default:
 		break;
 	}
 
 	printf("in 0x%04x\n (no device there)", a);
-	return video_ula.idle_bus_byte;
+	zx_video_sync(zx);
+	return zx->video.ula.idle_bus_byte;
 }
 
-void zx_out8(uint16_t addr, uint8_t val)
+/** Read from I/O port.
+ *
+ * During RZX recording the value is recorded, during playback
+ * the recorded value replaces the value read from the device.
+ *
+ * @param a I/O address
+ * @return Value read
+ */
+uint8_t zx_in8(zx_machine_t *zx, uint16_t a)
+{
+	uint8_t val;
+
+	val = zx_in8_dev(zx, a);
+	if (zx->rzx != NULL)
+		val = rzx_in(zx->rzx, val);
+
+	return val;
+}
+
+void zx_out8(zx_machine_t *zx, uint16_t addr, uint8_t val)
 {
 	//  printf("out (0x%04x),0x%02x\n",addr,val);
-	if (iorec != NULL)
-		iorec_out(iorec, z80_clock, addr, val);
+	if (zx->iorec != NULL)
+		iorec_out(zx->iorec, zx->cpu.clock, addr, val);
+
+	/* Border, screen bank and palette changes affect video output */
+	zx_video_sync(zx);
+	/* Speaker, MIC and AY changes affect sound output */
+	zx_snd_sync(zx);
 
 	if ((addr & ULA_PORT_MASK) == ULA_PORT) {
 		/* the ULA (border/speaker/mic) */
-		border = val & 7;
-		spk = (val & 0x10) == 0;
-		mic = (val & 0x18) == 0;
+		zx->mem.border = val & 7;
+		zx->mem.spk = (val & 0x10) == 0;
+		zx->mem.mic = (val & 0x18) == 0;
 		//    printf("border %d, spk:%d, mic:%d\n",border,(val>>4)&1,(val>>3)&1);
 		//    z80_printstatus();
 		//    getchar();
 	} else if ((addr & ZX128K_PAGESEL_PORT_MASK) == ZX128K_PAGESEL_PORT_VAL) {
-		zx_mem_page_select(addr, val);
-	} else if (addr == AY_REG_WRITE_PORT && ay0_enable) {
-		ay_reg_write(&ay0, val);
-	}
-
-	if (addr == AY_REG_SEL_PORT && ay0_enable) {
-		ay_reg_select(&ay0, val);
-	} else if (addr == ULAPLUS_REGSEL_PORT && video_ula.plus_enable) {
-		ulaplus_write_regsel(&video_ula.plus, val);
-		zx_scr_update_pal();
-	} else if (addr == ULAPLUS_DATA_PORT && video_ula.plus_enable) {
-		ulaplus_write_data(&video_ula.plus, val);
-		zx_scr_update_pal();
+		zx_mem_page_select(zx, addr, val);
+	} else if (addr == AY_REG_WRITE_PORT && zx->ay_enable) {
+		ay_reg_write(&zx->ay, val);
+	}
+
+	if (addr == AY_REG_SEL_PORT && zx->ay_enable) {
+		ay_reg_select(&zx->ay, val);
+	} else if (addr == ULAPLUS_REGSEL_PORT && zx->video.ula.plus_enable) {
+		ulaplus_write_regsel(&zx->video.ula.plus, val);
+		zx_scr_update_pal(zx);
+	} else if (addr == ULAPLUS_DATA_PORT && zx->video.ula.plus_enable) {
+		ulaplus_write_data(&zx->video.ula.plus, val);
+		zx_scr_update_pal(zx);
 	} else {
 		// printf("out (0x%04x),0x%02x (no device there)\n",addr,val);
 	}
@@ -293,168 +831,402 @@ void zx_out8(uint16_t addr, uint8_t val)
 	/* no device attached */
 }
 
-int zx_select_memmodel(int model)
+/** Fill RAM with power-on contents.
+ *
+ * Fill RAM with random-looking stuff. Use a fixed seed so that
+ * starting the emulator is reproducible.
+ *
+ * @param ram RAM
+ * @param size Size of RAM in bytes
+ */
+void zx_mem_ram_init(uint8_t *ram, uint32_t size)
 {
-	int i;
-	char *cur_dir;
+	uint32_t seed;
+	uint32_t i;
 
-	mem_model = model;
+	seed = ZX_RAM_SEED;
+	for (i = 0; i < size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		ram[i] = seed;
+	}
+}
+
+/** Get memory sizes of a memory model.
+ *
+ * @param model Memory model
+ * @param rram Place to store RAM size
+ * @param rrom Place to store ROM size
+ * @return Zero on success, EINVAL if @a model is not valid
+ */
+int zx_mem_model_size(int model, uint32_t *rram, uint32_t *rrom)
+{
 	switch (model) {
 	case ZXM_48K:
-		/* 48K spectrum */
-		ram_size = 48 * 1024;
-		rom_size = 16 * 1024;
-		has_banksw = 0;
-		has_epg = 0;
+		*rram = 48 * 1024;
+		*rrom = 16 * 1024;
 		break;
-
 	case ZXM_128K:
-		/* 128K spectrum */
-		ram_size = 128 * 1024;
-		rom_size = 32 * 1024;
-		has_banksw = 1;
-		has_epg = 0;
-		break;
-
 	case ZXM_PLUS2:
-		/* spectrum +2 */
-		ram_size = 128 * 1024;
-		rom_size = 32 * 1024;
-		has_banksw = 1;
-		has_epg = 0;
+		*rram = 128 * 1024;
+		*rrom = 32 * 1024;
 		break;
-
 	case ZXM_PLUS2A:
 	case ZXM_PLUS3:
-		/* spectrum +3 */
-		ram_size = 128 * 1024;
-		rom_size = 64 * 1024;
-		has_banksw = 1;
-		has_epg = 1;
+		*rram = 128 * 1024;
+		*rrom = 64 * 1024;
 		break;
-
 	case ZXM_ZX81:
-		/* ZX81 */
-		ram_size = 24 * 1024;
-		rom_size = 16 * 1024;
-		has_banksw = 0;
-		has_epg = 0;
+		*rram = 24 * 1024;
+		*rrom = 16 * 1024;
 		break;
+	default:
+		return EINVAL;
 	}
 
-	/* reallocate memory */
-	zxram = realloc(zxram, ram_size);
-	zxrom = realloc(zxrom, rom_size);
-	if (zxram == NULL || zxrom == NULL) {
-		printf("malloc failed\n");
-		return -1;
+	return 0;
+}
+
+/** Set up the bank store with power-on contents of RAM.
+ *
+ * @return Zero on success, ENOMEM if out of memory
+ */
+static int zx_mem_store_init(void)
+{
+	pgshare_t *store;
+	uint8_t *ram;
+	unsigned b;
+	int rc;
+
+	if (zx_bank_store != NULL)
+		return 0;
+
+	ram = malloc(ZX_MEM_RAM_NBNK * ZX_MEM_BNK_SIZE);
+	if (ram == NULL)
+		return ENOMEM;
+
+	rc = pgshare_create(ZX_MEM_BNK_SIZE, &store);
+	if (rc != 0) {
+		free(ram);
+		return rc;
 	}
 
-	/* fill RAM with random stuff */
-	srand(time(NULL));
-	for (i = 0; i < ram_size; i++)
-		zxram[i] = rand();
+	zx_mem_ram_init(ram, ZX_MEM_RAM_NBNK * ZX_MEM_BNK_SIZE);
+	for (b = 0; b < ZX_MEM_RAM_NBNK; b++) {
+		rc = pgshare_get(store, ram + b * ZX_MEM_BNK_SIZE,
+		    &zx_ram_init_pg[b]);
+		if (rc != 0) {
+			pgshare_destroy(store);
+			free(ram);
+			return rc;
+		}
+	}
+
+	free(ram);
+	zx_bank_store = store;
+	return 0;
+}
+
+/** Load memory model.
+ *
+ * The ROM image is read from the ROM files the first time and kept
+ * in memory for all machines, as are the power-on contents of RAM.
+ * Once this succeeds, zx_select_memmodel() cannot fail for @a model.
+ * Loading is not thread-safe, all memory models that are going to be
+ * used should be loaded before machines are used from multiple threads.
+ *
+ * @param model Memory model
+ * @return Zero on success, EINVAL if @a model is not valid, ENOMEM
+ *         if out of memory, EIO if a ROM file cannot be read
+ */
+int zx_mem_model_load(int model)
+{
+	const zx_rom_file_t *rf;
+	uint32_t ram_sz;
+	uint32_t rom_sz;
+	uint8_t *img;
+	int rc;
+
+	rc = zx_mem_model_size(model, &ram_sz, &rom_sz);
+	if (rc != 0)
+		return rc;
 
-	/* load ROM */
-	cur_dir = sys_getcwd(NULL, 0);
-	if (start_dir)
-		sys_chdir(start_dir);
+	rc = zx_mem_store_init();
+	if (rc != 0)
+		return rc;
 
-	switch (mem_model) {
+	if (zx_rom_img[model] != NULL)
+		return 0;
+
+	img = calloc(1, rom_sz);
+	if (img == NULL)
+		return ENOMEM;
+
+	for (rf = zx_rom_files[model]; rf->fname != NULL; rf++) {
+		if (rom_load(rf, img) < 0) {
+			free(img);
+			return EIO;
+		}
+	}
+
+	/* Nothing is mapped above 32K in ZX81 mode */
+	if (model == ZXM_ZX81)
+		memset(zx_mem_unmapped, 0xff, ZX_MEM_PG_SIZE);
+
+	zx_rom_img[model] = img;
+	return 0;
+}
+
+/** Switch in the power-on banks of the memory model.
+ *
+ * The page tables need to be updated afterwards.
+ *
+ * @param zx Machine
+ */
+static void zx_mem_bnk_init(zx_machine_t *zx)
+{
+	switch (zx->mem.model) {
 	case ZXM_48K:
-		if (spec_rom_load("roms/zx48.rom", 0) < 0)
-			return -1;
+		zx->mem.bnk[0] = zx->mem.rom;
+		zx->mem.bnk[1] = zx->mem.ram[0];
+		zx->mem.bnk[2] = zx->mem.ram[1];
+		zx->mem.bnk[3] = zx->mem.ram[2];
+		zx->mem.scr = zx->mem.ram[0];
 		break;
 
 	case ZXM_128K:
-		if (spec_rom_load("roms/zx128_0.rom", 0) < 0)
-			return -1;
-		if (spec_rom_load("roms/zx128_1.rom", 1) < 0)
-			return -1;
-		break;
-
 	case ZXM_PLUS2:
-		if (spec_rom_load("roms/zxp2_0.rom", 0) < 0)
-			return -1;
-		if (spec_rom_load("roms/zxp2_1.rom", 1) < 0)
-			return -1;
+		zx->mem.bnk[0] = zx->mem.rom;
+		zx->mem.bnk[1] = zx->mem.ram[5];
+		zx->mem.bnk[2] = zx->mem.ram[2];
+		zx->mem.bnk[3] = zx->mem.ram[7];
+		zx->mem.scr = zx->mem.ram[5];
 		break;
 
 	case ZXM_PLUS2A:
 	case ZXM_PLUS3:
-		if (spec_rom_load("roms/zxp3_0.rom", 0) < 0)
-			return -1;
-		if (spec_rom_load("roms/zxp3_1.rom", 1) < 0)
-			return -1;
-		if (spec_rom_load("roms/zxp3_2.rom", 2) < 0)
-			return -1;
-		if (spec_rom_load("roms/zxp3_3.rom", 3) < 0)
-			return -1;
+		zx->mem.bnk[0] = zx->mem.rom;
+		zx->mem.bnk[1] = zx->mem.ram[5];
+		zx->mem.bnk[2] = zx->mem.ram[2];
+		zx->mem.bnk[3] = zx->mem.ram[7];
+		zx->mem.scr = zx->mem.ram[5];
 		break;
 
-	case ZXM_ZX81:
-		if (rom_load("roms/zx81.rom", 0, 0x2000) < 0)
-			return -1;
+	case ZXM_ZX81: /* 8k pages, only the first 8K of RAM is mapped */
+		zx->mem.bnk[0] = zx->mem.rom;
+		zx->mem.bnk[1] = zx->mem.ram[0];
+		zx->mem.bnk[2] = zx->mem.ram[1];
+		zx->mem.bnk[3] = zx->mem.ram[1];
+		zx->mem.scr = zx->mem.ram[0];
 		break;
 	}
-	if (cur_dir) {
-		sys_chdir(cur_dir);
-		free(cur_dir);
-	}
+}
 
-	/* setup memory banks */
-	switch (mem_model) {
-	case ZXM_48K:
-		zxbnk[0] = zxrom;
-		zxbnk[1] = zxram;
-		zxbnk[2] = zxram + 16 * 1024;
-		zxbnk[3] = zxram + 32 * 1024;
-		zxscr = zxram;
-		break;
+/** Free memory of the machine.
+ *
+ * @param zx Machine
+ */
+void zx_mem_fini(zx_machine_t *zx)
+{
+	zx_mem_banks_release(zx);
+}
 
+/** Select memory model.
+ *
+ * The machine gets the power-on contents of RAM and the ROM of
+ * @a model. Memory is shared with other machines until written to.
+ *
+ * @param zx Machine
+ * @param model Memory model
+ * @return Zero on success, -1 if the memory model cannot be loaded
+ */
+int zx_select_memmodel(zx_machine_t *zx, int model)
+{
+	unsigned b;
+
+	if (zx_mem_model_load(model) != 0)
+		return -1;
+
+	(void) zx_mem_model_size(model, &zx->mem.ram_size, &zx->mem.rom_size);
+
+	zx->mem.model = model;
+	switch (model) {
 	case ZXM_128K:
 	case ZXM_PLUS2:
-		zxbnk[0] = zxrom;
-		zxbnk[1] = zxram + 5 * 0x4000;
-		zxbnk[2] = zxram + 2 * 0x4000;
-		zxbnk[3] = zxram + 7 * 0x4000;
-		zxscr = zxram + 5 * 0x4000;
+		zx->mem.has_banksw = 1;
+		zx->mem.has_epg = 0;
 		break;
 
 	case ZXM_PLUS2A:
 	case ZXM_PLUS3:
-		zxbnk[0] = zxrom;
-		zxbnk[1] = zxram + 5 * 0x4000;
-		zxbnk[2] = zxram + 2 * 0x4000;
-		zxbnk[3] = zxram + 7 * 0x4000;
-		zxscr = zxram + 5 * 0x4000;
+		zx->mem.has_banksw = 1;
+		zx->mem.has_epg = 1;
 		break;
 
-	case ZXM_ZX81: /* 8k pages */
-		zxbnk[0] = zxrom;
-		zxbnk[1] = zxram;
-		zxbnk[2] = zxram + 16 * 1024;
-		zxbnk[3] = zxram + 32 * 1024;
-		zxscr = zxram;
+	default:
+		zx->mem.has_banksw = 0;
+		zx->mem.has_epg = 0;
 		break;
 	}
 
-	gzx_notify_mode_48k(has_banksw == false);
+	/* GPU memory planes hold memory of the old model */
+	if (gpu_is_on(zx))
+		gpu_disable(zx);
+
+	zx_mem_banks_release(zx);
+
+	zx->mem.ram_nbnk = (zx->mem.ram_size + ZX_MEM_BNK_SIZE - 1) /
+	    ZX_MEM_BNK_SIZE;
+	zx_bank_lock();
+	for (b = 0; b < zx->mem.ram_nbnk; b++) {
+		pgshare_ref(zx_ram_init_pg[b]);
+		zx->mem.ram_pg[b] = zx_ram_init_pg[b];
+		zx->mem.ram[b] = zx_ram_init_pg[b]->data;
+	}
+	zx_bank_unlock();
+
+	zx->mem.rom = zx_rom_img[model];
+	zx->mem.unmapped = model == ZXM_ZX81 ? zx_mem_unmapped : NULL;
+
+	memset(zx->mem.dirty_map, 1, zx->mem.ram_size >> ZX_MEM_PG_SHIFT);
+
+	(void) romtrap_reset(zx, zx->mem.rom_size);
+
+	zx_mem_bnk_init(zx);
+	zx_mem_bnk_update(zx);
+
+	zx_add_rom_traps(zx);
+	zx_notify_mode_48k(zx, zx->mem.has_banksw == false);
 	return 0;
 }
 
-static int rom_load(char *fname, int bank, uint16_t banksize)
+/** Share memory of another machine.
+ *
+ * @a dst is switched to the memory model of @a src and gets the same
+ * RAM and ROM contents. RAM banks are shared by both machines until
+ * either writes to them. Private banks of @a src are moved to the bank
+ * store first (banks with identical contents are only kept once).
+ * Paging of @a dst is reset and all its RAM is dirty.
+ *
+ * @param dst Destination machine
+ * @param src Source machine
+ * @return Zero on success, ENOMEM if out of memory
+ */
+int zx_mem_share(zx_machine_t *dst, zx_machine_t *src)
+{
+	pgshare_page_t *pg;
+	uint8_t *rom = NULL;
+	uint8_t *old;
+	unsigned b;
+	int rc;
+
+	for (b = 0; b < src->mem.ram_nbnk; b++) {
+		if (src->mem.ram_pg[b] != NULL)
+			continue;
+
+		zx_bank_lock();
+		rc = pgshare_get(zx_bank_store, src->mem.ram[b], &pg);
+		zx_bank_unlock();
+		if (rc != 0)
+			return rc;
+
+		old = src->mem.ram[b];
+		src->mem.ram[b] = pg->data;
+		src->mem.ram_pg[b] = pg;
+		zx_mem_remap(src, old, pg->data, ZX_MEM_BNK_SIZE);
+		free(old);
+	}
+
+	zx_mem_bnk_update(src);
+
+	if (src->mem.rom_priv) {
+		rom = malloc(src->mem.rom_size);
+		if (rom == NULL)
+			return ENOMEM;
+		memcpy(rom, src->mem.rom, src->mem.rom_size);
+	}
+
+	/* Cannot fail, the memory model is in use by src */
+	(void) zx_select_memmodel(dst, src->mem.model);
+
+	zx_bank_lock();
+	for (b = 0; b < dst->mem.ram_nbnk; b++) {
+		pgshare_release(zx_bank_store, dst->mem.ram_pg[b]);
+		pgshare_ref(src->mem.ram_pg[b]);
+		dst->mem.ram_pg[b] = src->mem.ram_pg[b];
+		dst->mem.ram[b] = src->mem.ram[b];
+	}
+	zx_bank_unlock();
+
+	if (rom != NULL) {
+		dst->mem.rom = rom;
+		dst->mem.rom_priv = true;
+	}
+
+	zx_mem_bnk_init(dst);
+	zx_mem_bnk_update(dst);
+	return 0;
+}
+
+/** Get number of RAM banks in the bank store.
+ *
+ * @return Number of distinct shared banks of all machines
+ */
+size_t zx_mem_store_banks(void)
+{
+	size_t n;
+
+	zx_bank_lock();
+	n = zx_bank_store != NULL ? zx_bank_store->npages : 0;
+	zx_bank_unlock();
+	return n;
+}
+
+/** Open ROM file.
+ *
+ * ROM files are looked up relative to start_dir (or the current
+ * directory if it is @c NULL). The working directory is not changed.
+ *
+ * @param fname File name relative to start_dir
+ * @return Open file or @c NULL on error
+ */
+static FILE *rom_fopen(const char *fname)
 {
 	FILE *f;
+	char *path;
+
+	if (start_dir == NULL)
+		return fopen(fname, "rb");
 
-	f = fopen(fname, "rb");
+	path = malloc(strlen(start_dir) + 1 + strlen(fname) + 1);
+	if (path == NULL)
+		return NULL;
+
+	sprintf(path, "%s/%s", start_dir, fname);
+	f = fopen(path, "rb");
+	free(path);
+	return f;
+}
+
+/** Load ROM file.
+ *
+ * @param rf ROM file
+ * @param img ROM image to load the file into
+ * @return Zero on success, -1 on error
+ */
+static int rom_load(const zx_rom_file_t *rf, uint8_t *img)
+{
+	FILE *f;
+
+	f = rom_fopen(rf->fname);
 
 	if (f == NULL) {
-		printf("rom_load: cannot open file '%s'\n", fname);
+		printf("rom_load: cannot open file '%s'\n", rf->fname);
 		return -1;
 	}
 
-	if (fread(zxrom + (bank * banksize), 1, banksize, f) != banksize) {
+	if (fread(img + rf->offs, 1, rf->size, f) != rf->size) {
 		printf("rom_load: unexpected end of file\n");
 		fclose(f);
 		return -1;
@@ -464,35 +1236,24 @@ static int rom_load(char *fname, int bank, uint16_t banksize)
 	return 0;
 }
 
-static int spec_rom_load(char *fname, int bank)
-{
-	return rom_load(fname, bank, 0x4000);
-}
-
-int gfxrom_load(char *fname, unsigned bank)
+int gfxrom_load(zx_machine_t *zx, char *fname, unsigned bank)
 {
 	FILE *f;
 	unsigned u, v, w;
 	uint8_t buf[8];
 	uint8_t b;
-	char *cur_dir;
 	size_t nr;
 
-	cur_dir = sys_getcwd(NULL, 0);
-	if (start_dir)
-		sys_chdir(start_dir);
-
-	f = fopen(fname, "rb");
+	f = rom_fopen(fname);
 	if (f == NULL) {
 		printf("gfxrom_load: cannot open file '%s'\n", fname);
-		sys_chdir(cur_dir);
 		return -1;
 	}
 	for (u = 0; u < 16384; u++) {
 		nr = fread(buf, 1, 8, f);
 		if (nr != 8) {
 			printf("gfxrom_load: error loading file '%s'\n", fname);
-			sys_chdir(cur_dir);
+			fclose(f);
 			return -1;
 		}
 
@@ -502,12 +1263,10 @@ int gfxrom_load(char *fname, unsigned bank)
 				if (buf[w] & (1 << v))
 					b |= (1 << w);
 			}
-			gfxrom[v][bank * 0x4000 + u] = b;
+			zx->gpu.planes->rom[v][bank * 0x4000 + u] = b;
 		}
 	}
 
 	fclose(f);
-	sys_chdir(cur_dir);
-
 	return 0;
 }
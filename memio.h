@@ -32,8 +32,13 @@
 #ifndef MEMIO_H
 #define MEMIO_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "types/memio.h"
+#include "types/zx.h"
+
 /* memory models */
 #define ZXM_48K    0
 #define ZXM_128K   1
@@ -43,33 +48,89 @@
 #define ZXM_ZX81   5
 
 /* spectrum memory access */
-extern uint8_t zx_memget8(uint16_t addr);
-extern uint8_t zx_imemget8(uint16_t addr);
-extern void zx_memset8(uint16_t addr, uint8_t val);
-extern void zx_memset8f(uint16_t addr, uint8_t val);
-extern uint16_t zx_memget16(uint16_t addr);
-extern void zx_memset16(uint16_t addr, uint16_t val);
+extern void zx_memset8_slow(zx_machine_t *, uint16_t addr, uint8_t val);
+extern void zx_memset8f(zx_machine_t *, uint16_t addr, uint8_t val);
+extern uint8_t *zx_mem_direct(zx_machine_t *, uint16_t addr, uint16_t len,
+    int write);
+extern uint16_t zx_memget16(zx_machine_t *, uint16_t addr);
+extern void zx_memset16(zx_machine_t *, uint16_t addr, uint16_t val);
 
 /* spectrum i/o port access */
-extern void zx_out8(uint16_t addr, uint8_t val);
-extern uint8_t zx_in8(uint16_t addr);
+extern void zx_out8(zx_machine_t *, uint16_t addr, uint8_t val);
+extern uint8_t zx_in8(zx_machine_t *, uint16_t addr);
+
+extern void zx_mem_ram_init(uint8_t *, uint32_t);
+extern int zx_mem_model_size(int, uint32_t *, uint32_t *);
+extern int zx_mem_model_load(int);
+extern int zx_select_memmodel(zx_machine_t *, int model);
+extern int zx_mem_share(zx_machine_t *, zx_machine_t *);
+extern size_t zx_mem_store_banks(void);
+extern void zx_mem_fini(zx_machine_t *);
+extern void zx_mem_page_select(zx_machine_t *, uint16_t, uint8_t val);
+extern void zx_mem_page_reset(zx_machine_t *);
+extern int zx_mem_basic48_rom(zx_machine_t *);
+extern void zx_mem_bnk_update(zx_machine_t *);
+extern bool zx_mem_ram_off(zx_machine_t *, const uint8_t *, uint32_t *);
+extern uint8_t *zx_mem_bank_wr(zx_machine_t *, unsigned);
+extern void zx_mem_ram_save(zx_machine_t *, uint8_t *);
+extern void zx_mem_ram_restore(zx_machine_t *, const uint8_t *);
+extern bool zx_mem_dirty(zx_machine_t *, uint32_t);
+extern void zx_mem_dirty_clear(zx_machine_t *);
+extern int gfxrom_load(zx_machine_t *, char *fname, unsigned bank);
+
+/** Get pointer for reading RAM, bypassing the page tables.
+ *
+ * The pointer is valid until the machine next writes to memory.
+ *
+ * @param zx Machine
+ * @param off Offset into RAM (bank number * 16K + offset in the bank)
+ * @return Pointer to the byte at @a off (the rest of its bank follows)
+ */
+static inline const uint8_t *zx_mem_ram_ptr(zx_machine_t *zx, uint32_t off)
+{
+	return zx->mem.ram[off / ZX_MEM_BNK_SIZE] + off % ZX_MEM_BNK_SIZE;
+}
+
+/** Read byte from memory.
+ *
+ * @param zx Machine
+ * @param addr Address
+ * @return Byte value
+ */
+static inline uint8_t zx_memget8(zx_machine_t *zx, uint16_t addr)
+{
+	return zx->mem.rdpg[addr >> ZX_MEM_PG_SHIFT]
+	    [addr & (ZX_MEM_PG_SIZE - 1)];
+}
 
-extern int zx_select_memmodel(int model);
-extern void zx_mem_page_select(uint16_t, uint8_t val);
-extern void zx_mem_page_reset(void);
-extern int zx_mem_is_48k_basic_rom(void);
-extern int gfxrom_load(char *fname, unsigned bank);
+/** Read byte from memory during instruction fetch.
+ *
+ * @param zx Machine
+ * @param addr Address
+ * @return Byte value
+ */
+static inline uint8_t zx_imemget8(zx_machine_t *zx, uint16_t addr)
+{
+	return zx_memget8(zx, addr);
+}
 
-extern uint8_t page_reg;
-extern uint8_t epg_reg;
-extern uint8_t border;
-extern uint8_t spk, mic, ear;
-extern uint8_t *zxram, *zxrom, *zxscr, *zxbnk[4];
-extern int mem_model;
+/** Write byte to memory.
+ *
+ * Pages with no entry in the write page table need extra processing.
+ *
+ * @param zx Machine
+ * @param addr Address
+ * @param val Byte value
+ */
+static inline void zx_memset8(zx_machine_t *zx, uint16_t addr, uint8_t val)
+{
+	uint8_t *pg;
 
-extern int bnk_lock48;
-extern uint32_t ram_size, rom_size;
-extern int has_banksw;
-extern int has_epg;
+	pg = zx->mem.wrpg[addr >> ZX_MEM_PG_SHIFT];
+	if (pg != NULL)
+		pg[addr & (ZX_MEM_PG_SIZE - 1)] = val;
+	else
+		zx_memset8_slow(zx, addr, val);
+}
 
 #endif
@@ -0,0 +1,108 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Host clock pacing
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host clock pacing
+ *
+ * Each emulated field is scheduled on the host monotonic clock. If
+ * emulation is ahead, we sleep until the field is due. If it is behind,
+ * we tell the caller to skip rendering the next field rather than slowing
+ * down emulation. If it is too far behind (e.g. after the emulator was
+ * stopped in a menu), the schedule is restarted.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pace.h"
+#include "sys_all.h"
+
+/** Restart schedule when this many fields behind */
+#define PACE_MAX_LAG 10
+/** Maximum number of fields to skip in a row */
+#define PACE_MAX_SKIP 5
+
+/** Initialize pacing.
+ *
+ * @param pace Pacing
+ * @param period Field period in microseconds
+ */
+void pace_init(pace_t *pace, uint32_t period)
+{
+	pace->period = period;
+	pace_reset(pace);
+}
+
+/** Restart schedule from the current time.
+ *
+ * @param pace Pacing
+ */
+void pace_reset(pace_t *pace)
+{
+	pace->due = sys_time_usec();
+	pace->nskip = 0;
+}
+
+/** Wait for the end of the current field.
+ *
+ * Called once per emulated field, when the field has been emulated.
+ *
+ * @param pace Pacing
+ * @return @c true if the next field should be rendered, @c false if
+ *         the host is falling behind and it should be skipped
+ */
+bool pace_field(pace_t *pace)
+{
+	uint64_t now;
+
+	pace->due += pace->period;
+	now = sys_time_usec();
+
+	if (now < pace->due) {
+		sys_sleep_until(pace->due);
+		pace->nskip = 0;
+		return true;
+	}
+
+	if (now - pace->due >= (uint64_t)PACE_MAX_LAG * pace->period) {
+		/* Hopelessly behind, start over */
+		pace_reset(pace);
+		return true;
+	}
+
+	/* Behind, but not for too long */
+	if (pace->nskip >= PACE_MAX_SKIP) {
+		pace->nskip = 0;
+		return true;
+	}
+
+	++pace->nskip;
+	return false;
+}
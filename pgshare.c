@@ -0,0 +1,223 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Shared copy-on-write memory pages
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Shared copy-on-write memory pages
+ *
+ * Pages with identical contents are stored only once. A page is never
+ * modified while referenced: to change it, the owner gets a page with
+ * the new contents and releases the old one. Pages are found by hash
+ * of their contents.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adt/list.h"
+#include "hash.h"
+#include "pgshare.h"
+
+/** Initial number of hash table buckets */
+#define PGSHARE_BUCKETS_INIT 256
+
+/** Allocate hash table buckets.
+ *
+ * @param n Number of buckets
+ * @return Buckets or @c NULL if out of memory
+ */
+static list_t *pgshare_buckets_alloc(size_t n)
+{
+	list_t *buckets;
+	size_t i;
+
+	buckets = calloc(n, sizeof(list_t));
+	if (buckets == NULL)
+		return NULL;
+
+	for (i = 0; i < n; i++)
+		list_initialize(&buckets[i]);
+
+	return buckets;
+}
+
+/** Create store of shared pages.
+ *
+ * @param pg_size Page size in bytes
+ * @param rpgs Place to store pointer to new store
+ * @return Zero on success, ENOMEM if out of memory
+ */
+int pgshare_create(size_t pg_size, pgshare_t **rpgs)
+{
+	pgshare_t *pgs;
+
+	pgs = calloc(1, sizeof(pgshare_t));
+	if (pgs == NULL)
+		return ENOMEM;
+
+	pgs->buckets = pgshare_buckets_alloc(PGSHARE_BUCKETS_INIT);
+	if (pgs->buckets == NULL) {
+		free(pgs);
+		return ENOMEM;
+	}
+
+	pgs->nbuckets = PGSHARE_BUCKETS_INIT;
+	pgs->pg_size = pg_size;
+	*rpgs = pgs;
+	return 0;
+}
+
+/** Destroy store of shared pages.
+ *
+ * Any pages still referenced are freed.
+ *
+ * @param pgs Store
+ */
+void pgshare_destroy(pgshare_t *pgs)
+{
+	link_t *link;
+	size_t i;
+
+	for (i = 0; i < pgs->nbuckets; i++) {
+		while (!list_empty(&pgs->buckets[i])) {
+			link = list_first(&pgs->buckets[i]);
+			list_remove(link);
+			free(list_get_instance(link, pgshare_page_t, lbucket));
+		}
+	}
+
+	free(pgs->buckets);
+	free(pgs);
+}
+
+/** Double the number of hash table buckets.
+ *
+ * If out of memory, the table is left unchanged (it only gets slower).
+ *
+ * @param pgs Store
+ */
+static void pgshare_grow(pgshare_t *pgs)
+{
+	list_t *nbuckets;
+	size_t n;
+	link_t *link;
+	pgshare_page_t *pg;
+	size_t i;
+
+	n = 2 * pgs->nbuckets;
+	nbuckets = pgshare_buckets_alloc(n);
+	if (nbuckets == NULL)
+		return;
+
+	for (i = 0; i < pgs->nbuckets; i++) {
+		while (!list_empty(&pgs->buckets[i])) {
+			link = list_first(&pgs->buckets[i]);
+			list_remove(link);
+			pg = list_get_instance(link, pgshare_page_t, lbucket);
+			list_append(link, &nbuckets[pg->hash & (n - 1)]);
+		}
+	}
+
+	free(pgs->buckets);
+	pgs->buckets = nbuckets;
+	pgs->nbuckets = n;
+}
+
+/** Get reference to page with the given contents.
+ *
+ * If the store already contains an identical page, it is shared,
+ * otherwise a new page is created.
+ *
+ * @param pgs Store
+ * @param data Page contents (pg_size bytes)
+ * @param rpg Place to store pointer to page (with a new reference)
+ * @return Zero on success, ENOMEM if out of memory
+ */
+int pgshare_get(pgshare_t *pgs, const uint8_t *data, pgshare_page_t **rpg)
+{
+	pgshare_page_t *pg;
+	list_t *bucket;
+	uint32_t hash;
+
+	hash = hash_fnv1a(HASH_FNV1A_INIT, data, pgs->pg_size);
+	bucket = &pgs->buckets[hash & (pgs->nbuckets - 1)];
+
+	list_foreach(*bucket, lbucket, pgshare_page_t, p) {
+		if (p->hash == hash &&
+		    memcmp(p->data, data, pgs->pg_size) == 0) {
+			++p->refcnt;
+			*rpg = p;
+			return 0;
+		}
+	}
+
+	pg = malloc(sizeof(pgshare_page_t) + pgs->pg_size);
+	if (pg == NULL)
+		return ENOMEM;
+
+	link_initialize(&pg->lbucket);
+	pg->hash = hash;
+	pg->refcnt = 1;
+	memcpy(pg->data, data, pgs->pg_size);
+	list_append(&pg->lbucket, bucket);
+
+	if (++pgs->npages > 2 * pgs->nbuckets)
+		pgshare_grow(pgs);
+
+	*rpg = pg;
+	return 0;
+}
+
+/** Add reference to page.
+ *
+ * @param pg Page
+ */
+void pgshare_ref(pgshare_page_t *pg)
+{
+	++pg->refcnt;
+}
+
+/** Release reference to page.
+ *
+ * The page is freed when the last reference is released.
+ *
+ * @param pgs Store
+ * @param pg Page
+ */
+void pgshare_release(pgshare_t *pgs, pgshare_page_t *pg)
+{
+	if (--pg->refcnt > 0)
+		return;
+
+	list_remove(&pg->lbucket);
+	--pgs->npages;
+	free(pg);
+}
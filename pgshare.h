@@ -0,0 +1,69 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Shared copy-on-write memory pages
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PGSHARE_H
+#define PGSHARE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types/adt/list.h"
+
+/** Shared page (immutable while referenced) */
+typedef struct {
+	/** Link to pgshare_t.buckets */
+	link_t lbucket;
+	/** Hash of page contents */
+	uint32_t hash;
+	/** Number of references */
+	unsigned long refcnt;
+	/** Page contents (pgshare_t.pg_size bytes) */
+	uint8_t data[];
+} pgshare_page_t;
+
+/** Store of shared pages, deduplicated by contents */
+typedef struct {
+	/** Hash table buckets (lists of pgshare_page_t) */
+	list_t *buckets;
+	/** Number of buckets (power of two) */
+	size_t nbuckets;
+	/** Number of pages */
+	size_t npages;
+	/** Page size in bytes */
+	size_t pg_size;
+} pgshare_t;
+
+extern int pgshare_create(size_t, pgshare_t **);
+extern void pgshare_destroy(pgshare_t *);
+extern int pgshare_get(pgshare_t *, const uint8_t *, pgshare_page_t **);
+extern void pgshare_ref(pgshare_page_t *);
+extern void pgshare_release(pgshare_t *, pgshare_page_t *);
+
+#endif
@@ -45,11 +45,14 @@ static size_t rs_d;
 static uint8_t *rsbuf;
 static hound_context_t *hound;
 
-int sndw_init(int bufs)
+int sndw_init(int bufs, int latency)
 {
 	pcm_format_t fmt;
 	int rc;
 
+	/* Latency is determined by the hound buffer size */
+	(void) latency;
+
 	fmt.channels = 1;
 	fmt.sampling_rate = /* 28000 */44100;
 	fmt.sample_format = PCM_SAMPLE_UINT8;
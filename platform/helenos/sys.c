@@ -32,20 +32,38 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fibril.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <vfs/vfs.h>
-#include "../../clock.h"
 #include "../../sys_all.h"
 
 static DIR *sd;
 
-void timer_reset(timer *t)
+/** Get monotonic time.
+ *
+ * @return Time in microseconds (from an arbitrary origin)
+ */
+uint64_t sys_time_usec(void)
 {
+	struct timespec ts;
+
+	getuptime(&ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-unsigned long timer_val(timer *t)
+/** Sleep until a point in time.
+ *
+ * @param usec Monotonic time in microseconds (see sys_time_usec())
+ */
+void sys_sleep_until(uint64_t usec)
 {
-	return 0;
+	uint64_t now;
+
+	now = sys_time_usec();
+	if (now < usec)
+		fibril_usleep(usec - now);
 }
 
 int sys_chdir(const char *path)
@@ -109,3 +127,56 @@ void sys_usleep(unsigned usec)
 {
 	fibril_usleep(usec);
 }
+
+/** Get number of available processors.
+ *
+ * @return Number of processors (at least one)
+ */
+int sys_ncpus(void)
+{
+	return 1;
+}
+
+/** Start job in a separate process (not supported).
+ *
+ * @param fn Job function
+ * @param arg Argument to @a fn
+ * @param out File to receive standard output of the job
+ * @param rid Place to store job ID
+ * @return ENOTSUP
+ */
+int sys_job_start(int (*fn)(void *), void *arg, FILE *out, long *rid)
+{
+	return ENOTSUP;
+}
+
+/** Wait for any job to finish (not supported).
+ *
+ * @param rid Place to store ID of the finished job
+ * @param rstatus Place to store exit status of the job
+ * @return ECHILD
+ */
+int sys_job_wait(long *rid, int *rstatus)
+{
+	return ECHILD;
+}
+
+/** Allocate zero-filled memory.
+ *
+ * @param size Size in bytes, updated to the actual size allocated
+ * @return Pointer to memory or @c NULL if out of memory
+ */
+void *sys_mem_alloc(size_t *size)
+{
+	return calloc(1, *size);
+}
+
+/** Free memory allocated with sys_mem_alloc().
+ *
+ * @param p Pointer to memory or @c NULL
+ * @param size Size returned by sys_mem_alloc()
+ */
+void sys_mem_free(void *p, size_t size)
+{
+	free(p);
+}
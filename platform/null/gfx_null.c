@@ -0,0 +1,136 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Null graphics (no display)
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Graphics backend without any display. The virtual frame buffer
+ * is kept in memory only, there is no input.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../mgfx.h"
+
+static int fs = 0;
+
+static int init_vscr(void)
+{
+	vscr0 = calloc(scr_xs * scr_ys, sizeof(uint8_t));
+	if (!vscr0) {
+		printf("malloc failed\n");
+		return -1;
+	}
+
+	if (dbl_ln) {
+		vscr1 = calloc(scr_xs * scr_ys, sizeof(uint8_t));
+		if (!vscr1) {
+			printf("malloc failed\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void fini_vscr(void)
+{
+	free(vscr0);
+	vscr0 = NULL;
+	if (dbl_ln) {
+		free(vscr1);
+		vscr1 = NULL;
+	}
+}
+
+int mgfx_init(int w, int h)
+{
+	scr_xs = w;
+	scr_ys = h;
+
+	w_initkey();
+
+	if (init_vscr() < 0)
+		return -1;
+
+	mgfx_selln(3);
+
+	clip_x0 = clip_y0 = 0;
+	clip_x1 = scr_xs - 1;
+	clip_y1 = scr_ys - 1;
+
+	return 0;
+}
+
+void mgfx_updscr(void)
+{
+}
+
+void mgfx_setpal(int base, int cnt, int *p)
+{
+}
+
+void mgfx_input_update(void)
+{
+}
+
+int mgfx_toggle_fs(void)
+{
+	fs = !fs;
+	return 0;
+}
+
+int mgfx_toggle_dbl_ln(void)
+{
+	fini_vscr();
+	dbl_ln = !dbl_ln;
+	/* Make sure to update write bits */
+	mgfx_selln(3);
+	return init_vscr();
+}
+
+int mgfx_is_fs(void)
+{
+	return fs;
+}
+
+int mgfx_set_disp_size(int w, int h)
+{
+	fini_vscr();
+	scr_xs = w;
+	scr_ys = h;
+	if (init_vscr() < 0)
+		return -1;
+
+	clip_x0 = clip_y0 = 0;
+	clip_x1 = scr_xs - 1;
+	clip_y1 = scr_ys - 1;
+	return 0;
+}
@@ -29,21 +29,92 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ * All SDL video and event calls are made by a dedicated presentation
+ * thread. The emulation thread hands completed frames over through
+ * a triple buffer and receives input events through a single-producer,
+ * single-consumer queue, so neither side ever waits for the other
+ * during normal operation. Mode changes (full screen, double lines,
+ * display size) are carried out by the presentation thread on request
+ * while the emulation thread waits.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL.h>
+#include <SDL_thread.h>
 #include "../../mgfx.h"
 
 #define WINDOW_CAPTION "GZX"
 
+/** Number of frame buffers in the triple buffer */
+#define FB_COUNT 3
+/** Bit in fb_mid set when the middle buffer holds a frame not yet shown */
+#define FB_FRESH 0x4
+/** Size of input event queue (power of two) */
+#define INQ_SIZE 256
+/** How often the presentation thread polls input when idle (ms) */
+#define PRESENT_POLL_MS 10
+
+/** Frame handed over from emulation to presentation thread */
+typedef struct {
+	/** Pixels, one or two (with double lines) planes of scr_xs * scr_ys */
+	uint8_t *pix;
+	/** Palette */
+	SDL_Color color[256];
+	/** Palette generation the color array corresponds to */
+	unsigned pal_gen;
+} gfx_frame_t;
+
+/** Request to the presentation thread */
+typedef enum {
+	gcmd_none,
+	/** (Re)initialize video mode */
+	gcmd_reinit,
+	/** Shut down video and terminate */
+	gcmd_quit
+} gfx_cmd_t;
+
+/* Presentation thread state */
 static SDL_Surface *sdl_screen;
-static int fs = 0;
-static  SDL_Color color[256];
+static SDL_Color pr_color[256];
+static unsigned pr_pal_gen;
 static int xscale;
 static int yscale;
+static int pr_fs;
+static int pr_dbl_ln;
+static int pr_xs, pr_ys;
+
+/* Emulation thread state */
+static int fs = 0;
+static SDL_Color color[256];
+static unsigned pal_gen;
 static int video_w, video_h;
 
+/* Frame handoff */
+static gfx_frame_t fbuf[FB_COUNT];
+static int fb_back;
+static int fb_front;
+static atomic_int fb_mid;
+static SDL_sem *fb_sem;
+
+/* Input event queue */
+static wkey_t inq[INQ_SIZE];
+static atomic_uint inq_head;
+static atomic_uint inq_tail;
+static atomic_bool quit_req;
+
+/* Requests to the presentation thread */
+static SDL_Thread *pr_thread;
+static SDL_mutex *cmd_lock;
+static SDL_cond *cmd_cv;
+static atomic_int cmd;
+static int cmd_fs, cmd_dbl_ln, cmd_w, cmd_h;
+
 static int *txkey;
 static int txsize;
 static int ktabsrc[] = {
@@ -162,21 +233,28 @@ static void w_vga_problem(void)
 	exit(1);
 }
 
+/** Set video mode according to the last request.
+ *
+ * Called in the presentation thread.
+ */
 static void init_video(void)
 {
 	int flags;
 	int vw, vh;
 
 	/* Initialize SDL */
-	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+	if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
 		w_vga_problem();
 	}
 
-	flags = SDL_SWSURFACE | (fs ? SDL_FULLSCREEN : 0);
-	scr_xs = video_w;
-	scr_ys = video_h;
+	pr_fs = cmd_fs;
+	pr_dbl_ln = cmd_dbl_ln;
+	pr_xs = cmd_w;
+	pr_ys = cmd_h;
 
-	if (dbl_ln) {
+	flags = SDL_SWSURFACE | (pr_fs ? SDL_FULLSCREEN : 0);
+
+	if (pr_dbl_ln) {
 		xscale = 2;
 		yscale = 1;
 	} else {
@@ -184,10 +262,10 @@ static void init_video(void)
 		yscale = 2;
 	}
 
-	vw = scr_xs * xscale;
-	vh = scr_ys * yscale;
+	vw = pr_xs * xscale;
+	vh = pr_ys * yscale;
 
-	if (dbl_ln) {
+	if (pr_dbl_ln) {
 		vh *= 2;
 	}
 
@@ -197,6 +275,39 @@ static void init_video(void)
 
 	if (sdl_screen == NULL)
 		w_vga_problem();
+
+	SDL_SetColors(sdl_screen, pr_color, 0, 256);
+}
+
+static void quit_video(void)
+{
+	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+	sdl_screen = NULL;
+}
+
+/** Allocate the triple buffer for the current video mode.
+ *
+ * Called in the presentation thread while the emulation thread waits
+ * for the request to complete.
+ */
+static void init_fbuf(void)
+{
+	size_t size;
+	int i;
+
+	size = (size_t) pr_xs * pr_ys * (pr_dbl_ln ? 2 : 1);
+	for (i = 0; i < FB_COUNT; i++) {
+		free(fbuf[i].pix);
+		fbuf[i].pix = calloc(size, sizeof(uint8_t));
+		if (fbuf[i].pix == NULL) {
+			printf("malloc failed\n");
+			exit(1);
+		}
+	}
+
+	fb_back = 0;
+	atomic_store(&fb_mid, 1);
+	fb_front = 2;
 }
 
 static void init_vscr(void)
@@ -226,22 +337,198 @@ static void fini_vscr(void)
 	}
 }
 
-static void quit_video(void)
+static void render_display_line(int dy, uint8_t *spix)
 {
-	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+	uint8_t *dp;
+	int i, j, k;
+
+	dp = sdl_screen->pixels + sdl_screen->pitch * dy * yscale;
+	if (xscale != 1 || yscale != 1) {
+		for (j = 0; j < yscale; j++) {
+			for (i = 0; i < pr_xs; i++) {
+				for (k = 0; k < xscale; k++) {
+					dp[xscale * i + k] = spix[i];
+				}
+			}
+			dp += sdl_screen->pitch;
+		}
+	} else {
+		memcpy(dp, spix, pr_xs);
+	}
 }
 
-int mgfx_init(int w, int h)
+/** Show the latest frame handed over by the emulation thread, if any.
+ *
+ * Called in the presentation thread.
+ */
+static void present_frame(void)
 {
-	int i;
+	gfx_frame_t *frame;
+	uint8_t *pix0, *pix1;
+	unsigned y;
 
-	atexit(SDL_Quit);
+	if ((atomic_load(&fb_mid) & FB_FRESH) == 0)
+		return;
 
-	video_w = w;
-	video_h = h;
-	init_video();
+	fb_front = atomic_exchange(&fb_mid, fb_front) & ~FB_FRESH;
+	frame = &fbuf[fb_front];
 
-	w_initkey();
+	if (frame->pal_gen != pr_pal_gen) {
+		memcpy(pr_color, frame->color, sizeof(pr_color));
+		pr_pal_gen = frame->pal_gen;
+		SDL_SetColors(sdl_screen, pr_color, 0, 256);
+	}
+
+	pix0 = frame->pix;
+	pix1 = frame->pix + pr_xs * pr_ys;
+
+	if (pr_dbl_ln) {
+		for (y = 0; y < pr_ys; y++) {
+			render_display_line(2 * y, pix0 + pr_xs * y);
+			render_display_line(2 * y + 1, pix1 + pr_xs * y);
+		}
+	} else {
+		for (y = 0; y < pr_ys; y++) {
+			render_display_line(y, pix0 + pr_xs * y);
+		}
+	}
+	SDL_UpdateRect(sdl_screen, 0, 0, 0, 0);
+}
+
+/** Queue input event for the emulation thread.
+ *
+ * Called in the presentation thread. If the queue is full, the event
+ * is dropped.
+ *
+ * @param press 1 = press, 0 = release
+ * @param key Key code
+ */
+static void inq_put(int press, int key)
+{
+	unsigned head;
+
+	head = atomic_load_explicit(&inq_head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&inq_tail, memory_order_acquire) >=
+	    INQ_SIZE)
+		return;
+
+	inq[head % INQ_SIZE].press = press;
+	inq[head % INQ_SIZE].key = key;
+	inq[head % INQ_SIZE].c = -1;
+	atomic_store_explicit(&inq_head, head + 1, memory_order_release);
+}
+
+/** Process pending SDL events.
+ *
+ * Called in the presentation thread.
+ */
+static void poll_events(void)
+{
+	SDL_Event event;
+
+	while (SDL_PollEvent(&event)) {
+		switch (event.type) {
+		case SDL_QUIT:
+			atomic_store(&quit_req, true);
+			break;
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			// XXX use SDL key to character translation
+			inq_put(event.type == SDL_KEYDOWN,
+			    txkey[event.key.keysym.sym]);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/** Presentation thread main function. */
+static int present_thread(void *arg)
+{
+	bool quit = false;
+
+	(void) arg;
+
+	while (!quit) {
+		SDL_SemWaitTimeout(fb_sem, PRESENT_POLL_MS);
+
+		if (atomic_load(&cmd) != gcmd_none) {
+			SDL_mutexP(cmd_lock);
+			switch (atomic_load(&cmd)) {
+			case gcmd_reinit:
+				if (sdl_screen != NULL)
+					quit_video();
+				init_video();
+				init_fbuf();
+				break;
+			case gcmd_quit:
+				if (sdl_screen != NULL)
+					quit_video();
+				quit = true;
+				break;
+			default:
+				break;
+			}
+			atomic_store(&cmd, gcmd_none);
+			SDL_CondSignal(cmd_cv);
+			SDL_mutexV(cmd_lock);
+		}
+
+		if (sdl_screen != NULL) {
+			present_frame();
+			poll_events();
+		}
+	}
+
+	return 0;
+}
+
+/** Have the presentation thread carry out a request and wait for it.
+ *
+ * @param c Request
+ */
+static void present_request(gfx_cmd_t c)
+{
+	SDL_mutexP(cmd_lock);
+	cmd_fs = fs;
+	cmd_dbl_ln = dbl_ln;
+	cmd_w = video_w;
+	cmd_h = video_h;
+	atomic_store(&cmd, c);
+	SDL_SemPost(fb_sem);
+	while (atomic_load(&cmd) != gcmd_none)
+		SDL_CondWait(cmd_cv, cmd_lock);
+	SDL_mutexV(cmd_lock);
+}
+
+/** Stop presentation thread and shut down SDL. */
+static void mgfx_quit(void)
+{
+	/* Exiting from the presentation thread itself (fatal error) */
+	if (SDL_ThreadID() == SDL_GetThreadID(pr_thread))
+		return;
+
+	present_request(gcmd_quit);
+	SDL_WaitThread(pr_thread, NULL);
+	SDL_Quit();
+}
+
+/** Switch video mode and wait until it is set.
+ *
+ * Display size is updated to match.
+ */
+static void set_video_mode(void)
+{
+	present_request(gcmd_reinit);
+
+	scr_xs = video_w;
+	scr_ys = video_h;
+}
+
+int mgfx_init(int w, int h)
+{
+	int i;
 
 	/* set up key translation table */
 	txsize = 1;
@@ -258,6 +545,27 @@ int mgfx_init(int w, int h)
 	for (i = 0; ktabsrc[i * 2 + 1] != -1; i++)
 		txkey[ktabsrc[i * 2]] = ktabsrc[i * 2 + 1];
 
+	if (SDL_Init(0) < 0)
+		w_vga_problem();
+
+	fb_sem = SDL_CreateSemaphore(0);
+	cmd_lock = SDL_CreateMutex();
+	cmd_cv = SDL_CreateCond();
+	if (fb_sem == NULL || cmd_lock == NULL || cmd_cv == NULL)
+		w_vga_problem();
+
+	pr_thread = SDL_CreateThread(present_thread, NULL);
+	if (pr_thread == NULL)
+		w_vga_problem();
+
+	atexit(mgfx_quit);
+
+	video_w = w;
+	video_h = h;
+	set_video_mode();
+
+	w_initkey();
+
 	/* set up virtual frame buffer */
 	init_vscr();
 
@@ -270,41 +578,33 @@ int mgfx_init(int w, int h)
 	return 0;
 }
 
-static void render_display_line(int dy, uint8_t *spix)
+/** Hand the virtual frame buffer over for presentation.
+ *
+ * The frame is copied into the back buffer of the triple buffer and
+ * published. Never waits for the presentation thread. If the
+ * presentation thread has not taken the previous frame yet, that
+ * frame is dropped.
+ */
+void mgfx_updscr(void)
 {
-	uint8_t *dp;
-	int i, j, k;
+	gfx_frame_t *frame;
+	size_t size;
 
-	dp = sdl_screen->pixels + sdl_screen->pitch * dy * yscale;
-	if (xscale != 1 || yscale != 1) {
-		for (j = 0; j < yscale; j++) {
-			for (i = 0; i < scr_xs; i++) {
-				for (k = 0; k < xscale; k++) {
-					dp[xscale * i + k] = spix[i];
-				}
-			}
-			dp += sdl_screen->pitch;
-		}
-	} else {
-		memcpy(dp, spix, scr_xs);
-	}
-}
+	frame = &fbuf[fb_back];
+	size = (size_t) scr_xs * scr_ys;
 
-void mgfx_updscr(void)
-{
-	unsigned y;
+	memcpy(frame->pix, vscr0, size);
+	if (dbl_ln)
+		memcpy(frame->pix + size, vscr1, size);
 
-	if (dbl_ln) {
-		for (y = 0; y < scr_ys; y++) {
-			render_display_line(2 * y, vscr0 + scr_xs * y);
-			render_display_line(2 * y + 1, vscr1 + scr_xs * y);
-		}
-	} else {
-		for (y = 0; y < scr_ys; y++) {
-			render_display_line(y, vscr0 + scr_xs * y);
-		}
+	if (frame->pal_gen != pal_gen) {
+		memcpy(frame->color, color, sizeof(color));
+		frame->pal_gen = pal_gen;
 	}
-	SDL_UpdateRect(sdl_screen, 0, 0, 0, 0);
+
+	fb_back = atomic_exchange(&fb_mid, fb_back | FB_FRESH) & ~FB_FRESH;
+	if (SDL_SemValue(fb_sem) == 0)
+		SDL_SemPost(fb_sem);
 }
 
 static unsigned b6to8(unsigned cval)
@@ -322,52 +622,45 @@ void mgfx_setpal(int base, int cnt, int *p)
 		color[i].b = b6to8(p[3 * i + 2]);
 	}
 
-	SDL_SetColors(sdl_screen, color, 0, 256);
+	/* Takes effect with the next frame handed over */
+	++pal_gen;
 }
 
 /* input */
 
+/** Deliver input events queued by the presentation thread. */
 void mgfx_input_update(void)
 {
-	SDL_Event event;
+	unsigned tail;
 
-	while (SDL_PollEvent(&event)) {
-		switch (event.type) {
-		case SDL_QUIT:
-			exit(0);
-			break;
-		case SDL_KEYDOWN:
-		case SDL_KEYUP:
-			// XXX use SDL key to character translation
-			w_putkey(event.type == SDL_KEYDOWN,
-			    txkey[event.key.keysym.sym], -1);
-			break;
-		default:
-			break;
-		}
+	if (atomic_load(&quit_req))
+		exit(0);
+
+	tail = atomic_load_explicit(&inq_tail, memory_order_relaxed);
+	while (tail != atomic_load_explicit(&inq_head, memory_order_acquire)) {
+		w_putkey(inq[tail % INQ_SIZE].press, inq[tail % INQ_SIZE].key,
+		    inq[tail % INQ_SIZE].c);
+		++tail;
+		atomic_store_explicit(&inq_tail, tail, memory_order_release);
 	}
 }
 
 int mgfx_toggle_fs(void)
 {
 	/* Toggle fullscreen mode */
-	quit_video();
 	fs = !fs;
-	init_video();
-	SDL_SetColors(sdl_screen, color, 0, 256);
+	set_video_mode();
 	return 0;
 }
 
 int mgfx_toggle_dbl_ln(void)
 {
-	quit_video();
 	fini_vscr();
 	dbl_ln = !dbl_ln;
 	/* Make sure to update write bits */
 	mgfx_selln(3);
-	init_video();
+	set_video_mode();
 	init_vscr();
-	SDL_SetColors(sdl_screen, color, 0, 256);
 	return 0;
 }
 
@@ -380,13 +673,11 @@ int mgfx_set_disp_size(int w, int h)
 {
 	video_w = w;
 	video_h = h;
-	quit_video();
 	fini_vscr();
-	init_video();
+	set_video_mode();
 	init_vscr();
 	clip_x0 = clip_y0 = 0;
 	clip_x1 = scr_xs - 1;
 	clip_y1 = scr_ys - 1;
-	SDL_SetColors(sdl_screen, color, 0, 256);
 	return 0;
 }
@@ -29,73 +29,132 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ * Samples are passed from the emulation thread to the SDL audio callback
+ * through a single-producer, single-consumer lock-free ring. Neither side
+ * ever waits for the other: on overrun the producer drops samples, on
+ * underrun the callback repeats the last sample.
+ *
+ * To keep the ring fill level near the target latency despite the drift
+ * between the emulated and the audio device clock, the producer
+ * resamples its input with a ratio that deviates from 1 by at most
+ * RS_MAX_ADJ, in proportion to the distance of the fill level from
+ * the target (dynamic rate control).
+ */
+
 #include <SDL.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <errno.h>
-#include <unistd.h>
 #include "../../mgfx.h"
 #include "../../sndw.h"
 
+/** Output sampling frequency */
+#define SND_FREQ 28000
+/** Fixed-point one for resampling position */
+#define RS_ONE 0x10000
+/** Maximum deviation of resampling ratio from 1 (0.5 %) */
+#define RS_MAX_ADJ (RS_ONE / 200)
+/** Time constant of the integral rate control term, in blocks */
+#define RS_INTEG_BLOCKS 64
+
 static uint8_t *audio_ring;
+/** Size of ring (power of two) */
+static unsigned audio_ringsize;
+/** Size of one block from sndw_write */
 static int audio_bufsize;
-static int audio_ringsize;
-static int bin, bout, bcnt;
-static int paused;
+/** Target ring fill level */
+static unsigned audio_target;
+/** Producer position (free-running) */
+static atomic_uint ring_in;
+/** Consumer position (free-running) */
+static atomic_uint ring_out;
+/** Playback has been started */
+static bool playing;
+
+/** Last input sample (producer) */
+static uint8_t rs_prev;
+/** Position of next output sample after rs_prev, in RS_ONE units */
+static uint32_t rs_pos;
+/** Accumulated deviation of fill level from target */
+static int64_t rs_integ;
+
+/** Last sample played (consumer) */
+static uint8_t last_smp = 128;
 
 static void sdl_audio_cb(void *userdata, Uint8 *stream, int len)
 {
-	int xfer;
-
-	if (bcnt < len) {
-		printf("Audio buffer ring empty, filling silence "
-		    "and pausing.\n");
-		memset(stream, 128, len);
-		if (!paused) {
-			paused = 1;
-			SDL_PauseAudio(1);
-		}
-		return;
-	}
+	unsigned out;
+	unsigned avail;
+	unsigned xfer;
+	unsigned i;
+
+	(void) userdata;
 
-	while (len > 0) {
-		xfer = bout + len > audio_ringsize ? audio_ringsize - bout :
-		    len;
-		memcpy(stream, audio_ring + bout, xfer);
-		stream += xfer;
-		bout += xfer;
-		bcnt -= xfer;
-		len -= xfer;
-		if (bout == audio_ringsize)
-			bout = 0;
+	out = atomic_load_explicit(&ring_out, memory_order_relaxed);
+	avail = atomic_load_explicit(&ring_in, memory_order_acquire) - out;
+	xfer = avail < (unsigned) len ? avail : (unsigned) len;
+
+	for (i = 0; i < xfer; i++)
+		stream[i] = audio_ring[(out + i) & (audio_ringsize - 1)];
+
+	if (xfer > 0) {
+		last_smp = stream[xfer - 1];
+		atomic_store_explicit(&ring_out, out + xfer,
+		    memory_order_release);
 	}
 
+	/* Underrun. Hold the last level to avoid a click. */
+	memset(stream + xfer, last_smp, len - xfer);
 }
 
-int sndw_init(int bufs)
+/** Initialize audio output.
+ *
+ * @param bufs Size of blocks passed to sndw_write()
+ * @param latency Target latency in samples
+ * @return Zero on success, -1 on error
+ */
+int sndw_init(int bufs, int latency)
 {
 	SDL_AudioSpec desired;
+	unsigned dev_samples;
+
+	audio_bufsize = bufs;
+	audio_target = latency;
+
+	/* Room for target fill level, one block and plenty of slack */
+	audio_ringsize = 1;
+	while (audio_ringsize < 2 * (audio_target + audio_bufsize))
+		audio_ringsize <<= 1;
 
-	audio_ringsize = bufs * 3;
 	audio_ring = calloc(1, audio_ringsize);
 	if (audio_ring == NULL)
 		goto error;
 
-	audio_bufsize = bufs;
-
 	if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
 		goto error;
 
-	desired.freq = 28000;
+	/* Device buffer of at most half the target latency */
+	dev_samples = 256;
+	while (dev_samples * 4 <= audio_target)
+		dev_samples <<= 1;
+
+	desired.freq = SND_FREQ;
 	desired.format = AUDIO_U8;
 	desired.channels = 1;
-	desired.samples = bufs * 3;
+	desired.samples = dev_samples;
 	desired.callback = sdl_audio_cb;
 	desired.userdata = NULL;
 
-	bin = bout = 0;
-	paused = 1;
+	atomic_store(&ring_in, 0);
+	atomic_store(&ring_out, 0);
+	playing = false;
+	rs_prev = 128;
+	rs_pos = 0;
+	rs_integ = 0;
 
 	if (SDL_OpenAudio(&desired, NULL) < 0)
 		goto error;
@@ -104,32 +163,102 @@ int sndw_init(int bufs)
 
 error:
 	free(audio_ring);
+	audio_ring = NULL;
 	return -1;
 }
 
 void sndw_done(void)
 {
 	SDL_CloseAudio();
+	free(audio_ring);
+	audio_ring = NULL;
+}
+
+/** Compute resampling step from current ring fill level.
+ *
+ * Proportional-integral control. The integral term absorbs a constant
+ * clock drift, so the fill level settles at the target rather than
+ * at an offset proportional to the drift.
+ *
+ * @param fill Number of samples in the ring
+ * @return Input advance per output sample, in RS_ONE units
+ */
+static uint32_t sndw_rs_step(unsigned fill)
+{
+	int64_t dev;
+	int64_t lim;
+	int64_t adj;
+
+	dev = (int64_t) fill - audio_target;
+	if (dev > audio_target)
+		dev = audio_target;
+	if (dev < -(int64_t) audio_target)
+		dev = -(int64_t) audio_target;
+
+	lim = (int64_t) audio_target * RS_INTEG_BLOCKS;
+	rs_integ += dev;
+	if (rs_integ > lim)
+		rs_integ = lim;
+	if (rs_integ < -lim)
+		rs_integ = -lim;
+
+	/* Fuller ring -> consume input faster -> produce fewer samples */
+	adj = RS_MAX_ADJ * dev / audio_target +
+	    RS_MAX_ADJ * rs_integ / lim;
+	if (adj > RS_MAX_ADJ)
+		adj = RS_MAX_ADJ;
+	if (adj < -RS_MAX_ADJ)
+		adj = -RS_MAX_ADJ;
+
+	return RS_ONE + adj;
 }
 
 void sndw_write(uint8_t *buf)
 {
-	SDL_LockAudio();
-	while (bcnt + audio_bufsize > audio_ringsize) {
-		SDL_UnlockAudio();
-		if (paused) {
-			printf("Starting playback.\n");
-			SDL_PauseAudio(0);
-			paused = 0;
+	unsigned in;
+	unsigned fill;
+	uint32_t step;
+	int smp;
+	int i;
+
+	in = atomic_load_explicit(&ring_in, memory_order_relaxed);
+	fill = in - atomic_load_explicit(&ring_out, memory_order_acquire);
+
+	/*
+	 * If the ring ran dry (e.g. while output was muted), prefill it
+	 * with the held level so that rate control starts from the target.
+	 */
+	if (playing && fill == 0) {
+		while (fill + audio_bufsize < audio_target) {
+			audio_ring[in & (audio_ringsize - 1)] = rs_prev;
+			++in;
+			++fill;
+		}
+	}
+
+	step = sndw_rs_step(fill);
+
+	/* Linear interpolation between consecutive input samples */
+	for (i = 0; i < audio_bufsize; i++) {
+		while (rs_pos < RS_ONE) {
+			smp = rs_prev + (buf[i] - rs_prev) *
+			    (int32_t) rs_pos / RS_ONE;
+			if (fill < audio_ringsize) {
+				audio_ring[in & (audio_ringsize - 1)] = smp;
+				++in;
+				++fill;
+			}
+			rs_pos += step;
 		}
-		usleep(10000);
-		SDL_LockAudio();
+
+		rs_pos -= RS_ONE;
+		rs_prev = buf[i];
 	}
 
-	memcpy(audio_ring + bin, buf, audio_bufsize);
-	bcnt += audio_bufsize;
-	bin += audio_bufsize;
-	if (bin >= audio_ringsize)
-		bin = 0;
-	SDL_UnlockAudio();
+	atomic_store_explicit(&ring_in, in, memory_order_release);
+
+	if (!playing && fill >= audio_target) {
+		SDL_PauseAudio(0);
+		playing = true;
+	}
 }
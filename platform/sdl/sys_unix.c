@@ -30,39 +30,43 @@
  */
 
 #include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
-#include <sys/time.h>
-#include "../../clock.h"
+#include <sys/wait.h>
 #include "../../sys_all.h"
 
 static DIR *sd;
 
-void timer_reset(timer *t)
+/** Get monotonic time.
+ *
+ * @return Time in microseconds (from an arbitrary origin)
+ */
+uint64_t sys_time_usec(void)
 {
-	struct timezone tz;
-	struct timeval tv;
+	struct timespec ts;
 
-	gettimeofday(&tv, &tz);
-	t->sec = tv.tv_sec;
-	t->usec = tv.tv_usec;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-unsigned long timer_val(timer *t)
+/** Sleep until a point in time.
+ *
+ * @param usec Monotonic time in microseconds (see sys_time_usec())
+ */
+void sys_sleep_until(uint64_t usec)
 {
-	struct timezone tz;
-	struct timeval tv;
-	unsigned long usec, sec;
-	unsigned long long tstates;
-
-	gettimeofday(&tv, &tz);
-	usec = tv.tv_usec - t->usec;
-	sec = tv.tv_sec - t->sec;
-
-	/* calculate tstates modulo 2^32 */
-	tstates = sec * (unsigned long)Z80_CLOCK + ((usec * 35) / 10);
+	struct timespec ts;
 
-	return tstates;
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+	    NULL) == EINTR)
+		;
 }
 
 int sys_chdir(const char *path)
@@ -111,3 +115,121 @@ void sys_usleep(unsigned usec)
 {
 	usleep(usec);
 }
+
+/** Get number of available processors.
+ *
+ * @return Number of online processors (at least one)
+ */
+int sys_ncpus(void)
+{
+	long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+}
+
+/** Start job in a separate process.
+ *
+ * The job runs in a copy of the current process, with standard output
+ * redirected to @a out. The exit status of the job is the return value
+ * of @a fn.
+ *
+ * @param fn Job function
+ * @param arg Argument to @a fn
+ * @param out File to receive standard output of the job
+ * @param rid Place to store job ID
+ * @return Zero on success, error code otherwise
+ */
+int sys_job_start(int (*fn)(void *), void *arg, FILE *out, long *rid)
+{
+	pid_t pid;
+	int rc;
+
+	/* Do not let the child write out buffered data a second time */
+	fflush(NULL);
+
+	pid = fork();
+	if (pid < 0)
+		return errno;
+
+	if (pid == 0) {
+		if (dup2(fileno(out), STDOUT_FILENO) < 0)
+			_exit(127);
+		rc = fn(arg);
+		fflush(stdout);
+		_exit(rc);
+	}
+
+	*rid = pid;
+	return 0;
+}
+
+/** Wait for any job to finish.
+ *
+ * @param rid Place to store ID of the finished job
+ * @param rstatus Place to store exit status of the job (-1 if the job
+ *                terminated abnormally)
+ * @return Zero on success, ECHILD if there are no running jobs
+ */
+int sys_job_wait(long *rid, int *rstatus)
+{
+	pid_t pid;
+	int status;
+
+	do {
+		pid = waitpid(-1, &status, 0);
+	} while (pid < 0 && errno == EINTR);
+
+	if (pid < 0)
+		return errno;
+
+	*rid = pid;
+	*rstatus = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	return 0;
+}
+
+/** Huge page size to try for memory allocations */
+#define SYS_HUGE_PG_SIZE (2 * 1024 * 1024)
+
+/** Allocate zero-filled, page-aligned memory from the system.
+ *
+ * Huge pages are used if the system has any reserved, otherwise normal
+ * pages are used.
+ *
+ * @param size Size in bytes, updated to the actual size allocated
+ * @return Pointer to memory or @c NULL if out of memory
+ */
+void *sys_mem_alloc(size_t *size)
+{
+	void *p;
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+	size_t hsize;
+
+	hsize = (*size + SYS_HUGE_PG_SIZE - 1) &
+	    ~(size_t)(SYS_HUGE_PG_SIZE - 1);
+	p = mmap(NULL, hsize, PROT_READ | PROT_WRITE, MAP_PRIVATE |
+	    MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+	if (p != MAP_FAILED) {
+		*size = hsize;
+		return p;
+	}
+#endif
+	p = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+
+	return p;
+}
+
+/** Free memory allocated with sys_mem_alloc().
+ *
+ * @param p Pointer to memory or @c NULL
+ * @param size Size returned by sys_mem_alloc()
+ */
+void sys_mem_free(void *p, size_t size)
+{
+	if (p != NULL)
+		munmap(p, size);
+}
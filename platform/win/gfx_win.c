@@ -45,6 +45,7 @@
 #include <string.h>
 #include "../../gzx.h"
 #include "../../mgfx.h"
+#include "../../zx.h"
 
 #include <ddraw.h>
 
@@ -67,13 +67,16 @@ static WAVEHDR wavehdr[N_BUF];
  * e         s
  */
 
-int sndw_init(int bufs)
+int sndw_init(int bufs, int latency)
 {
 	int play_rate;
 	WAVEFORMATEX wfx;
 	MMRESULT errcode;
 	int i;
 
+	/* Latency is determined by N_BUF */
+	(void) latency;
+
 	buf_size = bufs;
 
 	play_rate = 28000;
@@ -31,59 +31,42 @@
 
 #include <windows.h>
 #include <mmsystem.h>
-#include "../../clock.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
 #include "sys_win.h"
 
-#ifndef _TIMEVAL_DEFINED
-#define _TIMEVAL_DEFINED
-struct timeval {
-	long tv_sec;
-	long tv_usec;
-};
-#endif
-
-struct timezone {
-	int tz_minuteswest;
-	int tz_dsttime;
-};
-
-static int gettimeofday(struct timeval *tv, struct timezone *tz)
-{
-	unsigned long t;
-
-	t = timeGetTime();
-	tv->tv_sec = t / 1000;
-	t = t % 1000;
-	tv->tv_usec = t * 1000;
-
-	return 0;
-}
-
-void timer_reset(timer *t)
+/** Get monotonic time.
+ *
+ * @return Time in microseconds (from an arbitrary origin)
+ */
+uint64_t sys_time_usec(void)
 {
-	struct timezone tz;
-	struct timeval tv;
+	LARGE_INTEGER cnt, freq;
 
-	gettimeofday(&tv, &tz);
-	t->sec = tv.tv_sec;
-	t->usec = tv.tv_usec;
+	QueryPerformanceCounter(&cnt);
+	QueryPerformanceFrequency(&freq);
+	return (uint64_t)(cnt.QuadPart / freq.QuadPart) * 1000000 +
+	    (uint64_t)(cnt.QuadPart % freq.QuadPart) * 1000000 /
+	    freq.QuadPart;
 }
 
-unsigned long timer_val(timer *t)
+/** Sleep until a point in time.
+ *
+ * @param usec Monotonic time in microseconds (see sys_time_usec())
+ */
+void sys_sleep_until(uint64_t usec)
 {
-	struct timezone tz;
-	struct timeval tv;
-	unsigned long usec, sec;
-	unsigned long long tstates;
-
-	gettimeofday(&tv, &tz);
-	usec = tv.tv_usec - t->usec;
-	sec = tv.tv_sec - t->sec;
-
-	/* calculate tstates modulo 2^32 */
-	tstates = sec * (unsigned long)Z80_CLOCK + ((usec * 35) / 10);
-
-	return tstates;
+	uint64_t now;
+
+	/* Sleep() has millisecond resolution (with timeBeginPeriod(1)) */
+	timeBeginPeriod(1);
+	now = sys_time_usec();
+	while (now + 1000 < usec) {
+		Sleep((usec - now) / 1000);
+		now = sys_time_usec();
+	}
+	timeEndPeriod(1);
 }
 
 unsigned long win_enumdrives(void)
@@ -144,3 +127,61 @@ void sys_usleep(unsigned usec)
 {
 	usleep(usec);
 }
+
+/** Get number of available processors.
+ *
+ * @return Number of processors (at least one)
+ */
+int sys_ncpus(void)
+{
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+
+/** Start job in a separate process (not supported).
+ *
+ * @param fn Job function
+ * @param arg Argument to @a fn
+ * @param out File to receive standard output of the job
+ * @param rid Place to store job ID
+ * @return ENOTSUP
+ */
+int sys_job_start(int (*fn)(void *), void *arg, FILE *out, long *rid)
+{
+	return ENOTSUP;
+}
+
+/** Wait for any job to finish (not supported).
+ *
+ * @param rid Place to store ID of the finished job
+ * @param rstatus Place to store exit status of the job
+ * @return ECHILD
+ */
+int sys_job_wait(long *rid, int *rstatus)
+{
+	return ECHILD;
+}
+
+/** Allocate zero-filled, page-aligned memory from the system.
+ *
+ * @param size Size in bytes, updated to the actual size allocated
+ * @return Pointer to memory or @c NULL if out of memory
+ */
+void *sys_mem_alloc(size_t *size)
+{
+	return VirtualAlloc(NULL, *size, MEM_COMMIT | MEM_RESERVE,
+	    PAGE_READWRITE);
+}
+
+/** Free memory allocated with sys_mem_alloc().
+ *
+ * @param p Pointer to memory or @c NULL
+ * @param size Size returned by sys_mem_alloc()
+ */
+void sys_mem_free(void *p, size_t size)
+{
+	if (p != NULL)
+		VirtualFree(p, 0, MEM_RELEASE);
+}
@@ -0,0 +1,407 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Rewind buffer
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Rewind buffer
+ *
+ * A snapshot of the machine is taken every few fields. To keep many
+ * snapshots within a fixed memory budget, only the newest snapshot is kept
+ * complete. Each older snapshot consists of its machine state without RAM
+ * and undo records that turn RAM of the following snapshot into its own.
+ *
+ * Undo records are built when the following snapshot is taken. Only
+ * memory pages of RAM that were written to since the previous snapshot
+ * (as tracked by memio) are compared with the previous contents, in
+ * small pages. Only the differing range of each small page is stored.
+ * When the budget is exceeded, the oldest snapshots are dropped.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adt/list.h"
+#include "memio.h"
+#include "rewind.h"
+#include "state.h"
+
+/** Size of pages compared when building undo records (bits) */
+#define REWIND_PG_SHIFT 8
+/** Size of pages compared when building undo records */
+#define REWIND_PG_SIZE (1 << REWIND_PG_SHIFT)
+
+/** Going back within this many fields after a snapshot skips it */
+#define REWIND_MIN_FIELDS 10
+
+/** Rewind snapshot */
+typedef struct {
+	/** Link to rewind_t.snaps */
+	link_t lsnaps;
+	/** Machine state without RAM contents */
+	uint8_t *mach;
+	/** Undo records (NULL for the newest snapshot) */
+	uint8_t *undo;
+	/** Size of undo records in bytes */
+	size_t undo_size;
+} rewind_snap_t;
+
+/** Undo record header (followed by data) */
+typedef struct {
+	/** Page number */
+	uint16_t pg;
+	/** Offset of the first byte within page */
+	uint8_t start;
+	/** Offset of the last byte within page */
+	uint8_t end;
+} rewind_undo_t;
+
+/** Create rewind buffer.
+ *
+ * @param zx Machine
+ * @param budget Memory budget for snapshots in bytes
+ * @param interval Number of fields between snapshots
+ * @param rrew Place to store pointer to new rewind buffer
+ * @return Zero on success, ENOMEM if out of memory
+ */
+int rewind_create(zx_machine_t *zx, size_t budget, unsigned interval,
+    rewind_t **rrew)
+{
+	rewind_t *rew;
+
+	rew = calloc(1, sizeof(rewind_t));
+	if (rew == NULL)
+		return ENOMEM;
+
+	list_initialize(&rew->snaps);
+	rew->zx = zx;
+	rew->budget = budget;
+	rew->interval = interval;
+	*rrew = rew;
+	return 0;
+}
+
+/** Get size of snapshot.
+ *
+ * @param snap Snapshot
+ * @return Memory used by @a snap in bytes
+ */
+static size_t rewind_snap_size(rewind_snap_t *snap)
+{
+	return sizeof(rewind_snap_t) + zx_state_mach_size() +
+	    snap->undo_size;
+}
+
+/** Remove and free snapshot.
+ *
+ * @param rew Rewind buffer
+ * @param snap Snapshot
+ */
+static void rewind_snap_delete(rewind_t *rew, rewind_snap_t *snap)
+{
+	rew->used -= rewind_snap_size(snap);
+	list_remove(&snap->lsnaps);
+	free(snap->undo);
+	free(snap->mach);
+	free(snap);
+}
+
+/** Get newest snapshot.
+ *
+ * @param rew Rewind buffer
+ * @return Newest snapshot or @c NULL if there are none
+ */
+static rewind_snap_t *rewind_newest(rewind_t *rew)
+{
+	link_t *link;
+
+	link = list_last(&rew->snaps);
+	if (link == NULL)
+		return NULL;
+
+	return list_get_instance(link, rewind_snap_t, lsnaps);
+}
+
+/** Drop all snapshots.
+ *
+ * @param rew Rewind buffer
+ */
+void rewind_reset(rewind_t *rew)
+{
+	link_t *link;
+
+	while ((link = list_first(&rew->snaps)) != NULL) {
+		rewind_snap_delete(rew,
+		    list_get_instance(link, rewind_snap_t, lsnaps));
+	}
+
+	free(rew->state);
+	rew->state = NULL;
+	rew->state_size = 0;
+	free(rew->undo);
+	rew->undo = NULL;
+	rew->fields = 0;
+}
+
+/** Destroy rewind buffer.
+ *
+ * @param rew Rewind buffer
+ */
+void rewind_destroy(rewind_t *rew)
+{
+	if (rew == NULL)
+		return;
+
+	rewind_reset(rew);
+	free(rew);
+}
+
+/** Build undo records for the newest snapshot.
+ *
+ * RAM of the newest snapshot is updated to current RAM contents.
+ *
+ * @param rew Rewind buffer
+ * @return Size of undo records in @c rew->undo
+ */
+static size_t rewind_build_undo(rewind_t *rew)
+{
+	uint8_t *sram = rew->state + zx_state_mach_size();
+	uint32_t npg;
+	uint32_t mpg;
+	uint32_t pg;
+	uint32_t pg_end;
+	rewind_undo_t rec;
+	size_t size;
+	uint8_t *o;
+	const uint8_t *n;
+	int start;
+	int end;
+
+	size = 0;
+	npg = rew->zx->mem.ram_size >> ZX_MEM_PG_SHIFT;
+	for (mpg = 0; mpg < npg; mpg++) {
+		if (!zx_mem_dirty(rew->zx, mpg))
+			continue;
+
+		pg = mpg << (ZX_MEM_PG_SHIFT - REWIND_PG_SHIFT);
+		pg_end = pg + (1 << (ZX_MEM_PG_SHIFT - REWIND_PG_SHIFT));
+		for (; pg < pg_end; pg++) {
+			o = sram + (pg << REWIND_PG_SHIFT);
+			n = zx_mem_ram_ptr(rew->zx, pg << REWIND_PG_SHIFT);
+			if (memcmp(o, n, REWIND_PG_SIZE) == 0)
+				continue;
+
+			start = 0;
+			while (o[start] == n[start])
+				++start;
+			end = REWIND_PG_SIZE - 1;
+			while (o[end] == n[end])
+				--end;
+
+			/* Records follow data of any length, they can be unaligned */
+			rec.pg = pg;
+			rec.start = start;
+			rec.end = end;
+			memcpy(rew->undo + size, &rec, sizeof(rewind_undo_t));
+			size += sizeof(rewind_undo_t);
+			memcpy(rew->undo + size, o + start, end - start + 1);
+			size += end - start + 1;
+			memcpy(o + start, n + start, end - start + 1);
+		}
+	}
+
+	return size;
+}
+
+/** Apply undo records of snapshot to RAM of the newest snapshot.
+ *
+ * @param rew Rewind buffer
+ * @param snap Snapshot preceding the newest snapshot
+ */
+static void rewind_apply_undo(rewind_t *rew, rewind_snap_t *snap)
+{
+	uint8_t *sram = rew->state + zx_state_mach_size();
+	rewind_undo_t rec;
+	size_t off;
+	size_t len;
+
+	off = 0;
+	while (off < snap->undo_size) {
+		memcpy(&rec, snap->undo + off, sizeof(rewind_undo_t));
+		off += sizeof(rewind_undo_t);
+		len = rec.end - rec.start + 1;
+		memcpy(sram + (rec.pg << REWIND_PG_SHIFT) + rec.start,
+		    snap->undo + off, len);
+		off += len;
+	}
+}
+
+/** Take a snapshot.
+ *
+ * @param rew Rewind buffer
+ * @return Zero on success, ENOMEM if out of memory, ENOTSUP if
+ *         the machine state cannot be saved
+ */
+static int rewind_snap(rewind_t *rew)
+{
+	rewind_snap_t *snap;
+	rewind_snap_t *prev;
+	size_t undo_size;
+	link_t *link;
+	int rc;
+
+	snap = calloc(1, sizeof(rewind_snap_t));
+	if (snap == NULL)
+		return ENOMEM;
+
+	snap->mach = malloc(zx_state_mach_size());
+	if (snap->mach == NULL) {
+		free(snap);
+		return ENOMEM;
+	}
+
+	rc = zx_state_save_mach(rew->zx, snap->mach, zx_state_mach_size());
+	if (rc != 0) {
+		free(snap->mach);
+		free(snap);
+		return rc;
+	}
+
+	prev = rewind_newest(rew);
+	if (prev != NULL && rew->state_size == zx_state_size(rew->zx)) {
+		/* Record how to get from the new snapshot back to prev */
+		undo_size = rewind_build_undo(rew);
+		if (undo_size > 0) {
+			prev->undo = malloc(undo_size);
+			if (prev->undo == NULL) {
+				free(snap->mach);
+				free(snap);
+				rewind_reset(rew);
+				return ENOMEM;
+			}
+
+			memcpy(prev->undo, rew->undo, undo_size);
+			prev->undo_size = undo_size;
+			rew->used += undo_size;
+		}
+	} else {
+		/* First snapshot or RAM size changed */
+		rewind_reset(rew);
+		rew->state_size = zx_state_size(rew->zx);
+		rew->state = malloc(rew->state_size);
+		rew->undo = malloc((rew->zx->mem.ram_size >> REWIND_PG_SHIFT) *
+		    (sizeof(rewind_undo_t) + REWIND_PG_SIZE));
+		if (rew->state == NULL || rew->undo == NULL) {
+			free(snap->mach);
+			free(snap);
+			rewind_reset(rew);
+			return ENOMEM;
+		}
+
+		zx_mem_ram_save(rew->zx, rew->state + zx_state_mach_size());
+	}
+
+	zx_mem_dirty_clear(rew->zx);
+
+	list_append(&snap->lsnaps, &rew->snaps);
+	rew->used += rewind_snap_size(snap);
+	rew->fields = 0;
+
+	/* Drop oldest snapshots to stay within budget */
+	while (rew->used > rew->budget) {
+		link = list_first(&rew->snaps);
+		if (link == &snap->lsnaps)
+			break;
+		rewind_snap_delete(rew,
+		    list_get_instance(link, rewind_snap_t, lsnaps));
+	}
+
+	return 0;
+}
+
+/** Account for a new field, taking a snapshot if it is due.
+ *
+ * @param rew Rewind buffer
+ */
+void rewind_field(rewind_t *rew)
+{
+	if (++rew->fields < rew->interval && !list_empty(&rew->snaps))
+		return;
+
+	if (rewind_snap(rew) != 0)
+		rewind_reset(rew);
+}
+
+/** Go back to an earlier snapshot.
+ *
+ * Goes back to the newest snapshot, or to the one before it if the newest
+ * snapshot was taken only a few fields ago. The snapshots after the
+ * restored one are dropped.
+ *
+ * @param rew Rewind buffer
+ * @return Zero on success, ENOENT if there is no snapshot to go back to,
+ *         other error code if the snapshot cannot be loaded
+ */
+int rewind_back(rewind_t *rew)
+{
+	rewind_snap_t *snap;
+	rewind_snap_t *prev;
+	link_t *link;
+	int rc;
+
+	snap = rewind_newest(rew);
+	if (snap == NULL)
+		return ENOENT;
+
+	link = list_prev(&snap->lsnaps, &rew->snaps);
+	if (rew->fields < REWIND_MIN_FIELDS && link != NULL) {
+		prev = list_get_instance(link, rewind_snap_t, lsnaps);
+		rewind_apply_undo(rew, prev);
+		rew->used -= prev->undo_size;
+		free(prev->undo);
+		prev->undo = NULL;
+		prev->undo_size = 0;
+		rewind_snap_delete(rew, snap);
+		snap = prev;
+	}
+
+	memcpy(rew->state, snap->mach, zx_state_mach_size());
+	rc = zx_state_load(rew->zx, rew->state, rew->state_size);
+	if (rc != 0) {
+		rewind_reset(rew);
+		return rc;
+	}
+
+	/* RAM now matches the newest snapshot */
+	zx_mem_dirty_clear(rew->zx);
+	rew->fields = 0;
+	return 0;
+}
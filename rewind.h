@@ -0,0 +1,68 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Rewind buffer
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types/adt/list.h"
+#include "types/zx.h"
+
+/** Rewind buffer */
+typedef struct {
+	/** Machine */
+	zx_machine_t *zx;
+	/** Snapshots (rewind_snap_t), oldest first */
+	list_t snaps;
+	/** Memory budget for snapshots in bytes */
+	size_t budget;
+	/** Memory used by snapshots in bytes */
+	size_t used;
+	/** Number of fields between snapshots */
+	unsigned interval;
+	/** Fields since the newest snapshot */
+	unsigned fields;
+	/** Machine state of the newest snapshot (including RAM contents) */
+	uint8_t *state;
+	/** Size of @c state in bytes */
+	size_t state_size;
+	/** Buffer for building undo records */
+	uint8_t *undo;
+} rewind_t;
+
+extern int rewind_create(zx_machine_t *, size_t, unsigned, rewind_t **);
+extern void rewind_destroy(rewind_t *);
+extern void rewind_reset(rewind_t *);
+extern void rewind_field(rewind_t *);
+extern int rewind_back(rewind_t *);
+
+#endif
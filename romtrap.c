@@ -0,0 +1,149 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * ROM traps
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ROM traps
+ *
+ * A ROM trap replaces a ROM routine (e.g. loading from tape) with native
+ * code. Traps are identified by their offset in the ROM image, i.e. by
+ * ROM bank and address, so that a trap only fires when its ROM is paged
+ * in. A bitmap with one bit per ROM byte makes checking for a trap cheap.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memio.h"
+#include "romtrap.h"
+
+/** Remove all ROM traps.
+ *
+ * Needs to be called whenever the size of the ROM image changes.
+ *
+ * @param size Size of ROM image in bytes
+ * @return Zero on success, EINVAL if @a size is larger than
+ *         ROMTRAP_ROM_MAX
+ */
+int romtrap_reset(zx_machine_t *zx, uint32_t size)
+{
+	if (size > ROMTRAP_ROM_MAX)
+		return EINVAL;
+
+	memset(zx->romtraps.map, 0, (size + 7) / 8);
+	zx->romtraps.cnt = 0;
+	return 0;
+}
+
+/** Add ROM trap.
+ *
+ * @param bank ROM bank (16K)
+ * @param addr Address of the trap in the bank
+ * @param handler Function called when the CPU is about to execute
+ *                the instruction at @a addr
+ * @param arg Argument to @a handler
+ * @return Zero on success, EINVAL if the trap is outside the ROM image,
+ *         ENOMEM if there are too many traps
+ */
+int romtrap_add(zx_machine_t *zx, unsigned bank, uint16_t addr,
+    void (*handler)(void *), void *arg)
+{
+	uint32_t off;
+
+	if (addr >= 0x4000)
+		return EINVAL;
+
+	off = bank * 0x4000 + addr;
+	if (off >= zx->mem.rom_size)
+		return EINVAL;
+
+	if (zx->romtraps.cnt >= ROMTRAP_MAX)
+		return ENOMEM;
+
+	zx->romtraps.trap[zx->romtraps.cnt].off = off;
+	zx->romtraps.trap[zx->romtraps.cnt].handler = handler;
+	zx->romtraps.trap[zx->romtraps.cnt].arg = arg;
+	++zx->romtraps.cnt;
+
+	zx->romtraps.map[off >> 3] |= 1 << (off & 7);
+	return 0;
+}
+
+/** Determine if there is a ROM trap in memory page.
+ *
+ * Only traps in the ROM that is currently paged in are considered.
+ *
+ * @param pg Memory page number
+ * @return @c true iff there is a trap in page @a pg
+ */
+bool romtrap_in_page(zx_machine_t *zx, unsigned pg)
+{
+	uintptr_t off;
+	int i;
+
+	off = (uintptr_t)zx->mem.rdpg[pg] - (uintptr_t)zx->mem.rom;
+	if (off >= zx->mem.rom_size)
+		return false;
+
+	for (i = 0; i < zx->romtraps.cnt; i++) {
+		if (zx->romtraps.trap[i].off - off < ZX_MEM_PG_SIZE)
+			return true;
+	}
+
+	return false;
+}
+
+/** Process ROM trap at address, if any.
+ *
+ * @param addr Address of the instruction that is about to be executed
+ * @return @c true iff a trap handler was called
+ */
+bool romtrap_proc(zx_machine_t *zx, uint16_t addr)
+{
+	uint32_t off;
+	int i;
+
+	if (!romtrap_at(zx, addr))
+		return false;
+
+	off = (uintptr_t)zx->mem.rdpg[addr >> ZX_MEM_PG_SHIFT] +
+	    (addr & (ZX_MEM_PG_SIZE - 1)) - (uintptr_t)zx->mem.rom;
+
+	for (i = 0; i < zx->romtraps.cnt; i++) {
+		if (zx->romtraps.trap[i].off == off) {
+			zx->romtraps.trap[i].handler(zx->romtraps.trap[i].arg);
+			return true;
+		}
+	}
+
+	return false;
+}
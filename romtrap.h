@@ -0,0 +1,68 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * ROM traps
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ROMTRAP_H
+#define ROMTRAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "memio.h"
+#include "types/romtrap.h"
+#include "types/zx.h"
+
+extern int romtrap_reset(zx_machine_t *, uint32_t);
+extern int romtrap_add(zx_machine_t *, unsigned, uint16_t, void (*)(void *),
+    void *);
+extern bool romtrap_in_page(zx_machine_t *, unsigned);
+extern bool romtrap_proc(zx_machine_t *, uint16_t);
+
+/** Determine if there is a ROM trap at address.
+ *
+ * Only traps in the ROM that is currently paged in are considered.
+ * This is a single bitmap lookup.
+ *
+ * @param zx Machine
+ * @param addr Address
+ * @return @c true iff a trap is set at @a addr
+ */
+static inline bool romtrap_at(zx_machine_t *zx, uint16_t addr)
+{
+	uintptr_t off;
+
+	off = (uintptr_t)zx->mem.rdpg[addr >> ZX_MEM_PG_SHIFT] +
+	    (addr & (ZX_MEM_PG_SIZE - 1)) - (uintptr_t)zx->mem.rom;
+	if (off >= zx->mem.rom_size)
+		return false;
+
+	return (zx->romtraps.map[off >> 3] & (1 << (off & 7))) != 0;
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Run-ahead
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Run-ahead
+ *
+ * To hide the input latency of the emulated software, the field shown
+ * is not the one that has just been emulated, but one emulated a few
+ * fields ahead of time with the current input. The canonical timeline
+ * is restored from a saved machine state afterwards.
+ *
+ * Run-ahead belongs to the interactive front end, which drives a single
+ * machine (the state buffer is shared).
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "iorec.h"
+#include "mgfx.h"
+#include "runahead.h"
+#include "state.h"
+#include "sys_all.h"
+#include "zx.h"
+#include "zx_sound.h"
+
+/** Number of fields to run ahead (zero to disable run-ahead) */
+unsigned runahead;
+/** Machine state saved before running ahead */
+static void *ra_state;
+/** Size of ra_state buffer */
+static size_t ra_state_size;
+/** Number of fields presented from running ahead */
+static unsigned long ra_fields;
+/** Total host time spent saving state for running ahead (us) */
+static uint64_t ra_save_usec;
+/** Total host time spent emulating ahead (us) */
+static uint64_t ra_run_usec;
+/** Total host time spent restoring state after running ahead (us) */
+static uint64_t ra_load_usec;
+
+/** Determine whether to run ahead.
+ *
+ * @param zx Machine
+ * @return @c true if run-ahead is enabled and possible
+ */
+bool runahead_on(zx_machine_t *zx)
+{
+	return runahead != 0 && !zx->warp_on && zx->rzx == NULL &&
+	    zx_run_allowed(zx);
+}
+
+/** Present a field emulated ahead of time.
+ *
+ * Machine state is saved, the next few fields are emulated speculatively
+ * with the current input and the last one is shown. Then the machine
+ * state is restored. Sound, MIDI and I/O recording of the speculative
+ * fields are discarded.
+ *
+ * @param zx Machine
+ * @return Zero on success, error code if machine state cannot be saved
+ *         or restored
+ */
+int runahead_run(zx_machine_t *zx)
+{
+	iorec_t *rec;
+	uint64_t t0, t1, t2;
+	unsigned n;
+	int rc;
+
+	t0 = sys_time_usec();
+
+	if (ra_state_size != zx_state_size(zx)) {
+		free(ra_state);
+		ra_state_size = zx_state_size(zx);
+		ra_state = malloc(ra_state_size);
+		if (ra_state == NULL) {
+			ra_state_size = 0;
+			return ENOMEM;
+		}
+	}
+
+	rc = zx_state_save(zx, ra_state, ra_state_size);
+	if (rc != 0)
+		return rc;
+
+	t1 = sys_time_usec();
+
+	zx->speculative = true;
+	rec = zx->iorec;
+	zx->iorec = NULL;
+	zx_sound_discard(zx, true);
+
+	/* Only draw the field that is going to be shown */
+	n = 0;
+	zx->field_skip = runahead > 1;
+	while (true) {
+		if (zx_dispatch(zx)) {
+			if (++n >= runahead)
+				break;
+			zx->field_skip = n + 1 < runahead;
+		}
+
+		zx_exec(zx);
+	}
+
+	mgfx_updscr();
+
+	zx_sound_discard(zx, false);
+	zx->iorec = rec;
+	zx->speculative = false;
+
+	t2 = sys_time_usec();
+
+	rc = zx_state_load(zx, ra_state, ra_state_size);
+	if (rc != 0)
+		return rc;
+
+	++ra_fields;
+	ra_save_usec += t1 - t0;
+	ra_run_usec += t2 - t1;
+	ra_load_usec += sys_time_usec() - t2;
+	return 0;
+}
+
+/** Write run-ahead statistics to log file. */
+void runahead_writestat(void)
+{
+	if (ra_fields == 0)
+		return;
+
+	fprintf(logfi, "\nRun-ahead (%u fields): %lu fields presented\n",
+	    runahead, ra_fields);
+	fprintf(logfi, "Average per field: save %.1f us, run %.1f us, "
+	    "restore %.1f us\n", (double)ra_save_usec / ra_fields,
+	    (double)ra_run_usec / ra_fields,
+	    (double)ra_load_usec / ra_fields);
+}
@@ -0,0 +1,745 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * RZX input recording and playback
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * RZX input recording and playback
+ *
+ * An RZX file contains a snapshot and, for each interrupt frame, the number
+ * of opcode fetches and the values returned by all IN instructions.
+ * When recording, the machine is first saved to a snapshot and restored
+ * from it, so that recording and playback start from the same state.
+ * All input reaches the machine through zx_in8(), so feeding back
+ * the recorded values reproduces the session exactly.
+ *
+ * Frames end with the video field interrupt. During playback the number
+ * of fetches and IN values of each frame is checked against the recording
+ * to detect loss of synchronization. Compressed blocks, external
+ * snapshots and files with more than one snapshot are not supported.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fileutil.h"
+#include "memio.h"
+#include "rzx.h"
+#include "snap.h"
+#include "strutil.h"
+#include "version.h"
+#include "z80.h"
+#include "zx.h"
+
+/** RZX format version (major) */
+#define RZX_VER_MAJOR 0
+/** RZX format version (minor) */
+#define RZX_VER_MINOR 13
+
+/** Block IDs */
+enum {
+	rzx_bid_creator = 0x10,
+	rzx_bid_sec_key = 0x20,
+	rzx_bid_sec_sig = 0x21,
+	rzx_bid_snap = 0x30,
+	rzx_bid_input = 0x80
+};
+
+/** Size of block header (ID and length) */
+#define RZX_BLK_HDR_SIZE 5
+/** Size of creator name field */
+#define RZX_CREATOR_SIZE 20
+/** Snapshot block flag: external snapshot */
+#define RZX_SNAP_EXT 0x1
+/** Snapshot block flag: compressed data */
+#define RZX_SNAP_COMPR 0x2
+/** Input block flag: compressed data */
+#define RZX_INPUT_COMPR 0x2
+/** IN counter value meaning the IN values of previous frame repeat */
+#define RZX_IN_REPEAT 0xffff
+
+/** Create RZX structure.
+ *
+ * @param zx Machine
+ * @param playing @c true for playback, @c false for recording
+ * @param rrzx Place to store pointer to new structure
+ * @return Zero on success, ENOMEM if out of memory
+ */
+static int rzx_create(zx_machine_t *zx, bool playing, rzx_t **rrzx)
+{
+	rzx_t *rzx;
+
+	rzx = calloc(1, sizeof(rzx_t));
+	if (rzx == NULL)
+		return ENOMEM;
+
+	rzx->zx = zx;
+	rzx->playing = playing;
+	*rrzx = rzx;
+	return 0;
+}
+
+/** Destroy RZX structure.
+ *
+ * @param rzx RZX
+ */
+static void rzx_destroy(rzx_t *rzx)
+{
+	free(rzx->fname);
+	free(rzx->snap);
+	free(rzx->frames);
+	free(rzx->in);
+	free(rzx);
+}
+
+/** Append frame.
+ *
+ * @param rzx RZX
+ * @param frame Frame
+ * @return Zero on success, ENOMEM if out of memory
+ */
+static int rzx_add_frame(rzx_t *rzx, rzx_frame_t *frame)
+{
+	rzx_frame_t *nframes;
+	size_t nalloc;
+
+	if (rzx->nframes >= rzx->frames_alloc) {
+		nalloc = rzx->frames_alloc != 0 ? 2 * rzx->frames_alloc : 1024;
+		nframes = realloc(rzx->frames, nalloc * sizeof(rzx_frame_t));
+		if (nframes == NULL)
+			return ENOMEM;
+		rzx->frames = nframes;
+		rzx->frames_alloc = nalloc;
+	}
+
+	rzx->frames[rzx->nframes++] = *frame;
+	return 0;
+}
+
+/** Append IN values.
+ *
+ * @param rzx RZX
+ * @param data IN values
+ * @param size Number of IN values
+ * @return Zero on success, ENOMEM if out of memory
+ */
+static int rzx_add_in(rzx_t *rzx, const uint8_t *data, size_t size)
+{
+	uint8_t *nin;
+	size_t nalloc;
+
+	if (rzx->in_size + size > rzx->in_alloc) {
+		nalloc = rzx->in_alloc != 0 ? rzx->in_alloc : 4096;
+		while (rzx->in_size + size > nalloc)
+			nalloc *= 2;
+		nin = realloc(rzx->in, nalloc);
+		if (nin == NULL)
+			return ENOMEM;
+		rzx->in = nin;
+		rzx->in_alloc = nalloc;
+	}
+
+	memcpy(rzx->in + rzx->in_size, data, size);
+	rzx->in_size += size;
+	return 0;
+}
+
+/** Read whole file.
+ *
+ * @param fname File name
+ * @param rdata Place to store pointer to newly allocated data
+ * @param rsize Place to store size of data
+ * @return Zero on success, error code otherwise
+ */
+static int rzx_read_file(const char *fname, uint8_t **rdata, size_t *rsize)
+{
+	FILE *f;
+	uint8_t *data;
+	size_t size;
+
+	f = fopen(fname, "rb");
+	if (f == NULL)
+		return ENOENT;
+
+	size = fsize(f);
+	data = malloc(size != 0 ? size : 1);
+	if (data == NULL) {
+		fclose(f);
+		return ENOMEM;
+	}
+
+	if (fread(data, 1, size, f) != size) {
+		free(data);
+		fclose(f);
+		return EIO;
+	}
+
+	fclose(f);
+	*rdata = data;
+	*rsize = size;
+	return 0;
+}
+
+/** Write whole file.
+ *
+ * @param fname File name
+ * @param data Data
+ * @param size Size of data
+ * @return Zero on success, EIO on error
+ */
+static int rzx_write_file(const char *fname, const uint8_t *data,
+    size_t size)
+{
+	FILE *f;
+
+	f = fopen(fname, "wb");
+	if (f == NULL)
+		return EIO;
+
+	if (fwrite(data, 1, size, f) != size) {
+		fclose(f);
+		return EIO;
+	}
+
+	if (fclose(f) != 0)
+		return EIO;
+
+	return 0;
+}
+
+/** Get temporary snapshot file name.
+ *
+ * @param fname RZX file name
+ * @param ext Snapshot file extension
+ * @return Newly allocated file name or @c NULL if out of memory
+ */
+static char *rzx_snap_fname(const char *fname, const char *ext)
+{
+	char *sname;
+	size_t len;
+
+	len = strlen(fname) + 1 + strlen(ext) + 1;
+	sname = malloc(len);
+	if (sname == NULL)
+		return NULL;
+
+	snprintf(sname, len, "%s.%s", fname, ext);
+	return sname;
+}
+
+/** Start RZX recording.
+ *
+ * The machine is saved to a snapshot which is then loaded back, so that
+ * the recording starts from exactly the state stored in the snapshot.
+ * Only machines supported by the Z80 snapshot format can be recorded.
+ *
+ * @param zx Machine
+ * @param fname RZX file name
+ * @param tstates T-states since the last interrupt (informational)
+ * @param rrzx Place to store pointer to new RZX recording
+ * @return Zero on success, ENOTSUP if the machine cannot be recorded,
+ *         ENOMEM if out of memory, EIO on I/O error
+ */
+int rzx_rec_create(zx_machine_t *zx, const char *fname, uint32_t tstates,
+    rzx_t **rrzx)
+{
+	rzx_t *rzx;
+	char *sname;
+	int rc;
+
+	if (zx->mem.model != ZXM_48K && zx->mem.model != ZXM_128K)
+		return ENOTSUP;
+
+	rc = rzx_create(zx, false, &rzx);
+	if (rc != 0)
+		return rc;
+
+	rzx->fname = strdup(fname);
+	sname = rzx_snap_fname(fname, "z80");
+	if (rzx->fname == NULL || sname == NULL) {
+		free(sname);
+		rzx_destroy(rzx);
+		return ENOMEM;
+	}
+
+	if (zx_save_snap(zx, sname) < 0 || zx_load_snap_z80(zx, sname) < 0) {
+		(void) remove(sname);
+		free(sname);
+		rzx_destroy(rzx);
+		return EIO;
+	}
+
+	rc = rzx_read_file(sname, &rzx->snap, &rzx->snap_size);
+	(void) remove(sname);
+	free(sname);
+	if (rc != 0) {
+		rzx_destroy(rzx);
+		return rc;
+	}
+
+	rzx->tstates = tstates;
+	rzx->frame_fetches = zx->cpu.fetches;
+	*rrzx = rzx;
+	return 0;
+}
+
+/** Get 16-bit little-endian value.
+ *
+ * @param p Data
+ * @return Value
+ */
+static uint16_t rzx_get16(const uint8_t *p)
+{
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+/** Get 32-bit little-endian value.
+ *
+ * @param p Data
+ * @return Value
+ */
+static uint32_t rzx_get32(const uint8_t *p)
+{
+	return (uint32_t)rzx_get16(p) | ((uint32_t)rzx_get16(p + 2) << 16);
+}
+
+/** Load snapshot block.
+ *
+ * @param zx Machine
+ * @param fname RZX file name
+ * @param blk Block data (without block header)
+ * @param size Size of block data
+ * @return Zero on success, error code otherwise
+ */
+static int rzx_load_snap(zx_machine_t *zx, const char *fname,
+    const uint8_t *blk, size_t size)
+{
+	uint32_t flags;
+	char ext[5];
+	char *sname;
+	int rc;
+
+	if (size < 12)
+		return EINVAL;
+
+	flags = rzx_get32(blk);
+	if ((flags & (RZX_SNAP_EXT | RZX_SNAP_COMPR)) != 0) {
+		printf("RZX: external or compressed snapshot not supported.\n");
+		return ENOTSUP;
+	}
+
+	memcpy(ext, blk + 4, 4);
+	ext[4] = '\0';
+
+	sname = rzx_snap_fname(fname, ext);
+	if (sname == NULL)
+		return ENOMEM;
+
+	rc = rzx_write_file(sname, blk + 12, size - 12);
+	if (rc == 0) {
+		if (strcmpci(ext, "z80") == 0)
+			rc = zx_load_snap_z80(zx, sname) < 0 ? EIO : 0;
+		else if (strcmpci(ext, "sna") == 0)
+			rc = zx_load_snap_sna(zx, sname) < 0 ? EIO : 0;
+		else
+			rc = ENOTSUP;
+	}
+
+	(void) remove(sname);
+	free(sname);
+	return rc;
+}
+
+/** Load input recording block.
+ *
+ * @param rzx RZX
+ * @param blk Block data (without block header)
+ * @param size Size of block data
+ * @return Zero on success, error code otherwise
+ */
+static int rzx_load_input(rzx_t *rzx, const uint8_t *blk, size_t size)
+{
+	rzx_frame_t frame;
+	rzx_frame_t prev;
+	uint32_t nframes;
+	uint32_t flags;
+	uint32_t i;
+	size_t off;
+	int rc;
+
+	if (size < 13)
+		return EINVAL;
+
+	nframes = rzx_get32(blk);
+	flags = rzx_get32(blk + 9);
+	if ((flags & RZX_INPUT_COMPR) != 0) {
+		printf("RZX: compressed input recording not supported.\n");
+		return ENOTSUP;
+	}
+
+	memset(&prev, 0, sizeof(prev));
+	off = 13;
+	for (i = 0; i < nframes; i++) {
+		if (off + 4 > size)
+			return EINVAL;
+
+		frame.fetches = rzx_get16(blk + off);
+		frame.nin = rzx_get16(blk + off + 2);
+		off += 4;
+
+		if (frame.nin == RZX_IN_REPEAT) {
+			frame.nin = prev.nin;
+			frame.in_off = prev.in_off;
+		} else {
+			if (off + frame.nin > size)
+				return EINVAL;
+
+			frame.in_off = rzx->in_size;
+			rc = rzx_add_in(rzx, blk + off, frame.nin);
+			if (rc != 0)
+				return rc;
+			off += frame.nin;
+		}
+
+		rc = rzx_add_frame(rzx, &frame);
+		if (rc != 0)
+			return rc;
+		prev = frame;
+	}
+
+	return 0;
+}
+
+/** Start RZX playback.
+ *
+ * The snapshot contained in the file is loaded.
+ *
+ * @param zx Machine
+ * @param fname RZX file name
+ * @param rrzx Place to store pointer to new RZX playback
+ * @return Zero on success, ENOENT if the file cannot be opened, EINVAL
+ *         if the file is not valid, ENOTSUP if the file uses features
+ *         that are not supported, other error code on other error
+ */
+int rzx_play_open(zx_machine_t *zx, const char *fname, rzx_t **rrzx)
+{
+	rzx_t *rzx;
+	uint8_t *data;
+	size_t size;
+	size_t off;
+	uint8_t bid;
+	uint32_t blen;
+	bool have_snap;
+	int rc;
+
+	rc = rzx_read_file(fname, &data, &size);
+	if (rc != 0)
+		return rc;
+
+	rc = rzx_create(zx, true, &rzx);
+	if (rc != 0) {
+		free(data);
+		return rc;
+	}
+
+	if (size < 10 || memcmp(data, "RZX!", 4) != 0) {
+		rc = EINVAL;
+		goto error;
+	}
+
+	have_snap = false;
+	off = 10;
+	while (off < size) {
+		if (off + RZX_BLK_HDR_SIZE > size) {
+			rc = EINVAL;
+			goto error;
+		}
+
+		bid = data[off];
+		blen = rzx_get32(data + off + 1);
+		if (blen < RZX_BLK_HDR_SIZE || blen > size - off) {
+			rc = EINVAL;
+			goto error;
+		}
+
+		switch (bid) {
+		case rzx_bid_snap:
+			if (have_snap) {
+				printf("RZX: multiple snapshots not "
+				    "supported.\n");
+				rc = ENOTSUP;
+				goto error;
+			}
+
+			rc = rzx_load_snap(zx, fname, data + off +
+			    RZX_BLK_HDR_SIZE, blen - RZX_BLK_HDR_SIZE);
+			if (rc != 0)
+				goto error;
+			have_snap = true;
+			break;
+		case rzx_bid_input:
+			if (!have_snap) {
+				rc = EINVAL;
+				goto error;
+			}
+
+			rc = rzx_load_input(rzx, data + off +
+			    RZX_BLK_HDR_SIZE, blen - RZX_BLK_HDR_SIZE);
+			if (rc != 0)
+				goto error;
+			break;
+		default:
+			/* Creator, security and unknown blocks */
+			break;
+		}
+
+		off += blen;
+	}
+
+	if (!have_snap || rzx->nframes == 0) {
+		rc = EINVAL;
+		goto error;
+	}
+
+	free(data);
+	rzx->frame_fetches = zx->cpu.fetches;
+	*rrzx = rzx;
+	return 0;
+error:
+	free(data);
+	rzx_destroy(rzx);
+	return rc;
+}
+
+/** Write block header.
+ *
+ * @param f File
+ * @param bid Block ID
+ * @param len Length of block data (without block header)
+ */
+static void rzx_write_blk_hdr(FILE *f, uint8_t bid, size_t len)
+{
+	fputu8(f, bid);
+	fputu32le(f, RZX_BLK_HDR_SIZE + len);
+}
+
+/** Determine if frame repeats IN values of the previous frame.
+ *
+ * @param rzx RZX
+ * @param i Frame index
+ * @return @c true if IN values are the same as in the previous frame
+ */
+static bool rzx_frame_repeats(rzx_t *rzx, size_t i)
+{
+	rzx_frame_t *frame = &rzx->frames[i];
+	rzx_frame_t *prev;
+
+	if (i == 0)
+		return false;
+
+	prev = &rzx->frames[i - 1];
+	return frame->nin != 0 && frame->nin == prev->nin &&
+	    memcmp(rzx->in + frame->in_off, rzx->in + prev->in_off,
+	    frame->nin) == 0;
+}
+
+/** Write RZX file.
+ *
+ * @param rzx RZX recording
+ * @return Zero on success, EIO on error
+ */
+static int rzx_write(rzx_t *rzx)
+{
+	FILE *f;
+	char creator[RZX_CREATOR_SIZE];
+	size_t ilen;
+	size_t i;
+	int major;
+	int minor;
+
+	f = fopen(rzx->fname, "wb");
+	if (f == NULL)
+		return EIO;
+
+	/* Header */
+	fwrite("RZX!", 1, 4, f);
+	fputu8(f, RZX_VER_MAJOR);
+	fputu8(f, RZX_VER_MINOR);
+	fputu32le(f, 0);
+
+	/* Creator */
+	memset(creator, 0, sizeof(creator));
+	strncpy(creator, "GZX", sizeof(creator) - 1);
+	major = 0;
+	minor = 0;
+	(void) sscanf(VERSION_STR, "%d.%d", &major, &minor);
+	rzx_write_blk_hdr(f, rzx_bid_creator, RZX_CREATOR_SIZE + 4);
+	fwrite(creator, 1, RZX_CREATOR_SIZE, f);
+	fputu16le(f, major);
+	fputu16le(f, minor);
+
+	/* Snapshot */
+	rzx_write_blk_hdr(f, rzx_bid_snap, 12 + rzx->snap_size);
+	fputu32le(f, 0);
+	fwrite("z80\0", 1, 4, f);
+	fputu32le(f, rzx->snap_size);
+	fwrite(rzx->snap, 1, rzx->snap_size, f);
+
+	/* Input recording */
+	ilen = 13;
+	for (i = 0; i < rzx->nframes; i++) {
+		ilen += 4;
+		if (!rzx_frame_repeats(rzx, i))
+			ilen += rzx->frames[i].nin;
+	}
+
+	rzx_write_blk_hdr(f, rzx_bid_input, ilen);
+	fputu32le(f, rzx->nframes);
+	fputu8(f, 0);
+	fputu32le(f, rzx->tstates);
+	fputu32le(f, 0);
+
+	for (i = 0; i < rzx->nframes; i++) {
+		fputu16le(f, rzx->frames[i].fetches);
+		if (rzx_frame_repeats(rzx, i)) {
+			fputu16le(f, RZX_IN_REPEAT);
+		} else {
+			fputu16le(f, rzx->frames[i].nin);
+			fwrite(rzx->in + rzx->frames[i].in_off, 1,
+			    rzx->frames[i].nin, f);
+		}
+	}
+
+	if (ferror(f)) {
+		fclose(f);
+		return EIO;
+	}
+
+	if (fclose(f) != 0)
+		return EIO;
+
+	return 0;
+}
+
+/** Stop RZX recording or playback.
+ *
+ * When recording, the RZX file is written. The current (incomplete)
+ * frame is not part of the recording.
+ *
+ * @param rzx RZX
+ * @return Zero on success, EIO if the RZX file cannot be written
+ */
+int rzx_close(rzx_t *rzx)
+{
+	int rc = 0;
+
+	if (!rzx->playing)
+		rc = rzx_write(rzx);
+
+	rzx_destroy(rzx);
+	return rc;
+}
+
+/** Process value read by IN instruction.
+ *
+ * When recording, the value is recorded. When playing back, the recorded
+ * value is returned instead.
+ *
+ * @param rzx RZX
+ * @param val Value read from the emulated device
+ * @return Value to return from the IN instruction
+ */
+uint8_t rzx_in(rzx_t *rzx, uint8_t val)
+{
+	rzx_frame_t *frame;
+
+	if (!rzx->playing) {
+		if (rzx->cur_nin < RZX_IN_REPEAT &&
+		    rzx_add_in(rzx, &val, 1) == 0)
+			++rzx->cur_nin;
+		else
+			rzx->in_overrun = true;
+		return val;
+	}
+
+	frame = &rzx->frames[rzx->cur_frame];
+	if (rzx->cur_nin >= frame->nin) {
+		rzx->in_overrun = true;
+		return val;
+	}
+
+	return rzx->in[frame->in_off + rzx->cur_nin++];
+}
+
+/** End interrupt frame.
+ *
+ * @param rzx RZX
+ * @return Zero on success, ENOENT if all recorded frames have been played
+ *         back, EIO if playback lost synchronization or a frame could
+ *         not be recorded, ENOMEM if out of memory
+ */
+int rzx_int(rzx_t *rzx)
+{
+	rzx_frame_t *frame;
+	rzx_frame_t nframe;
+	unsigned long fetches;
+	int rc;
+
+	fetches = rzx->zx->cpu.fetches - rzx->frame_fetches;
+	rzx->frame_fetches = rzx->zx->cpu.fetches;
+
+	if (!rzx->playing) {
+		if (rzx->in_overrun || fetches >= RZX_IN_REPEAT)
+			return EIO;
+
+		nframe.fetches = fetches;
+		nframe.nin = rzx->cur_nin;
+		nframe.in_off = rzx->in_size - rzx->cur_nin;
+		rzx->cur_nin = 0;
+		rc = rzx_add_frame(rzx, &nframe);
+		if (rc != 0)
+			return rc;
+
+		return 0;
+	}
+
+	frame = &rzx->frames[rzx->cur_frame];
+	if (rzx->in_overrun || fetches != frame->fetches ||
+	    rzx->cur_nin != frame->nin)
+		return EIO;
+
+	rzx->cur_nin = 0;
+	if (++rzx->cur_frame >= rzx->nframes)
+		return ENOENT;
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * RZX input recording and playback
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RZX_H
+#define RZX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** RZX input recording frame */
+typedef struct {
+	/** Number of opcode fetches in the frame */
+	uint16_t fetches;
+	/** Number of IN values */
+	uint16_t nin;
+	/** Offset of the first IN value in rzx_t.in */
+	size_t in_off;
+} rzx_frame_t;
+
+struct zx_machine;
+
+/** RZX input recording or playback */
+typedef struct {
+	/** Machine */
+	struct zx_machine *zx;
+	/** Playing back (otherwise recording) */
+	bool playing;
+	/** File name (recording) */
+	char *fname;
+	/** Snapshot data */
+	uint8_t *snap;
+	/** Size of snapshot data */
+	size_t snap_size;
+	/** T-states since interrupt at the start of recording */
+	uint32_t tstates;
+	/** Frames */
+	rzx_frame_t *frames;
+	/** Number of frames */
+	size_t nframes;
+	/** Number of allocated frames */
+	size_t frames_alloc;
+	/** IN values of all frames */
+	uint8_t *in;
+	/** Number of IN values */
+	size_t in_size;
+	/** Number of allocated IN values */
+	size_t in_alloc;
+	/** Current frame */
+	size_t cur_frame;
+	/** Number of IN values in the current frame so far */
+	size_t cur_nin;
+	/** Value of CPU fetches at the start of the current frame */
+	unsigned long frame_fetches;
+	/** More IN values were read than recorded in the current frame */
+	bool in_overrun;
+} rzx_t;
+
+extern int rzx_rec_create(struct zx_machine *, const char *, uint32_t,
+    rzx_t **);
+extern int rzx_play_open(struct zx_machine *, const char *, rzx_t **);
+extern int rzx_close(rzx_t *);
+extern uint8_t rzx_in(rzx_t *, uint8_t);
+extern int rzx_int(rzx_t *);
+
+#endif
@@ -39,7 +39,6 @@
 #include "memio.h"
 #include "strutil.h"
 #include "ay.h"
-#include "gzx.h"
 #include "snap.h"
 #include "snap_ay.h"
 #include "z80.h"
@@ -47,7 +46,22 @@
 #include "z80g.h"
 #include "zx_scr.h"
 
-static int gfxram_load(char *);
+static int gfxram_load(zx_machine_t *, char *);
+
+/* 48k RAM is three 16k banks */
+static void snap_read_48k_ram(zx_machine_t *zx, FILE *f) {
+  int i;
+
+  for(i=0;i<3;i++)
+    fread(zx_mem_bank_wr(zx, i),1,0x4000,f);
+}
+
+static void snap_write_48k_ram(zx_machine_t *zx, FILE *f) {
+  int i;
+
+  for(i=0;i<3;i++)
+    fwrite(zx->mem.ram[i],1,0x4000,f);
+}
 
 /*
   Translate 48k page numbers (8,4,5) to our numbering system (0,1,2)
@@ -65,11 +79,12 @@ static int map48k(int page_n) {
   We need to get the CPU to a state representable in others' snapshot
   formats.
 */
-static void prepare_cpu(void) {
-  if(cpus.modifier) /* DD/FD prefix - go back */
-    cpus.PC--;
-  /* cpus.halted .. too bad, there's just nothing we can do */
-  /* cpus.int_lock .. XXX we should advance to the first instruction
+static void prepare_cpu(zx_machine_t *zx) {
+  z80_sync_flags(&zx->cpu.cpus);
+  if(zx->cpu.cpus.modifier) /* DD/FD prefix - go back */
+    zx->cpu.cpus.PC--;
+  /* cpu0.cpus.halted .. too bad, there's just nothing we can do */
+  /* cpu0.cpus.int_lock .. XXX we should advance to the first instruction
    * that does not enable int_lock. But that could theoretically take
    * a long time. So just forget it. */
 }
@@ -100,22 +115,22 @@ static void snap_z80_read_mem_page(FILE *f, uint8_t *b0, unsigned page_bytes) {
   }
 }
 
-static void snap_z80_read_48k_page(FILE *f, int page_n) {
+static void snap_z80_read_48k_page(zx_machine_t *zx, FILE *f, int page_n) {
   int page_i;
   
   page_i = map48k(page_n);
   if(page_i<0) printf("page type %d - ignoring\n",page_n);
-    else snap_z80_read_mem_page(f,zxram+0x4000*page_i,0x4000);
+    else snap_z80_read_mem_page(f,zx_mem_bank_wr(zx, page_i),0x4000);
 }
 
-static void snap_z80_read_128k_page(FILE *f, int page_n) {
+static void snap_z80_read_128k_page(zx_machine_t *zx, FILE *f, int page_n) {
   if(page_n>=3 && page_n<=10)
-    snap_z80_read_mem_page(f,zxram+(page_n-3)*0x4000,0x4000);
+    snap_z80_read_mem_page(f,zx_mem_bank_wr(zx, page_n-3),0x4000);
       else printf("page type %d - ignoring\n",page_n);
 }
 
 /* returns 0 when ok, -1 on error -> reset ZX */
-int zx_load_snap_z80(char *name) {
+int zx_load_snap_z80(zx_machine_t *zx, char *name) {
   FILE *f;
   uint8_t flags1,flags2,flags3,hw,i1rp;
   uint8_t page,ay_r;
@@ -126,6 +141,7 @@ int zx_load_snap_z80(char *name) {
   uint8_t page_n;
   uint16_t page_len;
   long page_end;
+  uint8_t *buf;
   int i;
   
   f=fopen(name,"rb");
@@ -134,68 +150,68 @@ int zx_load_snap_z80(char *name) {
     return -1;
   }
   
-  zx_reset();
-  
-  cpus.r[rA]=fgetu8(f);
-  cpus.F=fgetu8(f);
-  cpus.r[rC]=fgetu8(f);
-  cpus.r[rB]=fgetu8(f);
-  cpus.r[rL]=fgetu8(f);
-  cpus.r[rH]=fgetu8(f);
-  cpus.PC=fgetu16le(f);
-  cpus.SP=fgetu16le(f);
-  cpus.I=fgetu8(f);
-  cpus.R=fgetu8(f)&0x7f;
+  zx_reset(zx);
+  
+  zx->cpu.cpus.r[rA]=fgetu8(f);
+  zx->cpu.cpus.F=fgetu8(f);
+  zx->cpu.cpus.r[rC]=fgetu8(f);
+  zx->cpu.cpus.r[rB]=fgetu8(f);
+  zx->cpu.cpus.r[rL]=fgetu8(f);
+  zx->cpu.cpus.r[rH]=fgetu8(f);
+  zx->cpu.cpus.PC=fgetu16le(f);
+  zx->cpu.cpus.SP=fgetu16le(f);
+  zx->cpu.cpus.I=fgetu8(f);
+  zx->cpu.cpus.R=fgetu8(f)&0x7f;
   flags1=fgetu8(f);
   if(flags1==0xff) flags1=0x01; /* Do I deserve this?
 				   Did I say anything bad about G.A.Lunter? */
-  cpus.R = cpus.R | ((flags1&1)<<7);  /* what the... */
-  border=(flags1>>1)&0x07;
+  zx->cpu.cpus.R = zx->cpu.cpus.R | ((flags1&1)<<7);  /* what the... */
+  zx->mem.border=(flags1>>1)&0x07;
   /* bit4 = samrom?! igroring for now.. */
   compressed=(flags1&0x20)!=0;
 				   
-  cpus.r[rE]=fgetu8(f);
-  cpus.r[rD]=fgetu8(f);
+  zx->cpu.cpus.r[rE]=fgetu8(f);
+  zx->cpu.cpus.r[rD]=fgetu8(f);
   
-  cpus.r_[rC]=fgetu8(f);
-  cpus.r_[rB]=fgetu8(f);
-  cpus.r_[rE]=fgetu8(f);
-  cpus.r_[rD]=fgetu8(f);
-  cpus.r_[rL]=fgetu8(f);
-  cpus.r_[rH]=fgetu8(f);
-  cpus.r_[rA]=fgetu8(f);
-  cpus.F_=fgetu8(f);
+  zx->cpu.cpus.r_[rC]=fgetu8(f);
+  zx->cpu.cpus.r_[rB]=fgetu8(f);
+  zx->cpu.cpus.r_[rE]=fgetu8(f);
+  zx->cpu.cpus.r_[rD]=fgetu8(f);
+  zx->cpu.cpus.r_[rL]=fgetu8(f);
+  zx->cpu.cpus.r_[rH]=fgetu8(f);
+  zx->cpu.cpus.r_[rA]=fgetu8(f);
+  zx->cpu.cpus.F_=fgetu8(f);
   
-  cpus.IY=fgetu16le(f);
-  cpus.IX=fgetu16le(f);
+  zx->cpu.cpus.IY=fgetu16le(f);
+  zx->cpu.cpus.IX=fgetu16le(f);
   
-  cpus.IFF1=fgetu8(f)?1:0;
-  cpus.IFF2=fgetu8(f)?1:0;
+  zx->cpu.cpus.IFF1=fgetu8(f)?1:0;
+  zx->cpu.cpus.IFF2=fgetu8(f)?1:0;
   
   /* Z80 does not implement or save this */
-  cpus.int_lock=0;
-  cpus.modifier=0;
-  cpus.halted=0;
+  zx->cpu.cpus.int_lock=0;
+  zx->cpu.cpus.modifier=0;
+  zx->cpu.cpus.halted=0;
   
   flags2=fgetu8(f);
-  cpus.int_mode=flags2&0x03;
-  if(cpus.int_mode==3) {
+  zx->cpu.cpus.int_mode=flags2&0x03;
+  if(zx->cpu.cpus.int_mode==3) {
     printf("error in Z80 snapshot: int_mode==3\n");
     return -1;
   }
   /* other bits of flags2 just make no sense to this emulator... */
   
-  if(cpus.PC==0) { /* version >=2.0 */
+  if(zx->cpu.cpus.PC==0) { /* version >=2.0 */
     hdr_len=fgetu16le(f);
     hdr_end=ftell(f)+hdr_len; /* to handle any possible new version */
     
-    cpus.PC=fgetu16le(f);
+    zx->cpu.cpus.PC=fgetu16le(f);
     hw=fgetu8(f);
     page=fgetu8(f); /* 128k:last out to 7ffd, samram:something else */
     switch(hw) {
       case 0:
       case 1:
-        zx_select_memmodel(ZXM_48K);
+        zx_select_memmodel(zx, ZXM_48K);
 	pages=3;
 	break;
 	
@@ -205,8 +221,8 @@ int zx_load_snap_z80(char *name) {
 
       case 3:
       case 4:
-        zx_select_memmodel(ZXM_128K);
-	zx_mem_page_select(ZXPLUS_PAGESEL_PORT, page);
+        zx_select_memmodel(zx, ZXM_128K);
+	zx_mem_page_select(zx, ZXPLUS_PAGESEL_PORT, page);
 	pages=8;
 	break;
 	
@@ -220,13 +236,13 @@ int zx_load_snap_z80(char *name) {
     flags3=fgetu8(f); /* totally useless */
     (void) flags3;
     ay_r=fgetu8(f); /* sound chip register number */
-    ay_reg_select(&ay0, ay_r);
+    ay_reg_select(&zx->ay, ay_r);
     /* contents of sound registers */
     for(i=0;i<16;i++) {
-      ay_reg_select(&ay0, i);
-      ay_reg_write(&ay0, fgetu8(f));
+      ay_reg_select(&zx->ay, i);
+      ay_reg_write(&zx->ay, fgetu8(f));
     }
-    ay_reg_select(&ay0, ay_r);
+    ay_reg_select(&zx->ay, ay_r);
     
     fseek(f,hdr_end,SEEK_SET); /* just to be sure .. */
     
@@ -244,12 +260,12 @@ int zx_load_snap_z80(char *name) {
       switch(hw) {
 	case 0:
         case 1:
-	  snap_z80_read_48k_page(f,page_n);
+	  snap_z80_read_48k_page(zx, f,page_n);
           break;
 	
         case 3:
         case 4:
-	  snap_z80_read_128k_page(f,page_n);
+	  snap_z80_read_128k_page(zx, f,page_n);
           break;
       }
       fseek(f,page_end,SEEK_SET);
@@ -258,14 +274,23 @@ int zx_load_snap_z80(char *name) {
   } else {
     printf("Z80 OLD version snapshot\n");
     printf("page data starts at offset %ld\n",ftell(f));
-    zx_select_memmodel(ZXM_48K); /* always ZX-48k */
+    zx_select_memmodel(zx, ZXM_48K); /* always ZX-48k */
     
     if(compressed) {
       printf("compressed\n");
-      snap_z80_read_mem_page(f,zxram,48*1024);
+      /* runs can cross bank boundaries */
+      buf=malloc(48*1024);
+      if(!buf) {
+        fclose(f);
+        return -1;
+      }
+      snap_z80_read_mem_page(f,buf,48*1024);
+      for(i=0;i<3;i++)
+        memcpy(zx_mem_bank_wr(zx, i),buf+i*0x4000,0x4000);
+      free(buf);
     } else {
       printf("uncompressed\n");
-      fread(zxram,1,48*1024,f);
+      snap_read_48k_ram(zx, f);
     }
   }
   
@@ -311,7 +336,7 @@ static void z80_write_page_data(FILE *f, uint8_t *b0) {
   }
 }
 
-static void z80_write_page(FILE *f, int page_i, int page_n) {    
+static void z80_write_page(zx_machine_t *zx, FILE *f, int page_i, int page_n) {    
   uint16_t page_len;
   long page_end,page_start;
   
@@ -319,7 +344,7 @@ static void z80_write_page(FILE *f, int page_i, int page_n) {
   fputu8(f,page_n);
   page_start = ftell(f);
 
-  z80_write_page_data(f,zxram+0x4000*page_i);
+  z80_write_page_data(f,zx->mem.ram[page_i]);
     
   page_end = ftell(f);
   page_len = page_end-page_start;
@@ -331,20 +356,20 @@ static void z80_write_page(FILE *f, int page_i, int page_n) {
 }
 
 /* returns 0 when ok, -1 on error */
-static int zx_save_snap_z80(char *name) {
+static int zx_save_snap_z80(zx_machine_t *zx, char *name) {
   FILE *f;
   uint8_t flags1,flags2,flags3,hw,i1rp;
   uint16_t hdr_len;
   long hdr_end;
   int i;
   
-  switch(mem_model) {
+  switch(zx->mem.model) {
     case ZXM_48K: hw=0; break;
     case ZXM_128K: hw=3; break;
     default: printf("Invalid model for Z80 snapshot.\n"); return -1;
   }
 
-  prepare_cpu();
+  prepare_cpu(zx);
   
   f=fopen(name,"wb");
   if(!f) {
@@ -352,65 +377,65 @@ static int zx_save_snap_z80(char *name) {
     return -1;
   }
   
-  fputu8(f,cpus.r[rA]);
-  fputu8(f,cpus.F);
-  fputu8(f,cpus.r[rC]);
-  fputu8(f,cpus.r[rB]);
-  fputu8(f,cpus.r[rL]);
-  fputu8(f,cpus.r[rH]);
+  fputu8(f,zx->cpu.cpus.r[rA]);
+  fputu8(f,zx->cpu.cpus.F);
+  fputu8(f,zx->cpu.cpus.r[rC]);
+  fputu8(f,zx->cpu.cpus.r[rB]);
+  fputu8(f,zx->cpu.cpus.r[rL]);
+  fputu8(f,zx->cpu.cpus.r[rH]);
   fputu16le(f,0); /* would be PC in version < 2.0 of Z80 */
-  fputu16le(f,cpus.SP);
-  fputu8(f,cpus.I);
-  fputu8(f,cpus.R);
-  flags1 = (cpus.R>>7)|(border<<1)|0x20;
+  fputu16le(f,zx->cpu.cpus.SP);
+  fputu8(f,zx->cpu.cpus.I);
+  fputu8(f,zx->cpu.cpus.R);
+  flags1 = (zx->cpu.cpus.R>>7)|(zx->mem.border<<1)|0x20;
     /* Samrom not switched in, data is compressed */
   fputu8(f,flags1);
 
-  fputu8(f,cpus.r[rE]);
-  fputu8(f,cpus.r[rD]);
+  fputu8(f,zx->cpu.cpus.r[rE]);
+  fputu8(f,zx->cpu.cpus.r[rD]);
   
-  fputu8(f,cpus.r_[rC]);
-  fputu8(f,cpus.r_[rB]);
-  fputu8(f,cpus.r_[rE]);
-  fputu8(f,cpus.r_[rD]);
-  fputu8(f,cpus.r_[rL]);
-  fputu8(f,cpus.r_[rH]);
-  fputu8(f,cpus.r_[rA]);
-  fputu8(f,cpus.F_);
+  fputu8(f,zx->cpu.cpus.r_[rC]);
+  fputu8(f,zx->cpu.cpus.r_[rB]);
+  fputu8(f,zx->cpu.cpus.r_[rE]);
+  fputu8(f,zx->cpu.cpus.r_[rD]);
+  fputu8(f,zx->cpu.cpus.r_[rL]);
+  fputu8(f,zx->cpu.cpus.r_[rH]);
+  fputu8(f,zx->cpu.cpus.r_[rA]);
+  fputu8(f,zx->cpu.cpus.F_);
   
-  fputu16le(f,cpus.IY);
-  fputu16le(f,cpus.IX);
+  fputu16le(f,zx->cpu.cpus.IY);
+  fputu16le(f,zx->cpu.cpus.IX);
   
-  fputu8(f,cpus.IFF1);
-  fputu8(f,cpus.IFF2);
+  fputu8(f,zx->cpu.cpus.IFF1);
+  fputu8(f,zx->cpu.cpus.IFF2);
   
   /* Z80 does not implement or save this */
-/*  cpus.int_lock=0; better watch out for these!!
-  cpus.modifier=0;
-  cpus.halted=0;*/
+/*  cpu0.cpus.int_lock=0; better watch out for these!!
+  zx->cpu.cpus.modifier=0;
+  zx->cpu.cpus.halted=0;*/
   
-  flags2 = cpus.int_mode; /* Normal sync, no double int. freq, no Issue 2 */
+  flags2 = zx->cpu.cpus.int_mode; /* Normal sync, no double int. freq, no Issue 2 */
   fputu8(f,flags2);
   
   hdr_len=23; /* additional header length in bytes */
   fputu16le(f,hdr_len);
   hdr_end=ftell(f)+hdr_len;
     
-  fputu16le(f,cpus.PC);
+  fputu16le(f,zx->cpu.cpus.PC);
   
   fputu8(f,hw);
-  fputu8(f,page_reg); /* 128k:last out to 7ffd, samram:something else */
+  fputu8(f,zx->mem.page_reg); /* 128k:last out to 7ffd, samram:something else */
     
   i1rp=0x00; /* Interface 1 not paged in */
   fputu8(f,i1rp);
   flags3 = 0x07; /* R-reg & LDIR emulation on, AY always */
   fputu8(f,flags3);
   
-  fputu8(f,ay_get_sel_regn(&ay0)); /* sound chip register number */
+  fputu8(f,ay_get_sel_regn(&zx->ay)); /* sound chip register number */
   
   /* contents of sound registers */
   for(i=0;i<16;i++) {
-    fputu8(f,ay_get_reg_contents(&ay0, i));
+    fputu8(f,ay_get_reg_contents(&zx->ay, i));
   }
     
   fseek(f,hdr_end,SEEK_SET); /* just to be sure .. */
@@ -418,16 +443,16 @@ static int zx_save_snap_z80(char *name) {
   printf("save Z80 NEW version snapshot\n");
   printf("page data starts at offset %ld\n",ftell(f));
 
-  switch(mem_model) {
+  switch(zx->mem.model) {
     case ZXM_48K:
-      z80_write_page(f,1,4);
-      z80_write_page(f,2,5);
-      z80_write_page(f,0,8);
+      z80_write_page(zx, f,1,4);
+      z80_write_page(zx, f,2,5);
+      z80_write_page(zx, f,0,8);
       break;
       
     case ZXM_128K:
       for(i=0;i<8;i++)
-        z80_write_page(f,i,3+i);
+        z80_write_page(zx, f,i,3+i);
       break;
 
     default:
@@ -439,17 +464,17 @@ static int zx_save_snap_z80(char *name) {
 }
 
 
-static void snap_sna_read_128k_page(FILE *f, int page_n) {
-  fread(zxram+page_n*0x4000,1,0x4000,f);
+static void snap_sna_read_128k_page(zx_machine_t *zx, FILE *f, int page_n) {
+  fread(zx_mem_bank_wr(zx, page_n),1,0x4000,f);
 }
 
-static void snap_sna_write_128k_page(FILE *f, int page_n) {
-  fwrite(zxram+page_n*0x4000,1,0x4000,f);
+static void snap_sna_write_128k_page(zx_machine_t *zx, FILE *f, int page_n) {
+  fwrite(zx->mem.ram[page_n],1,0x4000,f);
 }
 
 
 /* returns 0 when ok, -1 on error -> reset ZX */
-int zx_load_snap_sna(char *name) {
+int zx_load_snap_sna(zx_machine_t *zx, char *name) {
   FILE *f;
   uint8_t inter;
   long size;
@@ -474,86 +499,86 @@ int zx_load_snap_sna(char *name) {
       return -1;
   }
    
-  zx_reset();
-  
-  cpus.I=fgetu8(f);
-  
-  cpus.r_[rL]=fgetu8(f);
-  cpus.r_[rH]=fgetu8(f);
-  cpus.r_[rE]=fgetu8(f);
-  cpus.r_[rD]=fgetu8(f);
-  cpus.r_[rC]=fgetu8(f);
-  cpus.r_[rB]=fgetu8(f);
-  cpus.F_=fgetu8(f);
-  cpus.r_[rA]=fgetu8(f);
-  
-  cpus.r[rL]=fgetu8(f);
-  cpus.r[rH]=fgetu8(f);
-  cpus.r[rE]=fgetu8(f);
-  cpus.r[rD]=fgetu8(f);
-  cpus.r[rC]=fgetu8(f);
-  cpus.r[rB]=fgetu8(f);
-  cpus.IY=fgetu16le(f);
-  cpus.IX=fgetu16le(f);
+  zx_reset(zx);
+  
+  zx->cpu.cpus.I=fgetu8(f);
+  
+  zx->cpu.cpus.r_[rL]=fgetu8(f);
+  zx->cpu.cpus.r_[rH]=fgetu8(f);
+  zx->cpu.cpus.r_[rE]=fgetu8(f);
+  zx->cpu.cpus.r_[rD]=fgetu8(f);
+  zx->cpu.cpus.r_[rC]=fgetu8(f);
+  zx->cpu.cpus.r_[rB]=fgetu8(f);
+  zx->cpu.cpus.F_=fgetu8(f);
+  zx->cpu.cpus.r_[rA]=fgetu8(f);
+  
+  zx->cpu.cpus.r[rL]=fgetu8(f);
+  zx->cpu.cpus.r[rH]=fgetu8(f);
+  zx->cpu.cpus.r[rE]=fgetu8(f);
+  zx->cpu.cpus.r[rD]=fgetu8(f);
+  zx->cpu.cpus.r[rC]=fgetu8(f);
+  zx->cpu.cpus.r[rB]=fgetu8(f);
+  zx->cpu.cpus.IY=fgetu16le(f);
+  zx->cpu.cpus.IX=fgetu16le(f);
   
   inter=fgetu8(f);
   
-  cpus.IFF2=inter ? 1:0;
-  cpus.IFF1=cpus.IFF2;		/* don't know if this is stored anywhere */
+  zx->cpu.cpus.IFF2=inter ? 1:0;
+  zx->cpu.cpus.IFF1=zx->cpu.cpus.IFF2;		/* don't know if this is stored anywhere */
   
-  cpus.R=fgetu8(f);
+  zx->cpu.cpus.R=fgetu8(f);
   
-  cpus.F=fgetu8(f);
-  cpus.r[rA]=fgetu8(f);
-  cpus.SP=fgetu16le(f);
+  zx->cpu.cpus.F=fgetu8(f);
+  zx->cpu.cpus.r[rA]=fgetu8(f);
+  zx->cpu.cpus.SP=fgetu16le(f);
   
-  cpus.int_mode=fgetu8(f);
-  if(cpus.int_mode>2) {
+  zx->cpu.cpus.int_mode=fgetu8(f);
+  if(zx->cpu.cpus.int_mode>2) {
     printf("error in SNA snapshot: int_mode>2\n");
     return -1;
   }
   
-  border=fgetu8(f)&0x07;
+  zx->mem.border=fgetu8(f)&0x07;
   				   
   /* not supported by SNA */  
-  cpus.int_lock=0;
-  cpus.modifier=0;
-  cpus.halted=0;
+  zx->cpu.cpus.int_lock=0;
+  zx->cpu.cpus.modifier=0;
+  zx->cpu.cpus.halted=0;
  
   if(type==0) {  /* 48k SNA */
-    zx_select_memmodel(ZXM_48K);
+    zx_select_memmodel(zx, ZXM_48K);
 
     /* read memory dump */
     fseek(f,27,SEEK_SET);  
-    fread(zxram,1,48*1024,f);
+    snap_read_48k_ram(zx, f);
   
     /* pop PC (yuck!)*/
-    cpus.PC=zx_memget16(cpus.SP);
-    zx_memset16(cpus.SP,0);	/* this is supposed to help sometimes */
-    cpus.SP+=2;
+    zx->cpu.cpus.PC=zx_memget16(zx, zx->cpu.cpus.SP);
+    zx_memset16(zx, zx->cpu.cpus.SP,0);	/* this is supposed to help sometimes */
+    zx->cpu.cpus.SP+=2;
   } else { /* 128k SNA */
-    zx_select_memmodel(ZXM_128K);
+    zx_select_memmodel(zx, ZXM_128K);
     
     /* read PC and paging info */
     fseek(f,49179,SEEK_SET);
-    cpus.PC=fgetu16le(f);
+    zx->cpu.cpus.PC=fgetu16le(f);
     pageout=fgetu8(f);
-    zx_mem_page_select(ZXPLUS_PAGESEL_PORT, pageout);
+    zx_mem_page_select(zx, ZXPLUS_PAGESEL_PORT, pageout);
     fgetu8(f); /* ??? I thought 128k didn't have TR-DOS? */
     
     curpaged=pageout & 0x07;
     
     /* read "48k" banks */
     fseek(f,27,SEEK_SET);
-    snap_sna_read_128k_page(f,5);
-    snap_sna_read_128k_page(f,2);
-    snap_sna_read_128k_page(f,curpaged);
+    snap_sna_read_128k_page(zx, f,5);
+    snap_sna_read_128k_page(zx, f,2);
+    snap_sna_read_128k_page(zx, f,curpaged);
     
     /* read other banks */
     fseek(f,49183,SEEK_SET);
     for(i=0;i<8;i++) {
       if((i!=2) && (i!=5) && (i!=curpaged)) {
-        snap_sna_read_128k_page(f,i);
+        snap_sna_read_128k_page(zx, f,i);
       }
     }
   }
@@ -565,13 +590,13 @@ int zx_load_snap_sna(char *name) {
 
 
 /* returns 0 when ok, -1 on error */
-static int zx_save_snap_sna(char *name) {
+static int zx_save_snap_sna(zx_machine_t *zx, char *name) {
   FILE *f;
   uint8_t inter;
   uint8_t curpaged;
   int i;
   
-  switch(mem_model) {
+  switch(zx->mem.model) {
     case ZXM_48K: break;
     case ZXM_128K: break;
     default: printf("Invalid model for SNA snapshot.\n"); return -1;
@@ -583,82 +608,82 @@ static int zx_save_snap_sna(char *name) {
     return -1;
   }
   
-  prepare_cpu();
+  prepare_cpu(zx);
 
-  if(mem_model == ZXM_48K) {
+  if(zx->mem.model == ZXM_48K) {
     /* ah! the horror! */
-    cpus.SP-=2;
-    zx_memset16(cpus.SP,cpus.PC);
+    zx->cpu.cpus.SP-=2;
+    zx_memset16(zx, zx->cpu.cpus.SP,zx->cpu.cpus.PC);
   }
   
-  fputu8(f,cpus.I);
-  
-  fputu8(f,cpus.r_[rL]);
-  fputu8(f,cpus.r_[rH]);
-  fputu8(f,cpus.r_[rE]);
-  fputu8(f,cpus.r_[rD]);
-  fputu8(f,cpus.r_[rC]);
-  fputu8(f,cpus.r_[rB]);
-  fputu8(f,cpus.F_);
-  fputu8(f,cpus.r_[rA]);
-  
-  fputu8(f,cpus.r[rL]);
-  fputu8(f,cpus.r[rH]);
-  fputu8(f,cpus.r[rE]);
-  fputu8(f,cpus.r[rD]);
-  fputu8(f,cpus.r[rC]);
-  fputu8(f,cpus.r[rB]);
-  fputu16le(f,cpus.IY);
-  fputu16le(f,cpus.IX);
+  fputu8(f,zx->cpu.cpus.I);
+  
+  fputu8(f,zx->cpu.cpus.r_[rL]);
+  fputu8(f,zx->cpu.cpus.r_[rH]);
+  fputu8(f,zx->cpu.cpus.r_[rE]);
+  fputu8(f,zx->cpu.cpus.r_[rD]);
+  fputu8(f,zx->cpu.cpus.r_[rC]);
+  fputu8(f,zx->cpu.cpus.r_[rB]);
+  fputu8(f,zx->cpu.cpus.F_);
+  fputu8(f,zx->cpu.cpus.r_[rA]);
+  
+  fputu8(f,zx->cpu.cpus.r[rL]);
+  fputu8(f,zx->cpu.cpus.r[rH]);
+  fputu8(f,zx->cpu.cpus.r[rE]);
+  fputu8(f,zx->cpu.cpus.r[rD]);
+  fputu8(f,zx->cpu.cpus.r[rC]);
+  fputu8(f,zx->cpu.cpus.r[rB]);
+  fputu16le(f,zx->cpu.cpus.IY);
+  fputu16le(f,zx->cpu.cpus.IX);
   
   /* The docs say IFF2 goes here. But, IFF1 is what's important.
    * Nobody cares aobut IFF2 except the NMI handler! */
-  inter=cpus.IFF1 ? 0x04 : 0x00;
+  inter=zx->cpu.cpus.IFF1 ? 0x04 : 0x00;
   
   fputu8(f,inter);
   
-  fputu8(f,cpus.R);
+  fputu8(f,zx->cpu.cpus.R);
   
-  fputu8(f,cpus.F);
-  fputu8(f,cpus.r[rA]);
-  fputu16le(f,cpus.SP);
+  fputu8(f,zx->cpu.cpus.F);
+  fputu8(f,zx->cpu.cpus.r[rA]);
+  fputu16le(f,zx->cpu.cpus.SP);
   
-  fputu8(f,cpus.int_mode);
+  fputu8(f,zx->cpu.cpus.int_mode);
   
   /* XXX I think this should really be the last byte written to the ULA port */
-  fputu8(f,border);
+  fputu8(f,zx->mem.border);
   
   /* filepos: 27 bytes */
   				   
   /* better watch out for these! */
-/*  cpus.int_lock;
-  cpus.modifier;
-  cpus.halted; */
+/*  cpu0.cpus.int_lock;
+  zx->cpu.cpus.modifier;
+  zx->cpu.cpus.halted; */
   
-  switch(mem_model) {
+  switch(zx->mem.model) {
     case ZXM_48K:      
       /* write memory dump */
-      fwrite(zxram,1,48*1024,f);
+      snap_write_48k_ram(zx, f);
       
       break;
     case ZXM_128K:
-      curpaged = page_reg & 7;
+      curpaged = zx->mem.page_reg & 7;
       
       /* write "48k" banks */
-      snap_sna_write_128k_page(f,5);
-      snap_sna_write_128k_page(f,2);
-      snap_sna_write_128k_page(f,curpaged);
+      snap_sna_write_128k_page(zx, f,5);
+      snap_sna_write_128k_page(zx, f,2);
+      snap_sna_write_128k_page(zx, f,curpaged);
         
       /* write other banks */
       for(i=0;i<8;i++) {
         if((i!=2) && (i!=5) && (i!=curpaged)) {
-          snap_sna_write_128k_page(f,i);
+          snap_sna_write_128k_page(zx, f,i);
         }
       }
       
       /* read PC and paging info */
-      fputu16le(f,cpus.PC);
-      fputu8(f,page_reg);
+      fputu16le(f,zx->cpu.cpus.PC);
+      fputu8(f,zx->mem.page_reg);
       fputu8(f,0); /* TR-DOS not paged in */
 
       break;
@@ -667,11 +692,11 @@ static int zx_save_snap_sna(char *name) {
       break;
   }
   
-  if(mem_model == ZXM_48K) {
+  if(zx->mem.model == ZXM_48K) {
     /* XXX The idea here is that if the snapshot is broken due to 
      * the stack being clobbered, we'd better find out immediately. */
-    zx_memset16(cpus.SP,0);
-    cpus.SP+=2;
+    zx_memset16(zx, zx->cpu.cpus.SP,0);
+    zx->cpu.cpus.SP+=2;
   }
 
   fclose(f);
@@ -682,7 +707,7 @@ static int zx_save_snap_sna(char *name) {
 
 /* returns 0 when ok, -1 on error -> reset ZX */
 /* determines snapshot type by extension */
-int zx_load_snap(char *name) {
+int zx_load_snap(zx_machine_t *zx, char *name) {
   char *ext;
   char *gext;
   char *gfxname;
@@ -696,11 +721,11 @@ int zx_load_snap(char *name) {
   }
   
   if(!strcmpci(ext,".z80"))
-    rc = zx_load_snap_z80(name);
+    rc = zx_load_snap_z80(zx, name);
   else if(!strcmpci(ext,".sna"))
-    rc = zx_load_snap_sna(name);
+    rc = zx_load_snap_sna(zx, name);
   else if(!strcmpci(ext,".ay"))
-    rc = zx_load_snap_ay(name);
+    rc = zx_load_snap_ay(zx, name);
   else {
     printf("unknown extension\n");
     rc = -1;
@@ -718,15 +743,15 @@ int zx_load_snap(char *name) {
     assert(gext != 0);
     memcpy(gext + 1, "gfx", strlen("gfx"));
 
-    if (gpu_allow && gfxram_load(gfxname)) {
+    if (zx->gpu.allow && gfxram_load(zx, gfxname)) {
       memcpy(gext + 1, "GFX", strlen("GFX"));
-      if (gfxram_load(gfxname)) {
+      if (gfxram_load(zx, gfxname)) {
         free(gfxname);
         return 0;
       }
     }
 
-    zx_scr_clear_bg();
+    zx_scr_clear_bg(zx);
 
     i = 0;
     while (i < 100) {
@@ -736,10 +761,10 @@ int zx_load_snap(char *name) {
       gext[3] = '0' + i % 10;
 
       printf("try loading '%s'\n", gfxname);
-      if (zx_scr_load_bg(gfxname, i)) {
+      if (zx_scr_load_bg(zx, gfxname, i)) {
         /* Try 'BNN' extension */
         gext[1] = 'B';
-        if (zx_scr_load_bg(gfxname, 0)) {
+        if (zx_scr_load_bg(zx, gfxname, 0)) {
           /* Not found, assuming there are no more backgrounds */
           break;
         }
@@ -751,10 +776,10 @@ int zx_load_snap(char *name) {
 
     { int i;
        for(i=0;i<NGP;i++)
-         gpus[i]=cpus;
+         zx->gpu.planes->gpus[i].cpus=zx->cpu.cpus;
     }
     printf("Setting screen mode 1\n");
-    zx_scr_mode(1);
+    zx_scr_mode(zx, 1);
   }
 
   return 0;
@@ -762,7 +787,7 @@ int zx_load_snap(char *name) {
 
 /* returns 0 when ok, -1 on error */
 /* determines snapshot type by extension */
-int zx_save_snap(char *name) {
+int zx_save_snap(zx_machine_t *zx, char *name) {
   char *ext;
   
   ext=strrchr(name,'.');
@@ -771,14 +796,14 @@ int zx_save_snap(char *name) {
     return -1;
   }
   
-  if(!strcmpci(ext,".z80")) return zx_save_snap_z80(name);
-  if(!strcmpci(ext,".sna")) return zx_save_snap_sna(name);
+  if(!strcmpci(ext,".z80")) return zx_save_snap_z80(zx, name);
+  if(!strcmpci(ext,".sna")) return zx_save_snap_sna(zx, name);
   
   printf("unknown extension\n");
   return -1;
 }
 
-static int gfxram_load(char *fname) {
+static int gfxram_load(zx_machine_t *zx, char *fname) {
   FILE *f;
   unsigned u,v,w;
   uint8_t buf[8];
@@ -790,7 +815,7 @@ static int gfxram_load(char *fname) {
     return -1;
   }
 
-  if (gpu_enable() < 0) {
+  if (gpu_enable(zx) < 0) {
     fclose(f);
     return -1;
   }
@@ -802,7 +827,7 @@ static int gfxram_load(char *fname) {
       for(w=0;w<8;w++) {
         if(buf[w]&(1<<v)) b|=(1<<w);
       }
-      gfxram[v][u]=b;
+      zx->gpu.planes->ram[v][u]=b;
     }
   }
   fclose(f);
@@ -32,9 +32,11 @@
 #ifndef SNAP_H
 #define SNAP_H
 
-int zx_load_snap_z80(char *name);
-int zx_load_snap_sna(char *name);
-int zx_load_snap(char *name);
-int zx_save_snap(char *name);
+#include "types/zx.h"
+
+int zx_load_snap_z80(zx_machine_t *, char *name);
+int zx_load_snap_sna(zx_machine_t *, char *name);
+int zx_load_snap(zx_machine_t *, char *name);
+int zx_save_snap(zx_machine_t *, char *name);
 
 #endif
@@ -32,6 +32,8 @@
 #ifndef SNAP_AY_H
 #define SNAP_AY_H
 
-int zx_load_snap_ay(char *name);
+#include "types/zx.h"
+
+int zx_load_snap_ay(zx_machine_t *, char *name);
 
 #endif
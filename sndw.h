@@ -34,7 +34,7 @@
 
 #include <stdint.h>
 
-int sndw_init(int bufs);
+int sndw_init(int bufs, int latency);
 void sndw_done(void);
 void sndw_write(uint8_t *buf);
 
@@ -0,0 +1,507 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Machine state serialization
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Machine state serialization
+ *
+ * The complete state of the emulated machine (CPU, memory, paging, video,
+ * sound chip, tape position and other devices) is copied to or from
+ * a caller-supplied buffer. This is meant to be fast enough to do every
+ * field (e.g. for rewind or run-ahead), not to be a portable file format.
+ * The state layout depends on the build. A header with a version number
+ * and the size of the state structure protects against loading
+ * incompatible state.
+ *
+ * ROM contents are not saved (they are constant for the memory model).
+ * Host-side state such as keyboard and joystick input, sound output
+ * buffers and the display is not part of the machine state.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ay.h"
+#include "memio.h"
+#include "midi.h"
+#include "rs232.h"
+#include "state.h"
+#include "tape/deck.h"
+#include "z80.h"
+#include "z80g.h"
+#include "zx.h"
+#include "zx_scr.h"
+
+/** State magic number */
+#define ZX_STATE_MAGIC "GZXS"
+/** State format version */
+#define ZX_STATE_VERSION 2
+
+/** Bank offset refers to ROM */
+#define ZX_STATE_ROM 0x80000000u
+
+/** State header */
+typedef struct {
+	/** Magic number */
+	char magic[4];
+	/** Format version */
+	uint32_t version;
+	/** Size of the state structure */
+	uint32_t size;
+	/** Memory model */
+	int32_t mem_model;
+	/** RAM size */
+	uint32_t ram_size;
+} zx_state_hdr_t;
+
+/** Machine state (followed by RAM contents) */
+typedef struct {
+	/** Header */
+	zx_state_hdr_t hdr;
+
+	/** CPU registers */
+	z80s cpus;
+	/** CPU clock */
+	unsigned long clock;
+	/** Clock value at the start of the current instruction */
+	unsigned long instr_clock;
+
+	/** Offsets of switched in banks (ZX_STATE_ROM for ROM) */
+	uint32_t bnk[4];
+	/** Offset of selected screen bank */
+	uint32_t scr;
+	/** Page select register */
+	uint8_t page_reg;
+	/** Enhanced paging register */
+	uint8_t epg_reg;
+	/** Paging is locked in 48K mode */
+	int bnk_lock48;
+	/** Border color */
+	uint8_t border;
+	/** Speaker output */
+	uint8_t spk;
+	/** MIC output */
+	uint8_t mic;
+	/** EAR input */
+	uint8_t ear;
+
+	/** ULA video generator */
+	video_ula_t ula;
+	/** AY sound chip */
+	ay_t ay;
+	/** RS-232 port */
+	rs232_t rs232;
+	/** MIDI port */
+	midi_port_t midi;
+	/** Tape position */
+	tape_deck_pos_t tape;
+	/** Event scheduling state */
+	zx_run_state_t run;
+} zx_state_t;
+
+/** Get offset of memory bank.
+ *
+ * @param zx Machine
+ * @param p Pointer to memory bank
+ * @return Offset into RAM, or into ROM with ZX_STATE_ROM set
+ */
+static uint32_t zx_state_bnk_off(zx_machine_t *zx, uint8_t *p)
+{
+	uint32_t off;
+
+	if (zx_mem_ram_off(zx, p, &off))
+		return off;
+
+	return ZX_STATE_ROM | (uint32_t)(p - zx->mem.rom);
+}
+
+/** Check offset of memory bank.
+ *
+ * @param off Offset obtained with zx_state_bnk_off()
+ * @param ram_sz RAM size of the memory model
+ * @param rom_sz ROM size of the memory model
+ * @return Zero on success, EINVAL if offset is out of range
+ */
+static int zx_state_bnk_check(uint32_t off, uint32_t ram_sz, uint32_t rom_sz)
+{
+	if ((off & ZX_STATE_ROM) != 0)
+		return (off & ~ZX_STATE_ROM) < rom_sz ? 0 : EINVAL;
+
+	return off < ram_sz ? 0 : EINVAL;
+}
+
+/** Get memory bank at offset.
+ *
+ * @param zx Machine
+ * @param off Offset checked with zx_state_bnk_check()
+ * @return Pointer to memory bank
+ */
+static uint8_t *zx_state_bnk_ptr(zx_machine_t *zx, uint32_t off)
+{
+	if ((off & ZX_STATE_ROM) != 0)
+		return zx->mem.rom + (off & ~ZX_STATE_ROM);
+
+	return zx->mem.ram[off / ZX_MEM_BNK_SIZE] + off % ZX_MEM_BNK_SIZE;
+}
+
+/** Restore AY state, keeping the I/O port callback.
+ *
+ * @param zx Machine
+ * @param ay Saved AY state
+ */
+static void zx_state_load_ay(zx_machine_t *zx, const ay_t *ay)
+{
+	void (*ioport_write)(void *, uint8_t) = zx->ay.ioport_write;
+	void *ioport_write_arg = zx->ay.ioport_write_arg;
+
+	zx->ay = *ay;
+	zx->ay.ioport_write = ioport_write;
+	zx->ay.ioport_write_arg = ioport_write_arg;
+}
+
+/** Restore RS-232 port state, keeping the sendchar callback.
+ *
+ * @param zx Machine
+ * @param port Saved RS-232 port state
+ */
+static void zx_state_load_rs232(zx_machine_t *zx, const rs232_t *port)
+{
+	void (*sendchar)(void *, uint8_t) = zx->rs232.sendchar;
+	void *sendchar_arg = zx->rs232.sendchar_arg;
+
+	zx->rs232 = *port;
+	zx->rs232.sendchar = sendchar;
+	zx->rs232.sendchar_arg = sendchar_arg;
+}
+
+/** Restore MIDI port state, keeping the message callback.
+ *
+ * @param zx Machine
+ * @param port Saved MIDI port state
+ */
+static void zx_state_load_midi(zx_machine_t *zx, const midi_port_t *port)
+{
+	void (*midi_msg)(void *, midi_msg_t *) = zx->midi.midi_msg;
+	void *midi_msg_arg = zx->midi.midi_msg_arg;
+
+	zx->midi = *port;
+	zx->midi.midi_msg = midi_msg;
+	zx->midi.midi_msg_arg = midi_msg_arg;
+}
+
+/** Get size of machine state.
+ *
+ * @param zx Machine
+ * @return Number of bytes needed to save machine state
+ *         with the current memory model
+ */
+size_t zx_state_size(zx_machine_t *zx)
+{
+	return sizeof(zx_state_t) + zx->mem.ram_size;
+}
+
+/** Get size of machine state without RAM contents.
+ *
+ * In the saved state RAM contents follow the rest of the machine state
+ * at this offset.
+ *
+ * @return Size of machine state without RAM contents in bytes
+ */
+size_t zx_state_mach_size(void)
+{
+	return sizeof(zx_state_t);
+}
+
+/** Save machine state except for RAM contents.
+ *
+ * @param zx Machine
+ * @param buf Buffer
+ * @param size Size of @a buf in bytes
+ * @return Zero on success, EINVAL if the buffer is too small,
+ *         ENOTSUP if the machine state cannot be saved (Spec256)
+ */
+int zx_state_save_mach(zx_machine_t *zx, void *buf, size_t size)
+{
+	zx_state_t *st = (zx_state_t *)buf;
+	int i;
+
+	if (size < sizeof(zx_state_t))
+		return EINVAL;
+
+	if (gpu_is_on(zx))
+		return ENOTSUP;
+
+	memcpy(st->hdr.magic, ZX_STATE_MAGIC, sizeof(st->hdr.magic));
+	st->hdr.version = ZX_STATE_VERSION;
+	st->hdr.size = sizeof(zx_state_t);
+	st->hdr.mem_model = zx->mem.model;
+	st->hdr.ram_size = zx->mem.ram_size;
+
+	st->cpus = zx->cpu.cpus;
+	/*
+	 * Save F, not how it is computed. Flags are evaluated at different
+	 * times with and without translation to native code.
+	 */
+	z80_sync_flags(&st->cpus);
+	st->cpus.lf_a = 0;
+	st->cpus.lf_b = 0;
+	st->cpus.lf_c = 0;
+	st->cpus.lf_res = 0;
+	st->clock = zx->cpu.clock;
+	st->instr_clock = zx->cpu.instr_clock;
+
+	for (i = 0; i < 4; i++)
+		st->bnk[i] = zx_state_bnk_off(zx, zx->mem.bnk[i]);
+	st->scr = zx_state_bnk_off(zx, zx->mem.scr);
+	st->page_reg = zx->mem.page_reg;
+	st->epg_reg = zx->mem.epg_reg;
+	st->bnk_lock48 = zx->mem.bnk_lock48;
+	st->border = zx->mem.border;
+	st->spk = zx->mem.spk;
+	st->mic = zx->mem.mic;
+	st->ear = zx->mem.ear;
+
+	st->ula = zx->video.ula;
+	st->ay = zx->ay;
+	st->rs232 = zx->rs232;
+	st->midi = zx->midi;
+
+	/*
+	 * Links to the rest of the machine are not part of the state (and
+	 * would make the states of identical machines differ)
+	 */
+	st->ula.vout = NULL;
+	st->ula.mem = NULL;
+	st->ula.field_end = NULL;
+	st->ula.field_end_arg = NULL;
+	st->ay.ioport_write = NULL;
+	st->ay.ioport_write_arg = NULL;
+	st->rs232.sendchar = NULL;
+	st->rs232.sendchar_arg = NULL;
+	st->midi.midi_msg = NULL;
+	st->midi.midi_msg_arg = NULL;
+
+	tape_deck_get_pos(zx->tape_deck, &st->tape);
+	zx_run_state_save(zx, &st->run);
+	return 0;
+}
+
+/** Save machine state.
+ *
+ * @param zx Machine
+ * @param buf Buffer
+ * @param size Size of @a buf in bytes
+ * @return Zero on success, EINVAL if the buffer is too small,
+ *         ENOTSUP if the machine state cannot be saved (Spec256)
+ */
+int zx_state_save(zx_machine_t *zx, void *buf, size_t size)
+{
+	int rc;
+
+	if (size < zx_state_size(zx))
+		return EINVAL;
+
+	rc = zx_state_save_mach(zx, buf, size);
+	if (rc != 0)
+		return rc;
+
+	zx_mem_ram_save(zx, (uint8_t *)buf + sizeof(zx_state_t));
+	return 0;
+}
+
+/** Validate machine state.
+ *
+ * @param zx Machine
+ * @param st State (without RAM contents)
+ * @return Zero on success, EINVAL if the state is invalid or does not
+ *         match the emulator, ENOTSUP if the machine state cannot be
+ *         loaded (Spec256)
+ */
+static int zx_state_check(zx_machine_t *zx, const zx_state_t *st)
+{
+	uint32_t ram_sz;
+	uint32_t rom_sz;
+	int rc;
+	int i;
+
+	if (memcmp(st->hdr.magic, ZX_STATE_MAGIC, sizeof(st->hdr.magic)) != 0 ||
+	    st->hdr.version != ZX_STATE_VERSION ||
+	    st->hdr.size != sizeof(zx_state_t))
+		return EINVAL;
+
+	rc = zx_mem_model_size(st->hdr.mem_model, &ram_sz, &rom_sz);
+	if (rc != 0)
+		return rc;
+
+	if (st->hdr.ram_size != ram_sz)
+		return EINVAL;
+
+	for (i = 0; i < 4; i++) {
+		rc = zx_state_bnk_check(st->bnk[i], ram_sz, rom_sz);
+		if (rc != 0)
+			return rc;
+	}
+
+	rc = zx_state_bnk_check(st->scr, ram_sz, rom_sz);
+	if (rc != 0)
+		return rc;
+
+	rc = tape_deck_check_pos(zx->tape_deck, &st->tape);
+	if (rc != 0)
+		return rc;
+
+	if (gpu_is_on(zx))
+		return ENOTSUP;
+
+	return 0;
+}
+
+/** Apply validated machine state except for memory model and RAM.
+ *
+ * @param zx Machine
+ * @param st State checked with zx_state_check()
+ */
+static void zx_state_apply(zx_machine_t *zx, const zx_state_t *st)
+{
+	int i;
+
+	(void) tape_deck_set_pos(zx->tape_deck, &st->tape);
+
+	zx->mem.page_reg = st->page_reg;
+	zx->mem.epg_reg = st->epg_reg;
+	zx->mem.bnk_lock48 = st->bnk_lock48;
+	for (i = 0; i < 4; i++)
+		zx->mem.bnk[i] = zx_state_bnk_ptr(zx, st->bnk[i]);
+	zx->mem.scr = zx_state_bnk_ptr(zx, st->scr);
+	zx_mem_bnk_update(zx);
+
+	zx->mem.border = st->border;
+	zx->mem.spk = st->spk;
+	zx->mem.mic = st->mic;
+	zx->mem.ear = st->ear;
+
+	zx->cpu.cpus = st->cpus;
+	zx->cpu.clock = st->clock;
+	zx->cpu.instr_clock = st->instr_clock;
+
+	zx->video.ula.clock = st->ula.clock;
+	zx->video.ula.cbase = st->ula.cbase;
+	zx->video.ula.fl_rev = st->ula.fl_rev;
+	zx->video.ula.field_no = st->ula.field_no;
+	zx->video.ula.frame_no = st->ula.frame_no;
+	zx->video.ula.idle_bus_byte = st->ula.idle_bus_byte;
+	zx->video.ula.plus = st->ula.plus;
+	zx->video.ula.plus_enable = st->ula.plus_enable;
+	zx_scr_update_pal(zx);
+
+	zx_state_load_ay(zx, &st->ay);
+	zx_state_load_rs232(zx, &st->rs232);
+	zx_state_load_midi(zx, &st->midi);
+
+	zx_run_state_load(zx, &st->run);
+}
+
+/** Load machine state.
+ *
+ * The state must have been saved by the same build of the emulator
+ * with the same tape inserted. The memory model is switched if needed.
+ * The state is fully validated first, so the machine is not changed
+ * when the state is rejected.
+ *
+ * @param zx Machine
+ * @param buf Buffer containing state saved with zx_state_save()
+ * @param size Size of @a buf in bytes
+ * @return Zero on success, EINVAL if the state is invalid or does not
+ *         match the emulator, ENOTSUP if the machine state cannot be
+ *         loaded (Spec256), ENOMEM if out of memory, EIO if the ROM of
+ *         the memory model cannot be read
+ */
+int zx_state_load(zx_machine_t *zx, const void *buf, size_t size)
+{
+	const zx_state_t *st = (const zx_state_t *)buf;
+	int rc;
+
+	/* Validate everything before changing anything */
+	if (size < sizeof(zx_state_t))
+		return EINVAL;
+
+	rc = zx_state_check(zx, st);
+	if (rc != 0)
+		return rc;
+
+	if (size < sizeof(zx_state_t) + st->hdr.ram_size)
+		return EINVAL;
+
+	if (st->hdr.mem_model != zx->mem.model) {
+		rc = zx_mem_model_load(st->hdr.mem_model);
+		if (rc != 0)
+			return rc;
+
+		/* Cannot fail once the memory model is loaded */
+		(void) zx_select_memmodel(zx, st->hdr.mem_model);
+	}
+
+	zx_mem_ram_restore(zx, (const uint8_t *)buf + sizeof(zx_state_t));
+	zx_state_apply(zx, st);
+	return 0;
+}
+
+/** Copy machine state to another machine.
+ *
+ * RAM is not copied, the machines share it until either writes to it
+ * (see zx_mem_share()). The same tape must be inserted in both machines.
+ *
+ * @param dst Destination machine
+ * @param src Source machine
+ * @return Zero on success, EINVAL if the tapes do not match, ENOTSUP
+ *         if the machine state cannot be copied (Spec256), ENOMEM if out
+ *         of memory
+ */
+int zx_state_copy(zx_machine_t *dst, zx_machine_t *src)
+{
+	zx_state_t st;
+	int rc;
+
+	rc = zx_state_save_mach(src, &st, sizeof(st));
+	if (rc != 0)
+		return rc;
+
+	rc = zx_state_check(dst, &st);
+	if (rc != 0)
+		return rc;
+
+	rc = zx_mem_share(dst, src);
+	if (rc != 0)
+		return rc;
+
+	zx_state_apply(dst, &st);
+	return 0;
+}
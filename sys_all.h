@@ -34,12 +34,12 @@
 
 #define SYS_PATH_MAX 128
 
-typedef struct {
-	long sec, usec;
-} timer;
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
-void timer_reset(timer *t);
-unsigned long timer_val(timer *t);
+uint64_t sys_time_usec(void);
+void sys_sleep_until(uint64_t);
 
 int sys_chdir(const char *path);
 char *sys_getcwd(char *buf, int buflen);
@@ -51,4 +51,11 @@ int sys_readdir(char **name, int *is_dir);
 void sys_closedir(void);
 void sys_usleep(unsigned);
 
+int sys_ncpus(void);
+int sys_job_start(int (*)(void *), void *, FILE *, long *);
+int sys_job_wait(long *, int *);
+
+void *sys_mem_alloc(size_t *);
+void sys_mem_free(void *, size_t);
+
 #endif
@@ -47,6 +47,7 @@
 #include "../strutil.h"
 
 static void tape_deck_process_sig(tape_deck_t *, tape_player_sig_t);
+static void tape_deck_state_change(tape_deck_t *);
 
 /** Create tape deck.
  *
@@ -162,6 +163,20 @@ int tape_deck_new(tape_deck_t *deck)
 	return 0;
 }
 
+/** Determine whether file is a tape file (by extension).
+ *
+ * @param fname File name
+ * @return @c true if the file can be opened in the tape deck
+ */
+bool tape_deck_is_tape_file(const char *fname)
+{
+	const char *ext;
+
+	ext = strrchr(fname, '.');
+	return ext != NULL && (strcmpci(ext, ".tap") == 0 ||
+	    strcmpci(ext, ".tzx") == 0 || strcmpci(ext, ".wav") == 0);
+}
+
 /** Open tape file in tape deck.
  *
  * @param deck Tape deck
@@ -298,6 +313,7 @@ void tape_deck_play(tape_deck_t *deck)
 {
 	if (deck->paused) {
 		deck->paused = false;
+		tape_deck_state_change(deck);
 		return;
 	}
 
@@ -307,6 +323,7 @@ void tape_deck_play(tape_deck_t *deck)
 		return;
 
 	deck->playing = true;
+	tape_deck_state_change(deck);
 }
 
 /** Pause tape.
@@ -315,8 +332,11 @@ void tape_deck_play(tape_deck_t *deck)
  */
 void tape_deck_pause(tape_deck_t *deck)
 {
-	if (deck->playing)
-		deck->paused = true;
+	if (!deck->playing || deck->paused)
+		return;
+
+	deck->paused = true;
+	tape_deck_state_change(deck);
 }
 
 /** Stop tape.
@@ -331,6 +351,7 @@ void tape_deck_stop(tape_deck_t *deck)
 	deck->playing = false;
 	deck->paused = false;
 	deck->cur_block = tape_sampler_cur_block(deck->sampler);
+	tape_deck_state_change(deck);
 }
 
 /** Rewind tape.
@@ -375,7 +396,19 @@ bool tape_deck_is_playing(tape_deck_t *deck)
 	return deck->playing;
 }
 
+/** Check if tape is paused.
+ *
+ * @param deck Tape deck
+ * @return @c true iff the tape is playing, but paused
+ */
+bool tape_deck_is_paused(tape_deck_t *deck)
+{
+	return deck->paused;
+}
+
 /** Get tape sample.
+ *
+ * The sample only changes while the tape is playing and not paused.
  *
  * @param deck Tape deck
  * @param smp Place to store sample
@@ -421,10 +454,180 @@ static void tape_deck_process_sig(tape_deck_t *deck, tape_player_sig_t sig)
 		break;
 	case tps_stop:
 		deck->playing = false;
+		tape_deck_state_change(deck);
 		break;
 	case tps_stop_48k:
-		if (deck->mode48k)
+		if (deck->mode48k) {
 			deck->playing = false;
+			tape_deck_state_change(deck);
+		}
 		break;
 	}
 }
+
+/** Notify the owner of the deck that the playback state changed.
+ *
+ * @param deck Tape deck
+ */
+static void tape_deck_state_change(tape_deck_t *deck)
+{
+	if (deck->state_change != NULL)
+		deck->state_change(deck->state_change_arg);
+}
+
+/** Get index of tape block.
+ *
+ * @param deck Tape deck
+ * @param block Tape block or @c NULL
+ * @return Index of @a block in the tape or -1 if @a block is @c NULL
+ */
+static int tape_deck_block_idx(tape_deck_t *deck, tape_block_t *block)
+{
+	tape_block_t *b;
+	int idx;
+
+	if (block == NULL)
+		return -1;
+
+	idx = 0;
+	b = tape_first(deck->tape);
+	while (b != block) {
+		assert(b != NULL);
+		b = tape_next(b);
+		++idx;
+	}
+
+	return idx;
+}
+
+/** Get tape block by index.
+ *
+ * @param deck Tape deck
+ * @param idx Block index or -1
+ * @param rblock Place to store block or @c NULL (if @a idx is -1)
+ * @return Zero on success, EINVAL if there is no such block
+ */
+static int tape_deck_block_at(tape_deck_t *deck, int idx,
+    tape_block_t **rblock)
+{
+	tape_block_t *b;
+
+	if (idx < 0) {
+		*rblock = NULL;
+		return 0;
+	}
+
+	if (deck->tape == NULL)
+		return EINVAL;
+
+	b = tape_first(deck->tape);
+	while (b != NULL && idx > 0) {
+		b = tape_next(b);
+		--idx;
+	}
+
+	if (b == NULL)
+		return EINVAL;
+
+	*rblock = b;
+	return 0;
+}
+
+/** Get tape deck position and playback state.
+ *
+ * @param deck Tape deck
+ * @param pos Place to store position
+ */
+void tape_deck_get_pos(tape_deck_t *deck, tape_deck_pos_t *pos)
+{
+	tape_player_t *player = deck->player;
+	tape_sampler_t *sampler = deck->sampler;
+
+	pos->cur_block = tape_deck_block_idx(deck, deck->cur_block);
+	pos->playing = deck->playing;
+	pos->paused = deck->paused;
+	pos->cur_smp = deck->cur_smp;
+	pos->mode48k = deck->mode48k;
+
+	pos->pl_cur_block = tape_deck_block_idx(deck, player->cur_block);
+	pos->pl_cur_idx = player->cur_idx;
+	pos->pl_pause_done = player->pause_done;
+	pos->pl_loop_cnt = player->loop_cnt;
+	pos->pl_sig = player->sig;
+	pos->pl_next_block = tape_deck_block_idx(deck, player->next_block);
+	pos->pl_tgen = player->tgen;
+
+	pos->smp_cur_lvl = sampler->cur_lvl;
+	pos->smp_next_delay = sampler->next_delay;
+	pos->smp_next_lvl = sampler->next_lvl;
+}
+
+/** Check that a tape deck position fits the tape.
+ *
+ * @param deck Tape deck
+ * @param pos Position previously obtained with tape_deck_get_pos()
+ * @return Zero if @a pos can be restored, EINVAL if it does not fit
+ *         the tape
+ */
+int tape_deck_check_pos(tape_deck_t *deck, const tape_deck_pos_t *pos)
+{
+	tape_block_t *block;
+	int rc;
+
+	rc = tape_deck_block_at(deck, pos->cur_block, &block);
+	if (rc != 0)
+		return rc;
+
+	rc = tape_deck_block_at(deck, pos->pl_cur_block, &block);
+	if (rc != 0)
+		return rc;
+
+	return tape_deck_block_at(deck, pos->pl_next_block, &block);
+}
+
+/** Restore tape deck position and playback state.
+ *
+ * @param deck Tape deck
+ * @param pos Position previously obtained with tape_deck_get_pos()
+ *            for the same tape
+ * @return Zero on success, EINVAL if @a pos does not fit the tape
+ *         (the deck is not changed then)
+ */
+int tape_deck_set_pos(tape_deck_t *deck, const tape_deck_pos_t *pos)
+{
+	tape_player_t *player = deck->player;
+	tape_sampler_t *sampler = deck->sampler;
+	tape_block_t *cur_block;
+	tape_block_t *pl_cur_block;
+	tape_block_t *pl_next_block;
+	int rc;
+
+	rc = tape_deck_check_pos(deck, pos);
+	if (rc != 0)
+		return rc;
+
+	(void) tape_deck_block_at(deck, pos->cur_block, &cur_block);
+	(void) tape_deck_block_at(deck, pos->pl_cur_block, &pl_cur_block);
+	(void) tape_deck_block_at(deck, pos->pl_next_block, &pl_next_block);
+
+	deck->cur_block = cur_block;
+	deck->playing = pos->playing;
+	deck->paused = pos->paused;
+	deck->cur_smp = pos->cur_smp;
+	deck->mode48k = pos->mode48k;
+
+	player->cur_block = pl_cur_block;
+	player->cur_idx = pos->pl_cur_idx;
+	player->pause_done = pos->pl_pause_done;
+	player->loop_cnt = pos->pl_loop_cnt;
+	player->sig = pos->pl_sig;
+	player->next_block = pl_next_block;
+	player->tgen = pos->pl_tgen;
+
+	sampler->cur_lvl = pos->smp_cur_lvl;
+	sampler->next_delay = pos->smp_next_delay;
+	sampler->next_lvl = pos->smp_next_lvl;
+
+	tape_deck_state_change(deck);
+	return 0;
+}
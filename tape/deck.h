@@ -44,6 +44,7 @@ extern int tape_deck_create(tape_deck_t **, uint32_t, bool);
 extern void tape_deck_destroy(tape_deck_t *);
 
 extern int tape_deck_new(tape_deck_t *);
+extern bool tape_deck_is_tape_file(const char *);
 extern int tape_deck_open(tape_deck_t *, const char *);
 extern int tape_deck_save(tape_deck_t *);
 extern int tape_deck_save_as(tape_deck_t *, const char *);
@@ -56,7 +57,11 @@ extern void tape_deck_next(tape_deck_t *);
 
 extern void tape_deck_set_48k(tape_deck_t *, bool);
 extern bool tape_deck_is_playing(tape_deck_t *);
+extern bool tape_deck_is_paused(tape_deck_t *);
 extern void tape_deck_getsmp(tape_deck_t *, uint8_t *smp);
 extern tape_block_t *tape_deck_cur_block(tape_deck_t *);
+extern void tape_deck_get_pos(tape_deck_t *, tape_deck_pos_t *);
+extern int tape_deck_check_pos(tape_deck_t *, const tape_deck_pos_t *);
+extern int tape_deck_set_pos(tape_deck_t *, const tape_deck_pos_t *);
 
 #endif
@@ -34,9 +34,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "../gzx.h"
 #include "../memio.h"
 #include "../z80.h"
+#include "../zx.h"
 #include "deck.h"
 #include "defs.h"
 #include "quick.h"
@@ -47,10 +47,12 @@
  * Emulate (most of) the ROM LD-BYTES routine using a virtual tape deck.
  * This can only load a standard speed data block.
  *
- * @param deck Source tape deck
+ * @param zx Machine (loads from its tape deck)
  */
-void tape_quick_ldbytes(tape_deck_t *deck)
+void tape_quick_ldbytes(zx_machine_t *zx)
 {
+	tape_deck_t *deck = zx->tape_deck;
+	z80s *cpus = &zx->cpu.cpus;
 	bool verify;
 	uint8_t req_flag;
 	uint16_t toload, addr;
@@ -78,12 +80,13 @@ void tape_quick_ldbytes(tape_deck_t *deck)
 
 	assert(tblock->btype == tb_data);
 	data = (tblock_data_t *)tblock->ext;
+	z80_sync_flags(cpus);
 
 	fprintf(logfi, "...\n");
-	req_flag = cpus.r_[rA];
-	toload = ((uint16_t)cpus.r[rD] << 8) | (uint16_t)cpus.r[rE];
-	addr = cpus.IX;
-	verify = (cpus.F_ & fC) == 0;
+	req_flag = cpus->r_[rA];
+	toload = ((uint16_t)cpus->r[rD] << 8) | (uint16_t)cpus->r[rE];
+	addr = cpus->IX;
+	verify = (cpus->F_ & fC) == 0;
 
 	if (data->data_len < 1) {
 		printf("Data block too short.\n");
@@ -96,7 +99,7 @@ void tape_quick_ldbytes(tape_deck_t *deck)
 	    toload, req_flag, addr, verify);
 	fprintf(logfi, "block len %u, block flag:0x%02x\n", data->data_len,
 	    flag);
-	fprintf(logfi, "z80 F:%02x\n", cpus.F_);
+	fprintf(logfi, "z80 F:%02x\n", cpus->F_);
 
 	if (flag != req_flag)
 		goto error;
@@ -115,7 +118,7 @@ void tape_quick_ldbytes(tape_deck_t *deck)
 
 		b = data->data[1 + u];
 		if (!verify)
-			zx_memset8(addr + u, b);
+			zx_memset8(zx, addr + u, b);
 		x ^= b;
 	}
 
@@ -132,19 +135,19 @@ void tape_quick_ldbytes(tape_deck_t *deck)
 		goto error;
 	}
 
-	cpus.F |= fC;
+	cpus->F |= fC;
 	fprintf(logfi, "load ok\n");
 	goto common;
 error:
-	cpus.F &= ~fC;
+	cpus->F &= ~fC;
 	fprintf(logfi, "load error\n");
 common:
 	tape_deck_next(deck);
 
 	/* RET */
 	fprintf(logfi, "returning\n");
-	cpus.PC = zx_memget16(cpus.SP);
-	cpus.SP += 2;
+	cpus->PC = zx_memget16(zx, cpus->SP);
+	cpus->SP += 2;
 }
 
 /** Quick save.
@@ -152,10 +155,12 @@ common:
  * Emulate (most of) the ROM SA-BYTES routine using a virtual tape deck.
  * This produces a standard speed data block.
  *
- * @param deck Destination tape deck
+ * @param zx Machine (saves to its tape deck)
  */
-void tape_quick_sabytes(tape_deck_t *deck)
+void tape_quick_sabytes(zx_machine_t *zx)
 {
+	tape_deck_t *deck = zx->tape_deck;
+	z80s *cpus = &zx->cpu.cpus;
 	uint8_t flag;
 	uint16_t tosave;
 	uint16_t addr;
@@ -173,9 +178,9 @@ void tape_quick_sabytes(tape_deck_t *deck)
 		goto done;
 	}
 
-	flag = cpus.r_[rA];
-	tosave = ((uint16_t)cpus.r[rD] << 8) | (uint16_t)cpus.r[rE];
-	addr = cpus.IX;
+	flag = cpus->r_[rA];
+	tosave = ((uint16_t)cpus->r[rD] << 8) | (uint16_t)cpus->r[rE];
+	addr = cpus->IX;
 
 	data->data_len = (size_t)tosave + 2;
 	data->data = malloc(data->data_len);
@@ -197,7 +202,7 @@ void tape_quick_sabytes(tape_deck_t *deck)
 	fprintf(logfi, "writing\n");
 	x = flag;
 	for (u = 0; u < tosave; u++) {
-		b = zx_memget8(addr + u);
+		b = zx_memget8(zx, addr + u);
 		data->data[1 + u] = b;
 		x ^= b;
 	}
@@ -206,13 +211,14 @@ void tape_quick_sabytes(tape_deck_t *deck)
 	data->data[1 + (size_t)tosave] = x;
 
 done:
-	cpus.F = error ? (cpus.F & (~fC)) : (cpus.F | fC);
+	z80_sync_flags(cpus);
+	cpus->F = error ? (cpus->F & (~fC)) : (cpus->F | fC);
 	if (!error)
 		fprintf(logfi, "write ok\n");
 
 	/* RET */
-	cpus.PC = zx_memget16(cpus.SP);
-	cpus.SP += 2;
+	cpus->PC = zx_memget16(zx, cpus->SP);
+	cpus->SP += 2;
 
 	if (data != NULL) {
 		data->pause_after = ROM_PAUSE_LEN_MS;
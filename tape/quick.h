@@ -35,9 +35,9 @@
 #define TAPE_LDBYTES_TRAP 0x056a
 #define TAPE_SABYTES_TRAP 0x04d1
 
-#include "../types/tape/deck.h"
+#include "../types/zx.h"
 
-extern void tape_quick_ldbytes(tape_deck_t *);
-extern void tape_quick_sabytes(tape_deck_t *);
+extern void tape_quick_ldbytes(zx_machine_t *);
+extern void tape_quick_sabytes(zx_machine_t *);
 
 #endif
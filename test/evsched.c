@@ -0,0 +1,289 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Event scheduler unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Event scheduler unit tests.
+ */
+
+#include <stdio.h>
+#include "../evsched.h"
+#include "evsched.h"
+
+enum {
+	test_nev = 8
+};
+
+/** Test event */
+typedef struct {
+	/** Scheduler event */
+	evsched_event_t ev;
+	/** Event number */
+	int id;
+	/** Reschedule to this clock value when handled (zero for never) */
+	unsigned long again;
+} test_ev_t;
+
+/** Scheduler under test */
+static evsched_t test_sched;
+/** Numbers of handled events in the order they were handled */
+static int test_log[2 * test_nev];
+/** Number of entries in test_log */
+static int test_nlog;
+
+/** Test event handler.
+ *
+ * @param arg Test event (test_ev_t *)
+ */
+static void test_ev_handler(void *arg)
+{
+	test_ev_t *tev = (test_ev_t *)arg;
+
+	if (test_nlog < 2 * test_nev)
+		test_log[test_nlog++] = tev->id;
+
+	if (tev->again != 0) {
+		evsched_at(&test_sched, &tev->ev, tev->again);
+		tev->again = 0;
+	}
+}
+
+/** Initialize scheduler and test events.
+ *
+ * @param tevs Array of test_nev test events
+ */
+static void test_evsched_setup(test_ev_t *tevs)
+{
+	int i;
+
+	evsched_init(&test_sched);
+	for (i = 0; i < test_nev; i++) {
+		evsched_event_init(&tevs[i].ev, test_ev_handler, &tevs[i]);
+		tevs[i].id = i;
+		tevs[i].again = 0;
+	}
+
+	test_nlog = 0;
+}
+
+/** Check handled events.
+ *
+ * @param ids Expected event numbers in expected order
+ * @param n Number of entries in @a ids
+ * @return Zero on success, non-zero on failure
+ */
+static int test_evsched_check_log(const int *ids, int n)
+{
+	int i;
+
+	if (test_nlog != n) {
+		printf("Incorrect number of handled events %d != %d.\n",
+		    test_nlog, n);
+		return 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (test_log[i] != ids[i]) {
+			printf("Incorrect event %d != %d at position %d.\n",
+			    test_log[i], ids[i], i);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/** Test that events are handled in order of their due time.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_evsched_order(void)
+{
+	test_ev_t tevs[test_nev];
+	unsigned long clocks[test_nev] = { 50, 10, 80, 30, 70, 20, 60, 40 };
+	int first[] = { 1, 5, 3, 7 };
+	int rest[] = { 0, 6, 4, 2 };
+	int i;
+
+	printf("Test event scheduler ordering...\n");
+
+	test_evsched_setup(tevs);
+	for (i = 0; i < test_nev; i++)
+		evsched_at(&test_sched, &tevs[i].ev, clocks[i]);
+
+	if (evsched_next(&test_sched, 0) != 10) {
+		printf("Incorrect next event clock %lu != 10.\n",
+		    evsched_next(&test_sched, 0));
+		return 1;
+	}
+
+	/* Only events that are due are handled */
+	evsched_dispatch(&test_sched, 40);
+	if (test_evsched_check_log(first, 4) != 0)
+		return 1;
+
+	if (evsched_next(&test_sched, 0) != 50) {
+		printf("Incorrect next event clock %lu != 50.\n",
+		    evsched_next(&test_sched, 0));
+		return 1;
+	}
+
+	test_nlog = 0;
+	evsched_dispatch(&test_sched, 100);
+	if (test_evsched_check_log(rest, 4) != 0)
+		return 1;
+
+	if (evsched_next(&test_sched, 1234) != 1234) {
+		printf("Events left after dispatch.\n");
+		return 1;
+	}
+
+	printf(" ... passed\n");
+
+	return 0;
+}
+
+/** Test cancelling events.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_evsched_cancel(void)
+{
+	test_ev_t tevs[test_nev];
+	int ids[] = { 1, 2, 4, 6, 7 };
+	int i;
+
+	printf("Test event scheduler cancel...\n");
+
+	test_evsched_setup(tevs);
+	for (i = 0; i < test_nev; i++)
+		evsched_at(&test_sched, &tevs[i].ev, 10 * (i + 1));
+
+	/* Cancel first, middle and last event */
+	evsched_cancel(&test_sched, &tevs[0].ev);
+	evsched_cancel(&test_sched, &tevs[3].ev);
+	evsched_cancel(&test_sched, &tevs[5].ev);
+
+	/* Cancelling an event that is not scheduled does nothing */
+	evsched_cancel(&test_sched, &tevs[3].ev);
+
+	if (evsched_is_scheduled(&tevs[3].ev) ||
+	    !evsched_is_scheduled(&tevs[4].ev)) {
+		printf("Incorrect scheduled state.\n");
+		return 1;
+	}
+
+	if (evsched_next(&test_sched, 0) != 20) {
+		printf("Incorrect next event clock %lu != 20.\n",
+		    evsched_next(&test_sched, 0));
+		return 1;
+	}
+
+	evsched_dispatch(&test_sched, 100);
+	if (test_evsched_check_log(ids, 5) != 0)
+		return 1;
+
+	for (i = 0; i < test_nev; i++) {
+		if (evsched_is_scheduled(&tevs[i].ev)) {
+			printf("Event %d scheduled after dispatch.\n", i);
+			return 1;
+		}
+	}
+
+	printf(" ... passed\n");
+
+	return 0;
+}
+
+/** Test rescheduling events.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_evsched_resched(void)
+{
+	test_ev_t tevs[test_nev];
+	int ids[] = { 2, 1, 0, 0, 3, 1 };
+	int i;
+
+	printf("Test event scheduler reschedule...\n");
+
+	test_evsched_setup(tevs);
+	for (i = 0; i < 4; i++)
+		evsched_at(&test_sched, &tevs[i].ev, 10 * (i + 1));
+
+	/* Move scheduled events later and earlier */
+	evsched_at(&test_sched, &tevs[0].ev, 25);
+	evsched_at(&test_sched, &tevs[2].ev, 5);
+
+	/* Handlers reschedule their events, due ones are handled now */
+	tevs[0].again = 35;
+	tevs[1].again = 200;
+
+	evsched_dispatch(&test_sched, 40);
+	if (test_evsched_check_log(ids, 5) != 0)
+		return 1;
+
+	if (!evsched_is_scheduled(&tevs[1].ev) ||
+	    evsched_next(&test_sched, 0) != 200) {
+		printf("Rescheduled event not pending.\n");
+		return 1;
+	}
+
+	evsched_dispatch(&test_sched, 200);
+	if (test_evsched_check_log(ids, 6) != 0)
+		return 1;
+
+	printf(" ... passed\n");
+
+	return 0;
+}
+
+/** Run event scheduler unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_evsched(void)
+{
+	int rc;
+
+	rc = test_evsched_order();
+	if (rc != 0)
+		return 1;
+
+	rc = test_evsched_cancel();
+	if (rc != 0)
+		return 1;
+
+	rc = test_evsched_resched();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
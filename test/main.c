@@ -34,16 +34,47 @@
  */
 
 #include <stdio.h>
+#include "evsched.h"
+#include "pgshare.h"
+#include "rewind.h"
+#include "romtrap.h"
+#include "runahead.h"
+#include "state.h"
 #include "tape/player.h"
 #include "tape/tonegen.h"
 #include "tape/tap.h"
 #include "tape/tzx.h"
 #include "tape/wav.h"
+#include "z80.h"
 
 int main(void)
 {
 	int rc;
 
+	rc = test_evsched();
+	if (rc != 0)
+		goto error;
+
+	rc = test_pgshare();
+	if (rc != 0)
+		goto error;
+
+	rc = test_rewind();
+	if (rc != 0)
+		goto error;
+
+	rc = test_romtrap();
+	if (rc != 0)
+		goto error;
+
+	rc = test_runahead();
+	if (rc != 0)
+		goto error;
+
+	rc = test_state();
+	if (rc != 0)
+		goto error;
+
 	rc = test_tape_player();
 	if (rc != 0)
 		goto error;
@@ -64,6 +95,10 @@ int main(void)
 	if (rc != 0)
 		goto error;
 
+	rc = test_z80();
+	if (rc != 0)
+		goto error;
+
 	printf("All tests passed.\n");
 
 	return 0;
@@ -0,0 +1,293 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Shared page unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Shared page unit tests.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../pgshare.h"
+#include "pgshare.h"
+
+enum {
+	/** Page size for testing */
+	test_pg_size = 1024,
+	/** Number of pages for testing hash table growth */
+	test_npages = 2000
+};
+
+/** Fill page buffer with a pattern.
+ *
+ * @param buf Buffer (test_pg_size bytes)
+ * @param seed Pattern seed
+ */
+static void test_pgshare_fill(uint8_t *buf, unsigned seed)
+{
+	size_t i;
+
+	for (i = 0; i < test_pg_size; i++)
+		buf[i] = (uint8_t)(seed * 31 + i);
+
+	/* Make pages with different seeds differ */
+	memcpy(buf, &seed, sizeof(seed));
+}
+
+/** Test that identical pages are stored once and counted.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_pgshare_dedup(void)
+{
+	pgshare_t *pgs;
+	pgshare_page_t *p1, *p2, *p3;
+	uint8_t buf[test_pg_size];
+	int rc = 1;
+
+	printf("Test shared page deduplication and reference counting...\n");
+
+	if (pgshare_create(test_pg_size, &pgs) != 0) {
+		printf("Error creating page store.\n");
+		return 1;
+	}
+
+	test_pgshare_fill(buf, 1);
+	if (pgshare_get(pgs, buf, &p1) != 0 ||
+	    pgshare_get(pgs, buf, &p2) != 0) {
+		printf("Error getting page.\n");
+		goto out;
+	}
+
+	if (p1 != p2 || p1->refcnt != 2 || pgs->npages != 1) {
+		printf("Identical pages not shared.\n");
+		goto out;
+	}
+
+	test_pgshare_fill(buf, 2);
+	if (pgshare_get(pgs, buf, &p3) != 0) {
+		printf("Error getting page.\n");
+		goto out;
+	}
+
+	if (p3 == p1 || p3->refcnt != 1 || pgs->npages != 2 ||
+	    memcmp(p3->data, buf, test_pg_size) != 0) {
+		printf("Different page not stored separately.\n");
+		goto out;
+	}
+
+	pgshare_ref(p1);
+	if (p1->refcnt != 3) {
+		printf("Incorrect reference count %lu != 3.\n", p1->refcnt);
+		goto out;
+	}
+
+	pgshare_release(pgs, p1);
+	pgshare_release(pgs, p1);
+	if (p1->refcnt != 1 || pgs->npages != 2) {
+		printf("Page freed while referenced.\n");
+		goto out;
+	}
+
+	pgshare_release(pgs, p1);
+	pgshare_release(pgs, p3);
+	if (pgs->npages != 0) {
+		printf("Unreferenced pages not freed (%zu left).\n",
+		    pgs->npages);
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	pgshare_destroy(pgs);
+	return rc;
+}
+
+/** Test modifying a shared page copy-on-write.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_pgshare_cow(void)
+{
+	pgshare_t *pgs;
+	pgshare_page_t *pa, *pb, *pn, *po;
+	uint8_t orig[test_pg_size];
+	uint8_t buf[test_pg_size];
+	int rc = 1;
+
+	printf("Test shared page copy-on-write...\n");
+
+	if (pgshare_create(test_pg_size, &pgs) != 0) {
+		printf("Error creating page store.\n");
+		return 1;
+	}
+
+	/* Owners A and B share a page */
+	test_pgshare_fill(orig, 3);
+	if (pgshare_get(pgs, orig, &pa) != 0) {
+		printf("Error getting page.\n");
+		goto out;
+	}
+
+	pgshare_ref(pa);
+	pb = pa;
+
+	/* A writes a byte: gets a page with new contents, drops the old */
+	memcpy(buf, pa->data, test_pg_size);
+	buf[100] ^= 0xff;
+	if (pgshare_get(pgs, buf, &pn) != 0) {
+		printf("Error getting page.\n");
+		goto out;
+	}
+
+	pgshare_release(pgs, pa);
+	pa = pn;
+
+	if (pa == pb || memcmp(pb->data, orig, test_pg_size) != 0 ||
+	    memcmp(pa->data, buf, test_pg_size) != 0) {
+		printf("Write to shared page visible to other owner.\n");
+		goto out;
+	}
+
+	if (pa->refcnt != 1 || pb->refcnt != 1 || pgs->npages != 2) {
+		printf("Incorrect reference counts after copy.\n");
+		goto out;
+	}
+
+	/* A writes the byte back: shares the page with B again */
+	if (pgshare_get(pgs, orig, &po) != 0) {
+		printf("Error getting page.\n");
+		goto out;
+	}
+
+	pgshare_release(pgs, pa);
+	pa = po;
+
+	if (pa != pb || pb->refcnt != 2 || pgs->npages != 1) {
+		printf("Restored page not shared again.\n");
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	pgshare_destroy(pgs);
+	return rc;
+}
+
+/** Test finding pages after the hash table has grown.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_pgshare_grow(void)
+{
+	pgshare_t *pgs;
+	static pgshare_page_t *pages[test_npages];
+	pgshare_page_t *pg;
+	uint8_t buf[test_pg_size];
+	unsigned i;
+	int rc = 1;
+
+	printf("Test shared page store growth...\n");
+
+	if (pgshare_create(test_pg_size, &pgs) != 0) {
+		printf("Error creating page store.\n");
+		return 1;
+	}
+
+	for (i = 0; i < test_npages; i++) {
+		test_pgshare_fill(buf, i);
+		if (pgshare_get(pgs, buf, &pages[i]) != 0) {
+			printf("Error getting page.\n");
+			goto out;
+		}
+	}
+
+	if (pgs->npages != test_npages) {
+		printf("Incorrect number of pages %zu != %d.\n", pgs->npages,
+		    test_npages);
+		goto out;
+	}
+
+	for (i = 0; i < test_npages; i++) {
+		test_pgshare_fill(buf, i);
+		if (pgshare_get(pgs, buf, &pg) != 0) {
+			printf("Error getting page.\n");
+			goto out;
+		}
+
+		if (pg != pages[i]) {
+			printf("Page %u not found after growth.\n", i);
+			goto out;
+		}
+
+		pgshare_release(pgs, pg);
+	}
+
+	for (i = 0; i < test_npages; i++)
+		pgshare_release(pgs, pages[i]);
+
+	if (pgs->npages != 0) {
+		printf("Unreferenced pages not freed (%zu left).\n",
+		    pgs->npages);
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	pgshare_destroy(pgs);
+	return rc;
+}
+
+/** Run shared page unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_pgshare(void)
+{
+	int rc;
+
+	rc = test_pgshare_dedup();
+	if (rc != 0)
+		return 1;
+
+	rc = test_pgshare_cow();
+	if (rc != 0)
+		return 1;
+
+	rc = test_pgshare_grow();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Rewind buffer unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Rewind buffer unit tests.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../memio.h"
+#include "../rewind.h"
+#include "../state.h"
+#include "../zx.h"
+#include "rewind.h"
+#include "zx.h"
+
+enum {
+	/** Number of fields between snapshots */
+	test_interval = 25,
+	/** Number of snapshots */
+	test_nsnaps = 5,
+	/** Fields run after the last snapshot (enough to return to it) */
+	test_extra = 15
+};
+
+/** Run one field, modifying RAM on the way.
+ *
+ * @param zx Machine
+ * @param field Field number
+ */
+static void test_rewind_run(zx_machine_t *zx, unsigned field)
+{
+	zx_run_field(zx);
+
+	/* Scatter writes over RAM in addition to those of the ROM */
+	zx_memset8(zx, 0x6000 + (field * 517) % 0xa000, (uint8_t)field);
+}
+
+/** Compare machine state with saved state.
+ *
+ * @param zx Machine
+ * @param st Saved state
+ * @param size Size of saved state
+ * @return Zero if equal, non-zero otherwise
+ */
+static int test_rewind_compare(zx_machine_t *zx, const uint8_t *st,
+    size_t size)
+{
+	uint8_t *cur;
+	int rc;
+
+	cur = calloc(1, size);
+	if (cur == NULL) {
+		printf("Out of memory.\n");
+		return 1;
+	}
+
+	rc = 1;
+	if (zx_state_size(zx) == size && zx_state_save(zx, cur, size) == 0 &&
+	    memcmp(cur, st, size) == 0)
+		rc = 0;
+
+	free(cur);
+	return rc;
+}
+
+/** Test going back through snapshots rebuilt from undo records.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_rewind_undo(void)
+{
+	zx_machine_t *zx;
+	rewind_t *rew = NULL;
+	uint8_t *snaps[test_nsnaps];
+	size_t size;
+	unsigned field;
+	int n;
+	int i;
+	int rc = 1;
+
+	printf("Test rewind buffer undo records...\n");
+
+	for (i = 0; i < test_nsnaps; i++)
+		snaps[i] = NULL;
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	zx_reset(zx);
+
+	if (rewind_create(zx, 16 * 1024 * 1024, test_interval, &rew) != 0) {
+		printf("Error creating rewind buffer.\n");
+		return 1;
+	}
+
+	/* Keep a full copy of the machine state at each snapshot */
+	size = zx_state_size(zx);
+	n = 0;
+	field = 0;
+	while (n < test_nsnaps) {
+		test_rewind_run(zx, field++);
+		rewind_field(rew);
+		if (rew->fields != 0)
+			continue;
+
+		snaps[n] = calloc(1, size);
+		if (snaps[n] == NULL ||
+		    zx_state_save(zx, snaps[n], size) != 0) {
+			printf("Error saving state.\n");
+			goto out;
+		}
+
+		++n;
+	}
+
+	for (i = 0; i < test_extra; i++) {
+		test_rewind_run(zx, field++);
+		rewind_field(rew);
+	}
+
+	/* Back to the newest snapshot, then to each one before it */
+	for (i = test_nsnaps - 1; i >= 0; i--) {
+		if (rewind_back(rew) != 0) {
+			printf("Error going back to snapshot %d.\n", i);
+			goto out;
+		}
+
+		if (test_rewind_compare(zx, snaps[i], size) != 0) {
+			printf("Incorrect state after going back to snapshot "
+			    "%d.\n", i);
+			goto out;
+		}
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	for (i = 0; i < test_nsnaps; i++)
+		free(snaps[i]);
+	rewind_destroy(rew);
+	return rc;
+}
+
+/** Test that old snapshots are dropped to stay within budget.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_rewind_budget(void)
+{
+	zx_machine_t *zx;
+	rewind_t *rew;
+	size_t budget;
+	unsigned field;
+
+	printf("Test rewind buffer memory budget...\n");
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	/* Enough for one full snapshot and a few undo records */
+	budget = zx_state_size(zx) * 2;
+	if (rewind_create(zx, budget, 1, &rew) != 0) {
+		printf("Error creating rewind buffer.\n");
+		return 1;
+	}
+
+	for (field = 0; field < 200; field++) {
+		test_rewind_run(zx, field);
+		rewind_field(rew);
+		if (rew->used > budget) {
+			printf("Budget exceeded, %zu > %zu.\n", rew->used,
+			    budget);
+			rewind_destroy(rew);
+			return 1;
+		}
+	}
+
+	if (rewind_back(rew) != 0) {
+		printf("Error going back.\n");
+		rewind_destroy(rew);
+		return 1;
+	}
+
+	rewind_destroy(rew);
+	printf(" ... passed\n");
+
+	return 0;
+}
+
+/** Run rewind buffer unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_rewind(void)
+{
+	int rc;
+
+	rc = test_rewind_undo();
+	if (rc != 0)
+		return 1;
+
+	rc = test_rewind_budget();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
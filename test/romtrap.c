@@ -0,0 +1,186 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * ROM trap unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file ROM trap unit tests.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include "../iospace.h"
+#include "../memio.h"
+#include "../romtrap.h"
+#include "romtrap.h"
+#include "zx.h"
+
+/** Trap address in ROM 0 and ROM 3 */
+#define TEST_ADDR_A 0x0100
+/** Trap address in ROM 1 */
+#define TEST_ADDR_B 0x0200
+
+/** ROM bank of the last trap handled or -1 */
+static int test_trap_bank;
+
+/** Test trap handler.
+ *
+ * @param arg ROM bank of the trap (int *)
+ */
+static void test_trap_handler(void *arg)
+{
+	test_trap_bank = *(int *)arg;
+}
+
+/** Check trap processing at address.
+ *
+ * @param zx Machine
+ * @param addr Address
+ * @param bank Expected ROM bank of the trap or -1 if there should be
+ *             no trap at @a addr
+ * @return Zero on success, non-zero on failure
+ */
+static int test_romtrap_check(zx_machine_t *zx, uint16_t addr, int bank)
+{
+	test_trap_bank = -1;
+
+	if (romtrap_at(zx, addr) != (bank >= 0)) {
+		printf("Incorrect trap presence at 0x%04x.\n", addr);
+		return 1;
+	}
+
+	if (romtrap_proc(zx, addr) != (bank >= 0)) {
+		printf("Incorrect trap processing at 0x%04x.\n", addr);
+		return 1;
+	}
+
+	if (test_trap_bank != bank) {
+		printf("Incorrect trap at 0x%04x handled, bank %d != %d.\n",
+		    addr, test_trap_bank, bank);
+		return 1;
+	}
+
+	return 0;
+}
+
+/** Test that traps only fire in the ROM bank they were set in.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_romtrap_banks(void)
+{
+	zx_machine_t *zx;
+	static int banks[] = { 0, 1, 3 };
+
+	printf("Test ROM trap bank selection...\n");
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	/* Four ROM banks */
+	if (zx_select_memmodel(zx, ZXM_PLUS3) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	if (romtrap_reset(zx, zx->mem.rom_size) != 0) {
+		printf("Error resetting ROM traps.\n");
+		return 1;
+	}
+
+	if (romtrap_add(zx, 0, TEST_ADDR_A, test_trap_handler,
+	    &banks[0]) != 0 ||
+	    romtrap_add(zx, 1, TEST_ADDR_B, test_trap_handler,
+	    &banks[1]) != 0 ||
+	    romtrap_add(zx, 3, TEST_ADDR_A, test_trap_handler,
+	    &banks[2]) != 0) {
+		printf("Error adding ROM trap.\n");
+		return 1;
+	}
+
+	/* Traps outside of the ROM image */
+	if (romtrap_add(zx, 4, TEST_ADDR_A, test_trap_handler,
+	    NULL) != EINVAL ||
+	    romtrap_add(zx, 0, 0x4000, test_trap_handler, NULL) != EINVAL) {
+		printf("Trap outside of ROM accepted.\n");
+		return 1;
+	}
+
+	/* ROM 0 */
+	zx_mem_page_select(zx, ZXPLUS_EPG_PORT, 0x00);
+	zx_mem_page_select(zx, ZXPLUS_PAGESEL_PORT, 0x00);
+	if (test_romtrap_check(zx, TEST_ADDR_A, 0) != 0 ||
+	    test_romtrap_check(zx, TEST_ADDR_B, -1) != 0)
+		return 1;
+
+	/* ROM 1 */
+	zx_mem_page_select(zx, ZXPLUS_PAGESEL_PORT, 0x10);
+	if (test_romtrap_check(zx, TEST_ADDR_A, -1) != 0 ||
+	    test_romtrap_check(zx, TEST_ADDR_B, 1) != 0)
+		return 1;
+
+	/* ROM 3 */
+	zx_mem_page_select(zx, ZXPLUS_EPG_PORT, 0x04);
+	if (test_romtrap_check(zx, TEST_ADDR_A, 3) != 0 ||
+	    test_romtrap_check(zx, TEST_ADDR_B, -1) != 0)
+		return 1;
+
+	/* RAM at the same offset in the address space */
+	if (test_romtrap_check(zx, 0x4000 + TEST_ADDR_A, -1) != 0)
+		return 1;
+
+	/* All-RAM mode, no ROM paged in */
+	zx_mem_page_select(zx, ZXPLUS_EPG_PORT, 0x01);
+	if (test_romtrap_check(zx, TEST_ADDR_A, -1) != 0)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	printf(" ... passed\n");
+
+	return 0;
+}
+
+/** Run ROM trap unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_romtrap(void)
+{
+	int rc;
+
+	rc = test_romtrap_banks();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Run-ahead unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Run-ahead unit tests.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../memio.h"
+#include "../runahead.h"
+#include "../tape/deck.h"
+#include "../tape/quick.h"
+#include "../tape/tape.h"
+#include "../zx.h"
+#include "runahead.h"
+#include "zx.h"
+
+/** Address of the data block to save */
+#define TEST_RA_DATA 0x8000
+/** Length of the data block to save */
+#define TEST_RA_LEN 16
+/** Return address of SA-BYTES (an endless loop) */
+#define TEST_RA_RET 0x8100
+/** Stack pointer */
+#define TEST_RA_SP 0xff00
+/** Number of fields to run */
+#define TEST_RA_FIELDS 10
+
+/** Count blocks on the tape.
+ *
+ * @param zx Machine
+ * @return Number of blocks
+ */
+static unsigned test_runahead_nblocks(zx_machine_t *zx)
+{
+	tape_block_t *block;
+	unsigned n;
+
+	n = 0;
+	block = tape_first(zx->tape_deck->tape);
+	while (block != NULL) {
+		++n;
+		block = tape_next(block);
+	}
+
+	return n;
+}
+
+/** Test that saving to tape while running ahead saves a single block.
+ *
+ * The CPU is put at the SA-BYTES ROM trap, with the registers set up
+ * to save a data block, and the machine is run with run-ahead enabled.
+ * Only the canonical timeline may save the block.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_runahead_save(void)
+{
+	zx_machine_t *zx;
+	unsigned i;
+	int rc;
+
+	printf("Test quick save while running ahead...\n");
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	zx_reset(zx);
+
+	rc = tape_deck_new(zx->tape_deck);
+	if (rc != 0) {
+		printf("Error creating tape.\n");
+		return 1;
+	}
+
+	for (i = 0; i < TEST_RA_LEN; i++)
+		zx_memset8(zx, TEST_RA_DATA + i, i);
+
+	/* JR $ */
+	zx_memset8(zx, TEST_RA_RET, 0x18);
+	zx_memset8(zx, TEST_RA_RET + 1, 0xfe);
+	zx_memset16(zx, TEST_RA_SP, TEST_RA_RET);
+
+	zx->cpu.cpus.r_[rA] = 0xff;
+	zx->cpu.cpus.r[rD] = TEST_RA_LEN >> 8;
+	zx->cpu.cpus.r[rE] = TEST_RA_LEN & 0xff;
+	zx->cpu.cpus.IX = TEST_RA_DATA;
+	zx->cpu.cpus.SP = TEST_RA_SP;
+	zx->cpu.cpus.PC = TAPE_SABYTES_TRAP;
+
+	runahead = 2;
+	for (i = 0; i < TEST_RA_FIELDS; i++) {
+		rc = runahead_run(zx);
+		if (rc != 0) {
+			printf("Error running ahead.\n");
+			runahead = 0;
+			return 1;
+		}
+
+		if (test_runahead_nblocks(zx) != (i > 0 ? 1 : 0)) {
+			printf("Field %u: %u blocks on tape after running "
+			    "ahead.\n", i, test_runahead_nblocks(zx));
+			runahead = 0;
+			return 1;
+		}
+
+		zx_run_field(zx);
+	}
+
+	runahead = 0;
+
+	if (test_runahead_nblocks(zx) != 1) {
+		printf("%u blocks on tape instead of 1.\n",
+		    test_runahead_nblocks(zx));
+		return 1;
+	}
+
+	if (tape_deck_cur_block(zx->tape_deck) != NULL) {
+		printf("Tape not positioned after the saved block.\n");
+		return 1;
+	}
+
+	if (zx->cpu.cpus.PC != TEST_RA_RET) {
+		printf("SA-BYTES did not return (PC=0x%04x).\n",
+		    zx->cpu.cpus.PC);
+		return 1;
+	}
+
+	printf(" ... passed\n");
+
+	return 0;
+}
+
+/** Run run-ahead unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_runahead(void)
+{
+	int rc;
+
+	rc = test_runahead_save();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,554 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Machine state unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Machine state unit tests.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../memio.h"
+#include "../state.h"
+#include "../zx.h"
+#include "state.h"
+#include "zx.h"
+
+/** Number of fields to run before saving state */
+#define TEST_STATE_FIELDS 60
+
+/** Offsets of state header fields (see zx_state_hdr_t) */
+enum {
+	test_hdr_magic = 0,
+	test_hdr_version = 4,
+	test_hdr_size = 8,
+	test_hdr_mem_model = 12,
+	test_hdr_ram_size = 16
+};
+
+/** Run machine.
+ *
+ * @param zx Machine
+ * @param n Number of fields to run
+ */
+static void test_state_run(zx_machine_t *zx, int n)
+{
+	while (n-- > 0)
+		zx_run_field(zx);
+}
+
+/** Allocate and save machine state.
+ *
+ * @param zx Machine
+ * @param rsize Place to store size of state
+ * @return State or @c NULL on failure
+ */
+static uint8_t *test_state_save(zx_machine_t *zx, size_t *rsize)
+{
+	uint8_t *buf;
+
+	*rsize = zx_state_size(zx);
+	buf = calloc(1, *rsize);
+	if (buf == NULL) {
+		printf("Out of memory.\n");
+		return NULL;
+	}
+
+	if (zx_state_save(zx, buf, *rsize) != 0) {
+		printf("Error saving state.\n");
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/** Test that loading saved state continues exactly where it was saved.
+ *
+ * The state is saved on a 128K machine and loaded into a 48K machine.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_state_roundtrip(void)
+{
+	zx_machine_t *zx;
+	uint8_t *sa = NULL;
+	uint8_t *sb = NULL;
+	uint8_t *sc = NULL;
+	size_t size_a, size_b, size_c;
+	int rc = 1;
+
+	printf("Test machine state save and load...\n");
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_128K) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	zx_reset(zx);
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	sa = test_state_save(zx, &size_a);
+	if (sa == NULL)
+		goto out;
+
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	sb = test_state_save(zx, &size_b);
+	if (sb == NULL)
+		goto out;
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error selecting memory model.\n");
+		goto out;
+	}
+
+	zx_reset(zx);
+
+	if (zx_state_load(zx, sa, size_a) != 0) {
+		printf("Error loading state.\n");
+		goto out;
+	}
+
+	if (zx->mem.model != ZXM_128K) {
+		printf("Memory model not restored.\n");
+		goto out;
+	}
+
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	sc = test_state_save(zx, &size_c);
+	if (sc == NULL)
+		goto out;
+
+	if (size_b != size_c || memcmp(sb, sc, size_b) != 0) {
+		printf("Machine diverged after loading state.\n");
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	free(sa);
+	free(sb);
+	free(sc);
+	return rc;
+}
+
+/** Test loading corrupted state.
+ *
+ * @param zx Machine
+ * @param name Description of the corruption
+ * @param st Saved state
+ * @param size Size of saved state
+ * @param off Offset of 32-bit value to corrupt
+ * @param val Value to store at @a off
+ * @param lsize Size to pass to zx_state_load()
+ * @param err Expected error code
+ * @return Zero on success, non-zero on failure
+ */
+static int test_state_reject_one(zx_machine_t *zx, const char *name,
+    uint8_t *st, size_t size, size_t off, uint32_t val, size_t lsize, int err)
+{
+	uint8_t *sa;
+	uint8_t *sb = NULL;
+	uint32_t orig;
+	size_t size_a, size_b;
+	int model;
+	int rc = 1;
+
+	sa = test_state_save(zx, &size_a);
+	if (sa == NULL)
+		return 1;
+
+	model = zx->mem.model;
+
+	memcpy(&orig, st + off, sizeof(uint32_t));
+	memcpy(st + off, &val, sizeof(uint32_t));
+
+	if (zx_state_load(zx, st, lsize) != err) {
+		printf("State with %s not rejected.\n", name);
+		goto out;
+	}
+
+	if (zx->mem.model != model) {
+		printf("Memory model changed by state with %s.\n", name);
+		goto out;
+	}
+
+	sb = test_state_save(zx, &size_b);
+	if (sb == NULL)
+		goto out;
+
+	if (size_a != size_b || memcmp(sa, sb, size_a) != 0) {
+		printf("Machine changed by state with %s.\n", name);
+		goto out;
+	}
+
+	rc = 0;
+out:
+	memcpy(st + off, &orig, sizeof(uint32_t));
+	free(sa);
+	free(sb);
+	return rc;
+}
+
+/** Test that invalid state is rejected without changing the machine.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_state_reject(void)
+{
+	zx_machine_t *zx;
+	uint8_t *st;
+	size_t size;
+	uint32_t v;
+	int rc = 1;
+
+	printf("Test loading invalid machine state...\n");
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	/* Save 128K state, then move on to a different 48K machine */
+	if (zx_select_memmodel(zx, ZXM_128K) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	zx_reset(zx);
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	st = test_state_save(zx, &size);
+	if (st == NULL)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error selecting memory model.\n");
+		goto out;
+	}
+
+	zx_reset(zx);
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	memcpy(&v, st + test_hdr_magic, sizeof(uint32_t));
+	if (test_state_reject_one(zx, "bad magic", st, size, test_hdr_magic,
+	    v ^ 1, size, EINVAL) != 0)
+		goto out;
+
+	memcpy(&v, st + test_hdr_version, sizeof(uint32_t));
+	if (test_state_reject_one(zx, "bad version", st, size, test_hdr_version,
+	    v + 1, size, EINVAL) != 0)
+		goto out;
+
+	memcpy(&v, st + test_hdr_size, sizeof(uint32_t));
+	if (test_state_reject_one(zx, "bad structure size", st, size,
+	    test_hdr_size, v + 4, size, EINVAL) != 0)
+		goto out;
+
+	if (test_state_reject_one(zx, "unknown memory model", st, size,
+	    test_hdr_mem_model, 99, size, EINVAL) != 0)
+		goto out;
+
+	memcpy(&v, st + test_hdr_ram_size, sizeof(uint32_t));
+	if (test_state_reject_one(zx, "bad RAM size", st, size,
+	    test_hdr_ram_size, v / 2, size, EINVAL) != 0)
+		goto out;
+
+	/* Truncated buffers (the value written is the original one) */
+	memcpy(&v, st + test_hdr_magic, sizeof(uint32_t));
+	if (test_state_reject_one(zx, "truncated RAM", st, size, test_hdr_magic,
+	    v, size - 1, EINVAL) != 0)
+		goto out;
+
+	if (test_state_reject_one(zx, "truncated header", st, size,
+	    test_hdr_magic, v, zx_state_mach_size() - 1, EINVAL) != 0)
+		goto out;
+
+	/* Intact state is accepted */
+	if (zx_state_load(zx, st, size) != 0 || zx->mem.model != ZXM_128K) {
+		printf("Error loading valid state.\n");
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	free(st);
+	return rc;
+}
+
+/** Test loading state with a different memory model without ROM files.
+ *
+ * ROM images of memory models that have been used are kept in memory,
+ * so switching to them does not need the ROM files. Switching to a
+ * memory model whose ROM cannot be read fails without changing the
+ * machine.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_state_rom(void)
+{
+	zx_machine_t *zx;
+	uint8_t *st;
+	size_t size;
+	char *sdir;
+	int rc = 1;
+
+	printf("Test loading machine state without ROM files...\n");
+
+	if (test_zx_init(&zx) != 0)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_128K) < 0) {
+		printf("Error selecting memory model.\n");
+		return 1;
+	}
+
+	zx_reset(zx);
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	st = test_state_save(zx, &size);
+	if (st == NULL)
+		return 1;
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error selecting memory model.\n");
+		goto out;
+	}
+
+	zx_reset(zx);
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	/* Make ROM files unreachable */
+	sdir = start_dir;
+	start_dir = "nonexistent";
+
+	/* +2 has the same RAM size, but its ROM has not been loaded */
+	if (test_state_reject_one(zx, "unreadable ROM", st, size,
+	    test_hdr_mem_model, ZXM_PLUS2, size, EIO) != 0)
+		goto restore;
+
+	if (zx_state_load(zx, st, size) != 0 || zx->mem.model != ZXM_128K) {
+		printf("Error loading state with cached ROM.\n");
+		goto restore;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+restore:
+	start_dir = sdir;
+out:
+	free(st);
+	return rc;
+}
+
+/** Test that machines do not share state.
+ *
+ * Two new machines are run interleaved for the same number of fields and
+ * must end up in the same state. Writing to the memory of one of them
+ * must not change the other.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_state_machines(void)
+{
+	zx_machine_t *zx = NULL;
+	zx_machine_t *zx2 = NULL;
+	uint8_t *sa = NULL;
+	uint8_t *sb = NULL;
+	size_t size_a, size_b;
+	int i;
+	int rc = 1;
+
+	printf("Test independent machines...\n");
+
+	if (zx_create(false, false, &zx) < 0 ||
+	    zx_create(false, false, &zx2) < 0) {
+		printf("Error creating machine.\n");
+		goto out;
+	}
+
+	/* Interleave the machines */
+	for (i = 0; i < TEST_STATE_FIELDS; i++) {
+		test_state_run(zx, 1);
+		test_state_run(zx2, 1);
+	}
+
+	sa = test_state_save(zx, &size_a);
+	sb = test_state_save(zx2, &size_b);
+	if (sa == NULL || sb == NULL)
+		goto out;
+
+	if (size_a != size_b || memcmp(sa, sb, size_a) != 0) {
+		printf("Machines diverged.\n");
+		goto out;
+	}
+
+	zx_memset8(zx, 0x8000, zx_memget8(zx, 0x8000) ^ 0xff);
+	if (zx_memget8(zx2, 0x8000) == zx_memget8(zx, 0x8000)) {
+		printf("Write to one machine changed the other.\n");
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	free(sa);
+	free(sb);
+	if (zx != NULL)
+		zx_destroy(zx);
+	if (zx2 != NULL)
+		zx_destroy(zx2);
+	return rc;
+}
+
+/** Test cloning a machine.
+ *
+ * The clone must start in the same state, share the memory banks of
+ * the original until one of them writes and keep in step with it.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_state_clone(void)
+{
+	zx_machine_t *zx = NULL;
+	zx_machine_t *zx2 = NULL;
+	uint8_t *sa = NULL;
+	uint8_t *sb = NULL;
+	size_t size_a, size_b;
+	size_t nbanks;
+	uint8_t val;
+	int rc = 1;
+
+	printf("Test cloning machine...\n");
+
+	if (zx_create(false, false, &zx) < 0) {
+		printf("Error creating machine.\n");
+		goto out;
+	}
+
+	test_state_run(zx, TEST_STATE_FIELDS);
+
+	nbanks = zx_mem_store_banks();
+	if (zx_clone(zx, &zx2) != 0) {
+		printf("Error cloning machine.\n");
+		goto out;
+	}
+
+	/* Only the banks of the original can have been added */
+	if (zx_mem_store_banks() > nbanks + zx->mem.ram_nbnk) {
+		printf("Clone did not share memory banks.\n");
+		goto out;
+	}
+
+	sa = test_state_save(zx, &size_a);
+	sb = test_state_save(zx2, &size_b);
+	if (sa == NULL || sb == NULL)
+		goto out;
+
+	if (size_a != size_b || memcmp(sa, sb, size_a) != 0) {
+		printf("Clone state differs.\n");
+		goto out;
+	}
+
+	free(sa);
+	free(sb);
+	sa = sb = NULL;
+
+	test_state_run(zx, TEST_STATE_FIELDS);
+	test_state_run(zx2, TEST_STATE_FIELDS);
+
+	sa = test_state_save(zx, &size_a);
+	sb = test_state_save(zx2, &size_b);
+	if (sa == NULL || sb == NULL)
+		goto out;
+
+	if (size_a != size_b || memcmp(sa, sb, size_a) != 0) {
+		printf("Clone diverged.\n");
+		goto out;
+	}
+
+	val = zx_memget8(zx2, 0x8000);
+	zx_memset8(zx, 0x8000, val ^ 0xff);
+	if (zx_memget8(zx2, 0x8000) != val) {
+		printf("Write to original changed the clone.\n");
+		goto out;
+	}
+
+	printf(" ... passed\n");
+	rc = 0;
+out:
+	free(sa);
+	free(sb);
+	if (zx != NULL)
+		zx_destroy(zx);
+	if (zx2 != NULL)
+		zx_destroy(zx2);
+	return rc;
+}
+
+/** Run machine state unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_state(void)
+{
+	int rc;
+
+	rc = test_state_roundtrip();
+	if (rc != 0)
+		return 1;
+
+	rc = test_state_reject();
+	if (rc != 0)
+		return 1;
+
+	rc = test_state_rom();
+	if (rc != 0)
+		return 1;
+
+	rc = test_state_machines();
+	if (rc != 0)
+		return 1;
+
+	rc = test_state_clone();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
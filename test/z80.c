@@ -0,0 +1,1115 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Z80 CPU unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Z80 CPU unit tests.
+ *
+ * The CPU runs test programs in a flat 64K memory of its own. Programs
+ * are loaded at address zero and run until PC reaches their end.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "../z80.h"
+#include "z80.h"
+
+/** Maximum number of instructions executed by a test program */
+#define TEST_Z80_MAX_INSTR 1000000
+
+/** Test machine */
+typedef struct {
+	/** CPU */
+	z80_t z;
+	/** Memory */
+	uint8_t mem[0x10000];
+	/** Page table for reading memory */
+	uint8_t *rdpg[Z80_NPG];
+	/** Page table for writing memory */
+	uint8_t *wrpg[Z80_NPG];
+	/** Address at which the program ends */
+	uint16_t stop;
+	/** Allow direct access to memory */
+	bool direct;
+} test_z80_t;
+
+/** Machines under test */
+static test_z80_t test_ma, test_mb;
+
+static void test_z80_memset8(void *arg, uint16_t addr, uint8_t val)
+{
+	test_z80_t *m = (test_z80_t *)arg;
+
+	m->mem[addr] = val;
+}
+
+static uint8_t *test_z80_mem_direct(void *arg, uint16_t addr, uint16_t len,
+    int write)
+{
+	test_z80_t *m = (test_z80_t *)arg;
+
+	if (!m->direct || (uint32_t)addr + len > sizeof(m->mem))
+		return NULL;
+
+	return &m->mem[addr];
+}
+
+static uint8_t test_z80_in8(void *arg, uint16_t addr)
+{
+	return 0xff;
+}
+
+static void test_z80_out8(void *arg, uint16_t addr, uint8_t val)
+{
+}
+
+static uint8_t test_z80_snoop8(void *arg)
+{
+	return 0xff;
+}
+
+static int test_z80_code_break(void *arg, uint16_t addr)
+{
+	test_z80_t *m = (test_z80_t *)arg;
+
+	return addr == m->stop;
+}
+
+static void test_z80_trace_instr(void *arg)
+{
+}
+
+/** Memory and I/O of the test machine */
+static const z80_ops_t test_z80_ops = {
+	.memset8 = test_z80_memset8,
+	.mem_direct = test_z80_mem_direct,
+	.in8 = test_z80_in8,
+	.out8 = test_z80_out8,
+	.snoop8 = test_z80_snoop8,
+	.code_break = test_z80_code_break,
+	.trace_instr = test_z80_trace_instr
+};
+
+/** Set up test machine with a program.
+ *
+ * @param m Test machine
+ * @param prog Program
+ * @param size Size of program in bytes
+ */
+static void test_z80_setup(test_z80_t *m, const uint8_t *prog, size_t size)
+{
+	int i;
+
+	memset(m->mem, 0, sizeof(m->mem));
+	memcpy(m->mem, prog, size);
+	m->stop = size;
+	m->direct = true;
+
+	for (i = 0; i < Z80_NPG; i++) {
+		m->rdpg[i] = m->mem + i * Z80_PG_SIZE;
+		m->wrpg[i] = m->mem + i * Z80_PG_SIZE;
+	}
+
+	z80_init_tables();
+	z80_fini(&m->z);
+	z80_init(&m->z, &test_z80_ops, m, m->rdpg, m->wrpg);
+	z80_reset(&m->z);
+}
+
+/** Run program one instruction at a time.
+ *
+ * @param m Test machine
+ * @return Zero on success, non-zero if the program did not end
+ */
+static int test_z80_step(test_z80_t *m)
+{
+	long n;
+
+	for (n = 0; n < TEST_Z80_MAX_INSTR; n++) {
+		if (m->z.cpus.PC == m->stop)
+			return 0;
+		z80_execinstr(&m->z);
+	}
+
+	printf("Program did not end.\n");
+	return 1;
+}
+
+/** Run program with z80_run().
+ *
+ * @param m Test machine
+ * @param slice Number of T states to run at a time
+ * @return Zero on success, non-zero if the program did not end
+ */
+static int test_z80_run(test_z80_t *m, unsigned long slice)
+{
+	long n;
+
+	for (n = 0; n < TEST_Z80_MAX_INSTR; n++) {
+		if (m->z.cpus.PC == m->stop)
+			return 0;
+		z80_run(&m->z, m->z.clock + slice);
+	}
+
+	printf("Program did not end.\n");
+	return 1;
+}
+
+/** Compare state of two test machines.
+ *
+ * @param a First test machine
+ * @param b Second test machine
+ * @param name Description of the test
+ * @return Zero if the states are the same, non-zero otherwise
+ */
+static int test_z80_cmp(test_z80_t *a, test_z80_t *b, const char *name)
+{
+	z80s *sa = &a->z.cpus;
+	z80s *sb = &b->z.cpus;
+
+	z80_sync_flags(sa);
+	z80_sync_flags(sb);
+
+	if (memcmp(sa->r, sb->r, sizeof(sa->r)) != 0 || sa->F != sb->F ||
+	    memcmp(sa->r_, sb->r_, sizeof(sa->r_)) != 0 ||
+	    sa->F_ != sb->F_ || sa->IX != sb->IX || sa->IY != sb->IY ||
+	    sa->SP != sb->SP || sa->PC != sb->PC || sa->W != sb->W) {
+		printf("%s: registers differ.\n", name);
+		return 1;
+	}
+
+	if (sa->R != sb->R) {
+		printf("%s: R=%02x, expected %02x.\n", name, sb->R, sa->R);
+		return 1;
+	}
+
+	if (a->z.clock != b->z.clock) {
+		printf("%s: clock %lu, expected %lu.\n", name, b->z.clock,
+		    a->z.clock);
+		return 1;
+	}
+
+	if (memcmp(a->mem, b->mem, sizeof(a->mem)) != 0) {
+		printf("%s: memory differs.\n", name);
+		return 1;
+	}
+
+	return 0;
+}
+
+/** Lazy flags test case */
+typedef struct {
+	/** Description */
+	const char *name;
+	/** Program */
+	uint8_t prog[16];
+	/** Size of program */
+	size_t size;
+	/** Expected value of A */
+	uint8_t a;
+	/** Expected value of F */
+	uint8_t f;
+} test_z80_flags_case_t;
+
+/** Lazy flags test cases (expected values are those of a real Z80) */
+static const test_z80_flags_case_t test_z80_flags_cases[] = {
+	{
+		/* LD A,7F; ADD A,1 */
+		"ADD with overflow",
+		{ 0x3e, 0x7f, 0xc6, 0x01 }, 4, 0x80, 0x94
+	},
+	{
+		/* LD A,10; SUB 20 */
+		"SUB with borrow",
+		{ 0x3e, 0x10, 0xd6, 0x20 }, 4, 0xf0, 0xa3
+	},
+	{
+		/* LD A,10; CP 28 */
+		"CP (undocumented flags from operand)",
+		{ 0x3e, 0x10, 0xfe, 0x28 }, 4, 0x10, 0xbb
+	},
+	{
+		/* SCF; LD A,FF; INC A */
+		"INC keeps carry",
+		{ 0x37, 0x3e, 0xff, 0x3c }, 4, 0x00, 0x51
+	},
+	{
+		/* LD A,80; DEC A */
+		"DEC with overflow",
+		{ 0x3e, 0x80, 0x3d }, 3, 0x7f, 0x3e
+	},
+	{
+		/* SCF; LD HL,7800; LD DE,0800; ADC HL,DE; LD A,H */
+		"ADC HL with overflow",
+		{ 0x37, 0x21, 0x00, 0x78, 0x11, 0x00, 0x08, 0xed, 0x5a,
+		0x7c }, 10, 0x80, 0x94
+	},
+	{
+		/* OR A; LD HL,1234; LD DE,1234; SBC HL,DE; LD A,H */
+		"SBC HL with zero result",
+		{ 0xb7, 0x21, 0x34, 0x12, 0x11, 0x34, 0x12, 0xed, 0x52,
+		0x7c }, 10, 0x00, 0x42
+	},
+	{
+		/* LD A,5; SUB 5; LD B,0; JR NZ,+2; LD B,1; LD A,B */
+		"JR NZ after SUB",
+		{ 0x3e, 0x05, 0xd6, 0x05, 0x06, 0x00, 0x20, 0x02, 0x06, 0x01,
+		0x78 }, 11, 0x01, 0x42
+	},
+	{
+		/* LD A,7F; ADD A,1; PUSH AF; POP BC; LD A,C */
+		"PUSH AF after ADD",
+		{ 0x3e, 0x7f, 0xc6, 0x01, 0xf5, 0xc1, 0x79 }, 7, 0x94, 0x94
+	},
+	{
+		/* LD A,0; CP 28; SCF */
+		"SCF after CP",
+		{ 0x3e, 0x00, 0xfe, 0x28, 0x37 }, 5, 0x00, 0x81
+	},
+	{
+		/* LD A,28; OR A; LD A,0; SCF */
+		"SCF after LD",
+		{ 0x3e, 0x28, 0xb7, 0x3e, 0x00, 0x37 }, 6, 0x00, 0x2d
+	},
+	{
+		/* LD A,0; CP 28; CCF */
+		"CCF after CP",
+		{ 0x3e, 0x00, 0xfe, 0x28, 0x3f }, 5, 0x00, 0x90
+	},
+	{
+		/* LD A,28; OR A; LD A,0; CCF */
+		"CCF after LD",
+		{ 0x3e, 0x28, 0xb7, 0x3e, 0x00, 0x3f }, 6, 0x00, 0x2d
+	}
+};
+
+/** Check A and F after running a lazy flags test case.
+ *
+ * @param m Test machine
+ * @param tc Test case
+ * @param how Description of how the program was run
+ * @return Zero on success, non-zero on failure
+ */
+static int test_z80_flags_check(test_z80_t *m,
+    const test_z80_flags_case_t *tc, const char *how)
+{
+	z80_sync_flags(&m->z.cpus);
+
+	if (m->z.cpus.r[rA] != tc->a || m->z.cpus.F != tc->f) {
+		printf("%s (%s): A=%02x F=%02x, expected A=%02x F=%02x.\n",
+		    tc->name, how, m->z.cpus.r[rA], m->z.cpus.F, tc->a,
+		    tc->f);
+		return 1;
+	}
+
+	return 0;
+}
+
+/** Test lazy evaluation of flags.
+ *
+ * Flags are checked after running each program one instruction at
+ * a time and with z80_run().
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_z80_flags(void)
+{
+	const test_z80_flags_case_t *tc;
+	size_t i;
+
+	printf("Test Z80 lazy flags...\n");
+
+	for (i = 0; i < sizeof(test_z80_flags_cases) /
+	    sizeof(test_z80_flags_cases[0]); i++) {
+		tc = &test_z80_flags_cases[i];
+
+		test_z80_setup(&test_ma, tc->prog, tc->size);
+		if (test_z80_step(&test_ma) != 0)
+			return 1;
+		if (test_z80_flags_check(&test_ma, tc, "stepped") != 0)
+			return 1;
+
+		test_z80_setup(&test_ma, tc->prog, tc->size);
+		if (test_z80_run(&test_ma, 1000) != 0)
+			return 1;
+		if (test_z80_flags_check(&test_ma, tc, "run") != 0)
+			return 1;
+	}
+
+	printf(" ... passed\n");
+	return 0;
+}
+
+/** Block instruction test case */
+typedef struct {
+	/** Description */
+	const char *name;
+	/** Program */
+	uint8_t prog[16];
+	/** Size of program */
+	size_t size;
+	/** Expected number of T states */
+	unsigned long clock;
+} test_z80_rep_case_t;
+
+/** Block instruction test cases */
+static const test_z80_rep_case_t test_z80_rep_cases[] = {
+	{
+		/* LD HL,9000; LD DE,A000; LD BC,1000; LDIR */
+		"LDIR",
+		{ 0x21, 0x00, 0x90, 0x11, 0x00, 0xa0, 0x01, 0x00, 0x10,
+		0xed, 0xb0 }, 11,
+		3 * 10 + 0x0fff * 21 + 16
+	},
+	{
+		/* LD HL,9000; LD DE,9001; LD BC,0200; LDIR */
+		"LDIR (fill)",
+		{ 0x21, 0x00, 0x90, 0x11, 0x01, 0x90, 0x01, 0x00, 0x02,
+		0xed, 0xb0 }, 11,
+		3 * 10 + 0x01ff * 21 + 16
+	},
+	{
+		/* LD HL,9000; LD DE,9003; LD BC,0200; LDIR */
+		"LDIR (overlapping)",
+		{ 0x21, 0x00, 0x90, 0x11, 0x03, 0x90, 0x01, 0x00, 0x02,
+		0xed, 0xb0 }, 11,
+		3 * 10 + 0x01ff * 21 + 16
+	},
+	{
+		/* LD HL,BF00; LD DE,C100; LD BC,0400; LDIR */
+		"LDIR (across banks)",
+		{ 0x21, 0x00, 0xbf, 0x11, 0x00, 0xc1, 0x01, 0x00, 0x04,
+		0xed, 0xb0 }, 11,
+		3 * 10 + 0x03ff * 21 + 16
+	},
+	{
+		/* LD HL,A000; LD DE,0000; LD BC,0010; LDIR (then NOP; OR B) */
+		"LDIR (overwriting itself)",
+		{ 0x21, 0x00, 0xa0, 0x11, 0x00, 0x00, 0x01, 0x10, 0x00,
+		0xed, 0xb0 }, 11,
+		3 * 10 + 10 * 21 + 4 + 4
+	},
+	{
+		/* LD HL,9FFF; LD DE,AFFF; LD BC,1000; LDDR */
+		"LDDR",
+		{ 0x21, 0xff, 0x9f, 0x11, 0xff, 0xaf, 0x01, 0x00, 0x10,
+		0xed, 0xb8 }, 11,
+		3 * 10 + 0x0fff * 21 + 16
+	},
+	{
+		/* LD HL,9100; LD DE,90FF; LD BC,0200; LDDR */
+		"LDDR (fill)",
+		{ 0x21, 0x00, 0x91, 0x11, 0xff, 0x90, 0x01, 0x00, 0x02,
+		0xed, 0xb8 }, 11,
+		3 * 10 + 0x01ff * 21 + 16
+	},
+	{
+		/* LD HL,9000; LD BC,1000; LD A,5A; CPIR */
+		"CPIR",
+		{ 0x21, 0x00, 0x90, 0x01, 0x00, 0x10, 0x3e, 0x5a,
+		0xed, 0xb1 }, 10,
+		2 * 10 + 7 + 0x0123 * 21 + 16
+	},
+	{
+		/* LD HL,9000; LD BC,1000; LD A,A5; CPIR */
+		"CPIR (not found)",
+		{ 0x21, 0x00, 0x90, 0x01, 0x00, 0x10, 0x3e, 0xa5,
+		0xed, 0xb1 }, 10,
+		2 * 10 + 7 + 0x0fff * 21 + 16
+	},
+	{
+		/* LD HL,9FFF; LD BC,1000; LD A,5A; CPDR */
+		"CPDR",
+		{ 0x21, 0xff, 0x9f, 0x01, 0x00, 0x10, 0x3e, 0x5a,
+		0xed, 0xb9 }, 10,
+		2 * 10 + 7 + 0x01de * 21 + 16
+	}
+};
+
+/** Set up test machine with a block instruction test case.
+ *
+ * Memory at 0x9000 - 0x9fff is filled with a pattern that contains
+ * 0x5a at 0x9123 and at 0x9e21, but no 0xa5.
+ *
+ * @param m Test machine
+ * @param tc Test case
+ */
+static void test_z80_rep_setup(test_z80_t *m, const test_z80_rep_case_t *tc)
+{
+	unsigned i;
+
+	test_z80_setup(m, tc->prog, tc->size);
+	for (i = 0x9000; i < 0xa000; i++)
+		m->mem[i] = (i * 7) & 0x3f;
+	m->mem[0x9123] = 0x5a;
+	m->mem[0x9e21] = 0x5a;
+	for (i = 0xbf00; i < 0xc300; i++)
+		m->mem[i] = i >> 3;
+}
+
+/** Test repeated block instructions.
+ *
+ * Each program is run one instruction at a time, which repeats
+ * the block instruction one iteration at a time. The result must be
+ * the same when the program is run with z80_run(), where iterations
+ * continue in place and are skipped in bulk, with or without direct
+ * memory access, with various run deadlines, and with the instrumented
+ * core.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_z80_rep(void)
+{
+	static const unsigned long slices[] = { 1000000, 1000, 100, 21, 7 };
+	const test_z80_rep_case_t *tc;
+	char name[64];
+	size_t i, j;
+
+	printf("Test Z80 repeated block instructions...\n");
+
+	for (i = 0; i < sizeof(test_z80_rep_cases) /
+	    sizeof(test_z80_rep_cases[0]); i++) {
+		tc = &test_z80_rep_cases[i];
+
+		test_z80_rep_setup(&test_ma, tc);
+		if (test_z80_step(&test_ma) != 0)
+			return 1;
+
+		if (test_ma.z.clock != tc->clock) {
+			printf("%s: clock %lu, expected %lu.\n", tc->name,
+			    test_ma.z.clock, tc->clock);
+			return 1;
+		}
+
+		for (j = 0; j < sizeof(slices) / sizeof(slices[0]); j++) {
+			test_z80_rep_setup(&test_mb, tc);
+			if (test_z80_run(&test_mb, slices[j]) != 0)
+				return 1;
+			snprintf(name, sizeof(name), "%s (run %lu)",
+			    tc->name, slices[j]);
+			if (test_z80_cmp(&test_ma, &test_mb, name) != 0)
+				return 1;
+		}
+
+		test_z80_rep_setup(&test_mb, tc);
+		test_mb.direct = false;
+		if (test_z80_run(&test_mb, 1000000) != 0)
+			return 1;
+		snprintf(name, sizeof(name), "%s (no direct access)",
+		    tc->name);
+		if (test_z80_cmp(&test_ma, &test_mb, name) != 0)
+			return 1;
+
+		test_z80_rep_setup(&test_mb, tc);
+		z80_set_instrumented(&test_mb.z, 1);
+		if (test_z80_run(&test_mb, 1000000) != 0)
+			return 1;
+		snprintf(name, sizeof(name), "%s (instrumented)", tc->name);
+		if (test_z80_cmp(&test_ma, &test_mb, name) != 0)
+			return 1;
+	}
+
+	printf(" ... passed\n");
+	return 0;
+}
+
+/** Prefix chain test case */
+typedef struct {
+	/** Description */
+	const char *name;
+	/** Program */
+	uint8_t prog[16];
+	/** Size of program */
+	size_t size;
+	/** Expected number of T states */
+	unsigned long clock;
+	/** Expected value of R */
+	uint8_t r;
+	/** Expected value of IX */
+	uint16_t ix;
+	/** Expected value of IY */
+	uint16_t iy;
+} test_z80_prefix_case_t;
+
+/** Prefix chain test cases */
+static const test_z80_prefix_case_t test_z80_prefix_cases[] = {
+	{
+		/* LD IX,1234 with an extra DD prefix */
+		"DD DD 21",
+		{ 0xdd, 0xdd, 0x21, 0x34, 0x12 }, 5, 18, 3, 0x1234, 0
+	},
+	{
+		/* LD IY,1234 with an extra DD prefix */
+		"DD FD 21",
+		{ 0xdd, 0xfd, 0x21, 0x34, 0x12 }, 5, 18, 3, 0, 0x1234
+	},
+	{
+		/* LD IX,1234 with an extra FD prefix */
+		"FD DD 21",
+		{ 0xfd, 0xdd, 0x21, 0x34, 0x12 }, 5, 18, 3, 0x1234, 0
+	},
+	{
+		/* LD IX,1234 with five extra prefixes */
+		"DD FD DD FD DD DD 21",
+		{ 0xdd, 0xfd, 0xdd, 0xfd, 0xdd, 0xdd, 0x21, 0x34, 0x12 }, 9,
+		34, 7, 0x1234, 0
+	},
+	{
+		/* SET 0,(IX+5) with an extra FD prefix */
+		"FD DD CB",
+		{ 0xfd, 0xdd, 0xcb, 0x05, 0xc6 }, 5, 27, 3, 0, 0
+	},
+	{
+		/* NEG with a stray FD prefix */
+		"FD ED",
+		{ 0xfd, 0xed, 0x44 }, 3, 12, 3, 0, 0
+	},
+	{
+		/* NOP with a stray DD prefix */
+		"DD 00",
+		{ 0xdd, 0x00 }, 2, 8, 2, 0, 0
+	}
+};
+
+/** Test chains of DD and FD prefixes.
+ *
+ * Only the last prefix in a chain applies, the others execute as
+ * four T state NOPs. Each program is run one instruction at a time,
+ * with z80_run() (also with a deadline after each prefix) and with
+ * the instrumented core.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_z80_prefix(void)
+{
+	const test_z80_prefix_case_t *tc;
+	char name[64];
+	size_t i;
+
+	printf("Test Z80 prefix chains...\n");
+
+	for (i = 0; i < sizeof(test_z80_prefix_cases) /
+	    sizeof(test_z80_prefix_cases[0]); i++) {
+		tc = &test_z80_prefix_cases[i];
+
+		test_z80_setup(&test_ma, tc->prog, tc->size);
+		if (test_z80_step(&test_ma) != 0)
+			return 1;
+
+		if (test_ma.z.clock != tc->clock ||
+		    test_ma.z.cpus.R != tc->r ||
+		    test_ma.z.cpus.IX != tc->ix ||
+		    test_ma.z.cpus.IY != tc->iy) {
+			printf("%s: clock %lu R=%02x IX=%04x IY=%04x, "
+			    "expected clock %lu R=%02x IX=%04x IY=%04x.\n",
+			    tc->name, test_ma.z.clock, test_ma.z.cpus.R,
+			    test_ma.z.cpus.IX, test_ma.z.cpus.IY, tc->clock,
+			    tc->r, tc->ix, tc->iy);
+			return 1;
+		}
+
+		test_z80_setup(&test_mb, tc->prog, tc->size);
+		if (test_z80_run(&test_mb, 1000) != 0)
+			return 1;
+		snprintf(name, sizeof(name), "%s (run)", tc->name);
+		if (test_z80_cmp(&test_ma, &test_mb, name) != 0)
+			return 1;
+
+		test_z80_setup(&test_mb, tc->prog, tc->size);
+		if (test_z80_run(&test_mb, 1) != 0)
+			return 1;
+		snprintf(name, sizeof(name), "%s (run 1)", tc->name);
+		if (test_z80_cmp(&test_ma, &test_mb, name) != 0)
+			return 1;
+
+		test_z80_setup(&test_mb, tc->prog, tc->size);
+		z80_set_instrumented(&test_mb.z, 1);
+		if (test_z80_run(&test_mb, 1000) != 0)
+			return 1;
+		snprintf(name, sizeof(name), "%s (instrumented)", tc->name);
+		if (test_z80_cmp(&test_ma, &test_mb, name) != 0)
+			return 1;
+	}
+
+	printf(" ... passed\n");
+	return 0;
+}
+
+/** State of the random number generator of the translator test */
+static uint32_t test_z80_jit_rnd_state;
+
+/** Get pseudo-random number.
+ *
+ * @param n Upper bound
+ * @return Number from 0 to @a n - 1
+ */
+static unsigned test_z80_jit_rnd(unsigned n)
+{
+	uint32_t x = test_z80_jit_rnd_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	test_z80_jit_rnd_state = x;
+	return x % n;
+}
+
+/** Test program being generated */
+typedef struct {
+	/** Program */
+	uint8_t prog[0x2000];
+	/** Next free address */
+	uint16_t pc;
+	/** Addresses of immediate operands in the current loop */
+	uint16_t imm[16];
+	/** Number of entries in @c imm */
+	unsigned nimm;
+} test_z80_jit_prog_t;
+
+/** Append bytes to test program */
+#define TEST_Z80_JIT_E(p, ...) test_z80_jit_emit((p), (const uint8_t []) \
+	{ __VA_ARGS__ }, sizeof((const uint8_t []) { __VA_ARGS__ }))
+
+static void test_z80_jit_emit(test_z80_jit_prog_t *p, const uint8_t *b,
+    size_t n)
+{
+	memcpy(&p->prog[p->pc], b, n);
+	p->pc += n;
+}
+
+/** Get random register other than B (and other than (HL)).
+ *
+ * @return Register number (r field of an opcode)
+ */
+static unsigned test_z80_jit_reg(void)
+{
+	static const uint8_t regs[] = { 1, 2, 3, 4, 5, 7 };
+
+	return regs[test_z80_jit_rnd(sizeof(regs))];
+}
+
+/** Append LD HL,nn with a random data address.
+ *
+ * Half of the addresses are in a page written through the memset8
+ * callback.
+ */
+static void test_z80_jit_hl(test_z80_jit_prog_t *p)
+{
+	TEST_Z80_JIT_E(p, 0x21, test_z80_jit_rnd(256),
+	    test_z80_jit_rnd(2) != 0 ? 0xa0 : 0xc0);
+}
+
+/** Append random instruction to loop body of test program.
+ *
+ * The instruction does not change B, SP, IX or IY.
+ *
+ * @param p Test program
+ */
+static void test_z80_jit_instr(test_z80_jit_prog_t *p)
+{
+	static const uint8_t misc[] = {
+		0x07, 0x0f, 0x17, 0x1f, 0x27, 0x2f, 0x37, 0x3f, 0x08, 0x00
+	};
+	static const uint8_t ed[] = {
+		0x44, 0x4a, 0x5a, 0x6a, 0x42, 0x52, 0x72, 0x47, 0x56
+	};
+	static const uint8_t dd[] = {
+		0x7e, 0x4e, 0x86, 0x96, 0xae, 0xbe, 0x34, 0x35, 0x77, 0x71
+	};
+	unsigned r = test_z80_jit_reg();
+	unsigned k = test_z80_jit_rnd(8);
+	uint8_t n = test_z80_jit_rnd(256);
+
+	switch (test_z80_jit_rnd(24)) {
+	case 0:
+		/* LD r, n */
+		if (p->nimm < 16)
+			p->imm[p->nimm++] = p->pc + 1;
+		TEST_Z80_JIT_E(p, 0x06 | r << 3, n);
+		break;
+	case 1:
+		/* LD r, r' */
+		TEST_Z80_JIT_E(p, 0x40 | r << 3 | (k == 6 ? 7 : k));
+		break;
+	case 2:
+		/* INC r; DEC r */
+		TEST_Z80_JIT_E(p, 0x04 | r << 3 | (n & 1));
+		break;
+	case 3:
+		/* ALU A, r */
+		TEST_Z80_JIT_E(p, 0x80 | k << 3 | (r == 6 ? 0 : n & 7));
+		break;
+	case 4:
+		/* ALU A, n */
+		TEST_Z80_JIT_E(p, 0xc6 | k << 3, n);
+		break;
+	case 5:
+		/* ALU A, (HL); LD r, (HL) */
+		test_z80_jit_hl(p);
+		TEST_Z80_JIT_E(p, (n & 1) != 0 ? 0x86 | k << 3 :
+		    0x46 | r << 3);
+		break;
+	case 6:
+		/* LD (HL), r; LD (HL), n; INC (HL); DEC (HL) */
+		test_z80_jit_hl(p);
+		if (k < 4)
+			TEST_Z80_JIT_E(p, 0x70 | (n & 7) % 6);
+		else if (k < 6)
+			TEST_Z80_JIT_E(p, 0x36, n);
+		else
+			TEST_Z80_JIT_E(p, 0x34 | (k & 1));
+		break;
+	case 7:
+		/* ADD HL, rr; INC DE/HL; DEC DE/HL; EX DE, HL */
+		if (k < 4)
+			TEST_Z80_JIT_E(p, 0x09 | k << 4);
+		else if (k < 7)
+			TEST_Z80_JIT_E(p, (n & 1) != 0 ? 0x13 : 0x2b);
+		else
+			TEST_Z80_JIT_E(p, 0xeb);
+		break;
+	case 8:
+		/* PUSH rr; POP rr' (not BC) */
+		TEST_Z80_JIT_E(p, 0xc5 | (k & 3) << 4, 0xd1 | (n % 3) << 4);
+		break;
+	case 9:
+		/* LD DE, nn; LD (DE), A / LD A, (DE); LD A, (BC) */
+		TEST_Z80_JIT_E(p, 0x11, n, 0xa0, k < 4 ? 0x12 : 0x1a);
+		if ((n & 1) != 0)
+			TEST_Z80_JIT_E(p, 0x0a);
+		break;
+	case 10:
+		/* LD (nn), A; LD A, (nn) */
+		TEST_Z80_JIT_E(p, (n & 1) != 0 ? 0x32 : 0x3a, n,
+		    k < 4 ? 0xa1 : 0xc1);
+		break;
+	case 11:
+		/* Change an operand in the code of the loop */
+		if (p->nimm > 0) {
+			k = p->imm[test_z80_jit_rnd(p->nimm)];
+			TEST_Z80_JIT_E(p, 0x32, k & 0xff, k >> 8);
+		}
+		break;
+	case 12:
+		/* JR cc, +1; INC A */
+		TEST_Z80_JIT_E(p, 0x20 | (k & 3) << 3, 0x01, 0x3c);
+		break;
+	case 13:
+		/* JP cc, next; INC D */
+		TEST_Z80_JIT_E(p, 0xc2 | k << 3, (p->pc + 4) & 0xff,
+		    (p->pc + 4) >> 8, 0x14);
+		break;
+	case 14:
+		/* CALL (cc), subroutine; RST 28 */
+		if (k < 2)
+			TEST_Z80_JIT_E(p, 0xcd, 0x40, 0x00);
+		else if (k < 6)
+			TEST_Z80_JIT_E(p, 0xc4 | (n & 7) << 3, 0x48, 0x00);
+		else
+			TEST_Z80_JIT_E(p, 0xef);
+		break;
+	case 15:
+		/* Rotations of A, flag operations, EX AF, AF' */
+		TEST_Z80_JIT_E(p, misc[test_z80_jit_rnd(sizeof(misc))]);
+		break;
+	case 16:
+		/* EXX; INC C; EXX; EX (SP), HL; LD HL, (nn); LD (nn), HL */
+		if (k < 3)
+			TEST_Z80_JIT_E(p, 0xd9, 0x0c, 0xd9);
+		else if (k < 5)
+			TEST_Z80_JIT_E(p, 0xe5, 0xe3, 0xe1);
+		else
+			TEST_Z80_JIT_E(p, (n & 1) != 0 ? 0x22 : 0x2a, n,
+			    k < 7 ? 0xa0 : 0xc0);
+		break;
+	case 17:
+		/* CB on register (not B) */
+		TEST_Z80_JIT_E(p, 0xcb, (n & 0xf8) | r);
+		break;
+	case 18:
+		/* CB on (HL) */
+		test_z80_jit_hl(p);
+		TEST_Z80_JIT_E(p, 0xcb, (n & 0xf8) | 6);
+		break;
+	case 19:
+		/* ED */
+		k = ed[test_z80_jit_rnd(sizeof(ed))];
+		TEST_Z80_JIT_E(p, 0xed, k);
+		if (k == 0x56 && (n & 1) != 0) {
+			/* RLD; LD (nn), DE; LD HL, (nn) */
+			test_z80_jit_hl(p);
+			TEST_Z80_JIT_E(p, 0xed, 0x6f, 0xed, 0x53, n, 0xa0,
+			    0xed, 0x6b, n ^ 1, 0xc0);
+		}
+		break;
+	case 20:
+		/* DD/FD with (IX + d) / (IY + d) */
+		TEST_Z80_JIT_E(p, (n & 1) != 0 ? 0xdd : 0xfd,
+		    dd[test_z80_jit_rnd(sizeof(dd))], n);
+		break;
+	case 21:
+		/*
+		 * LD (IX + d), n; SET/RES/RLC (IX + d);
+		 * PUSH IY; ADD IY, DE/IY; INC IYh; POP IY;
+		 * INC IX; DEC IY; DEC IX; INC IY
+		 */
+		if (k < 3)
+			TEST_Z80_JIT_E(p, 0xdd, 0x36, n, k);
+		else if (k < 6)
+			TEST_Z80_JIT_E(p, 0xdd, 0xcb, n, (n & 0xc0) |
+			    (k & 1) << 3 | 6);
+		else if (k < 7)
+			TEST_Z80_JIT_E(p, 0xfd, 0xe5, 0xfd, 0x19 | (n & 1) << 5,
+			    0xfd, 0x24, 0xfd, 0xe1);
+		else
+			TEST_Z80_JIT_E(p, 0xdd, 0x23, 0xfd, 0x2b, 0xdd, 0x2b,
+			    0xfd, 0x23);
+		break;
+	case 22:
+		/* Instructions that are not translated, stray prefix */
+		if (k < 3)
+			TEST_Z80_JIT_E(p, 0xd3, n);
+		else if (k < 5)
+			TEST_Z80_JIT_E(p, 0xf3, 0xfb);
+		else
+			TEST_Z80_JIT_E(p, 0xdd, 0x00);
+		break;
+	default:
+		/* RET cc (subroutine with conditional return) */
+		TEST_Z80_JIT_E(p, 0xcd, 0x50, 0x00);
+		break;
+	}
+}
+
+/** Generate random test program for the translator.
+ *
+ * The program consists of loops with random bodies. Subroutines and
+ * the interrupt routine are at fixed addresses.
+ *
+ * @param p Test program
+ */
+static void test_z80_jit_gen(test_z80_jit_prog_t *p)
+{
+	unsigned nloops;
+	unsigned ninstr;
+	uint16_t loop;
+	int d;
+
+	memset(p, 0, sizeof(*p));
+	/* JP 0100 */
+	TEST_Z80_JIT_E(p, 0xc3, 0x00, 0x01);
+	/* RST 28: INC L; RET */
+	p->pc = 0x28;
+	TEST_Z80_JIT_E(p, 0x2c, 0xc9);
+	/* Interrupt: EI; RET */
+	p->pc = 0x38;
+	TEST_Z80_JIT_E(p, 0xfb, 0xc9);
+	/* Subroutine: INC E; RET */
+	p->pc = 0x40;
+	TEST_Z80_JIT_E(p, 0x1c, 0xc9);
+	/* Subroutine: RET NC; INC D; RET */
+	p->pc = 0x48;
+	TEST_Z80_JIT_E(p, 0xd0, 0x14, 0xc9);
+	/* Subroutine: CP 80; RET PE; RET M; DEC D; RET */
+	p->pc = 0x50;
+	TEST_Z80_JIT_E(p, 0xfe, 0x80, 0xe8, 0xf8, 0x15, 0xc9);
+
+	/* LD SP, 8000; IM 1; EI; LD IX, A080; LD IY, C080 */
+	p->pc = 0x100;
+	TEST_Z80_JIT_E(p, 0x31, 0x00, 0x80, 0xed, 0x56, 0xfb,
+	    0xdd, 0x21, 0x80, 0xa0, 0xfd, 0x21, 0x80, 0xc0);
+
+	nloops = 1 + test_z80_jit_rnd(8);
+	while (nloops-- > 0) {
+		/* LD B, n */
+		TEST_Z80_JIT_E(p, 0x06, 1 + test_z80_jit_rnd(60));
+		loop = p->pc;
+		p->nimm = 0;
+		ninstr = 1 + test_z80_jit_rnd(20);
+		while (ninstr-- > 0)
+			test_z80_jit_instr(p);
+
+		d = loop - (p->pc + 2);
+		if (d >= -128 && test_z80_jit_rnd(2) != 0) {
+			/* DJNZ loop */
+			TEST_Z80_JIT_E(p, 0x10, d & 0xff);
+		} else {
+			/* DEC B; JP NZ, loop */
+			TEST_Z80_JIT_E(p, 0x05, 0xc2, loop & 0xff, loop >> 8);
+		}
+	}
+}
+
+/** Compare state of two test machines, including timing details.
+ *
+ * @param a First test machine
+ * @param b Second test machine
+ * @param name Description of the test
+ * @return Zero if the states are the same, non-zero otherwise
+ */
+static int test_z80_jit_cmp(test_z80_t *a, test_z80_t *b, const char *name)
+{
+	z80s *sa = &a->z.cpus;
+	z80s *sb = &b->z.cpus;
+
+	if (test_z80_cmp(a, b, name) != 0)
+		return 1;
+
+	if (a->z.instr_clock != b->z.instr_clock ||
+	    a->z.fetches != b->z.fetches ||
+	    sa->flags_aff != sb->flags_aff ||
+	    sa->pflags_aff != sb->pflags_aff ||
+	    sa->modifier != sb->modifier || sa->int_lock != sb->int_lock ||
+	    sa->IFF1 != sb->IFF1 || sa->IFF2 != sb->IFF2 ||
+	    sa->halted != sb->halted) {
+		printf("%s: instr_clock %lu fetches %lu aff %d/%d mod %d "
+		    "lock %d, expected %lu %lu %d/%d %d %d.\n", name,
+		    b->z.instr_clock, b->z.fetches, sb->pflags_aff,
+		    sb->flags_aff, sb->modifier, sb->int_lock,
+		    a->z.instr_clock, a->z.fetches, sa->pflags_aff,
+		    sa->flags_aff, sa->modifier, sa->int_lock);
+		return 1;
+	}
+
+	return 0;
+}
+
+/** Set up test machine with a translator test program.
+ *
+ * @param m Test machine
+ * @param p Test program
+ * @param jit Non-zero to enable translation
+ */
+static void test_z80_jit_setup(test_z80_t *m, test_z80_jit_prog_t *p,
+    int jit)
+{
+	unsigned i;
+
+	test_z80_setup(m, p->prog, p->pc);
+	/* Written through the memset8 callback */
+	m->wrpg[0xc000 >> Z80_PG_SHIFT] = NULL;
+	for (i = 0; i < Z80_NPG; i++)
+		z80_set_break_page(&m->z, i, i == m->stop >> Z80_PG_SHIFT);
+	z80_set_jit(&m->z, jit);
+}
+
+/** Test translation of hot code to native code.
+ *
+ * Random programs are run with translation enabled and disabled,
+ * in random slices, with interrupts arriving between slices. The state
+ * of the two machines, including the clock, R and the flags affected
+ * state, must be the same after each slice.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+static int test_z80_jit(void)
+{
+	static test_z80_jit_prog_t prog;
+	unsigned long slice;
+	char name[64];
+	unsigned i;
+	long n;
+
+	printf("Test Z80 translation to native code...\n");
+
+	test_z80_jit_rnd_state = 0x2545f491;
+
+	for (i = 0; i < 200; i++) {
+		test_z80_jit_gen(&prog);
+		test_z80_jit_setup(&test_ma, &prog, 0);
+		test_z80_jit_setup(&test_mb, &prog, 1);
+		snprintf(name, sizeof(name), "Program %u", i);
+
+		for (n = 0; n < TEST_Z80_MAX_INSTR; n++) {
+			if (test_ma.z.cpus.PC == test_ma.stop)
+				break;
+
+			switch (test_z80_jit_rnd(8)) {
+			case 0:
+				slice = 1 + test_z80_jit_rnd(10);
+				break;
+			case 1:
+				slice = 10000;
+				break;
+			default:
+				slice = 1 + test_z80_jit_rnd(500);
+				break;
+			}
+
+			if (test_z80_jit_rnd(4) == 0) {
+				z80_int(&test_ma.z);
+				z80_int(&test_mb.z);
+			}
+
+			z80_run(&test_ma.z, test_ma.z.clock + slice);
+			z80_run(&test_mb.z, test_mb.z.clock + slice);
+			if (test_z80_jit_cmp(&test_ma, &test_mb, name) != 0)
+				return 1;
+		}
+
+		if (n >= TEST_Z80_MAX_INSTR) {
+			printf("%s did not end.\n", name);
+			return 1;
+		}
+	}
+
+	printf(" ... passed\n");
+	return 0;
+}
+
+/** Run Z80 CPU unit tests.
+ *
+ * @return Zero on success, non-zero on failure
+ */
+int test_z80(void)
+{
+	int rc;
+
+	rc = test_z80_flags();
+	if (rc != 0)
+		return 1;
+
+	rc = test_z80_rep();
+	if (rc != 0)
+		return 1;
+
+	rc = test_z80_prefix();
+	if (rc != 0)
+		return 1;
+
+	rc = test_z80_jit();
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
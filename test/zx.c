@@ -0,0 +1,71 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Machine setup for unit tests
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file Machine setup for unit tests.
+ */
+
+#include <stdio.h>
+#include "../zx.h"
+#include "zx.h"
+
+/** Machine shared by the tests or @c NULL if not created yet */
+static zx_machine_t *test_zx;
+
+/** Initialize the machine for tests that need it.
+ *
+ * The machine is created only once, tests need to put it into
+ * the state they need. ROMs are loaded from the current directory.
+ *
+ * @param rzx Place to store pointer to the machine
+ * @return Zero on success, non-zero on failure
+ */
+int test_zx_init(zx_machine_t **rzx)
+{
+	if (test_zx != NULL) {
+		*rzx = test_zx;
+		return 0;
+	}
+
+	logfi = tmpfile();
+	if (logfi == NULL) {
+		printf("Error creating log file.\n");
+		return 1;
+	}
+
+	if (zx_create(false, false, &test_zx) < 0) {
+		printf("Error creating machine.\n");
+		return 1;
+	}
+
+	*rzx = test_zx;
+	return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Memory and I/O types
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TYPES_MEMIO_H
+#define TYPES_MEMIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../pgshare.h"
+#include "../z80.h"
+
+/** Memory page size for the page tables (log2) */
+#define ZX_MEM_PG_SHIFT Z80_PG_SHIFT
+/** Memory page size for the page tables */
+#define ZX_MEM_PG_SIZE (1 << ZX_MEM_PG_SHIFT)
+/** Number of memory pages in the address space */
+#define ZX_MEM_NPG (0x10000 >> ZX_MEM_PG_SHIFT)
+/** RAM bank size */
+#define ZX_MEM_BNK_SIZE 0x4000
+/** Maximum number of RAM banks */
+#define ZX_MEM_RAM_NBNK 8
+/** Number of memory pages in the largest RAM */
+#define ZX_MEM_RAM_NPG (ZX_MEM_RAM_NBNK * ZX_MEM_BNK_SIZE >> ZX_MEM_PG_SHIFT)
+
+/** Memory and I/O of the machine */
+typedef struct zx_mem {
+	/** RAM banks */
+	uint8_t *ram[ZX_MEM_RAM_NBNK];
+	/** Shared page holding each RAM bank or @c NULL if the bank is
+	 * private */
+	pgshare_page_t *ram_pg[ZX_MEM_RAM_NBNK];
+	/** Number of RAM banks */
+	unsigned ram_nbnk;
+	/** ROM (all banks, shared by all machines unless rom_priv is set) */
+	uint8_t *rom;
+	/** ROM is a private copy (after writes bypassing ROM protection) */
+	bool rom_priv;
+	/** Currently switched in banks */
+	uint8_t *bnk[4];
+	/** Selected screen bank */
+	uint8_t *scr;
+	/** Border color */
+	uint8_t border;
+	/** Speaker output */
+	uint8_t spk;
+	/** MIC output */
+	uint8_t mic;
+	/** EAR input */
+	uint8_t ear;
+	/** RAM size in bytes */
+	uint32_t ram_size;
+	/** ROM size in bytes */
+	uint32_t rom_size;
+	/** Memory model (ZXM_xxx) */
+	int model;
+	/** Bank switching is supported */
+	int has_banksw;
+	/** Bank switching is locked in 48K mode */
+	int bnk_lock48;
+	/** Enhanced paging is supported (+2A/+3) */
+	int has_epg;
+	/** Last data written to the page select port */
+	uint8_t page_reg;
+	/** Last data written to the enhanced paging port */
+	uint8_t epg_reg;
+	/** Nonzero for each memory page of RAM written since
+	 * zx_mem_dirty_clear() */
+	uint8_t dirty_map[ZX_MEM_RAM_NPG];
+	/** Memory page that reads as 0xff (ZX81) or @c NULL */
+	uint8_t *unmapped;
+	/** Memory pages for reading */
+	uint8_t *rdpg[ZX_MEM_NPG];
+	/** Memory pages for writing (NULL if writes need extra processing) */
+	uint8_t *wrpg[ZX_MEM_NPG];
+} zx_mem_t;
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * ROM trap types
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TYPES_ROMTRAP_H
+#define TYPES_ROMTRAP_H
+
+#include <stdint.h>
+
+/** Maximum number of ROM traps */
+#define ROMTRAP_MAX 32
+/** Maximum size of ROM image (+2A/+3) */
+#define ROMTRAP_ROM_MAX 0x10000
+
+/** ROM trap */
+typedef struct {
+	/** Offset in the ROM image */
+	uint32_t off;
+	/** Handler */
+	void (*handler)(void *);
+	/** Argument to the handler */
+	void *arg;
+} romtrap_t;
+
+/** ROM traps of the machine */
+typedef struct {
+	/** One bit for each byte of the ROM image, set where there is
+	 * a trap */
+	uint8_t map[ROMTRAP_ROM_MAX / 8];
+	/** Traps */
+	romtrap_t trap[ROMTRAP_MAX];
+	/** Number of traps */
+	int cnt;
+} romtraps_t;
+
+#endif
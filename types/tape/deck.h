@@ -63,6 +63,51 @@ typedef struct {
 	uint8_t cur_smp;
 	/** Mode is 48K */
 	bool mode48k;
+
+	/** Called when playback starts, stops, pauses or the position is set */
+	void (*state_change)(void *);
+	/** Argument to state_change callback */
+	void *state_change_arg;
 } tape_deck_t;
 
+/** Tape deck position and playback state.
+ *
+ * Tape blocks are referred to by their index in the tape (-1 for none),
+ * so the position is only valid for the same tape.
+ */
+typedef struct {
+	/** Index of deck current block */
+	int cur_block;
+	/** Tape is playing */
+	bool playing;
+	/** Tape is paused */
+	bool paused;
+	/** Current sample */
+	uint8_t cur_smp;
+	/** Mode is 48K */
+	bool mode48k;
+
+	/** Index of player current block */
+	int pl_cur_block;
+	/** Index in player current block */
+	uint32_t pl_cur_idx;
+	/** Player done programming pause */
+	bool pl_pause_done;
+	/** Player loop counter */
+	uint16_t pl_loop_cnt;
+	/** Player output signal */
+	tape_player_sig_t pl_sig;
+	/** Index of player next block */
+	int pl_next_block;
+	/** Player tone generator */
+	tonegen_t pl_tgen;
+
+	/** Sampler current level */
+	tape_lvl_t smp_cur_lvl;
+	/** Sampler delay until next event */
+	uint32_t smp_next_delay;
+	/** Sampler next level */
+	tape_lvl_t smp_next_lvl;
+} tape_deck_pos_t;
+
 #endif
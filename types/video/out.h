@@ -32,6 +32,8 @@
 #ifndef TYPES_VIDEO_OUT_H
 #define TYPES_VIDEO_OUT_H
 
+#include <stdint.h>
+
 /** Video output */
 typedef struct video_out {
 	/** X-coord of top left corner of video out on the screen, can be
@@ -46,6 +48,12 @@ typedef struct video_out {
 	int y0;
 	/** Field number, 0 or 1 */
 	int field_no;
+	/** Image to render to or @c NULL to render to the host display */
+	uint8_t *image;
+	/** Width of image */
+	int image_w;
+	/** Height of image */
+	int image_h;
 } video_out_t;
 
 enum {
@@ -34,9 +34,19 @@
 
 #include <stdint.h>
 
+struct zx_mem;
+
 /** Spec256 video generator */
 typedef struct {
 	struct video_out *vout;
+	/** Memory (border) */
+	const struct zx_mem *mem;
+	/** Screen of each GPU memory plane */
+	uint8_t *const *gfxscr;
+	/** Called at the end of each field (raises the interrupt) */
+	void (*field_end)(void *);
+	/** Argument to field_end */
+	void *field_end_arg;
 	unsigned long clock;
 	uint8_t *gfxpal;
 	/** Number of backgrounds */
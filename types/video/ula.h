@@ -36,9 +36,17 @@
 #include <stdint.h>
 #include "ulaplus.h"
 
+struct zx_mem;
+
 /** ULA video generator */
 typedef struct {
 	struct video_out *vout;
+	/** Memory (screen and border) */
+	const struct zx_mem *mem;
+	/** Called at the end of each field (raises the interrupt) */
+	void (*field_end)(void *);
+	/** Argument to field_end */
+	void *field_end_arg;
 	unsigned long clock;
 	unsigned long cbase;
 	/** Flash reverse */
@@ -0,0 +1,74 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Spec256 GPU types
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TYPES_Z80G_H
+#define TYPES_Z80G_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../z80.h"
+
+/* Number of graphical planes */
+#define NGP 8
+
+/** ROM size of a GPU memory plane */
+#define GPU_ROM_SIZE 0x4000
+/** RAM size of a GPU memory plane */
+#define GPU_RAM_SIZE 0xc000
+
+/** Spec256 GPUs with their memory planes (allocated while GPUs are on) */
+typedef struct {
+	/** GPUs */
+	z80_t gpus[NGP];
+	/** Screen of each memory plane */
+	uint8_t *scr[NGP];
+	/** Page tables of each GPU for reading its memory plane */
+	uint8_t *rdpg[NGP][Z80_NPG];
+	/** Page tables of each GPU for writing its memory plane */
+	uint8_t *wrpg[NGP][Z80_NPG];
+	/** ROM of each memory plane */
+	uint8_t rom[NGP][GPU_ROM_SIZE];
+	/** RAM of each memory plane */
+	uint8_t ram[NGP][GPU_RAM_SIZE];
+} zx_gpu_planes_t;
+
+/** Spec256 GPUs of the machine */
+typedef struct {
+	/** Allow probing for GFX and turning on GPU when needed */
+	bool allow;
+	/** GPUs and memory planes or @c NULL if GPUs are off */
+	zx_gpu_planes_t *planes;
+	/** Allocated size of planes */
+	size_t planes_size;
+} zx_gpu_t;
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * ZX machine types
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TYPES_ZX_H
+#define TYPES_ZX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../ay.h"
+#include "../debug.h"
+#include "../evsched.h"
+#include "../iorec.h"
+#include "../midi.h"
+#include "../rs232.h"
+#include "../rzx.h"
+#include "../z80.h"
+#include "../zx_kbd.h"
+#include "joystick/kempston.h"
+#include "memio.h"
+#include "romtrap.h"
+#include "tape/deck.h"
+#include "z80g.h"
+#include "zx_scr.h"
+#include "zx_sound.h"
+
+/** Number of events scheduled by the machine */
+#define ZX_NEVENTS 4
+
+/** Event scheduling state (part of the machine state) */
+typedef struct {
+	/** Event of each heap position (index to the machine events) */
+	uint8_t ev_heap[ZX_NEVENTS];
+	/** Number of scheduled events */
+	int nev;
+	/** Due time of each event */
+	unsigned long ev_clock[ZX_NEVENTS];
+	/** Host display update is due */
+	bool disp_due;
+	/** Last tape sample */
+	uint8_t tape_smp;
+	/** Due time of the last or next tape sample */
+	unsigned long tape_clock;
+	/** Clock value of the next audio sample */
+	unsigned long snd_clock;
+} zx_run_state_t;
+
+/** ZX machine
+ *
+ * Everything that belongs to one emulated machine. Independent machines
+ * can be used at the same time, e.g. from different threads.
+ */
+typedef struct zx_machine {
+	/** CPU */
+	z80_t cpu;
+	/** Device event scheduler */
+	evsched_t sched;
+	/** First AY */
+	ay_t ay;
+	/** First AY enabled */
+	bool ay_enable;
+	/** First Kempston joystick */
+	kempston_joy_t kjoy;
+	/** First Kempston joystick enabled */
+	bool kjoy_enable;
+	/** Debugger */
+	debugger_t dbg;
+	/** MIDI port */
+	midi_port_t midi;
+	/** RS-232 port */
+	rs232_t rs232;
+	/** Virtual tape deck */
+	tape_deck_t *tape_deck;
+	/** Keyboard */
+	zx_keys_t keys;
+
+	/** Memory and I/O */
+	zx_mem_t mem;
+	/** ROM traps */
+	romtraps_t romtraps;
+	/** Spec256 GPUs */
+	zx_gpu_t gpu;
+	/** Video */
+	zx_video_t video;
+	/** Sound */
+	zx_sound_t snd;
+
+	/** Load tapes in real time (no LD-BYTES trap) */
+	int slow_load;
+	/** Warp mode (run as fast as possible) enabled by user */
+	bool warp_mode;
+	/** Engage warp mode while the tape is playing (with quick load off) */
+	bool warp_auto;
+	/** Warp mode is currently in effect */
+	bool warp_on;
+	/** Fields until the next field drawn in warp mode */
+	int warp_field;
+	/** A field was drawn in warp mode and has not been shown yet */
+	bool warp_drawn;
+	/** The current field is not drawn (e.g. the host is falling behind) */
+	bool field_skip;
+	/** Running speculatively, output to the host is discarded */
+	bool speculative;
+
+	/** Stop runs of instructions before reaching stop_pc */
+	bool stop_pc_enabled;
+	/** Address to stop at (headless mode) */
+	uint16_t stop_pc;
+	/** Collect instruction statistics */
+	bool stat_enabled;
+	/** Record executed addresses */
+	bool xmap_enabled;
+	/** Executed addresses (one bit per address) or @c NULL */
+	uint8_t *xmap;
+	/** Log executed instructions */
+	bool xtrace_enabled;
+
+	/** I/O recording */
+	iorec_t *iorec;
+	/** RZX input recording or playback */
+	rzx_t *rzx;
+	/** Result of the last RZX frame (ENOENT at end of playback) */
+	int rzx_rc;
+
+	/** Host display update is due */
+	bool disp_due;
+	/** Audio output event (generates a batch of samples) */
+	evsched_event_t snd_ev;
+	/** Clock value of the next audio sample to generate */
+	unsigned long snd_clock;
+	/** Tape sample event */
+	evsched_event_t tape_ev;
+	/** End of video field event */
+	evsched_event_t field_ev;
+	/** Host display update event */
+	evsched_event_t disp_ev;
+	/** Last tape sample */
+	uint8_t tape_smp;
+} zx_machine_t;
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Sound types
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TYPES_ZX_SOUND_H
+#define TYPES_ZX_SOUND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "rwave.h"
+
+/** Function receiving generated audio samples */
+typedef void (*zx_sound_sink_t)(void *, const uint8_t *, size_t);
+
+/** Sound of the machine */
+typedef struct {
+	/** Block of samples being generated */
+	uint8_t *buf;
+	/** Size of block in samples */
+	int bufs;
+	/** Number of samples in the block */
+	int bff;
+	/** Audio capture or @c NULL */
+	rwavew_t *rwave;
+	/** Do not send audio to the output device */
+	bool mute;
+	/** Audio output device is open */
+	bool output;
+	/** Discard samples (not part of the canonical timeline) */
+	bool discard;
+	/** Hash of all generated samples */
+	uint32_t hash;
+	/** Function receiving generated samples (or @c NULL) */
+	zx_sound_sink_t sink;
+	/** Argument to sink */
+	void *sink_arg;
+} zx_sound_t;
+
+#endif
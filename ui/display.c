@@ -29,6 +29,7 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stddef.h>
 #include "../video/display.h"
 #include "../mgfx.h"
 #include "../gzx.h"
@@ -59,7 +60,7 @@ static void display_prev_opt(int l)
 {
 	switch (l) {
 	case 0:
-		zx_scr_set_area(video_area_prev(video_out_area));
+		zx_scr_set_area(zx0, video_area_prev(zx0->video.area));
 		break;
 	case 1:
 		gzx_toggle_dbl_ln();
@@ -74,7 +75,7 @@ static void display_next_opt(int l)
 {
 	switch (l) {
 	case 0:
-		zx_scr_set_area(video_area_next(video_out_area));
+		zx_scr_set_area(zx0, video_area_next(zx0->video.area));
 		break;
 	case 1:
 		gzx_toggle_dbl_ln();
@@ -89,7 +90,7 @@ static const char *display_get_opt(int l)
 {
 	switch (l) {
 	case 0:
-		return video_area_str(video_out_area);
+		return video_area_str(zx0->video.area);
 	case 1:
 		return dbl_ln ? "On" : "Off";
 	case 2:
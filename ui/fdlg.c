@@ -108,7 +108,7 @@ void select_tapefile_dialog(void)
 	if (file_sel(&fname, "Select Tapefile") > 0) {
 		fprintf(logfi, "selecting tape file\n");
 		fflush(logfi);
-		(void) tape_deck_open(tape_deck, fname);
+		(void) tape_deck_open(zx0->tape_deck, fname);
 		fprintf(logfi, "freeing filename\n");
 		fflush(logfi);
 		free(fname);
@@ -121,7 +121,7 @@ void load_snap_dialog(void)
 	char *fname;
 
 	if (file_sel(&fname, "Load Snapshot") > 0) {
-		zx_load_snap(fname);
+		zx_load_snap(zx0, fname);
 		free(fname);
 	}
 }
@@ -136,7 +136,7 @@ void save_snap_dialog(void)
 	if (rc != 0)
 		return;
 
-	zx_save_snap(fname);
+	zx_save_snap(zx0, fname);
 	free(fname);
 }
 
@@ -150,7 +150,7 @@ void save_tape_as_dialog(void)
 	if (rc != 0)
 		return;
 
-	tape_deck_save_as(tape_deck, fname);
+	tape_deck_save_as(zx0->tape_deck, fname);
 	free(fname);
 }
 
@@ -164,6 +164,6 @@ void rec_audio_dialog(void)
 	if (rc != 0)
 		return;
 
-	zx_sound_start_capture(fname);
+	zx_sound_start_capture(zx0, fname);
 	free(fname);
 }
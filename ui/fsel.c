@@ -35,9 +35,9 @@
 #include <limits.h>
 
 #include "fsel.h"
-#include "../gzx.h"
 #include "../mgfx.h"
 #include "../sys_all.h"
+#include "../zx.h"
 #include "teline.h"
 
 #ifdef __MINGW32__
@@ -31,8 +31,8 @@
 
 #include <stdlib.h>
 
-#include "../gzx.h"
 #include "../memio.h"
+#include "../gzx.h"
 #include "../mgfx.h"
 #include "../video/ula.h"
 #include "../z80g.h"
@@ -74,22 +74,23 @@ static void hwopts_prev_opt(int l)
 {
 	switch (l) {
 	case 0:
-		if (mem_model > ZXM_48K) {
-			zx_select_memmodel(mem_model - 1);
-			zx_reset();
+		if (zx0->mem.model > ZXM_48K) {
+			zx_select_memmodel(zx0, zx0->mem.model - 1);
+			zx_reset(zx0);
 		}
 		break;
 	case 1:
-		ay0_enable = !ay0_enable;
+		zx0->ay_enable = !zx0->ay_enable;
 		break;
 	case 2:
-		kjoy0_enable = !kjoy0_enable;
+		zx0->kjoy_enable = !zx0->kjoy_enable;
 		break;
 	case 3:
-		video_ula_enable_plus(&video_ula, !video_ula.plus_enable);
+		video_ula_enable_plus(&zx0->video.ula,
+		    !zx0->video.ula.plus_enable);
 		break;
 	case 4:
-		gpu_set_allow(!gpu_allow);
+		gpu_set_allow(zx0, !zx0->gpu.allow);
 		break;
 	}
 }
@@ -98,22 +99,23 @@ static void hwopts_next_opt(int l)
 {
 	switch (l) {
 	case 0:
-		if (mem_model < ZXM_PLUS2A) {
-			zx_select_memmodel(mem_model + 1);
-			zx_reset();
+		if (zx0->mem.model < ZXM_PLUS2A) {
+			zx_select_memmodel(zx0, zx0->mem.model + 1);
+			zx_reset(zx0);
 		}
 		break;
 	case 1:
-		ay0_enable = !ay0_enable;
+		zx0->ay_enable = !zx0->ay_enable;
 		break;
 	case 2:
-		kjoy0_enable = !kjoy0_enable;
+		zx0->kjoy_enable = !zx0->kjoy_enable;
 		break;
 	case 3:
-		video_ula_enable_plus(&video_ula, !video_ula.plus_enable);
+		video_ula_enable_plus(&zx0->video.ula,
+		    !zx0->video.ula.plus_enable);
 		break;
 	case 4:
-		gpu_set_allow(!gpu_allow);
+		gpu_set_allow(zx0, !zx0->gpu.allow);
 		break;
 	}
 }
@@ -138,15 +140,15 @@ static const char *hwopts_get_opt(int l)
 {
 	switch (l) {
 	case 0:
-		return hwopts_model_str(mem_model);
+		return hwopts_model_str(zx0->mem.model);
 	case 1:
-		return ay0_enable ? "On" : "Off";
+		return zx0->ay_enable ? "On" : "Off";
 	case 2:
-		return kjoy0_enable ? "On" : "Off";
+		return zx0->kjoy_enable ? "On" : "Off";
 	case 3:
-		return video_ula.plus_enable ? "On" : "Off";
+		return zx0->video.ula.plus_enable ? "On" : "Off";
 	case 4:
-		return gpu_allow ? "Auto" : "Off";
+		return zx0->gpu.allow ? "Auto" : "Off";
 	default:
 		return NULL;
 	}
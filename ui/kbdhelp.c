@@ -31,7 +31,6 @@
 
 #include <stdbool.h>
 #include "../fnt.h"
-#include "../gzx.h"
 #include "../mgfx.h"
 #include "../sys_all.h"
 #include "font.h"
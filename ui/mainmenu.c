@@ -33,6 +33,7 @@
 #include "../memio.h"
 #include "../mgfx.h"
 #include "../version.h"
+#include "../zx.h"
 #include "display.h"
 #include "fdlg.h"
 #include "hwopts.h"
@@ -82,7 +83,7 @@ static void menu_run_line(int l)
 		tape_menu();
 		break;
 	case 5:
-		zx_reset();
+		zx_reset(zx0);
 		break;
 	case 6:
 		model_menu();
@@ -29,9 +29,10 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "../gzx.h"
 #include "../memio.h"
+#include "../gzx.h"
 #include "../mgfx.h"
+#include "../zx.h"
 #include "menu.h"
 #include "model.h"
 
@@ -54,20 +55,20 @@ static void model_run_line(int l)
 {
 	switch (l) {
 	case 0:
-		zx_select_memmodel(ZXM_48K);
-		zx_reset();
+		zx_select_memmodel(zx0, ZXM_48K);
+		zx_reset(zx0);
 		break;
 	case 1:
-		zx_select_memmodel(ZXM_128K);
-		zx_reset();
+		zx_select_memmodel(zx0, ZXM_128K);
+		zx_reset(zx0);
 		break;
 	case 2:
-		zx_select_memmodel(ZXM_PLUS2);
-		zx_reset();
+		zx_select_memmodel(zx0, ZXM_PLUS2);
+		zx_reset(zx0);
 		break;
 	case 3:
-		zx_select_memmodel(ZXM_PLUS2A);
-		zx_reset();
+		zx_select_memmodel(zx0, ZXM_PLUS2A);
+		zx_reset(zx0);
 		break;
 	}
 }
@@ -99,5 +100,5 @@ static menu_t model_menu_spec = {
 /** Hardware options menu */
 void model_menu(void)
 {
-	menu_run(&model_menu_spec, mem_model);
+	menu_run(&model_menu_spec, zx0->mem.model);
 }
@@ -37,7 +37,7 @@
 #include "menu.h"
 #include "tapemenu.h"
 
-#define TMENU_NENT 7
+#define TMENU_NENT 9
 
 static const char *tmentry_text[TMENU_NENT] = {
 	"~Play",
@@ -46,37 +46,45 @@ static const char *tmentry_text[TMENU_NENT] = {
 	"~Quick Tape",
 	"~New",
 	"Sa~ve",
-	"Save ~As"
+	"Save ~As",
+	"~Warp",
+	"Warp on ~Load"
 };
 
 static int tmkeys[TMENU_NENT] = {
-	WKEY_P, WKEY_S, WKEY_R, WKEY_Q, WKEY_N, WKEY_V, WKEY_A
+	WKEY_P, WKEY_S, WKEY_R, WKEY_Q, WKEY_N, WKEY_V, WKEY_A, WKEY_W, WKEY_L
 };
 
 static void tmenu_run_line(int l)
 {
 	switch (l) {
 	case 0:
-		tape_deck_play(tape_deck);
+		tape_deck_play(zx0->tape_deck);
 		break;
 	case 1:
-		tape_deck_stop(tape_deck);
+		tape_deck_stop(zx0->tape_deck);
 		break;
 	case 2:
-		tape_deck_rewind(tape_deck);
+		tape_deck_rewind(zx0->tape_deck);
 		break;
 	case 3:
-		slow_load = !slow_load;
+		zx0->slow_load = !zx0->slow_load;
 		break;
 	case 4:
-		tape_deck_new(tape_deck);
+		tape_deck_new(zx0->tape_deck);
 		break;
 	case 5:
-		tape_deck_save(tape_deck);
+		tape_deck_save(zx0->tape_deck);
 		break;
 	case 6:
 		save_tape_as_dialog();
 		break;
+	case 7:
+		zx0->warp_mode = !zx0->warp_mode;
+		break;
+	case 8:
+		zx0->warp_auto = !zx0->warp_auto;
+		break;
 	}
 }
 
@@ -84,7 +92,13 @@ static void tmenu_prev_opt(int l)
 {
 	switch (l) {
 	case 3:
-		slow_load = !slow_load;
+		zx0->slow_load = !zx0->slow_load;
+		break;
+	case 7:
+		zx0->warp_mode = !zx0->warp_mode;
+		break;
+	case 8:
+		zx0->warp_auto = !zx0->warp_auto;
 		break;
 	}
 }
@@ -93,7 +107,13 @@ static void tmenu_next_opt(int l)
 {
 	switch (l) {
 	case 3:
-		slow_load = !slow_load;
+		zx0->slow_load = !zx0->slow_load;
+		break;
+	case 7:
+		zx0->warp_mode = !zx0->warp_mode;
+		break;
+	case 8:
+		zx0->warp_auto = !zx0->warp_auto;
 		break;
 	}
 }
@@ -102,7 +122,11 @@ static const char *tmenu_get_opt(int l)
 {
 	switch (l) {
 	case 3:
-		return slow_load ? "Off" : "On";
+		return zx0->slow_load ? "Off" : "On";
+	case 7:
+		return zx0->warp_mode ? "On" : "Off";
+	case 8:
+		return zx0->warp_auto ? "On" : "Off";
 	default:
 		return NULL;
 	}
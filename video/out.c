@@ -30,6 +30,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "../mgfx.h"
 #include "out.h"
 
@@ -45,8 +46,33 @@
 void video_out_rect(video_out_t *vout, int x0, int y0, int x1, int y1,
     uint8_t color)
 {
-	mgfx_fillrect(vout->x0 + x0, vout->y0 + y0, vout->x0 + x1,
-	    vout->y0 + y1, color);
+	int y;
+
+	if (vout->image == NULL) {
+		mgfx_fillrect(vout->x0 + x0, vout->y0 + y0, vout->x0 + x1,
+		    vout->y0 + y1, color);
+		return;
+	}
+
+	x0 += vout->x0;
+	y0 += vout->y0;
+	x1 += vout->x0;
+	y1 += vout->y0;
+
+	if (x0 < 0)
+		x0 = 0;
+	if (y0 < 0)
+		y0 = 0;
+	if (x1 > vout->image_w - 1)
+		x1 = vout->image_w - 1;
+	if (y1 > vout->image_h - 1)
+		y1 = vout->image_h - 1;
+	if (x1 < x0)
+		return;
+
+	for (y = y0; y <= y1; y++)
+		memset(vout->image + y * vout->image_w + x0, color,
+		    x1 - x0 + 1);
 }
 
 /** Render pixel to video output.
@@ -58,8 +84,18 @@ void video_out_rect(video_out_t *vout, int x0, int y0, int x1, int y1,
  */
 void video_out_pixel(video_out_t *vout, int x, int y, uint8_t color)
 {
-	mgfx_setcolor(color);
-	mgfx_drawpixel(vout->x0 + x, vout->y0 + y);
+	if (vout->image == NULL) {
+		mgfx_setcolor(color);
+		mgfx_drawpixel(vout->x0 + x, vout->y0 + y);
+		return;
+	}
+
+	x += vout->x0;
+	y += vout->y0;
+	if (x < 0 || y < 0 || x >= vout->image_w || y >= vout->image_h)
+		return;
+
+	vout->image[y * vout->image_w + x] = color;
 }
 
 /** Signal end of current field.
@@ -73,13 +109,15 @@ void video_out_end_field(video_out_t *vout)
 	vout->field_no ^= 1;
 
 	/* Enable rendering odd/even lines for the next field */
-	mgfx_selln(1 << vout->field_no);
+	if (vout->image == NULL)
+		mgfx_selln(1 << vout->field_no);
 }
 
 /** Set the color palette.
  *
  * This is used to set the entire color palette at once. This replaces
  * any previous color palette entirely (even if less colors are used).
+ * An image has no palette of its own, only the host display does.
  *
  * @param vout Video output
  * @param ncolors Number of colors in palette
@@ -90,6 +128,9 @@ void video_out_set_palette(video_out_t *vout, int ncolors, uint8_t *pal)
 	int ipal[3 * 256];
 	int i;
 
+	if (vout->image != NULL)
+		return;
+
 	for (i = 0; i < 3 * ncolors; i++)
 		ipal[i] = pal[i];
 
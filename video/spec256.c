@@ -35,11 +35,9 @@
 #include <string.h>
 #include "defs.h"
 #include "../clock.h"
-#include "../gzx.h"
-#include "../memio.h"
 #include "../sys_all.h"
-#include "../xtrace.h"
-#include "../z80g.h"
+#include "../types/memio.h"
+#include "../zx.h"
 #include "out.h"
 #include "spec256.h"
 
@@ -90,7 +88,7 @@ static void video_spec256_disp_fast_elem(video_spec256_t *spec, int x, int y)
 	for (i = 0; i < 8; i++) {
 		b = 0;
 		for (j = 0; j < 8; j++) {
-			if (gfxscr[j][offs] & (1 << (7 - i)))
+			if (spec->gfxscr[j][offs] & (1 << (7 - i)))
 				b |= (1 << j);
 		}
 		if (b != 0) {
@@ -127,19 +125,20 @@ void video_spec256_disp_fast(video_spec256_t *spec)
 	 */
 
 	/* top + corners */
-	video_out_rect(spec->vout, 0, 0, zx_field_w - 1, zx_paper_y0 - 1, border);
+	video_out_rect(spec->vout, 0, 0, zx_field_w - 1, zx_paper_y0 - 1,
+	    spec->mem->border);
 
 	/* bottom + corners */
 	video_out_rect(spec->vout, 0, zx_paper_y1, zx_field_w - 1,
-	    zx_field_h - 1, border);
+	    zx_field_h - 1, spec->mem->border);
 
 	/* left */
 	video_out_rect(spec->vout, 0, zx_paper_y0, zx_paper_x0 - 1,
-	    zx_paper_y1, border);
+	    zx_paper_y1, spec->mem->border);
 
 	/* right */
 	video_out_rect(spec->vout, zx_paper_x1, zx_paper_y0, zx_field_w - 1,
-	    zx_paper_y1, border);
+	    zx_paper_y1, spec->mem->border);
 
 	/*
 	 * Draw paper
@@ -151,25 +150,29 @@ void video_spec256_disp_fast(video_spec256_t *spec)
 
 	spec->clock += ULA_FIELD_TICKS;
 
-#ifdef XTRACE
-	xtrace_int();
-#endif
-	z80_int();
-
-	if (gpu_is_on())
-		z80_g_int();
+	spec->field_end(spec->field_end_arg);
 }
 
 /** Initialize Spec256 video generator.
  *
  * @param spec Spec256 video generator
  * @param vout Video output
+ * @param mem Memory (border)
+ * @param gfxscr Screen of each GPU memory plane
+ * @param field_end Function called at the end of each field
+ * @param arg Argument to @a field_end
  * @return Zero on success or an error code
  */
-int video_spec256_init(video_spec256_t *spec, video_out_t *vout)
+int video_spec256_init(video_spec256_t *spec, video_out_t *vout,
+    const struct zx_mem *mem, uint8_t *const *gfxscr,
+    void (*field_end)(void *), void *arg)
 {
 	spec->gfxpal = NULL;
 	spec->vout = vout;
+	spec->mem = mem;
+	spec->gfxscr = gfxscr;
+	spec->field_end = field_end;
+	spec->field_end_arg = arg;
 	spec->background = NULL;
 	spec->cur_bg = -1;
 	spec->clock = 0;
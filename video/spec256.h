@@ -31,10 +31,12 @@
 #ifndef VIDEO_SPEC256_H
 #define VIDEO_SPEC256_H
 
+#include <stdint.h>
 #include "../types/video/out.h"
 #include "../types/video/spec256.h"
 
-extern int video_spec256_init(video_spec256_t *, video_out_t *);
+extern int video_spec256_init(video_spec256_t *, video_out_t *,
+    const struct zx_mem *, uint8_t *const *, void (*)(void *), void *);
 extern int video_spec256_init_pal(video_spec256_t *);
 extern int video_spec256_load_bg(video_spec256_t *, const char *, int);
 extern void video_spec256_prev_bg(video_spec256_t *);
@@ -34,15 +34,11 @@
 #include <stdlib.h>
 #include "defs.h"
 #include "../clock.h"
-#include "../memio.h"
-#include "../xtrace.h"
-#include "../z80.h"
+#include "../types/memio.h"
 #include "out.h"
 #include "ula.h"
 #include "ulaplus.h"
 
-#include "../z80g.h"
-
 /* 64 scanline times pass before paper starts - 48 lines of border are displayed */
 #define SCR_SCAN_TOP     16
 /* 16 skip + 48 top border+192 screen+48 bottom border */
@@ -139,13 +135,7 @@ static void video_ula_next_field(video_ula_t *ula)
 		ula->fl_rev = !ula->fl_rev;
 	}
 
-#ifdef XTRACE
-	xtrace_int();
-#endif
-	z80_int();
-
-	if (gpu_is_on())
-		z80_g_int();
+	ula->field_end(ula->field_end_arg);
 }
 
 /** Crude and fast ULA display routine, called 50 times a second.
@@ -167,19 +157,20 @@ void video_ula_disp_fast(video_ula_t *ula)
 	 */
 
 	/* top + corners */
-	video_out_rect(ula->vout, 0, 0, zx_field_w - 1, zx_paper_y0 - 1, border);
+	video_out_rect(ula->vout, 0, 0, zx_field_w - 1, zx_paper_y0 - 1,
+	    ula->mem->border);
 
 	/* bottom + corners */
 	video_out_rect(ula->vout, 0, zx_paper_y1, zx_field_w - 1,
-	    zx_field_h - 1, border);
+	    zx_field_h - 1, ula->mem->border);
 
 	/* left */
 	video_out_rect(ula->vout, 0, zx_paper_y0, zx_paper_x0 - 1,
-	    zx_paper_y1, border);
+	    zx_paper_y1, ula->mem->border);
 
 	/* right */
 	video_out_rect(ula->vout, zx_paper_x1, zx_paper_y0,
-	    zx_field_w - 1, zx_paper_y1, border);
+	    zx_field_w - 1, zx_paper_y1, ula->mem->border);
 
 	/*
 	 * Draw paper
@@ -187,11 +178,11 @@ void video_ula_disp_fast(video_ula_t *ula)
 
 	for (y = 0; y < 24; y++) {
 		for (x = 0; x < 32; x++) {
-			attr = zxscr[ZX_ATTR_START + y * 32 + x];
+			attr = ula->mem->scr[ZX_ATTR_START + y * 32 + x];
 			video_ula_attr_to_colors(ula, attr, &fgc, &bgc);
 
 			for (yy = 0; yy < 8; yy++) {
-				a = zxscr[ZX_PIXEL_START +
+				a = ula->mem->scr[ZX_PIXEL_START +
 				    vxswapb((y * 8 + yy) * 32 + x)];
 				for (xx = 0; xx < 8; xx++) {
 					b = (a & 0x80);
@@ -229,8 +220,8 @@ static void scr_dispscrelem(video_ula_t *ula, int x, int y)
 	col = (x - zx_paper_x0) >> 3;
 	line = y - zx_paper_y0;
 
-	attr = zxscr[ZX_ATTR_START + (line >> 3) * 32 + col];
-	pix = zxscr[ZX_PIXEL_START + vxswapb(line * 32 + col)];
+	attr = ula->mem->scr[ZX_ATTR_START + (line >> 3) * 32 + col];
+	pix = ula->mem->scr[ZX_PIXEL_START + vxswapb(line * 32 + col)];
 
 	/*
 	 * In reality attr/pix are read at different times and we can get
@@ -257,7 +248,7 @@ static void scr_dispscrelem(video_ula_t *ula, int x, int y)
  */
 static void scr_dispbrdelem(video_ula_t *ula, int x, int y)
 {
-	video_out_rect(ula->vout, x, y, x + 7, y, border);
+	video_out_rect(ula->vout, x, y, x + 7, y, ula->mem->border);
 	ula->idle_bus_byte = 0xff;
 }
 
@@ -286,16 +277,54 @@ void video_ula_disp(video_ula_t *ula)
 		video_ula_next_field(ula);
 }
 
+/** Fast-forward ULA video generator (used in warp mode).
+ *
+ * Advance the video generator up to @a clock without drawing anything
+ * until the end of the field is reached. The field that has ended
+ * is then optionally drawn all at once.
+ *
+ * @param ula ULA video generator
+ * @param clock Z80 clock value
+ * @param draw Draw the field if it has ended
+ * @return @c true iff the end of field was reached
+ */
+bool video_ula_warp(video_ula_t *ula, unsigned long clock, bool draw)
+{
+	/* Already ahead */
+	if (CLOCK_GE(ula->cbase + ula->clock, clock))
+		return false;
+
+	/* Field ends after the 4T step starting at ULA_FIELD_TICKS - 4 */
+	if (CLOCK_GE(ula->cbase + ULA_FIELD_TICKS - 4, clock)) {
+		/* Same step position as video_ula_disp() would reach */
+		ula->clock = (clock - ula->cbase + 3) & ~3UL;
+		return false;
+	}
+
+	if (draw)
+		video_ula_disp_fast(ula);
+	else
+		video_ula_next_field(ula);
+	return true;
+}
+
 /** Initialize ULA video generator.
  *
  * @param ula ULA video generator
  * @param clock Initial clock value
  * @param vout Video output
+ * @param mem Memory to display
+ * @param field_end Function called at the end of each field
+ * @param arg Argument to @a field_end
  * @return Zero on success or an error code
  */
-int video_ula_init(video_ula_t *ula, unsigned long clock, video_out_t *vout)
+int video_ula_init(video_ula_t *ula, unsigned long clock, video_out_t *vout,
+    const struct zx_mem *mem, void (*field_end)(void *), void *arg)
 {
 	ula->vout = vout;
+	ula->mem = mem;
+	ula->field_end = field_end;
+	ula->field_end_arg = arg;
 
 	ula->clock = 0;
 	ula->cbase = clock;
@@ -36,10 +36,12 @@
 #include "../types/video/out.h"
 #include "../types/video/ula.h"
 
-extern int video_ula_init(video_ula_t *, unsigned long, video_out_t *);
+extern int video_ula_init(video_ula_t *, unsigned long, video_out_t *,
+    const struct zx_mem *, void (*)(void *), void *);
 extern void video_ula_reset(video_ula_t *);
 extern void video_ula_disp_fast(video_ula_t *);
 extern void video_ula_disp(video_ula_t *);
+extern bool video_ula_warp(video_ula_t *, unsigned long, bool);
 extern void video_ula_setpal(video_ula_t *);
 extern unsigned long video_ula_get_clock(video_ula_t *);
 extern void video_ula_enable_plus(video_ula_t *, bool);
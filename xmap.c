@@ -29,47 +29,67 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "xmap.h"
 #include "z80.h"
+#include "zx.h"
 
-#ifdef XMAP
+/** Size of the execution map in bytes (one bit per address) */
+#define XMAP_SIZE (8 * 1024)
 
-static uint8_t xmap[8 * 1024];
-
-void xmap_clear(void)
+/** Start recording executed addresses.
+ *
+ * @param zx Machine
+ * @return Zero on success, ENOMEM if out of memory
+ */
+int xmap_enable(zx_machine_t *zx)
 {
-	unsigned u;
+	if (zx->xmap == NULL) {
+		zx->xmap = calloc(XMAP_SIZE, 1);
+		if (zx->xmap == NULL)
+			return ENOMEM;
+	}
 
-	for (u = 0; u < 8 * 1024; u++)
-		xmap[u] = 0;
+	zx->xmap_enabled = true;
+	return 0;
 }
 
-void xmap_mark(void)
+void xmap_clear(zx_machine_t *zx)
+{
+	if (zx->xmap != NULL)
+		memset(zx->xmap, 0, XMAP_SIZE);
+}
+
+void xmap_mark(zx_machine_t *zx)
 {
 	uint8_t mask;
 	unsigned offs;
 
-	mask = 1 << (cpus.PC & 7);
-	offs = cpus.PC >> 3;
-	xmap[offs] = xmap[offs] | mask;
+	mask = 1 << (zx->cpu.cpus.PC & 7);
+	offs = zx->cpu.cpus.PC >> 3;
+	zx->xmap[offs] = zx->xmap[offs] | mask;
 }
 
-void xmap_save(void)
+void xmap_save(zx_machine_t *zx)
 {
 	FILE *f;
 	unsigned u, v;
 
+	if (zx->xmap == NULL)
+		return;
+
 	f = fopen("xmap.txt", "wt");
-	for (u = 0; u < 8 * 1024; u++) {
+	for (u = 0; u < XMAP_SIZE; u++) {
 		fprintf(f, "%04X ", u * 8);
 		for (v = 0; v < 8; v++) {
-			fputc((xmap[u] & (1 << v)) ? '1' : '0', f);
+			fputc((zx->xmap[u] & (1 << v)) ? '1' : '0', f);
 			fputc(v < 7 ? ',' : '\n', f);
 		}
 	}
 	fclose(f);
 }
-
-#endif
@@ -32,8 +32,11 @@
 #ifndef XMAP_H
 #define XMAP_H
 
-extern void xmap_clear(void);
-extern void xmap_mark(void);
-extern void xmap_save(void);
+#include "types/zx.h"
+
+extern int xmap_enable(zx_machine_t *);
+extern void xmap_clear(zx_machine_t *);
+extern void xmap_mark(zx_machine_t *);
+extern void xmap_save(zx_machine_t *);
 
 #endif
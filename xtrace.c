@@ -29,45 +29,49 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include "disasm.h"
-#include "gzx.h"
 #include "memio.h"
 #include "xtrace.h"
 #include "z80.h"
+#include "zx.h"
 
-static void xtrace_fprintregs(FILE *f)
+static void xtrace_fprintregs(zx_machine_t *zx, FILE *f)
 {
+	z80_t *cpu = &zx->cpu;
+
 	fprintf(f, "AF %04x BC %04x DE %04x HL %04x IX %04x PC %04x R %02d (HL)%02x Pg%02x\n",
-	    z80_getAF() & 0xffd7, z80_getBC(), z80_getDE(), z80_getHL(),
-	    cpus.IX, cpus.PC, cpus.R, zx_memget8(z80_getHL()), page_reg);
+	    z80_getAF(cpu) & 0xffd7, z80_getBC(cpu), z80_getDE(cpu), z80_getHL(cpu),
+	    cpu->cpus.IX, cpu->cpus.PC, cpu->cpus.R, zx_memget8(zx, z80_getHL(cpu)),
+	    zx->mem.page_reg);
 	fprintf(f, "AF'%04x BC'%04x DE'%04x HL'%04x IY %04x SP'%04x I%02d IFF%d%d IM%d\n",
-	    z80_getAF_() & 0xffd7, z80_getBC_(), z80_getDE_(), z80_getHL_(), cpus.IY,
-	    cpus.SP, cpus.I, cpus.IFF1, cpus.IFF2, cpus.int_mode);
+	    z80_getAF_(cpu) & 0xffd7, z80_getBC_(cpu), z80_getDE_(cpu), z80_getHL_(cpu), cpu->cpus.IY,
+	    cpu->cpus.SP, cpu->cpus.I, cpu->cpus.IFF1, cpu->cpus.IFF2, cpu->cpus.int_mode);
 }
 
-static void xtrace_fprintinstr(FILE *f)
+static void xtrace_fprintinstr(zx_machine_t *zx, FILE *f)
 {
-	disasm_org = cpus.PC;
-	if (disasm_instr() == 0)
-		fprintf(f, "%04x: %s\n", cpus.PC, disasm_buf);
+	disasm_org = zx->cpu.cpus.PC;
+	if (disasm_instr(zx) == 0)
+		fprintf(f, "%04x: %s\n", zx->cpu.cpus.PC, disasm_buf);
 }
 
 /** Log an instruction that is about to be executed. */
-void xtrace_instr(void)
+void xtrace_instr(zx_machine_t *zx)
 {
-	xtrace_fprintregs(logfi);
-	xtrace_fprintinstr(logfi);
+	xtrace_fprintregs(zx, logfi);
+	xtrace_fprintinstr(zx, logfi);
 }
 
 /** Log that the emulator is resetting the machine. */
-void xtrace_reset(void)
+void xtrace_reset(zx_machine_t *zx)
 {
 	fprintf(logfi, "** Resetting the machine **\n");
 }
 
 /** Log that an interrupt has been raised. */
-void xtrace_int(void)
+void xtrace_int(zx_machine_t *zx)
 {
 	fprintf(logfi, "** Raising interrupt **\n");
 }
@@ -32,8 +32,10 @@
 #ifndef XTRACE_H
 #define XTRACE_H
 
-extern void xtrace_instr(void);
-extern void xtrace_reset(void);
-extern void xtrace_int(void);
+#include "types/zx.h"
+
+extern void xtrace_instr(zx_machine_t *);
+extern void xtrace_reset(zx_machine_t *);
+extern void xtrace_int(zx_machine_t *);
 
 #endif
@@ -49,52 +49,111 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "z80.h"
 #include "z80dep.h"
 
-static void z80_readinstr(void);
-static void z80_check_nmi(void);
-static void z80_check_int(void);
+/*
+ * If Z80THREADED is defined, use threaded-code (computed goto) instruction
+ * dispatch where the compiler supports it. It is not faster than calling
+ * the handlers through the decode tables with GCC 12 on x86-64, so it is
+ * not used by default.
+ */
+#if defined(__GNUC__) && defined(Z80THREADED)
+#define Z80_THREADED
+#endif
 
-static uint8_t opcode;
-z80s cpus;
-/** CPU state used to read memory addresses from. Used by Spec256. */
-z80s *rcpus = &cpus;
-static uint8_t cbop;
-unsigned long z80_clock;
+/*
+ * If Z80JIT is defined, hot code is translated to x86-64 machine code
+ * (see z80jit.c). This needs GCC or Clang on x86-64 Unix, and the exact
+ * clock and undocumented behavior that the translator reproduces.
+ */
+#if defined(__GNUC__) && defined(Z80JIT) && defined(__x86_64__) && \
+    defined(__unix__) && !defined(NO_Z80CLOCK) && !defined(NO_Z80UNDOC)
+#define Z80_JIT
+#endif
+
+static void z80_check_nmi(z80_t *z);
+static void z80_check_int(z80_t *z);
 
-/* debugging & statistics */
-unsigned long uoc;	/* unsupported opcode counter */
-unsigned long smc;	/* stray modifier counter */
+#ifndef Z80_THREADED
 static uint8_t prefix1,prefix2;
+#endif
+
+static inline uint8_t z80_memget8(z80_t *z, uint16_t addr)
+{
+	return z->rdpg[addr >> Z80_PG_SHIFT][addr & (Z80_PG_SIZE - 1)];
+}
 
-static void (*const *ei_tab)(void);
+static inline uint8_t z80_imemget8(z80_t *z, uint16_t addr)
+{
+	return z->rdpg[addr >> Z80_PG_SHIFT][addr & (Z80_PG_SIZE - 1)];
+}
 
-#ifndef NO_Z80STAT
-static unsigned stat_tab[7][256];
-static int stat_i;
-#endif
+static inline void z80_memset8(z80_t *z, uint16_t addr, uint8_t val)
+{
+	uint8_t *pg = z->wrpg[addr >> Z80_PG_SHIFT];
+
+	if (pg != NULL)
+		pg[addr & (Z80_PG_SIZE - 1)] = val;
+	else
+		z->ops->memset8(z->arg, addr, val);
+}
+
+static inline uint8_t *z80_mem_direct(z80_t *z, uint16_t addr, uint16_t len,
+    int write)
+{
+	return z->ops->mem_direct(z->arg, addr, len, write);
+}
+
+static inline uint8_t z80_in8(z80_t *z, uint16_t addr)
+{
+	return z->ops->in8(z->arg, addr);
+}
+
+static inline void z80_out8(z80_t *z, uint16_t addr, uint8_t val)
+{
+	z->ops->out8(z->arg, addr, val);
+}
+
+static inline uint8_t z80_snoop8(z80_t *z)
+{
+	return z->ops->snoop8(z->arg);
+}
+
+static inline int z80_code_break(z80_t *z, uint16_t addr)
+{
+	if (z->brkpg[addr >> Z80_PG_SHIFT] == 0)
+		return 0;
+
+	return z->ops->code_break(z->arg, addr);
+}
+
+static inline void z80_trace_instr(z80_t *z)
+{
+	z->ops->trace_instr(z->arg);
+}
 
 /* fast flag computation lookup table */
 static uint8_t ox_tab[256]; /* OR,XOR and more */
 
-static uint16_t z80_memget16(uint16_t addr) {
-  return (uint16_t)z80_memget8(addr)+(((uint16_t)z80_memget8(addr+1))<<8);
+static uint16_t z80_memget16(z80_t *z, uint16_t addr) {
+  return (uint16_t)z80_memget8(z, addr)+(((uint16_t)z80_memget8(z, addr+1))<<8);
 }
 
-static uint16_t z80_imemget16(uint16_t addr) {
-  return (uint16_t)z80_imemget8(addr)+(((uint16_t)z80_imemget8(addr+1))<<8);
+static uint16_t z80_imemget16(z80_t *z, uint16_t addr) {
+  return (uint16_t)z80_imemget8(z, addr)+(((uint16_t)z80_imemget8(z, addr+1))<<8);
 }
 
-static void z80_memset16(uint16_t addr, uint16_t val) {
-  z80_memset8(addr, val & 0xff);
-  z80_memset8(addr+1, val >> 8);
+static void z80_memset16(z80_t *z, uint16_t addr, uint16_t val) {
+  z80_memset8(z, addr, val & 0xff);
+  z80_memset8(z, addr+1, val >> 8);
 }
 
-static inline void z80_clock_inc(uint8_t inc)
+static inline void z80_clock_inc(z80_t *z, uint8_t inc)
 {
 #ifndef NO_Z80CLOCK
-	z80_clock += inc;
+	z->clock += inc;
 #endif
 }
 
@@ -115,18 +174,6 @@ static int32_t u16sval(uint16_t u) {
 /*  these functions return 1 when sign overflow occurs */
 /*  (the result would be >127 or <-128) */
 
-static int add_v8(uint8_t a, uint8_t b) {
-  int16_t sign_r;
-  sign_r=u8sval(a)+u8sval(b);
-  return (sign_r<-128 || sign_r>127) ? 1 : 0;
-}
-
-static int sub_v8(uint8_t a, uint8_t b) {
-  int16_t sign_r;
-  sign_r=u8sval(a)-u8sval(b);
-  return (sign_r<-128 || sign_r>127) ? 1 : 0;
-}
-
 static int adc_v8(uint8_t a, uint8_t b, uint8_t c) {
   int16_t sign_r;
   sign_r=u8sval(a)+u8sval(b)+u8sval(c);
@@ -161,36 +208,191 @@ static int oddp8(uint8_t x) {
   return (int)(x&1);
 }
 
-static void setflags(int s, int z, int hc, int pv, int n, int c) {
-  if(s>=0) cpus.F = (cpus.F & (fS^0xff)) | (s!=0 ? fS : 0);
-  if(z>=0) cpus.F = (cpus.F & (fZ^0xff)) | (z!=0 ? fZ : 0);
-  if(hc>=0) cpus.F = (cpus.F & (fHC^0xff)) | (hc!=0 ? fHC : 0);
-  if(pv>=0) cpus.F = (cpus.F & (fPV^0xff)) | (pv!=0 ? fPV : 0);
-  if(n>=0) cpus.F = (cpus.F & (fN^0xff)) | (n!=0 ? fN : 0);
-  if(c>=0) cpus.F = (cpus.F & (fC^0xff)) | (c!=0 ? fC : 0);
-  cpus.flags_aff = 1;
+/*
+ * Lazy flag evaluation
+ *
+ * Instead of computing F after every arithmetic operation, we record
+ * the operation, its operands and result and only compute F when
+ * it is actually observed. Most of the time the flags are overwritten
+ * by another instruction before anyone looks at them. With
+ * NO_Z80LAZYFLAGS flags are computed immediately.
+ */
+
+enum {
+	/** F is up to date */
+	lf_none = 0,
+	/** 8-bit addition (ADD, ADC) */
+	lf_add8,
+	/** 8-bit subtraction (SUB, SBC) */
+	lf_sub8,
+	/** 8-bit comparison (CP) */
+	lf_cp8,
+	/** 8-bit increment (INC) */
+	lf_inc8,
+	/** 8-bit decrement (DEC) */
+	lf_dec8
+};
+
+/** Compute flags from lazy flags operation.
+ *
+ * @param s CPU state
+ * @return Value of F
+ */
+static uint8_t lazyflags_eval(z80s *s)
+{
+	uint8_t a = s->lf_a;
+	uint8_t b = s->lf_b;
+	uint8_t c = s->lf_c;
+	uint16_t res = s->lf_res;
+	uint8_t f;
+
+	f = (res & fS) | ((res & 0xff) == 0 ? fZ : 0);
+
+	switch (s->lf_op) {
+	case lf_add8:
+		if ((a & 0x0f) + (b & 0x0f) + c > 0x0f)
+			f |= fHC;
+		if (adc_v8(a, b, c))
+			f |= fPV;
+		if (res > 0xff)
+			f |= fC;
+		f |= res & fU;
+		break;
+	case lf_sub8:
+	case lf_cp8:
+		if ((a & 0x0f) - (b & 0x0f) - c < 0)
+			f |= fHC;
+		if (sbc_v8(a, b, c))
+			f |= fPV;
+		if (res > 0xff)
+			f |= fC;
+		f |= fN;
+		/* CP takes undocumented flags from the operand */
+		f |= (s->lf_op == lf_cp8 ? b : res) & fU;
+		break;
+	case lf_inc8:
+		if ((a & 0x0f) == 0x0f)
+			f |= fHC;
+		if (a == 0x7f)
+			f |= fPV;
+		f |= c | (res & fU);
+		break;
+	case lf_dec8:
+		if ((a & 0x0f) == 0)
+			f |= fHC;
+		if (a == 0x80)
+			f |= fPV;
+		f |= fN | c | (res & fU);
+		break;
+	default:
+		f = s->F;
+		break;
+	}
+
+	return f;
+}
+
+/** Make F of a CPU state reflect any pending lazy flags operation.
+ *
+ * This must be called before looking at F from outside of the CPU core.
+ *
+ * @param s CPU state
+ */
+void z80_sync_flags(z80s *s)
+{
+	if (s->lf_op != lf_none) {
+		s->F = lazyflags_eval(s);
+		s->lf_op = lf_none;
+	}
+}
+
+static void flags_sync(z80_t *z) {
+  if(z->cpus.lf_op != lf_none) z80_sync_flags(&z->cpus);
+}
+
+static uint8_t get_F(z80_t *z) {
+  flags_sync(z);
+  return z->cpus.F;
+}
+
+static void set_F(z80_t *z, uint8_t val) {
+  z->cpus.F = val;
+  z->cpus.lf_op = lf_none;
+}
+
+/* returns fC if carry flag is set, zero otherwise */
+static uint8_t flag_C(z80_t *z) {
+  switch(z->cpus.lf_op) {
+    case lf_none: return z->cpus.F & fC;
+    case lf_inc8:
+    case lf_dec8: return z->cpus.lf_c;
+    default: return z->cpus.lf_res > 0xff ? fC : 0;
+  }
+}
+
+/* returns fZ if zero flag is set, zero otherwise */
+static uint8_t flag_Z(z80_t *z) {
+  if(z->cpus.lf_op == lf_none) return z->cpus.F & fZ;
+  return (z->cpus.lf_res & 0xff) == 0 ? fZ : 0;
+}
+
+/* returns fS if sign flag is set, zero otherwise */
+static uint8_t flag_S(z80_t *z) {
+  if(z->cpus.lf_op == lf_none) return z->cpus.F & fS;
+  return z->cpus.lf_res & fS;
+}
+
+/* record lazy flags operation */
+static void lazyflags(z80_t *z, int op, uint8_t a, uint8_t b, uint8_t c, uint16_t res) {
+  z->cpus.lf_op = op;
+  z->cpus.lf_a = a;
+  z->cpus.lf_b = b;
+  z->cpus.lf_c = c;
+  z->cpus.lf_res = res;
+  z->cpus.flags_aff = 1;
+#ifdef NO_Z80LAZYFLAGS
+  flags_sync(z);
+#endif
+}
+
+static void setflags(z80_t *z, int s, int zf, int hc, int pv, int n, int c) {
+  flags_sync(z);
+  if(s>=0) z->cpus.F = (z->cpus.F & (fS^0xff)) | (s!=0 ? fS : 0);
+  if(zf>=0) z->cpus.F = (z->cpus.F & (fZ^0xff)) | (zf!=0 ? fZ : 0);
+  if(hc>=0) z->cpus.F = (z->cpus.F & (fHC^0xff)) | (hc!=0 ? fHC : 0);
+  if(pv>=0) z->cpus.F = (z->cpus.F & (fPV^0xff)) | (pv!=0 ? fPV : 0);
+  if(n>=0) z->cpus.F = (z->cpus.F & (fN^0xff)) | (n!=0 ? fN : 0);
+  if(c>=0) z->cpus.F = (z->cpus.F & (fC^0xff)) | (c!=0 ? fC : 0);
+  z->cpus.flags_aff = 1;
 }
 
 #ifndef NO_Z80UNDOC
 
-static void setundocflags8(uint8_t res) {
-  cpus.F &= fD;		/* leave only documented flags */
-  cpus.F |= (res & fU);     /* set undocumented flags */
+static void setundocflags8(z80_t *z, uint8_t res) {
+  flags_sync(z);
+  z->cpus.F &= fD;		/* leave only documented flags */
+  z->cpus.F |= (res & fU);     /* set undocumented flags */
 }
 
 #else
 
-#define setundocflags8(res) ((void)(res))
+#define setundocflags8(z, res) ((void)(res))
 
-static void ei_undoc(void)
+static void ei_undoc(z80_t *z)
 {
-	z80_clock_inc(4);
+	z80_clock_inc(z, 4);
 }
 
 #endif
 
-static void incr_R(uint8_t amount) {
-  cpus.R = (cpus.R & 0x80) | ((cpus.R+amount)&0x7f);
+static void incr_R(z80_t *z, unsigned long amount) {
+  z->cpus.R = (z->cpus.R & 0x80) | ((z->cpus.R+amount)&0x7f);
+  z->fetches += amount;
+}
+
+/* Increment R when accepting an interrupt (not counted as opcode fetches) */
+static void incr_R_int(z80_t *z, uint8_t amount) {
+  z->cpus.R = (z->cpus.R & 0x80) | ((z->cpus.R+amount)&0x7f);
 }
 
 /**************************** address register access *******************/
@@ -200,215 +402,215 @@ static void incr_R(uint8_t amount) {
  * case. If GPU is not enabled, rcpus just points to the CPU state.
  */
 
-static uint16_t get_addrBC(void)
+static uint16_t get_addrBC(z80_t *z)
 {
-  return ((uint16_t)rcpus->r[rB] << 8) | rcpus->r[rC];
+  return ((uint16_t)z->rcpus->r[rB] << 8) | z->rcpus->r[rC];
 }
 
-static uint16_t get_addrDE(void)
+static uint16_t get_addrDE(z80_t *z)
 {
-  return ((uint16_t)rcpus->r[rD] << 8) | rcpus->r[rE];
+  return ((uint16_t)z->rcpus->r[rD] << 8) | z->rcpus->r[rE];
 }
 
-static uint16_t get_addrHL(void)
+static uint16_t get_addrHL(z80_t *z)
 {
-  return ((uint16_t)rcpus->r[rH] << 8) | rcpus->r[rL];
+  return ((uint16_t)z->rcpus->r[rH] << 8) | z->rcpus->r[rL];
 }
 
-static uint16_t get_addrIX(void)
+static uint16_t get_addrIX(z80_t *z)
 {
-  return rcpus->IX;
+  return z->rcpus->IX;
 }
 
-static uint16_t get_addrIY(void)
+static uint16_t get_addrIY(z80_t *z)
 {
-  return rcpus->IY;
+  return z->rcpus->IY;
 }
 
 /**************************** operand access ***************************/
 
 /* returns (HL)(8) */
-static uint8_t _iHL8(void) {
-  return z80_memget8(get_addrHL());
+static uint8_t _iHL8(z80_t *z) {
+  return z80_memget8(z, get_addrHL(z));
 }
 
 /* returns (BC) */
-static uint8_t _iBC8(void) {
-  return z80_memget8(get_addrBC());
+static uint8_t _iBC8(z80_t *z) {
+  return z80_memget8(z, get_addrBC(z));
 }
 
 /* returns (DE) */
-static uint8_t _iDE8(void) {
-  return z80_memget8(get_addrDE());
+static uint8_t _iDE8(z80_t *z) {
+  return z80_memget8(z, get_addrDE(z));
 }
 
 /* returns (IX+N) */
-static uint8_t _iIXN8(uint8_t N) {
+static uint8_t _iIXN8(z80_t *z, uint8_t N) {
   uint16_t a16;
 
-  a16 = get_addrIX()+u8sval(N);
-  cpus.W = a16 >> 8;
-  return z80_memget8(a16);
+  a16 = get_addrIX(z)+u8sval(N);
+  z->cpus.W = a16 >> 8;
+  return z80_memget8(z, a16);
 }
 
 /* returns (IY+N) */
-static uint8_t _iIYN8(uint8_t N) {
+static uint8_t _iIYN8(z80_t *z, uint8_t N) {
   uint16_t a16;
 
-  a16 = get_addrIY()+u8sval(N);
-  cpus.W = a16 >> 8;
-  return z80_memget8(a16);
+  a16 = get_addrIY(z)+u8sval(N);
+  z->cpus.W = a16 >> 8;
+  return z80_memget8(z, a16);
 }
 
 /* (IX+N) <- val*/
-static void s_iIXN8(uint8_t N, uint8_t val) {
+static void s_iIXN8(z80_t *z, uint8_t N, uint8_t val) {
   uint16_t a16;
 
-  a16 = get_addrIX()+u8sval(N);
-  cpus.W = a16 >> 8;
-  z80_memset8(a16,val);
+  a16 = get_addrIX(z)+u8sval(N);
+  z->cpus.W = a16 >> 8;
+  z80_memset8(z, a16,val);
 }
 
 /* (IY+N) <- val*/
-static void s_iIYN8(uint8_t N, uint8_t val) {
+static void s_iIYN8(z80_t *z, uint8_t N, uint8_t val) {
   uint16_t a16;
 
-  a16 = get_addrIY()+u8sval(N);
-  cpus.W = a16 >> 8;
-  z80_memset8(a16,val);
+  a16 = get_addrIY(z)+u8sval(N);
+  z->cpus.W = a16 >> 8;
+  z80_memset8(z, a16,val);
 }
 
 
 /* (HL) <- val */
-static void s_iHL8(uint8_t val) {
-  z80_memset8(get_addrHL(),val);
+static void s_iHL8(z80_t *z, uint8_t val) {
+  z80_memset8(z, get_addrHL(z),val);
 }
 
 /* (BC) <- val */
-static void s_iBC8(uint8_t val) {
-  z80_memset8(get_addrBC(),val);
+static void s_iBC8(z80_t *z, uint8_t val) {
+  z80_memset8(z, get_addrBC(z),val);
 }
 
 /* (DE) <- val */
-static void s_iDE8(uint8_t val) {
-  z80_memset8(get_addrDE(),val);
+static void s_iDE8(z80_t *z, uint8_t val) {
+  z80_memset8(z, get_addrDE(z),val);
 }
 
 /* returns (SP)(16-bits) */
-static uint16_t _iSP16(void) {
-  return z80_memget16(cpus.SP);
+static uint16_t _iSP16(z80_t *z) {
+  return z80_memget16(z, z->cpus.SP);
 }
 
 /* (SP)(16-bits) <- val */
-static void s_iSP16(uint16_t val) {
-  z80_memset16(cpus.SP,val);
+static void s_iSP16(z80_t *z, uint16_t val) {
+  z80_memset16(z, z->cpus.SP,val);
 }
 
-static uint16_t getAF(void) {
-  return ((uint16_t)cpus.r[rA] << 8)|(uint16_t)cpus.F;
+static uint16_t getAF(z80_t *z) {
+  return ((uint16_t)z->cpus.r[rA] << 8)|(uint16_t)get_F(z);
 }
 
-static uint16_t getBC(void) {
-  return ((uint16_t)cpus.r[rB] << 8)|(uint16_t)cpus.r[rC];
+static uint16_t getBC(z80_t *z) {
+  return ((uint16_t)z->cpus.r[rB] << 8)|(uint16_t)z->cpus.r[rC];
 }
 
-static uint16_t getDE(void) {
-  return ((uint16_t)cpus.r[rD] << 8)|(uint16_t)cpus.r[rE];
+static uint16_t getDE(z80_t *z) {
+  return ((uint16_t)z->cpus.r[rD] << 8)|(uint16_t)z->cpus.r[rE];
 }
 
-static uint16_t getHL(void) {
-  return ((uint16_t)cpus.r[rH] << 8)|(uint16_t)cpus.r[rL];
+static uint16_t getHL(z80_t *z) {
+  return ((uint16_t)z->cpus.r[rH] << 8)|(uint16_t)z->cpus.r[rL];
 }
 
-static uint16_t getAF_(void) {
-  return ((uint16_t)cpus.r_[rA] << 8)|(uint16_t)cpus.F_;
+static uint16_t getAF_(z80_t *z) {
+  return ((uint16_t)z->cpus.r_[rA] << 8)|(uint16_t)z->cpus.F_;
 }
 
-static uint16_t getBC_(void) {
-  return ((uint16_t)cpus.r_[rB] << 8)|(uint16_t)cpus.r_[rC];
+static uint16_t getBC_(z80_t *z) {
+  return ((uint16_t)z->cpus.r_[rB] << 8)|(uint16_t)z->cpus.r_[rC];
 }
 
-static uint16_t getDE_(void) {
-  return ((uint16_t)cpus.r_[rD] << 8)|(uint16_t)cpus.r_[rE];
+static uint16_t getDE_(z80_t *z) {
+  return ((uint16_t)z->cpus.r_[rD] << 8)|(uint16_t)z->cpus.r_[rE];
 }
 
-static uint16_t getHL_(void) {
-  return ((uint16_t)cpus.r_[rH] << 8)|(uint16_t)cpus.r_[rL];
+static uint16_t getHL_(z80_t *z) {
+  return ((uint16_t)z->cpus.r_[rH] << 8)|(uint16_t)z->cpus.r_[rL];
 }
 
-static void setAF(uint16_t val) {
-  cpus.r[rA]=val>>8;
-  cpus.F=val & 0xff;
+static void setAF(z80_t *z, uint16_t val) {
+  z->cpus.r[rA]=val>>8;
+  set_F(z, val & 0xff);
 }
 
-static void setBC(uint16_t val) {
-  cpus.r[rB]=val>>8;
-  cpus.r[rC]=val & 0xff;
+static void setBC(z80_t *z, uint16_t val) {
+  z->cpus.r[rB]=val>>8;
+  z->cpus.r[rC]=val & 0xff;
 }
 
-static void setDE(uint16_t val) {
-  cpus.r[rD]=val>>8;
-  cpus.r[rE]=val & 0xff;
+static void setDE(z80_t *z, uint16_t val) {
+  z->cpus.r[rD]=val>>8;
+  z->cpus.r[rE]=val & 0xff;
 }
 
-static void setHL(uint16_t val) {
-  cpus.r[rH]=val>>8;
-  cpus.r[rL]=val & 0xff;
+static void setHL(z80_t *z, uint16_t val) {
+  z->cpus.r[rH]=val>>8;
+  z->cpus.r[rL]=val & 0xff;
 }
 
-uint16_t z80_getAF(void)
+uint16_t z80_getAF(z80_t *z)
 {
-	return getAF();
+	return getAF(z);
 }
 
-uint16_t z80_getBC(void)
+uint16_t z80_getBC(z80_t *z)
 {
-	return getBC();
+	return getBC(z);
 }
 
-uint16_t z80_getDE(void)
+uint16_t z80_getDE(z80_t *z)
 {
-	return getDE();
+	return getDE(z);
 }
 
-uint16_t z80_getHL(void)
+uint16_t z80_getHL(z80_t *z)
 {
-	return getHL();
+	return getHL(z);
 }
 
-uint16_t z80_getAF_(void)
+uint16_t z80_getAF_(z80_t *z)
 {
-	return getAF_();
+	return getAF_(z);
 }
 
-uint16_t z80_getBC_(void)
+uint16_t z80_getBC_(z80_t *z)
 {
-	return getBC_();
+	return getBC_(z);
 }
 
-uint16_t z80_getDE_(void)
+uint16_t z80_getDE_(z80_t *z)
 {
-	return getDE_();
+	return getDE_(z);
 }
 
-uint16_t z80_getHL_(void)
+uint16_t z80_getHL_(z80_t *z)
 {
-	return getHL_();
+	return getHL_(z);
 }
 
-static uint8_t z80_iget8(void) {
+static uint8_t z80_iget8(z80_t *z) {
   uint8_t tmp;
 
-  tmp=z80_imemget8(cpus.PC);
-  cpus.PC++;
+  tmp=z80_imemget8(z, z->cpus.PC);
+  z->cpus.PC++;
   return tmp;
 }
 
-static uint16_t z80_iget16(void) {
+static uint16_t z80_iget16(z80_t *z) {
   uint16_t tmp;
 
-  tmp=z80_imemget16(cpus.PC);
-  cpus.PC+=2;
+  tmp=z80_imemget16(z, z->cpus.PC);
+  z->cpus.PC+=2;
   return tmp;
 }
 
@@ -416,42 +618,42 @@ static uint16_t z80_iget16(void) {
 
 #ifndef NO_Z80UNDOC
 
-static void setIXh(uint8_t val) {
-  cpus.IX = (cpus.IX & 0x00ffu) | ((uint16_t)val<<8);
+static void setIXh(z80_t *z, uint8_t val) {
+  z->cpus.IX = (z->cpus.IX & 0x00ffu) | ((uint16_t)val<<8);
 }
 
-static void setIYh(uint8_t val) {
-  cpus.IY = (cpus.IY & 0x00ffu) | ((uint16_t)val<<8);
+static void setIYh(z80_t *z, uint8_t val) {
+  z->cpus.IY = (z->cpus.IY & 0x00ffu) | ((uint16_t)val<<8);
 }
 
-static void setIXl(uint8_t val) {
-  cpus.IX = (cpus.IX & 0xff00u) | (uint16_t)val;
+static void setIXl(z80_t *z, uint8_t val) {
+  z->cpus.IX = (z->cpus.IX & 0xff00u) | (uint16_t)val;
 }
 
-static void setIYl(uint8_t val) {
-  cpus.IY = (cpus.IY & 0xff00u) | (uint16_t)val;
+static void setIYl(z80_t *z, uint8_t val) {
+  z->cpus.IY = (z->cpus.IY & 0xff00u) | (uint16_t)val;
 }
 
-static uint8_t getIXh(void) {
-  return cpus.IX>>8;
+static uint8_t getIXh(z80_t *z) {
+  return z->cpus.IX>>8;
 }
 
-static uint8_t getIYh(void) {
-  return cpus.IY>>8;
+static uint8_t getIYh(z80_t *z) {
+  return z->cpus.IY>>8;
 }
 
-static uint8_t getIXl(void) {
-  return cpus.IX&0xff;
+static uint8_t getIXl(z80_t *z) {
+  return z->cpus.IX&0xff;
 }
 
-static uint8_t getIYl(void) {
-  return cpus.IY&0xff;
+static uint8_t getIYl(z80_t *z) {
+  return z->cpus.IY&0xff;
 }
 
 #endif
 
 /************************************************************************/
-static void _push16(uint16_t val);
+static void _push16(z80_t *z, uint16_t val);
 /************************************************************************/
 
 
@@ -465,29 +667,237 @@ void z80_init_tables(void) {
   ox_tab[0] |= fZ;
 }
 
+/********************** repeated block instructions *********************/
+
+/*
+ * Within z80_run() of the lean core a repeated block instruction (LDIR,
+ * CPIR, INIR, ...) does not rewind PC after each iteration, but continues
+ * in place until it is finished or the run deadline is reached.
+ * z80_rep_next() does the bookkeeping that z80_execinstr() would do
+ * between the iterations. Memory transfers and searches can also skip
+ * many iterations at once if memory can be accessed directly.
+ */
+
+#ifdef NO_Z80CLOCK
+/** Clock ticks per repeated iteration of a block instruction */
+#define Z80_REP_TICKS 12
+#else
+#define Z80_REP_TICKS 21
+#endif
+
+/** Start next iteration of a repeated block instruction in place.
+ *
+ * Called when a repeated block instruction is about to repeat.
+ *
+ * @param z CPU context
+ * @return Nonzero if the instruction should continue in place, zero
+ *         if PC should be rewound to the instruction
+ */
+static int z80_rep_next(z80_t *z)
+{
+	if (!z->running || (long)(z->clock - z->run_deadline) >= 0 ||
+	    z->cpus.int_pending != 0 || z->cpus.nmi_pending != 0)
+		return 0;
+
+	/* Instruction could have been modified or paged out */
+	if (z80_imemget8(z, z->cpus.PC - 2) != 0xed ||
+	    z80_imemget8(z, z->cpus.PC - 1) != z->opcode ||
+	    z80_code_break(z, z->cpus.PC - 2))
+		return 0;
+
+	/* End this iteration and start the next one like z80_execinstr() */
+	incr_R(z, 2);
+	z->cpus.modifier = 0;
+#ifdef NO_Z80CLOCK
+	z->clock += 12;
+#endif
+	z->instr_clock = z->clock;
+	z->cpus.pflags_aff = z->cpus.flags_aff;
+	z->cpus.flags_aff = 0;
+	z->cpus.int_lock = 0;
+	return 1;
+}
+
+/** Determine number of iterations that can be skipped at once.
+ *
+ * All skipped iterations must repeat and end before the deadline. Only
+ * called at the start of an iteration, after z80_rep_next().
+ *
+ * @param z CPU context
+ * @param cnt Remaining value of the iteration counter
+ * @return Number of iterations that can be skipped
+ */
+static uint16_t z80_rep_max(z80_t *z, uint16_t cnt)
+{
+	unsigned long n;
+
+	n = (z->run_deadline - z->clock - 1) / Z80_REP_TICKS;
+	if (n > (uint16_t)(cnt - 1))
+		n = (uint16_t)(cnt - 1);
+	return n;
+}
+
+/** Skip iterations of a repeated block instruction.
+ *
+ * The last skipped iteration is always followed by one that is executed
+ * normally, which sets the flags.
+ *
+ * @param z CPU context
+ * @param n Number of iterations
+ */
+static void z80_rep_skip(z80_t *z, uint16_t n)
+{
+	z->clock += (unsigned long)n * Z80_REP_TICKS;
+	z->instr_clock = z->clock;
+	incr_R(z, 2 * (unsigned long)n);
+}
+
+/** Transfer memory for LDIR/LDDR in bulk.
+ *
+ * @param z CPU context
+ * @param dir 1 for LDIR, -1 for LDDR
+ */
+static void z80_ldxr_bulk(z80_t *z, int dir)
+{
+	uint16_t hl, de, n, i;
+	uint8_t *src, *dst, *ip;
+	uintptr_t s, d;
+
+	hl = getHL(z);
+	de = getDE(z);
+	n = z80_rep_max(z, getBC(z));
+
+	/* Stay within a memory bank */
+	if (dir > 0) {
+		if (n > 0x4000 - (hl & 0x3fff))
+			n = 0x4000 - (hl & 0x3fff);
+		if (n > 0x4000 - (de & 0x3fff))
+			n = 0x4000 - (de & 0x3fff);
+	} else {
+		if (n > (hl & 0x3fff) + 1)
+			n = (hl & 0x3fff) + 1;
+		if (n > (de & 0x3fff) + 1)
+			n = (de & 0x3fff) + 1;
+	}
+
+	if (n < 2)
+		return;
+
+	/* Destination first, making it writable can move memory */
+	if (dir > 0) {
+		dst = z80_mem_direct(z, de, n, 1);
+		src = z80_mem_direct(z, hl, n, 0);
+	} else {
+		dst = z80_mem_direct(z, de - (n - 1), n, 1);
+		src = z80_mem_direct(z, hl - (n - 1), n, 0);
+	}
+
+	/* Do not overwrite the instruction itself */
+	ip = z80_mem_direct(z, z->cpus.PC - 2, 2, 0);
+	if (src == NULL || dst == NULL || ip == NULL ||
+	    ((uintptr_t)ip + 2 > (uintptr_t)dst &&
+	    (uintptr_t)ip < (uintptr_t)dst + n))
+		return;
+
+	/*
+	 * The Z80 copies byte by byte, so when the destination overlaps
+	 * the source ahead of it, the bytes being copied repeat.
+	 */
+	s = (uintptr_t)src;
+	d = (uintptr_t)dst;
+	if (dir > 0 && d > s && d < s + n) {
+		if (d == s + 1) {
+			memset(dst, src[0], n);
+		} else {
+			for (i = 0; i < n; i++)
+				dst[i] = src[i];
+		}
+	} else if (dir < 0 && d < s && d + n > s) {
+		if (d + 1 == s) {
+			memset(dst, src[n - 1], n);
+		} else {
+			for (i = n; i > 0; i--)
+				dst[i - 1] = src[i - 1];
+		}
+	} else {
+		memmove(dst, src, n);
+	}
+
+	setHL(z, hl + dir * n);
+	setDE(z, de + dir * n);
+	setBC(z, getBC(z) - n);
+	z80_rep_skip(z, n);
+}
+
+/** Search memory for CPIR/CPDR in bulk.
+ *
+ * @param z CPU context
+ * @param dir 1 for CPIR, -1 for CPDR
+ */
+static void z80_cpxr_bulk(z80_t *z, int dir)
+{
+	uint16_t hl, n, i;
+	uint8_t *p, *m;
+
+	hl = getHL(z);
+	n = z80_rep_max(z, getBC(z));
+
+	/* Stay within a memory bank */
+	if (dir > 0) {
+		if (n > 0x4000 - (hl & 0x3fff))
+			n = 0x4000 - (hl & 0x3fff);
+	} else {
+		if (n > (hl & 0x3fff) + 1)
+			n = (hl & 0x3fff) + 1;
+	}
+
+	if (n < 2)
+		return;
+
+	/* Skip the bytes before the first match */
+	if (dir > 0) {
+		p = z80_mem_direct(z, hl, n, 0);
+		if (p == NULL)
+			return;
+		m = memchr(p, z->cpus.r[rA], n);
+		if (m != NULL)
+			n = m - p;
+	} else {
+		p = z80_mem_direct(z, hl - (n - 1), n, 0);
+		if (p == NULL)
+			return;
+		for (i = 0; i < n; i++) {
+			if (p[n - 1 - i] == z->cpus.r[rA])
+				break;
+		}
+		n = i;
+	}
+
+	if (n == 0)
+		return;
+
+	setHL(z, hl + dir * n);
+	setBC(z, getBC(z) - n);
+	z80_rep_skip(z, n);
+}
+
 /************************ operations ************************************/
 
-static uint8_t _adc8(uint16_t a, uint16_t b) {
+static uint8_t _adc8(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res;
   uint16_t c;
   
-  c = (cpus.F&fC) != 0 ? 1 : 0;
+  c = flag_C(z) != 0 ? 1 : 0;
 
   res=a+b+c;
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	   (a&0x0f)+(b&0x0f)+c > 0x0f ? 1 : 0,
-	   adc_v8(a&0xff,b&0xff,c&0xff),
-	   0,
-	   res>0xff ? 1 : 0);
-  setundocflags8(res&0xff);
+  lazyflags(z, lf_add8,a,b,c,res);
   return res & 0xff;
 }
 
-static uint16_t _adc16(uint16_t a, uint16_t b) {
+static uint16_t _adc16(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res0,res1,a1,b1,c,c1;
   
-  c = (cpus.F&fC) != 0 ? 1 : 0;
+  c = flag_C(z) != 0 ? 1 : 0;
 
   res0=(a&0xff)+(b&0xff)+ c;
   a1=a>>8;
@@ -495,67 +905,61 @@ static uint16_t _adc16(uint16_t a, uint16_t b) {
   c1 = (res0>0xff) ? 1 : 0;
 
   res1=a1+b1+c1;
-  setflags((int)(res1&0x80),
+  setflags(z, (int)(res1&0x80),
 	   ((res0&0xff)|(res1&0xff)) == 0 ? 1 : 0,
 	   ((a1&0x0f) + (b1&0x0f)>0x0f) ? 1 : 0,
 	   adc_v16(a,b,c),
 	   0,
 	   res1>0xff ? 1 : 0);
-  setundocflags8(res1&0xff);
+  setundocflags8(z, res1&0xff);
   return (res0&0xff)|((res1&0xff)<<8);
 }
 
 /************************************************************************/
 
-static uint8_t _add8(uint16_t a, uint16_t b) {
+static uint8_t _add8(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res;
 
   res=a+b;
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	   (a&0x0f)+(b&0x0f) > 0x0f ? 1 : 0,
-	   add_v8(a&0xff,b&0xff),
-	   0,
-	   res>0xff ? 1 : 0);
-  setundocflags8(res&0xff);
+  lazyflags(z, lf_add8,a,b,0,res);
   return res & 0xff;
 }
 
-static uint16_t _add16(uint16_t a, uint16_t b) {
+static uint16_t _add16(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res0,res1,a1,b1;
 
   res0=(a&0xff)+(b&0xff);
   a1=a>>8; b1=b>>8;
   res1=a1+b1+((res0>0xff)?1:0);
-  setflags(-1,
+  setflags(z, -1,
 	   -1,
 	   (a1&0x0f) + (b1&0x0f)>0x0f ? 1 : 0,
 	   -1,
 	   0,
 	   res1>0xff ? 1 : 0);
-  setundocflags8(res1&0xff);
+  setundocflags8(z, res1&0xff);
   return (res0&0xff)|((res1&0xff)<<8);
 }
 
 /************************************************************************/
 
-static uint8_t _and8(uint8_t a, uint8_t b) {
+static uint8_t _and8(z80_t *z, uint8_t a, uint8_t b) {
   uint8_t res;
 
   res=a&b;
-  cpus.F=ox_tab[res]|fHC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[res]|fHC);
+  z->cpus.flags_aff=1;
   return res;
 }
 
 /************************************************************************/
 
-static uint8_t _bit8(uint8_t a, uint8_t b) {
+static uint8_t _bit8(z80_t *z, uint8_t a, uint8_t b) {
   uint8_t res;
 
   res=b & (1<<a);
-  cpus.F=(cpus.F&fC)|ox_tab[res]|fHC; /* CF does not change */
-  cpus.flags_aff=1;
+  set_F(z, flag_C(z)|ox_tab[res]|fHC); /* CF does not change */
+  z->cpus.flags_aff=1;
 /*  setflags(res&0x80,
 	   res==0,
 	   1,
@@ -569,125 +973,107 @@ static uint8_t _bit8(uint8_t a, uint8_t b) {
 
 /************************************************************************/
 
-static void _call16(uint16_t addr) {
-  _push16(cpus.PC);
-  cpus.W=addr>>8; // XXX not sure if RST should also affect W !!!!!!
-  cpus.PC=addr;
+static void _call16(z80_t *z, uint16_t addr) {
+  _push16(z, z->cpus.PC);
+  z->cpus.W=addr>>8; // XXX not sure if RST should also affect W !!!!!!
+  z->cpus.PC=addr;
 }
 
 /************************************************************************/
 
-static uint8_t _cp8(uint16_t a, uint16_t b) {
+static uint8_t _cp8(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res;
 
   res=a-b;
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	   (a&0x0f)-(b&0x0f) < 0 ? 1 : 0, /* I hope */
-	   sub_v8(a&0xff,b&0xff),
-	   1,
-	   res>0xff ? 1 : 0);
-  setundocflags8(b&0xff); /* not from the result! */
+  lazyflags(z, lf_cp8,a,b,0,res); /* undoc. flags not from the result! */
   return res & 0xff;
 }
 
 /************************************************************************/
 
-static uint8_t _dec8(uint16_t a) {
+static uint8_t _dec8(z80_t *z, uint16_t a) {
   uint16_t res;
 
   res=(a-1)&0xff;
-  setflags((int)(res>>7),
-	   res==0 ? 1 : 0,
-	   (a&0x0f)-1<0 ? 1 : 0, /* I hope */
-	   sub_v8(a&0xff,1),
-	   1,    /* !spemu */
-	   -1);
-  setundocflags8(res&0xff);
+  lazyflags(z, lf_dec8,a,1,flag_C(z),res); /* carry is preserved */
   return res & 0xff;
 }
 
 /************************************************************************/
 
-static uint8_t _in8pf(uint16_t a) {
-  return z80_in8(a);		/* query ZX */
+static uint8_t _in8pf(z80_t *z, uint16_t a) {
+  return z80_in8(z, a);		/* query ZX */
 }
 
-static uint8_t _in8(uint16_t a) {
+static uint8_t _in8(z80_t *z, uint16_t a) {
   uint16_t res;
 
-  res=_in8pf(a)&0xff;
-  setflags((int)(res>>7),
+  res=_in8pf(z, a)&0xff;
+  setflags(z, (int)(res>>7),
 	   res==0 ? 1 : 0,
 	   0,
 	   oddp8(res&0xff),
 	   0,
 	   -1);
-  setundocflags8(res&0xff);
+  setundocflags8(z, res&0xff);
   return res&0xff;
 }
 
 /************************************************************************/
 
-static uint8_t _inc8(uint16_t a) {
+static uint8_t _inc8(z80_t *z, uint16_t a) {
   uint16_t res;
 
   res=(a+1)&0xff;
-  setflags((int)(res>>7),
-	   res==0 ? 1 : 0,
-	   (a&0x0f)+1>0x0f ? 1 : 0,
-	   add_v8(a&0xff,1),
-	   0,		/* !spemu */
-	   -1);
-  setundocflags8(res&0xff);
+  lazyflags(z, lf_inc8,a,1,flag_C(z),res); /* carry is preserved */
   return res&0xff;
 }
 
 /************************************************************************/
 
 
-static void _jp16(uint16_t addr) {
-  cpus.PC=addr;
+static void _jp16(z80_t *z, uint16_t addr) {
+  z->cpus.PC=addr;
 }
 
 /************************************************************************/
 
-static void _jr8(uint8_t ofs) {
+static void _jr8(z80_t *z, uint8_t ofs) {
   uint16_t addr;
-  addr=cpus.PC+u8sval(ofs);
-  cpus.W=addr>>8;
-  cpus.PC=addr;
+  addr=z->cpus.PC+u8sval(ofs);
+  z->cpus.W=addr>>8;
+  z->cpus.PC=addr;
 }
 
 /************************************************************************/
 
-static uint8_t _or8(uint8_t a, uint8_t b) {
+static uint8_t _or8(z80_t *z, uint8_t a, uint8_t b) {
   uint8_t res;
 
   res=a|b;
-  cpus.F=ox_tab[res];
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[res]);
+  z->cpus.flags_aff=1;
   return res;
 }
 
 /************************************************************************/
 
-static void _out8(uint16_t addr, uint8_t val) {
-  z80_out8(addr,val);			/* pass it to ZX */
+static void _out8(z80_t *z, uint16_t addr, uint8_t val) {
+  z80_out8(z, addr,val);			/* pass it to ZX */
 }
 
 /************************************************************************/
 
-static void _push16(uint16_t val) {
-  cpus.SP-=2;
-  z80_memset16(cpus.SP,val);
+static void _push16(z80_t *z, uint16_t val) {
+  z->cpus.SP-=2;
+  z80_memset16(z, z->cpus.SP,val);
 }
 
-static uint16_t _pop16(void) {
+static uint16_t _pop16(z80_t *z) {
   uint16_t res;
 
-  res=z80_memget16(cpus.SP);
-  cpus.SP+=2;
+  res=z80_memget16(z, z->cpus.SP);
+  z->cpus.SP+=2;
   return res;
 }
 
@@ -702,87 +1088,87 @@ static uint8_t _res8(uint16_t a, uint16_t b) {
 
 /************************************************************************/
 
-static uint8_t _rla8(uint8_t a) {
+static uint8_t _rla8(z80_t *z, uint8_t a) {
   uint8_t nC,oC;
 
   nC=a>>7;
-  oC=(cpus.F & fC) != 0 ? 1 : 0;
+  oC=flag_C(z) != 0 ? 1 : 0;
   a=(a<<1)|oC;
-  cpus.F = (cpus.F & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | nC;
-  cpus.flags_aff=1;
+  set_F(z, (get_F(z) & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rl8(uint8_t a) {
+static uint8_t _rl8(z80_t *z, uint8_t a) {
   uint8_t nC,oC;
 
   nC=a>>7;
-  oC=(cpus.F & fC) != 0 ? 1 : 0;
+  oC=flag_C(z) != 0 ? 1 : 0;
   a=(a<<1)|oC;
-  cpus.F=ox_tab[a]|nC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rlca8(uint8_t a) {
+static uint8_t _rlca8(z80_t *z, uint8_t a) {
   uint8_t tmp;
 
   tmp=a>>7;
   a=(a<<1)|tmp;
-  cpus.F = (cpus.F & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | tmp;
-  cpus.flags_aff=1;
+  set_F(z, (get_F(z) & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | tmp);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rlc8(uint8_t a) {
+static uint8_t _rlc8(z80_t *z, uint8_t a) {
   uint8_t tmp;
 
   tmp=a>>7;
   a=(a<<1)|tmp;
-  cpus.F=ox_tab[a]|tmp;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|tmp);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rra8(uint8_t a) {
+static uint8_t _rra8(z80_t *z, uint8_t a) {
   uint8_t nC,oC;
 
   nC=a&1;
-  oC=(cpus.F & fC) != 0 ? 1 : 0;
+  oC=flag_C(z) != 0 ? 1 : 0;
   a=(a>>1)|(oC<<7);
-  cpus.F = (cpus.F & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | nC;
-  cpus.flags_aff=1;
+  set_F(z, (get_F(z) & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rr8(uint8_t a) {
+static uint8_t _rr8(z80_t *z, uint8_t a) {
   uint8_t nC,oC;
 
   nC=a&1;
-  oC=(cpus.F & fC) != 0 ? 1 : 0;
+  oC=flag_C(z) != 0 ? 1 : 0;
   a=(a>>1)|(oC<<7);
-  cpus.F=ox_tab[a]|nC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rrca8(uint8_t a) {
+static uint8_t _rrca8(z80_t *z, uint8_t a) {
   uint8_t tmp;
 
   tmp=a&1;
   a=(a>>1)|(tmp<<7);
-  cpus.F = (cpus.F & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | tmp;
-  cpus.flags_aff=1;
+  set_F(z, (get_F(z) & ~(fU1|fHC|fU2|fN|fC)) | (a&(fU1|fU2)) | tmp);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _rrc8(uint8_t a) {
+static uint8_t _rrc8(z80_t *z, uint8_t a) {
   uint8_t tmp;
 
   tmp=a&1;
   a=(a>>1)|(tmp<<7);
-  cpus.F=ox_tab[a]|tmp;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|tmp);
+  z->cpus.flags_aff=1;
   return a;
 }
 
@@ -790,85 +1176,79 @@ static uint8_t _rrc8(uint8_t a) {
 
 /************************************************************************/
 
-static uint8_t _sla8(uint8_t a) {
+static uint8_t _sla8(z80_t *z, uint8_t a) {
   uint8_t nC;
 
   nC=a>>7;
   a<<=1;
-  cpus.F=ox_tab[a]|nC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
-static uint8_t _sra8(uint8_t a) {
+static uint8_t _sra8(z80_t *z, uint8_t a) {
   uint8_t nC;
 
   nC=a&1;
   a=(a&0x80) | (a>>1);
-  cpus.F=ox_tab[a]|nC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
 #ifndef NO_Z80UNDOC
 
 /* Shift left with 1 insertion (sl1), also called sll */
-static uint8_t _sll8(uint8_t a) {
+static uint8_t _sll8(z80_t *z, uint8_t a) {
   uint8_t nC;
 
   nC=a>>7;
   a=(a<<1)|0x1;
-  cpus.F=ox_tab[a]|nC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
 #endif
 
-static uint8_t _srl8(uint8_t a) {
+static uint8_t _srl8(z80_t *z, uint8_t a) {
   uint8_t nC;
 
   nC=a&1;
   a>>=1;
-  cpus.F=ox_tab[a]|nC;
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[a]|nC);
+  z->cpus.flags_aff=1;
   return a;
 }
 
 /************************************************************************/
 
-static uint8_t _sbc8(uint16_t a, uint16_t b) {
+static uint8_t _sbc8(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res;
   uint16_t c;
   
-  c=((cpus.F&fC)!=0) ? 1 : 0;
+  c=(flag_C(z)!=0) ? 1 : 0;
 
   res=a-b-c;
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	   (a&0x0f)-(b&0x0f)-c < 0 ? 1 : 0, /* I hope */
-	   sbc_v8(a&0xff,b&0xff,c&0xff),
-	   1,
-	   res>0xff ? 1 : 0);
-  setundocflags8(res&0xff);
+  lazyflags(z, lf_sub8,a,b,c,res);
   return res & 0xff;
 }
 
-static uint16_t _sbc16(uint16_t a, uint16_t b) {
+static uint16_t _sbc16(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res0,res1,a1,b1,c,c1;
   
-  c= (cpus.F&fC) != 0 ? 1 : 0;
+  c= flag_C(z) != 0 ? 1 : 0;
 
   res0=(a&0xff)-(b&0xff)- c;
   a1=a>>8; b1=b>>8; c1 = (res0>0xff) ? 1 : 0;
   res1=a1-b1-c1;
-  setflags((int)(res1&0x80),
+  setflags(z, (int)(res1&0x80),
 	   ((res0&0xff)|(res1&0xff)) == 0 ? 1 : 0,
 	   (int)(((a1&0x0f) < (b1&0x0f) ? 1 : 0)+c1),
 	   sbc_v16(a,b,c),
 	   1,
 	   res1>0xff ? 1 : 0);
-  setundocflags8(res1&0xff);
+  setundocflags8(z, res1&0xff);
   return (res0&0xff)|((res1&0xff)<<8);
 }
 
@@ -884,28 +1264,22 @@ static uint8_t _set8(uint16_t a, uint16_t b) {
 /************************************************************************/
 
 
-static uint8_t _sub8(uint16_t a, uint16_t b) {
+static uint8_t _sub8(z80_t *z, uint16_t a, uint16_t b) {
   uint16_t res;
 
   res=a-b;
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	   (a&0x0f)-(b&0x0f) < 0 ? 1 : 0, /* I hope */
-	   sub_v8(a&0xff,b&0xff),
-	   1,
-	   res>0xff ? 1 : 0);
-  setundocflags8(res & 0xff);
+  lazyflags(z, lf_sub8,a,b,0,res);
   return res & 0xff;
 }
 
 /************************************************************************/
 
-static uint8_t _xor8(uint8_t a, uint8_t b) {
+static uint8_t _xor8(z80_t *z, uint8_t a, uint8_t b) {
   uint8_t res;
 
   res=a^b;
-  cpus.F=ox_tab[res];
-  cpus.flags_aff=1;
+  set_F(z, ox_tab[res]);
+  z->cpus.flags_aff=1;
   return res;
 }
 
@@ -915,3063 +1289,3112 @@ static uint8_t _xor8(uint8_t a, uint8_t b) {
 /************************************************************************/
 /********************* documented opcodes *******************************/
 
-static void ei_adc_A_r(void) {
+static void ei_adc_A_r(z80_t *z) {
   uint8_t res;
 
-  res=_adc8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_adc_A_N(void) {
+static void ei_adc_A_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_adc8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_adc_A_iHL(void) {
+static void ei_adc_A_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_adc8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_adc_A_iIXN(void) {
+static void ei_adc_A_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_adc8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_adc_A_iIYN(void) {
+static void ei_adc_A_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_adc8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_adc_HL_BC(void) {
+static void ei_adc_HL_BC(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_adc16(getHL(),getBC());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_adc16(z, getHL(z),getBC(z));
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_adc_HL_DE(void) {
+static void ei_adc_HL_DE(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_adc16(getHL(),getDE());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_adc16(z, getHL(z),getDE(z));
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_adc_HL_HL(void) {
+static void ei_adc_HL_HL(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_adc16(getHL(),getHL());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_adc16(z, getHL(z),getHL(z));
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_adc_HL_SP(void) {
+static void ei_adc_HL_SP(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_adc16(getHL(),cpus.SP);
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_adc16(z, getHL(z),z->cpus.SP);
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /************************************************************************/
 
-static void ei_add_A_r(void) {
+static void ei_add_A_r(z80_t *z) {
   uint8_t res;
 
-  res=_add8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_add_A_N(void) {
+static void ei_add_A_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_add8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_add_A_iHL(void) {
+static void ei_add_A_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_add8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_add_A_iIXN(void) {
+static void ei_add_A_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_add8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_add_A_iIYN(void) {
+static void ei_add_A_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_add8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_add_HL_BC(void) {
+static void ei_add_HL_BC(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_add16(getHL(),getBC());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_add16(z, getHL(z),getBC(z));
+  setHL(z, res);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_HL_DE(void) {
+static void ei_add_HL_DE(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_add16(getHL(),getDE());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_add16(z, getHL(z),getDE(z));
+  setHL(z, res);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_HL_HL(void) {
+static void ei_add_HL_HL(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_add16(getHL(),getHL());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_add16(z, getHL(z),getHL(z));
+  setHL(z, res);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_HL_SP(void) {
+static void ei_add_HL_SP(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_add16(getHL(),cpus.SP);
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_add16(z, getHL(z),z->cpus.SP);
+  setHL(z, res);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IX_BC(void) {
+static void ei_add_IX_BC(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IX>>8;
-  res=_add16(cpus.IX,getBC());
-  cpus.IX=res;
+  z->cpus.W=z->cpus.IX>>8;
+  res=_add16(z, z->cpus.IX,getBC(z));
+  z->cpus.IX=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IX_DE(void) {
+static void ei_add_IX_DE(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IX>>8;
-  res=_add16(cpus.IX,getDE());
-  cpus.IX=res;
+  z->cpus.W=z->cpus.IX>>8;
+  res=_add16(z, z->cpus.IX,getDE(z));
+  z->cpus.IX=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IX_IX(void) {
+static void ei_add_IX_IX(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IX>>8;
-  res=_add16(cpus.IX,cpus.IX);
-  cpus.IX=res;
+  z->cpus.W=z->cpus.IX>>8;
+  res=_add16(z, z->cpus.IX,z->cpus.IX);
+  z->cpus.IX=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IX_SP(void) {
+static void ei_add_IX_SP(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IX>>8;
-  res=_add16(cpus.IX,cpus.SP);
-  cpus.IX=res;
+  z->cpus.W=z->cpus.IX>>8;
+  res=_add16(z, z->cpus.IX,z->cpus.SP);
+  z->cpus.IX=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IY_BC(void) {
+static void ei_add_IY_BC(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IY>>8;
-  res=_add16(cpus.IY,getBC());
-  cpus.IY=res;
+  z->cpus.W=z->cpus.IY>>8;
+  res=_add16(z, z->cpus.IY,getBC(z));
+  z->cpus.IY=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IY_DE(void) {
+static void ei_add_IY_DE(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IY>>8;
-  res=_add16(cpus.IY,getDE());
-  cpus.IY=res;
+  z->cpus.W=z->cpus.IY>>8;
+  res=_add16(z, z->cpus.IY,getDE(z));
+  z->cpus.IY=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IY_IY(void) {
+static void ei_add_IY_IY(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IY>>8;
-  res=_add16(cpus.IY,cpus.IY);
-  cpus.IY=res;
+  z->cpus.W=z->cpus.IY>>8;
+  res=_add16(z, z->cpus.IY,z->cpus.IY);
+  z->cpus.IY=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_add_IY_SP(void) {
+static void ei_add_IY_SP(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.IY>>8;
-  res=_add16(cpus.IY,cpus.SP);
-  cpus.IY=res;
+  z->cpus.W=z->cpus.IY>>8;
+  res=_add16(z, z->cpus.IY,z->cpus.SP);
+  z->cpus.IY=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
 /************************************************************************/
 
-static void ei_and_r(void) {
+static void ei_and_r(z80_t *z) {
   uint8_t res;
 
-  res=_and8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_and_N(void) {
+static void ei_and_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_and8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_and_iHL(void) {
+static void ei_and_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_and8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_and_iIXN(void) {
+static void ei_and_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_and8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_and_iIYN(void) {
+static void ei_and_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_and8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /************************************************************************/
 
-static void ei_bit_b_r(void) {
-  (void)_bit8((opcode>>3)&0x07,cpus.r[opcode & 0x07]);
+static void ei_bit_b_r(z80_t *z) {
+  (void)_bit8(z, (z->opcode>>3)&0x07,z->cpus.r[z->opcode & 0x07]);
   /* Note that undoc flags are set from source operand, not from result! */
-  setundocflags8(cpus.r[opcode & 0x07]);
-  z80_clock_inc(8);
+  setundocflags8(z, z->cpus.r[z->opcode & 0x07]);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_bit_b_iHL(void) {
-  (void)_bit8((opcode>>3)&0x07,_iHL8());
-  setundocflags8(cpus.W);
-  z80_clock_inc(12);
+static void ei_bit_b_iHL(z80_t *z) {
+  (void)_bit8(z, (z->opcode>>3)&0x07,_iHL8(z));
+  setundocflags8(z, z->cpus.W);
+  z80_clock_inc(z, 12);
 }
 
 /* DDCB ! */
-static void ei_bit_b_iIXN(void) {
-  (void)_bit8((opcode>>3)&0x07,_iIXN8(cbop));
-  setundocflags8(cpus.W);
+static void ei_bit_b_iIXN(z80_t *z) {
+  (void)_bit8(z, (z->opcode>>3)&0x07,_iIXN8(z, z->cbop));
+  setundocflags8(z, z->cpus.W);
 
-  z80_clock_inc(16);
+  z80_clock_inc(z, 16);
 }
 
 /* FDCB ! */
-static void ei_bit_b_iIYN(void) {
+static void ei_bit_b_iIYN(z80_t *z) {
 
-  (void)_bit8((opcode>>3)&0x07,_iIYN8(cbop));
-  setundocflags8(cpus.W);
+  (void)_bit8(z, (z->opcode>>3)&0x07,_iIYN8(z, z->cbop));
+  setundocflags8(z, z->cpus.W);
 
-  z80_clock_inc(16);
+  z80_clock_inc(z, 16);
 }
 
 /************************************************************************/
 
-static void ei_call_NN(void) {
+static void ei_call_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  _call16(addr);
-  z80_clock_inc(17);
+  addr=z80_iget16(z);
+  _call16(z, addr);
+  z80_clock_inc(z, 17);
 }
 
-static void ei_call_C_NN(void) {
+static void ei_call_C_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fC) != 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if(flag_C(z) != 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_NC_NN(void) {
+static void ei_call_NC_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fC) == 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if(flag_C(z) == 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_M_NN(void) {
+static void ei_call_M_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fS) != 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if(flag_S(z) != 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_P_NN(void) {
+static void ei_call_P_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fS) == 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if(flag_S(z) == 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_Z_NN(void) {
+static void ei_call_Z_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fZ) != 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if(flag_Z(z) != 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_NZ_NN(void) {
+static void ei_call_NZ_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fZ) == 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if(flag_Z(z) == 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_PE_NN(void) {
+static void ei_call_PE_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fPV) != 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if((get_F(z) & fPV) != 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
-static void ei_call_PO_NN(void) {
+static void ei_call_PO_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  if((cpus.F & fPV) == 0) {
-    _call16(addr);
-    z80_clock_inc(17);
-  } else z80_clock_inc(10);
+  addr=z80_iget16(z);
+  if((get_F(z) & fPV) == 0) {
+    _call16(z, addr);
+    z80_clock_inc(z, 17);
+  } else z80_clock_inc(z, 10);
 }
 
 /************************************************************************/
 
-static void ei_ccf(void) { /* complement carry flag */
+static void ei_ccf(z80_t *z) { /* complement carry flag */
   uint8_t nHC;
   
-  nHC=(cpus.F&fC) != 0 ? fHC : 0;
+  flags_sync(z);
+  nHC=(z->cpus.F&fC) != 0 ? fHC : 0;
 
   /*
    * As found by Patrik Rak in 2012, if the previous instruction affected
    * flags, then SCF/CCF moves flags 3,5 from A. If it did not affect flags,
    * it ORs F with bits 3,5 from A.
    */
-  if (cpus.pflags_aff != 0)
-    cpus.F &= ~fU;
+  if (z->cpus.pflags_aff != 0)
+    z->cpus.F &= ~fU;
 
-  cpus.F= ((cpus.F ^ fC) & ~(fHC|fN)) | nHC | (cpus.r[rA]&(fU1|fU2));
-  cpus.flags_aff=1;
-  z80_clock_inc(4);
+  z->cpus.F= ((z->cpus.F ^ fC) & ~(fHC|fN)) | nHC | (z->cpus.r[rA]&(fU1|fU2));
+  z->cpus.flags_aff=1;
+  z80_clock_inc(z, 4);
 }
 
 /************************************************************************/
 
-static void ei_cp_r(void) {
-  (void)_cp8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  z80_clock_inc(4);
+static void ei_cp_r(z80_t *z) {
+  (void)_cp8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_cp_N(void) {
+static void ei_cp_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  (void)_cp8(cpus.r[rA],op);
-  z80_clock_inc(7);
+  (void)_cp8(z, z->cpus.r[rA],op);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_cp_iHL(void) {
-  (void)_cp8(cpus.r[rA],_iHL8());
-  z80_clock_inc(7);
+static void ei_cp_iHL(z80_t *z) {
+  (void)_cp8(z, z->cpus.r[rA],_iHL8(z));
+  z80_clock_inc(z, 7);
 }
 
-static void ei_cp_iIXN(void) {
+static void ei_cp_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  (void)_cp8(cpus.r[rA],_iIXN8(op));
-  z80_clock_inc(15);
+  (void)_cp8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z80_clock_inc(z, 15);
 }
 
-static void ei_cp_iIYN(void) {
+static void ei_cp_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  (void)_cp8(cpus.r[rA],_iIYN8(op));
-  z80_clock_inc(15);
+  (void)_cp8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z80_clock_inc(z, 15);
 }
 
-static void ei_cpd(void) {
+static void ei_cpd(z80_t *z) {
   uint8_t a,b,ufr,res;
   uint16_t newBC;
   uint8_t hf;
 
-  a=cpus.r[rA];
-  b=_iHL8();
+  a=z->cpus.r[rA];
+  b=_iHL8(z);
   res=a-b;
-  cpus.W = cpus.r[rB];
-  setHL(getHL()-1);
-  newBC=getBC()-1; setBC(newBC);
+  z->cpus.W = z->cpus.r[rB];
+  setHL(z, getHL(z)-1);
+  newBC=getBC(z)-1; setBC(z, newBC);
   hf=(a&0x0f)-(b&0x0f) < 0 ? 1 : 0;
   
-  setflags((int)((res>>7)&1),
+  setflags(z, (int)((res>>7)&1),
 	   (res&0xff)==0 ? 1 : 0,
 	   hf,
 	   newBC!=0 ? 1 : 0,
 	   1,
 	   -1);
 
-  ufr=cpus.r[rA]-b;
+  ufr=z->cpus.r[rA]-b;
   if(hf!=0) ufr--;  /* if we turned H flag on, decrease by 1 */
-  setundocflags8(((ufr&0x02)<<4)|(ufr&0x08));
+  setundocflags8(z, ((ufr&0x02)<<4)|(ufr&0x08));
 
-  z80_clock_inc(16);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_cpdr(void) {
+static void ei_cpdr(z80_t *z) {
   uint8_t a,b,ufr,res;
   uint16_t newBC;
   uint8_t hf;
 
-  a=cpus.r[rA];
-  b=_iHL8();
-  res=a-b;
-  cpus.W = cpus.r[rB];
-  setHL(getHL()-1);
-  newBC=getBC()-1; setBC(newBC);
-  hf=(a&0x0f)-(b&0x0f) < 0 ? 1 : 0;
-
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	   hf,
-	   newBC!=0 ? 1 : 0,
-	   1,
-	   -1);
-
-  ufr=cpus.r[rA]-b;
-  if(hf!=0) ufr--;  /* if we turned H flag on, decrease by 1 */
-  setundocflags8(((ufr&0x02)<<4)|(ufr&0x08));
-
-  if(newBC==0 || (cpus.F & fZ) != 0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+  for(;;) {
+    a=z->cpus.r[rA];
+    b=_iHL8(z);
+    res=a-b;
+    z->cpus.W = z->cpus.r[rB];
+    setHL(z, getHL(z)-1);
+    newBC=getBC(z)-1; setBC(z, newBC);
+    hf=(a&0x0f)-(b&0x0f) < 0 ? 1 : 0;
+
+    setflags(z, (int)((res>>7)&1),
+	     (res&0xff)==0 ? 1 : 0,
+	     hf,
+	     newBC!=0 ? 1 : 0,
+	     1,
+	     -1);
+
+    ufr=z->cpus.r[rA]-b;
+    if(hf!=0) ufr--;  /* if we turned H flag on, decrease by 1 */
+    setundocflags8(z, ((ufr&0x02)<<4)|(ufr&0x08));
+
+    if(newBC==0 || flag_Z(z) != 0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
+    z80_cpxr_bulk(z, -1);
   }
 }
 
-static void ei_cpi(void) {
+static void ei_cpi(z80_t *z) {
   uint8_t a,b,ufr,res;
   uint16_t newBC;
   uint8_t hf;
 
-  a=cpus.r[rA];
-  b=_iHL8();
+  a=z->cpus.r[rA];
+  b=_iHL8(z);
   res=a-b;
-  cpus.W = cpus.r[rB];
-  setHL(getHL()+1);
-  newBC=getBC()-1; setBC(newBC);
+  z->cpus.W = z->cpus.r[rB];
+  setHL(z, getHL(z)+1);
+  newBC=getBC(z)-1; setBC(z, newBC);
   hf=(a&0x0f)-(b&0x0f) < 0 ? 1 : 0;
   
-  setflags((int)((res>>7)&1),
+  setflags(z, (int)((res>>7)&1),
 	   (res&0xff)==0 ? 1 : 0,
 	   hf,
 	   newBC!=0 ? 1 : 0,
 	   1,
 	   -1);
 
-  ufr=cpus.r[rA]-b;
+  ufr=z->cpus.r[rA]-b;
   if(hf!=0) ufr--;  /* if we turned H flag on, decrease by 1 */
-  setundocflags8(((ufr&0x02)<<4)|(ufr&0x08));
+  setundocflags8(z, ((ufr&0x02)<<4)|(ufr&0x08));
 
-  z80_clock_inc(16);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_cpir(void) {
+static void ei_cpir(z80_t *z) {
   uint8_t a,b,ufr,res;
   uint16_t newBC;
   uint8_t hf;
 
-  a=cpus.r[rA];
-  b=_iHL8();
-  res=a-b;
-  cpus.W = cpus.r[rB];
-  setHL(getHL()+1);
-  newBC=getBC()-1; setBC(newBC);
-  hf=(a&0x0f)-(b&0x0f) < 0 ? 1 : 0;
-  
-  setflags((int)((res>>7)&1),
-	   (res&0xff)==0 ? 1 : 0,
-	  hf,
-	   newBC!=0 ? 1 : 0,
-	   1,
-	   -1);
-
-  ufr=cpus.r[rA]-b;
-  if(hf!=0) ufr--;  /* if we turned H flag on, decrease by 1 */
-  setundocflags8(((ufr&0x02)<<4)|(ufr&0x08));
-
-  if(newBC==0 || (cpus.F & fZ) != 0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+  for(;;) {
+    a=z->cpus.r[rA];
+    b=_iHL8(z);
+    res=a-b;
+    z->cpus.W = z->cpus.r[rB];
+    setHL(z, getHL(z)+1);
+    newBC=getBC(z)-1; setBC(z, newBC);
+    hf=(a&0x0f)-(b&0x0f) < 0 ? 1 : 0;
+
+    setflags(z, (int)((res>>7)&1),
+	     (res&0xff)==0 ? 1 : 0,
+	     hf,
+	     newBC!=0 ? 1 : 0,
+	     1,
+	     -1);
+
+    ufr=z->cpus.r[rA]-b;
+    if(hf!=0) ufr--;  /* if we turned H flag on, decrease by 1 */
+    setundocflags8(z, ((ufr&0x02)<<4)|(ufr&0x08));
+
+    if(newBC==0 || flag_Z(z) != 0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
+    z80_cpxr_bulk(z, 1);
   }
 }
 
 /************************************************************************/
 
-static void ei_cpl(void) { /* A <- cpl(A) ... one's complement */
-  cpus.r[rA] ^= 0xff;
-  setflags(-1,
+static void ei_cpl(z80_t *z) { /* A <- cpl(A) ... one's complement */
+  z->cpus.r[rA] ^= 0xff;
+  setflags(z, -1,
            -1,
 	   1,
 	   -1,
 	   1,
 	   -1);
-  setundocflags8(cpus.r[rA]);
-  z80_clock_inc(4);
+  setundocflags8(z, z->cpus.r[rA]);
+  z80_clock_inc(z, 4);
 }
 
 
 /************************************************************************/
 
-static void ei_daa(void) {
+static void ei_daa(z80_t *z) {
   uint16_t res;
   
-  res=cpus.r[rA];
+  flags_sync(z);
+  res=z->cpus.r[rA];
   
-  if((cpus.F & fN)==0) {
-    if((cpus.F & fC) != 0) res += 0x60;
-      else if(res>0x99) { res += 0x60; cpus.F|=fC; }
+  if((z->cpus.F & fN)==0) {
+    if((z->cpus.F & fC) != 0) res += 0x60;
+      else if(res>0x99) { res += 0x60; z->cpus.F|=fC; }
       
-    if((cpus.F & fHC) != 0) { if ((res & 0x0f) <= 0x09) cpus.F &= ~fHC; res += 0x06; }
-      else if((res&0x0f)>0x09) { res += 0x06; cpus.F|=fHC; }
+    if((z->cpus.F & fHC) != 0) { if ((res & 0x0f) <= 0x09) z->cpus.F &= ~fHC; res += 0x06; }
+      else if((res&0x0f)>0x09) { res += 0x06; z->cpus.F|=fHC; }
   } else {
-    if((cpus.F & fC) != 0) res -= 0x60;
-      else if(res>0x99) { res -= 0x60; cpus.F|=fC; }
+    if((z->cpus.F & fC) != 0) res -= 0x60;
+      else if(res>0x99) { res -= 0x60; z->cpus.F|=fC; }
       
-    if((cpus.F & fHC) != 0) { if ((res & 0x0f) >= 0x06) cpus.F &= ~fHC; res -= 0x06; }
+    if((z->cpus.F & fHC) != 0) { if ((res & 0x0f) >= 0x06) z->cpus.F &= ~fHC; res -= 0x06; }
       else if((res&0x0f)>0x09) { res -= 0x06; }
   }
-  setflags((int)((res>>7)&1),
+  setflags(z, (int)((res>>7)&1),
 	   (res&0xff)==0 ? 1 : 0,
 	   -1,
 	   oddp8(res&0xff),
 	   -1,
 	   -1);
-  setundocflags8(res&0xff);
+  setundocflags8(z, res&0xff);
   
-  cpus.r[rA] = res & 0xff;
+  z->cpus.r[rA] = res & 0xff;
   
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
 /************************************************************************/
 
-static void ei_dec_A(void) {
+static void ei_dec_A(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rA]);
-  cpus.r[rA]=res;
+  res=_dec8(z, z->cpus.r[rA]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_B(void) {
+static void ei_dec_B(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rB]);
-  cpus.r[rB]=res;
+  res=_dec8(z, z->cpus.r[rB]);
+  z->cpus.r[rB]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_C(void) {
+static void ei_dec_C(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rC]);
-  cpus.r[rC]=res;
+  res=_dec8(z, z->cpus.r[rC]);
+  z->cpus.r[rC]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_D(void) {
+static void ei_dec_D(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rD]);
-  cpus.r[rD]=res;
+  res=_dec8(z, z->cpus.r[rD]);
+  z->cpus.r[rD]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_E(void) {
+static void ei_dec_E(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rE]);
-  cpus.r[rE]=res;
+  res=_dec8(z, z->cpus.r[rE]);
+  z->cpus.r[rE]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_H(void) {
+static void ei_dec_H(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rH]);
-  cpus.r[rH]=res;
+  res=_dec8(z, z->cpus.r[rH]);
+  z->cpus.r[rH]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_L(void) {
+static void ei_dec_L(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(cpus.r[rL]);
-  cpus.r[rL]=res;
+  res=_dec8(z, z->cpus.r[rL]);
+  z->cpus.r[rL]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_dec_iHL(void) {
+static void ei_dec_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(_iHL8());
-  s_iHL8(res);
+  res=_dec8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_dec_iIXN(void) {
+static void ei_dec_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_dec8(_iIXN8(op));
-  s_iIXN8(op,res);
+  res=_dec8(z, _iIXN8(z, op));
+  s_iIXN8(z, op,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_dec_iIYN(void) {
+static void ei_dec_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_dec8(_iIYN8(op));
-  s_iIYN8(op,res);
+  res=_dec8(z, _iIYN8(z, op));
+  s_iIYN8(z, op,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_dec_BC(void) {
+static void ei_dec_BC(z80_t *z) {
 
-  setBC(getBC()-1);
-  z80_clock_inc(6);
+  setBC(z, getBC(z)-1);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_dec_DE(void) {
+static void ei_dec_DE(z80_t *z) {
 
-  setDE(getDE()-1);
-  z80_clock_inc(6);
+  setDE(z, getDE(z)-1);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_dec_HL(void) {
+static void ei_dec_HL(z80_t *z) {
 
-  setHL(getHL()-1);
-  z80_clock_inc(6);
+  setHL(z, getHL(z)-1);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_dec_SP(void) {
+static void ei_dec_SP(z80_t *z) {
 
-  cpus.SP--;
-  z80_clock_inc(6);
+  z->cpus.SP--;
+  z80_clock_inc(z, 6);
 }
 
-static void ei_dec_IX(void) {
+static void ei_dec_IX(z80_t *z) {
 
-  cpus.IX--;
-  z80_clock_inc(6);
+  z->cpus.IX--;
+  z80_clock_inc(z, 6);
 }
 
-static void ei_dec_IY(void) {
+static void ei_dec_IY(z80_t *z) {
 
-  cpus.IY--;
-  z80_clock_inc(6);
+  z->cpus.IY--;
+  z80_clock_inc(z, 6);
 }
 
 /************************************************************************/
 
-static void ei_di(void) {
-  cpus.IFF1=cpus.IFF2=0;
-  cpus.int_lock=1;
-  z80_clock_inc(4);
+static void ei_di(z80_t *z) {
+  z->cpus.IFF1=z->cpus.IFF2=0;
+  z->cpus.int_lock=1;
+  z80_clock_inc(z, 4);
 }
 
 /************************************************************************/
 
-static void ei_djnz(void) {
+static void ei_djnz(z80_t *z) {
   uint8_t ofs;
   
-  ofs=z80_iget8();
-  cpus.r[rB]--;
-  if(cpus.r[rB]!=0) {
-    _jr8(ofs);
-    z80_clock_inc(13);
-  } else z80_clock_inc(8);
+  ofs=z80_iget8(z);
+  z->cpus.r[rB]--;
+  if(z->cpus.r[rB]!=0) {
+    _jr8(z, ofs);
+    z80_clock_inc(z, 13);
+  } else z80_clock_inc(z, 8);
 }
 
 /************************************************************************/
 
-static void ei_ei(void) {
-  cpus.IFF1=cpus.IFF2=1;
-  cpus.int_lock=1;
-  z80_clock_inc(4);
+static void ei_ei(z80_t *z) {
+  z->cpus.IFF1=z->cpus.IFF2=1;
+  z->cpus.int_lock=1;
+  z80_clock_inc(z, 4);
 }
 
 /************************************************************************/
 
-static void ei_ex_iSP_HL(void) {
+static void ei_ex_iSP_HL(z80_t *z) {
   uint16_t tmp;
 
-  tmp=_iSP16();
-  s_iSP16(getHL());
-  setHL(tmp);
+  tmp=_iSP16(z);
+  s_iSP16(z, getHL(z));
+  setHL(z, tmp);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_ex_iSP_IX(void) {
+static void ei_ex_iSP_IX(z80_t *z) {
   uint16_t tmp;
 
-  tmp=_iSP16();
-  s_iSP16(cpus.IX);
-  cpus.IX=tmp;
+  tmp=_iSP16(z);
+  s_iSP16(z, z->cpus.IX);
+  z->cpus.IX=tmp;
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_ex_iSP_IY(void) {
+static void ei_ex_iSP_IY(z80_t *z) {
   uint16_t tmp;
 
-  tmp=_iSP16();
-  s_iSP16(cpus.IY);
-  cpus.IY=tmp;
+  tmp=_iSP16(z);
+  s_iSP16(z, z->cpus.IY);
+  z->cpus.IY=tmp;
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_ex_AF_xAF(void) {
+static void ei_ex_AF_xAF(z80_t *z) {
   uint8_t tmp;
 
-  tmp=cpus.r[rA]; cpus.r[rA]=cpus.r_[rA]; cpus.r_[rA]=tmp;
-  tmp=cpus.F; cpus.F=cpus.F_; cpus.F_=tmp;
+  tmp=z->cpus.r[rA]; z->cpus.r[rA]=z->cpus.r_[rA]; z->cpus.r_[rA]=tmp;
+  flags_sync(z);
+  tmp=z->cpus.F; z->cpus.F=z->cpus.F_; z->cpus.F_=tmp;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ex_DE_HL(void) {
+static void ei_ex_DE_HL(z80_t *z) {
   uint16_t tmp;
 
-  tmp=getDE(); setDE(getHL()); setHL(tmp);
-  z80_clock_inc(4);
+  tmp=getDE(z); setDE(z, getHL(z)); setHL(z, tmp);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_exx(void) {
+static void ei_exx(z80_t *z) {
   uint8_t tmp;
 
-  tmp=cpus.r[rB]; cpus.r[rB]=cpus.r_[rB]; cpus.r_[rB]=tmp;
-  tmp=cpus.r[rC]; cpus.r[rC]=cpus.r_[rC]; cpus.r_[rC]=tmp;
-  tmp=cpus.r[rD]; cpus.r[rD]=cpus.r_[rD]; cpus.r_[rD]=tmp;
-  tmp=cpus.r[rE]; cpus.r[rE]=cpus.r_[rE]; cpus.r_[rE]=tmp;
-  tmp=cpus.r[rH]; cpus.r[rH]=cpus.r_[rH]; cpus.r_[rH]=tmp;
-  tmp=cpus.r[rL]; cpus.r[rL]=cpus.r_[rL]; cpus.r_[rL]=tmp;
+  tmp=z->cpus.r[rB]; z->cpus.r[rB]=z->cpus.r_[rB]; z->cpus.r_[rB]=tmp;
+  tmp=z->cpus.r[rC]; z->cpus.r[rC]=z->cpus.r_[rC]; z->cpus.r_[rC]=tmp;
+  tmp=z->cpus.r[rD]; z->cpus.r[rD]=z->cpus.r_[rD]; z->cpus.r_[rD]=tmp;
+  tmp=z->cpus.r[rE]; z->cpus.r[rE]=z->cpus.r_[rE]; z->cpus.r_[rE]=tmp;
+  tmp=z->cpus.r[rH]; z->cpus.r[rH]=z->cpus.r_[rH]; z->cpus.r_[rH]=tmp;
+  tmp=z->cpus.r[rL]; z->cpus.r[rL]=z->cpus.r_[rL]; z->cpus.r_[rL]=tmp;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
 
 /************************************************************************/
 
 
-static void ei_halt(void) {
-  cpus.halted=1;
+static void ei_halt(z80_t *z) {
+  z->cpus.halted=1;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
 
 /************************************************************************/
 
-static void ei_im_0(void) {
-  cpus.int_mode=0;
-  z80_clock_inc(8);
+static void ei_im_0(z80_t *z) {
+  z->cpus.int_mode=0;
+  z80_clock_inc(z, 8);
 }
 
-static void ei_im_1(void) {
-  cpus.int_mode=1;
-  z80_clock_inc(8);
+static void ei_im_1(z80_t *z) {
+  z->cpus.int_mode=1;
+  z80_clock_inc(z, 8);
 }
 
-static void ei_im_2(void) {
-  cpus.int_mode=2;
-  z80_clock_inc(8);
+static void ei_im_2(z80_t *z) {
+  z->cpus.int_mode=2;
+  z80_clock_inc(z, 8);
 }
 
 /************************************************************************/
 
-static void ei_in_A_iN(void) {
+static void ei_in_A_iN(z80_t *z) {
   uint8_t res;
   uint16_t op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  cpus.W=cpus.r[rA];
-  res=_in8pf(((uint16_t)cpus.r[rA]<<8)|(uint16_t)op);
-  cpus.r[rA]=res;
+  z->cpus.W=z->cpus.r[rA];
+  res=_in8pf(z, ((uint16_t)z->cpus.r[rA]<<8)|(uint16_t)op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void Ui_in_iC(void) {
+static void Ui_in_iC(z80_t *z) {
 
 //  printf("ei_in_iC (unsupported)\n");
-  (void)_in8(getBC());
-  cpus.W=cpus.r[rB];
+  (void)_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
 
-  uoc++;
-  z80_clock_inc(12);
+  z->uoc++;
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_A_iC(void) {
+static void ei_in_A_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rA]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_B_iC(void) {
+static void ei_in_B_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rB]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rB]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_C_iC(void) {
+static void ei_in_C_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rC]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rC]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_D_iC(void) {
+static void ei_in_D_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rD]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rD]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_E_iC(void) {
+static void ei_in_E_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rE]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rE]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_H_iC(void) {
+static void ei_in_H_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rH]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rH]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_in_L_iC(void) {
+static void ei_in_L_iC(z80_t *z) {
   uint8_t res;
 
-  res=_in8(getBC());
-  cpus.W=cpus.r[rB];
-  cpus.r[rL]=res;
+  res=_in8(z, getBC(z));
+  z->cpus.W=z->cpus.r[rB];
+  z->cpus.r[rL]=res;
 
-  z80_clock_inc(12);
+  z80_clock_inc(z, 12);
 }
 
 /************************************************************************/
 
-static void ei_inc_A(void) {
+static void ei_inc_A(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rA]);
-  cpus.r[rA]=res;
+  res=_inc8(z, z->cpus.r[rA]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_B(void) {
+static void ei_inc_B(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rB]);
-  cpus.r[rB]=res;
+  res=_inc8(z, z->cpus.r[rB]);
+  z->cpus.r[rB]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_C(void) {
+static void ei_inc_C(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rC]);
-  cpus.r[rC]=res;
+  res=_inc8(z, z->cpus.r[rC]);
+  z->cpus.r[rC]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_D(void) {
+static void ei_inc_D(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rD]);
-  cpus.r[rD]=res;
+  res=_inc8(z, z->cpus.r[rD]);
+  z->cpus.r[rD]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_E(void) {
+static void ei_inc_E(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rE]);
-  cpus.r[rE]=res;
+  res=_inc8(z, z->cpus.r[rE]);
+  z->cpus.r[rE]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_H(void) {
+static void ei_inc_H(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rH]);
-  cpus.r[rH]=res;
+  res=_inc8(z, z->cpus.r[rH]);
+  z->cpus.r[rH]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_L(void) {
+static void ei_inc_L(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(cpus.r[rL]);
-  cpus.r[rL]=res;
+  res=_inc8(z, z->cpus.r[rL]);
+  z->cpus.r[rL]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_inc_iHL(void) {
+static void ei_inc_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(_iHL8());
-  s_iHL8(res);
+  res=_inc8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_inc_iIXN(void) {
+static void ei_inc_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_inc8(_iIXN8(op));
-  s_iIXN8(op,res);
+  res=_inc8(z, _iIXN8(z, op));
+  s_iIXN8(z, op,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_inc_iIYN(void) {
+static void ei_inc_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_inc8(_iIYN8(op));
-  s_iIYN8(op,res);
+  res=_inc8(z, _iIYN8(z, op));
+  s_iIYN8(z, op,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_inc_BC(void) {
+static void ei_inc_BC(z80_t *z) {
 
-  setBC(getBC()+1);
-  z80_clock_inc(6);
+  setBC(z, getBC(z)+1);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_inc_DE(void) {
+static void ei_inc_DE(z80_t *z) {
 
-  setDE(getDE()+1);
-  z80_clock_inc(6);
+  setDE(z, getDE(z)+1);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_inc_HL(void) {
+static void ei_inc_HL(z80_t *z) {
 
-  setHL(getHL()+1);
-  z80_clock_inc(6);
+  setHL(z, getHL(z)+1);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_inc_SP(void) {
+static void ei_inc_SP(z80_t *z) {
 
-  cpus.SP++;
-  z80_clock_inc(6);
+  z->cpus.SP++;
+  z80_clock_inc(z, 6);
 }
 
-static void ei_inc_IX(void) {
+static void ei_inc_IX(z80_t *z) {
 
-  cpus.IX++;
-  z80_clock_inc(6);
+  z->cpus.IX++;
+  z80_clock_inc(z, 6);
 }
 
-static void ei_inc_IY(void) {
+static void ei_inc_IY(z80_t *z) {
 
-  cpus.IY++;
-  z80_clock_inc(6);
+  z->cpus.IY++;
+  z80_clock_inc(z, 6);
 }
 
 
 /************************************************************************/
 
-static void ei_ind(void) {
+static void ei_ind(z80_t *z) {
   uint8_t res,val;
 
-  val=_in8pf(getBC());
-  s_iHL8(val);
-  setHL(getHL()-1);
-  cpus.W = cpus.r[rB];
-  res=(cpus.r[rB]-1)&0xff;
+  val=_in8pf(z, getBC(z));
+  s_iHL8(z, val);
+  setHL(z, getHL(z)-1);
+  z->cpus.W = z->cpus.r[rB];
+  res=(z->cpus.r[rB]-1)&0xff;
   
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
+  set_F(z, res & (fU1 | fU2));
+  setflags(z, (int)(res>>7),
            res==0 ? 1 : 0,
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]-1))>0xff ? 1 : 0,
-	   oddp8(((val+(uint8_t)(cpus.r[rC]-1))&7)^res),
+	   ((uint16_t)val+(uint8_t)(z->cpus.r[rC]-1))>0xff ? 1 : 0,
+	   oddp8(((val+(uint8_t)(z->cpus.r[rC]-1))&7)^res),
 	   (int)(val>>7),
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]-1))>0xff ? 1 : 0);
+	   ((uint16_t)val+(uint8_t)(z->cpus.r[rC]-1))>0xff ? 1 : 0);
   
-  cpus.r[rB]=res;
-  z80_clock_inc(16);
+  z->cpus.r[rB]=res;
+  z80_clock_inc(z, 16);
 }
 
-static void ei_indr(void) {
+static void ei_indr(z80_t *z) {
   uint8_t res,val;
 
-  val=_in8pf(getBC());
-  s_iHL8(val);
-  setHL(getHL()-1);
-  cpus.W = cpus.r[rB];
-  res=(cpus.r[rB]-1)&0xff;
-  
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
-           res==0 ? 1 : 0,
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]-1))>0xff ? 1 : 0,
-	   oddp8(((val+(uint8_t)(cpus.r[rC]-1))&7)^res),
-	   (int)(val>>7),
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]-1))>0xff ? 1 : 0);
-  
-  cpus.r[rB]=res;
-  
-  if(res==0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+  for(;;) {
+    val=_in8pf(z, getBC(z));
+    s_iHL8(z, val);
+    setHL(z, getHL(z)-1);
+    z->cpus.W = z->cpus.r[rB];
+    res=(z->cpus.r[rB]-1)&0xff;
+
+    set_F(z, res & (fU1 | fU2));
+    setflags(z, (int)(res>>7),
+             res==0 ? 1 : 0,
+	     ((uint16_t)val+(uint8_t)(z->cpus.r[rC]-1))>0xff ? 1 : 0,
+	     oddp8(((val+(uint8_t)(z->cpus.r[rC]-1))&7)^res),
+	     (int)(val>>7),
+	     ((uint16_t)val+(uint8_t)(z->cpus.r[rC]-1))>0xff ? 1 : 0);
+
+    z->cpus.r[rB]=res;
+
+    if(res==0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
   }
 }
 
-static void ei_ini(void) {
+static void ei_ini(z80_t *z) {
   uint8_t res,val;
 
-  val=_in8pf(getBC());
-  s_iHL8(val);
-  setHL(getHL()+1);
-  cpus.W = cpus.r[rB];
-  res=(cpus.r[rB]-1)&0xff;
+  val=_in8pf(z, getBC(z));
+  s_iHL8(z, val);
+  setHL(z, getHL(z)+1);
+  z->cpus.W = z->cpus.r[rB];
+  res=(z->cpus.r[rB]-1)&0xff;
   
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
+  set_F(z, res & (fU1 | fU2));
+  setflags(z, (int)(res>>7),
            res==0 ? 1 : 0,
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]+1))>0xff ? 1 : 0,
-	   oddp8(((val+(uint8_t)(cpus.r[rC]+1))&7)^res),
+	   ((uint16_t)val+(uint8_t)(z->cpus.r[rC]+1))>0xff ? 1 : 0,
+	   oddp8(((val+(uint8_t)(z->cpus.r[rC]+1))&7)^res),
 	   (int)(val>>7),
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]+1))>0xff ? 1 : 0);
+	   ((uint16_t)val+(uint8_t)(z->cpus.r[rC]+1))>0xff ? 1 : 0);
   
-  cpus.r[rB]=res;
-  z80_clock_inc(16);
+  z->cpus.r[rB]=res;
+  z80_clock_inc(z, 16);
 }
 
-static void ei_inir(void) {
+static void ei_inir(z80_t *z) {
   uint8_t res,val;
 
-  val=_in8pf(getBC());
-  s_iHL8(val);
-  setHL(getHL()+1);
-  cpus.W = cpus.r[rB];
-  res=(cpus.r[rB]-1)&0xff;
-  
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
-           res==0 ? 1 : 0,
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]+1))>0xff ? 1 : 0,
-	   oddp8(((val+(uint8_t)(cpus.r[rC]+1))&7)^res),
-	   (int)(val>>7),
-	   ((uint16_t)val+(uint8_t)(cpus.r[rC]+1))>0xff ? 1 : 0);
-  
-  cpus.r[rB]=res;
-  
-  if(res==0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+  for(;;) {
+    val=_in8pf(z, getBC(z));
+    s_iHL8(z, val);
+    setHL(z, getHL(z)+1);
+    z->cpus.W = z->cpus.r[rB];
+    res=(z->cpus.r[rB]-1)&0xff;
+
+    set_F(z, res & (fU1 | fU2));
+    setflags(z, (int)(res>>7),
+             res==0 ? 1 : 0,
+	     ((uint16_t)val+(uint8_t)(z->cpus.r[rC]+1))>0xff ? 1 : 0,
+	     oddp8(((val+(uint8_t)(z->cpus.r[rC]+1))&7)^res),
+	     (int)(val>>7),
+	     ((uint16_t)val+(uint8_t)(z->cpus.r[rC]+1))>0xff ? 1 : 0);
+
+    z->cpus.r[rB]=res;
+
+    if(res==0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
   }
 }
 
 /************************************************************************/
 
-static void ei_jp_NN(void) {
+static void ei_jp_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
  // printf("jp 0x%04x\n",addr);
-  _jp16(addr);
-  z80_clock_inc(10);
+  _jp16(z, addr);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_HL(void) {
+static void ei_jp_HL(z80_t *z) {
   uint16_t addr;
 
-  addr=getHL();
+  addr=getHL(z);
 //  printf("%04x:jp HL [0x%04x]\n",cpus.PC,addr);
-  _jp16(addr);
-  z80_clock_inc(4);
+  _jp16(z, addr);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_jp_IX(void) {
+static void ei_jp_IX(z80_t *z) {
   uint16_t addr;
 
-  addr=cpus.IX;
-  _jp16(addr);
-  z80_clock_inc(4);
+  addr=z->cpus.IX;
+  _jp16(z, addr);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_jp_IY(void) {
+static void ei_jp_IY(z80_t *z) {
   uint16_t addr;
 
-  addr=cpus.IY;
-  _jp16(addr);
-  z80_clock_inc(4);
+  addr=z->cpus.IY;
+  _jp16(z, addr);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_jp_C_NN(void) {
+static void ei_jp_C_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fC) != 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if(flag_C(z) != 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_NC_NN(void) {
+static void ei_jp_NC_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fC) == 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if(flag_C(z) == 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_M_NN(void) {
+static void ei_jp_M_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fS) != 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if(flag_S(z) != 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_P_NN(void) {
+static void ei_jp_P_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fS) == 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if(flag_S(z) == 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_Z_NN(void) {
+static void ei_jp_Z_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fZ) != 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if(flag_Z(z) != 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_NZ_NN(void) {
+static void ei_jp_NZ_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fZ) == 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if(flag_Z(z) == 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_PE_NN(void) {
+static void ei_jp_PE_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fPV) != 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if((get_F(z) & fPV) != 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_jp_PO_NN(void) {
+static void ei_jp_PO_NN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.W=addr>>8;
-  if((cpus.F & fPV) == 0) {
-    _jp16(addr);
+  addr=z80_iget16(z);
+  z->cpus.W=addr>>8;
+  if((get_F(z) & fPV) == 0) {
+    _jp16(z, addr);
   }
-  z80_clock_inc(10);
+  z80_clock_inc(z, 10);
 }
 
 /************************************************************************/
 
-static void ei_jr_N(void) {
+static void ei_jr_N(z80_t *z) {
   uint8_t ofs;
 
-  ofs=z80_iget8();
-  _jr8(ofs);
-  z80_clock_inc(12);
+  ofs=z80_iget8(z);
+  _jr8(z, ofs);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_jr_C_N(void) {
+static void ei_jr_C_N(z80_t *z) {
   uint8_t ofs;
 
-  ofs=z80_iget8();
-  if((cpus.F & fC) != 0) {
-    _jr8(ofs);
-    z80_clock_inc(12);
-  } else z80_clock_inc(7);
+  ofs=z80_iget8(z);
+  if(flag_C(z) != 0) {
+    _jr8(z, ofs);
+    z80_clock_inc(z, 12);
+  } else z80_clock_inc(z, 7);
 }
 
-static void ei_jr_NC_N(void) {
+static void ei_jr_NC_N(z80_t *z) {
   uint8_t ofs;
 
-  ofs=z80_iget8();
-  if((cpus.F & fC) == 0) {
-    _jr8(ofs);
-    z80_clock_inc(12);
-  } else z80_clock_inc(7);
+  ofs=z80_iget8(z);
+  if(flag_C(z) == 0) {
+    _jr8(z, ofs);
+    z80_clock_inc(z, 12);
+  } else z80_clock_inc(z, 7);
 }
 
-static void ei_jr_Z_N(void) {
+static void ei_jr_Z_N(z80_t *z) {
   uint8_t ofs;
 
-  ofs=z80_iget8();
-  if((cpus.F & fZ) != 0) {
-    _jr8(ofs);
-    z80_clock_inc(12);
-  } else z80_clock_inc(7);
+  ofs=z80_iget8(z);
+  if(flag_Z(z) != 0) {
+    _jr8(z, ofs);
+    z80_clock_inc(z, 12);
+  } else z80_clock_inc(z, 7);
 }
 
-static void ei_jr_NZ_N(void) {
+static void ei_jr_NZ_N(z80_t *z) {
   uint8_t ofs;
 
-  ofs=z80_iget8();
-  if((cpus.F & fZ) == 0) {
-    _jr8(ofs);
-    z80_clock_inc(12);
-  } else z80_clock_inc(7);
+  ofs=z80_iget8(z);
+  if(flag_Z(z) == 0) {
+    _jr8(z, ofs);
+    z80_clock_inc(z, 12);
+  } else z80_clock_inc(z, 7);
 }
 
 /************************************************************************/
 
-static void ei_ld_I_A(void) {
+static void ei_ld_I_A(z80_t *z) {
 
-  cpus.I=cpus.r[rA];
-  z80_clock_inc(9);
+  z->cpus.I=z->cpus.r[rA];
+  z80_clock_inc(z, 9);
 }
 
-static void ei_ld_R_A(void) {
+static void ei_ld_R_A(z80_t *z) {
 
-  cpus.R=cpus.r[rA];
-  z80_clock_inc(9);
+  z->cpus.R=z->cpus.r[rA];
+  z80_clock_inc(z, 9);
 }
 
-static void ei_ld_A_I(void) {
+static void ei_ld_A_I(z80_t *z) {
 
-  cpus.r[rA]=cpus.I;
-  setflags((int)(cpus.r[rA]>>7),
-	   cpus.r[rA]==0 ? 1 : 0,
+  z->cpus.r[rA]=z->cpus.I;
+  setflags(z, (int)(z->cpus.r[rA]>>7),
+	   z->cpus.r[rA]==0 ? 1 : 0,
 	   0,
-	   cpus.IFF2,
+	   z->cpus.IFF2,
 	   0,
 	   -1);
-  setundocflags8(cpus.r[rA]);
-  z80_clock_inc(9);
+  setundocflags8(z, z->cpus.r[rA]);
+  z80_clock_inc(z, 9);
 }
 
-static void ei_ld_A_R(void) {
+static void ei_ld_A_R(z80_t *z) {
 
-  cpus.r[rA]=cpus.R;
-  setflags((int)(cpus.r[rA]>>7),
-	   cpus.r[rA]==0 ? 1 : 0,
+  z->cpus.r[rA]=z->cpus.R;
+  setflags(z, (int)(z->cpus.r[rA]>>7),
+	   z->cpus.r[rA]==0 ? 1 : 0,
 	   0,
-	   cpus.IFF2,
+	   z->cpus.IFF2,
 	   0,
 	   -1);
-  setundocflags8(cpus.r[rA]);
-  z80_clock_inc(9);
+  setundocflags8(z, z->cpus.r[rA]);
+  z80_clock_inc(z, 9);
 }
 
-static void ei_ld_A_r(void) {
+static void ei_ld_A_r(z80_t *z) {
 
-  cpus.r[rA]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rA]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_A_N(void) {
+static void ei_ld_A_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rA]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rA]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_A_iBC(void) {
+static void ei_ld_A_iBC(z80_t *z) {
 
-  cpus.r[rA]=_iBC8();
-  cpus.W=cpus.r[rB];
-  z80_clock_inc(7);
+  z->cpus.r[rA]=_iBC8(z);
+  z->cpus.W=z->cpus.r[rB];
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_A_iDE(void) {
+static void ei_ld_A_iDE(z80_t *z) {
 
-  cpus.r[rA]=_iDE8();
-  cpus.W=cpus.r[rD];
-  z80_clock_inc(7);
+  z->cpus.r[rA]=_iDE8(z);
+  z->cpus.W=z->cpus.r[rD];
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_A_iHL(void) {
+static void ei_ld_A_iHL(z80_t *z) {
 
-  cpus.r[rA]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rA]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_A_iIXN(void) {
+static void ei_ld_A_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rA]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rA]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_A_iIYN(void) {
+static void ei_ld_A_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rA]=_iIYN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rA]=_iIYN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_A_iNN(void) {
+static void ei_ld_A_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.r[rA]=z80_memget8(addr);
-  cpus.W=addr>>8;
-  z80_clock_inc(13);
+  addr=z80_iget16(z);
+  z->cpus.r[rA]=z80_memget8(z, addr);
+  z->cpus.W=addr>>8;
+  z80_clock_inc(z, 13);
 }
 
-static void ei_ld_B_r(void) {
+static void ei_ld_B_r(z80_t *z) {
 
-  cpus.r[rB]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rB]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_B_N(void) {
+static void ei_ld_B_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rB]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rB]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_B_iHL(void) {
+static void ei_ld_B_iHL(z80_t *z) {
 
-  cpus.r[rB]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rB]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_B_iIXN(void) {
+static void ei_ld_B_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rB]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rB]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_B_iIYN(void) {
+static void ei_ld_B_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rB]=_iIYN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rB]=_iIYN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_C_r(void) {
+static void ei_ld_C_r(z80_t *z) {
 
-  cpus.r[rC]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rC]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_C_N(void) {
+static void ei_ld_C_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rC]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rC]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_C_iHL(void) {
+static void ei_ld_C_iHL(z80_t *z) {
 
-  cpus.r[rC]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rC]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_C_iIXN(void) {
+static void ei_ld_C_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rC]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rC]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_C_iIYN(void) {
+static void ei_ld_C_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rC]=_iIYN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rC]=_iIYN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_D_r(void) {
+static void ei_ld_D_r(z80_t *z) {
 
-  cpus.r[rD]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rD]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_D_N(void) {
+static void ei_ld_D_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rD]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rD]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_D_iHL(void) {
+static void ei_ld_D_iHL(z80_t *z) {
 
-  cpus.r[rD]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rD]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_D_iIXN(void) {
+static void ei_ld_D_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rD]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rD]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_D_iIYN(void) {
+static void ei_ld_D_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rD]=_iIYN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rD]=_iIYN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_E_r(void) {
+static void ei_ld_E_r(z80_t *z) {
 
-  cpus.r[rE]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rE]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_E_N(void) {
+static void ei_ld_E_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rE]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rE]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_E_iHL(void) {
+static void ei_ld_E_iHL(z80_t *z) {
 
-  cpus.r[rE]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rE]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_E_iIXN(void) {
+static void ei_ld_E_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rE]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rE]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_E_iIYN(void) {
+static void ei_ld_E_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rE]=_iIYN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rE]=_iIYN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_H_r(void) {
+static void ei_ld_H_r(z80_t *z) {
 
-  cpus.r[rH]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rH]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_H_N(void) {
+static void ei_ld_H_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rH]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rH]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_H_iHL(void) {
+static void ei_ld_H_iHL(z80_t *z) {
 
-  cpus.r[rH]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rH]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_H_iIXN(void) {
+static void ei_ld_H_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rH]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rH]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_H_iIYN(void) {
+static void ei_ld_H_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rH]=_iIYN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rH]=_iIYN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_L_r(void) {
+static void ei_ld_L_r(z80_t *z) {
 
-  cpus.r[rL]=cpus.r[opcode & 0x07];
-  z80_clock_inc(4);
+  z->cpus.r[rL]=z->cpus.r[z->opcode & 0x07];
+  z80_clock_inc(z, 4);
 }
 
-static void ei_ld_L_N(void) {
+static void ei_ld_L_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rL]=op;
-  z80_clock_inc(7);
+  op=z80_iget8(z);
+  z->cpus.r[rL]=op;
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_L_iHL(void) {
+static void ei_ld_L_iHL(z80_t *z) {
 
-  cpus.r[rL]=_iHL8();
-  z80_clock_inc(7);
+  z->cpus.r[rL]=_iHL8(z);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_L_iIXN(void) {
+static void ei_ld_L_iIXN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  cpus.r[rL]=_iIXN8(op);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  z->cpus.r[rL]=_iIXN8(z, op);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_L_iIYN(void) {
+static void ei_ld_L_iIYN(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  cpus.r[rL]=_iIYN8(op);
+  z->cpus.r[rL]=_iIYN8(z, op);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_BC_iNN(void) {
+static void ei_ld_BC_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  setBC(z80_memget16(addr));
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  setBC(z, z80_memget16(z, addr));
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_BC_NN(void) {
+static void ei_ld_BC_NN(z80_t *z) {
   uint16_t data;
 
-  data=z80_iget16();
-  setBC(data);
-  z80_clock_inc(10);
+  data=z80_iget16(z);
+  setBC(z, data);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_DE_iNN(void) {
+static void ei_ld_DE_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  setDE(z80_memget16(addr));
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  setDE(z, z80_memget16(z, addr));
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_DE_NN(void) {
+static void ei_ld_DE_NN(z80_t *z) {
   uint16_t data;
 
-  data=z80_iget16();
-  setDE(data);
-  z80_clock_inc(10);
+  data=z80_iget16(z);
+  setDE(z, data);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_HL_iNN(void) {
+static void ei_ld_HL_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  setHL(z80_memget16(addr));
-  cpus.W=addr>>8;
-  z80_clock_inc(16);
+  addr=z80_iget16(z);
+  setHL(z, z80_memget16(z, addr));
+  z->cpus.W=addr>>8;
+  z80_clock_inc(z, 16);
 }
 
 /* ED prefixed variant, takes 4 more T states */
-static void ei_ld_HL_iNN_x(void) {
+static void ei_ld_HL_iNN_x(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  setHL(z80_memget16(addr));
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  setHL(z, z80_memget16(z, addr));
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_HL_NN(void) {
+static void ei_ld_HL_NN(z80_t *z) {
   uint16_t data;
 
-  data=z80_iget16();
-  setHL(data);
-  z80_clock_inc(10);
+  data=z80_iget16(z);
+  setHL(z, data);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_SP_iNN(void) {
+static void ei_ld_SP_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.SP=z80_memget16(addr);
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  z->cpus.SP=z80_memget16(z, addr);
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_SP_NN(void) {
+static void ei_ld_SP_NN(z80_t *z) {
   uint16_t data;
 
-  data=z80_iget16();
-  cpus.SP=data;
-  z80_clock_inc(10);
+  data=z80_iget16(z);
+  z->cpus.SP=data;
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_SP_HL(void) {
+static void ei_ld_SP_HL(z80_t *z) {
 
-  cpus.SP=getHL();
-  z80_clock_inc(6);
+  z->cpus.SP=getHL(z);
+  z80_clock_inc(z, 6);
 }
 
-static void ei_ld_SP_IX(void) {
+static void ei_ld_SP_IX(z80_t *z) {
 
-  cpus.SP=cpus.IX;
-  z80_clock_inc(6);
+  z->cpus.SP=z->cpus.IX;
+  z80_clock_inc(z, 6);
 }
 
-static void ei_ld_SP_IY(void) {
+static void ei_ld_SP_IY(z80_t *z) {
 
-  cpus.SP=cpus.IY;
-  z80_clock_inc(6);
+  z->cpus.SP=z->cpus.IY;
+  z80_clock_inc(z, 6);
 }
 
-static void ei_ld_IX_iNN(void) {
+static void ei_ld_IX_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.IX=z80_memget16(addr);
-  z80_clock_inc(16);
+  addr=z80_iget16(z);
+  z->cpus.IX=z80_memget16(z, addr);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_ld_IX_NN(void) {
+static void ei_ld_IX_NN(z80_t *z) {
   uint16_t data;
 
-  data=z80_iget16();
-  cpus.IX=data;
-  z80_clock_inc(10);
+  data=z80_iget16(z);
+  z->cpus.IX=data;
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_IY_iNN(void) {
+static void ei_ld_IY_iNN(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  cpus.IY=z80_memget16(addr);
-  z80_clock_inc(16);
+  addr=z80_iget16(z);
+  z->cpus.IY=z80_memget16(z, addr);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_ld_IY_NN(void) {
+static void ei_ld_IY_NN(z80_t *z) {
   uint16_t data;
 
-  data=z80_iget16();
-  cpus.IY=data;
-  z80_clock_inc(10);
+  data=z80_iget16(z);
+  z->cpus.IY=data;
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_iHL_r(void) {
+static void ei_ld_iHL_r(z80_t *z) {
 
-  s_iHL8(cpus.r[opcode & 0x07]);
-  z80_clock_inc(7);
+  s_iHL8(z, z->cpus.r[z->opcode & 0x07]);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_iHL_N(void) {
+static void ei_ld_iHL_N(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  s_iHL8(op);
-  z80_clock_inc(10);
+  op=z80_iget8(z);
+  s_iHL8(z, op);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ld_iBC_A(void) {
+static void ei_ld_iBC_A(z80_t *z) {
 
-  s_iBC8(cpus.r[rA]);
-  z80_clock_inc(7);
+  s_iBC8(z, z->cpus.r[rA]);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_iDE_A(void) {
+static void ei_ld_iDE_A(z80_t *z) {
 
-  s_iDE8(cpus.r[rA]);
-  z80_clock_inc(7);
+  s_iDE8(z, z->cpus.r[rA]);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_ld_iNN_A(void) {
+static void ei_ld_iNN_A(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset8(addr,cpus.r[rA]);
-  z80_clock_inc(13);
+  addr=z80_iget16(z);
+  z80_memset8(z, addr,z->cpus.r[rA]);
+  z80_clock_inc(z, 13);
 }
 
-static void ei_ld_iNN_BC(void) {
+static void ei_ld_iNN_BC(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset16(addr,getBC());
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  z80_memset16(z, addr,getBC(z));
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_iNN_DE(void) {
+static void ei_ld_iNN_DE(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset16(addr,getDE());
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  z80_memset16(z, addr,getDE(z));
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_iNN_HL(void) {
+static void ei_ld_iNN_HL(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset16(addr,getHL());
-  cpus.W=addr>>8;
-  z80_clock_inc(16);
+  addr=z80_iget16(z);
+  z80_memset16(z, addr,getHL(z));
+  z->cpus.W=addr>>8;
+  z80_clock_inc(z, 16);
 }
 
-static void ei_ld_iNN_SP(void) {
+static void ei_ld_iNN_SP(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset16(addr,cpus.SP);
-  z80_clock_inc(20);
+  addr=z80_iget16(z);
+  z80_memset16(z, addr,z->cpus.SP);
+  z80_clock_inc(z, 20);
 }
 
-static void ei_ld_iNN_IX(void) {
+static void ei_ld_iNN_IX(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset16(addr,cpus.IX);
-  z80_clock_inc(16);
+  addr=z80_iget16(z);
+  z80_memset16(z, addr,z->cpus.IX);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_ld_iNN_IY(void) {
+static void ei_ld_iNN_IY(z80_t *z) {
   uint16_t addr;
 
-  addr=z80_iget16();
-  z80_memset16(addr,cpus.IY);
-  z80_clock_inc(16);
+  addr=z80_iget16(z);
+  z80_memset16(z, addr,z->cpus.IY);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_ld_iIXN_r(void) {
+static void ei_ld_iIXN_r(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  s_iIXN8(op,cpus.r[opcode & 0x07]);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  s_iIXN8(z, op,z->cpus.r[z->opcode & 0x07]);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_iIXN_N(void) {
+static void ei_ld_iIXN_N(z80_t *z) {
   uint8_t op,data;
 
-  op=z80_iget8();
-  data=z80_iget8();
-  s_iIXN8(op,data);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  data=z80_iget8(z);
+  s_iIXN8(z, op,data);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_iIYN_r(void) {
+static void ei_ld_iIYN_r(z80_t *z) {
   uint8_t op;
 
-  op=z80_iget8();
-  s_iIYN8(op,cpus.r[opcode & 0x07]);
-  z80_clock_inc(15);
+  op=z80_iget8(z);
+  s_iIYN8(z, op,z->cpus.r[z->opcode & 0x07]);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_ld_iIYN_N(void) {
+static void ei_ld_iIYN_N(z80_t *z) {
   uint8_t op,data;
 
-  op=z80_iget8();
-  data=z80_iget8();
+  op=z80_iget8(z);
+  data=z80_iget8(z);
 
-  s_iIYN8(op,data);
+  s_iIYN8(z, op,data);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 
 /************************************************************************/
 
-static void ei_ldd(void) {
+static void ei_ldd(z80_t *z) {
   uint8_t res,ufr;
   uint16_t newBC;
 
-  res=_iHL8();
-  s_iDE8(res);
-  setHL(getHL()-1);
-  newBC=getBC()-1;  setBC(newBC);
-  setDE(getDE()-1);
+  res=_iHL8(z);
+  s_iDE8(z, res);
+  setHL(z, getHL(z)-1);
+  newBC=getBC(z)-1;  setBC(z, newBC);
+  setDE(z, getDE(z)-1);
   
-  setflags(-1,
+  setflags(z, -1,
 	   -1,
 	   0,
 	   newBC!=0 ? 1 : 0,
 	   0,
 	   -1);
-  ufr=res+cpus.r[rA];
-  setundocflags8(((ufr&0x02)<<4) | (ufr&0x08));
+  ufr=res+z->cpus.r[rA];
+  setundocflags8(z, ((ufr&0x02)<<4) | (ufr&0x08));
 
-  z80_clock_inc(16);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_lddr(void) {
+static void ei_lddr(z80_t *z) {
   uint8_t res,ufr;
   uint16_t newBC;
 
-  res=_iHL8();
-  s_iDE8(res);
-  setHL(getHL()-1);
-  newBC=getBC()-1;  setBC(newBC);
-  setDE(getDE()-1);
-  
-  setflags(-1,
-	   -1,
-	   0,
-	   newBC!=0 ? 1 : 0,
-	   0,
-	   -1);
-  ufr=res+cpus.r[rA];
-  setundocflags8(((ufr&0x02)<<4) | (ufr&0x08));
-
-  if(newBC==0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+  for(;;) {
+    res=_iHL8(z);
+    s_iDE8(z, res);
+    setHL(z, getHL(z)-1);
+    newBC=getBC(z)-1;  setBC(z, newBC);
+    setDE(z, getDE(z)-1);
+
+    setflags(z, -1,
+	     -1,
+	     0,
+	     newBC!=0 ? 1 : 0,
+	     0,
+	     -1);
+    ufr=res+z->cpus.r[rA];
+    setundocflags8(z, ((ufr&0x02)<<4) | (ufr&0x08));
+
+    if(newBC==0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
+    z80_ldxr_bulk(z, -1);
   }
 }
 
 
-static void ei_ldi(void) {
+static void ei_ldi(z80_t *z) {
   uint8_t res,ufr;
   uint16_t newBC;
 
-  res=_iHL8();
-  s_iDE8(res);
-  setHL(getHL()+1);
-  newBC=getBC()-1; setBC(newBC);
-  setDE(getDE()+1);
+  res=_iHL8(z);
+  s_iDE8(z, res);
+  setHL(z, getHL(z)+1);
+  newBC=getBC(z)-1; setBC(z, newBC);
+  setDE(z, getDE(z)+1);
   
-  setflags(-1,
+  setflags(z, -1,
 	   -1,
 	   0,
 	   newBC!=0 ? 1 : 0,
 	   0,
 	   -1);
-  ufr=res+cpus.r[rA];
-  setundocflags8(((ufr&0x02)<<4) | (ufr&0x08));
+  ufr=res+z->cpus.r[rA];
+  setundocflags8(z, ((ufr&0x02)<<4) | (ufr&0x08));
 
-  z80_clock_inc(16);
+  z80_clock_inc(z, 16);
 }
 
-static void ei_ldir(void) {
+static void ei_ldir(z80_t *z) {
   uint8_t res,ufr;
   uint16_t newBC;
 
-  res=_iHL8();
-  s_iDE8(res);
-  setHL(getHL()+1);
-  newBC=getBC()-1; setBC(newBC);
-  setDE(getDE()+1);
-  setflags(-1,
-	   -1,
-	   0,
-	   newBC!=0 ? 1 : 0,
-	   0,
-	   -1);
-  ufr=res+cpus.r[rA];
-  setundocflags8(((ufr&0x02)<<4) | (ufr&0x08));
-
-  if(newBC==0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+  for(;;) {
+    res=_iHL8(z);
+    s_iDE8(z, res);
+    setHL(z, getHL(z)+1);
+    newBC=getBC(z)-1; setBC(z, newBC);
+    setDE(z, getDE(z)+1);
+    setflags(z, -1,
+	     -1,
+	     0,
+	     newBC!=0 ? 1 : 0,
+	     0,
+	     -1);
+    ufr=res+z->cpus.r[rA];
+    setundocflags8(z, ((ufr&0x02)<<4) | (ufr&0x08));
+
+    if(newBC==0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
+    z80_ldxr_bulk(z, 1);
   }
 }
 
 
 /************************************************************************/
 
-static void ei_neg(void) {               /* A <- neg(A) .. two's complement */
+static void ei_neg(z80_t *z) {               /* A <- neg(A) .. two's complement */
   uint8_t oldA;
   uint8_t res;
 
-  oldA = cpus.r[rA];
+  oldA = z->cpus.r[rA];
   res = (oldA ^ 0xff)+1;
 
-  setflags((int)(res>>7),
+  setflags(z, (int)(res>>7),
 	   res==0 ? 1 : 0,
 	   (oldA&0x0f)!=0 ? 1 : 0,
 	   oldA==0x80 ? 1 : 0,     /* 127 -> -128 */
 	   1,
 	   oldA != 0x00 ? 1 : 0);
 
-  cpus.r[rA] = res;
-  setundocflags8(res);
-  z80_clock_inc(8);
+  z->cpus.r[rA] = res;
+  setundocflags8(z, res);
+  z80_clock_inc(z, 8);
 }
 
 /************************************************************************/
 
-static void ei_nop(void) {
-  z80_clock_inc(4);
+static void ei_nop(z80_t *z) {
+  z80_clock_inc(z, 4);
 }
 
 /************************************************************************/
 
-static void ei_or_r(void) {
+static void ei_or_r(z80_t *z) {
   uint8_t res;
 
-  res=_or8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_or_N(void) {
+static void ei_or_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_or8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_or_iHL(void) {
+static void ei_or_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_or8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_or_iIXN(void) {
+static void ei_or_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_or8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_or_iIYN(void) {
+static void ei_or_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_or8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /************************************************************************/
 
-static void ei_out_iN_A(void) {
+static void ei_out_iN_A(z80_t *z) {
   uint16_t op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  cpus.W=cpus.r[rA];
-  _out8(((uint16_t)cpus.r[rA]<<8)|(uint16_t)op,cpus.r[rA]);
+  z->cpus.W=z->cpus.r[rA];
+  _out8(z, ((uint16_t)z->cpus.r[rA]<<8)|(uint16_t)op,z->cpus.r[rA]);
 
-  z80_clock_inc(11);
+  z80_clock_inc(z, 11);
 }
 
-static void Ui_out_iC_0(void) {
+static void Ui_out_iC_0(z80_t *z) {
 
 //  printf("ei_out_iC_0 (unsupported)\n");
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),0);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),0);
 
-  uoc++;
-  z80_clock_inc(12);
+  z->uoc++;
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_A(void) {
+static void ei_out_iC_A(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rA]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rA]);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_B(void) {
+static void ei_out_iC_B(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rB]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rB]);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_C(void) {
+static void ei_out_iC_C(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rC]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rC]);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_D(void) {
+static void ei_out_iC_D(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rD]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rD]);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_E(void) {
+static void ei_out_iC_E(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rE]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rE]);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_H(void) {
+static void ei_out_iC_H(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rH]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rH]);
+  z80_clock_inc(z, 12);
 }
 
-static void ei_out_iC_L(void) {
+static void ei_out_iC_L(z80_t *z) {
 
-  cpus.W=cpus.r[rB];
-  _out8(getBC(),cpus.r[rL]);
-  z80_clock_inc(12);
+  z->cpus.W=z->cpus.r[rB];
+  _out8(z, getBC(z),z->cpus.r[rL]);
+  z80_clock_inc(z, 12);
 }
 
 /************************************************************************/
 
-static void ei_outd(void) {
+static void ei_outd(z80_t *z) {
   uint8_t res;
   uint8_t val;
   uint16_t bc;
   
-  res=cpus.r[rB]-1;
-  bc = ((uint16_t)res << 8) | cpus.r[rC];
-  val = _iHL8();
-  _out8(bc,val);
-  cpus.W=res;
-  setHL(getHL()-1);
+  res=z->cpus.r[rB]-1;
+  bc = ((uint16_t)res << 8) | z->cpus.r[rC];
+  val = _iHL8(z);
+  _out8(z, bc,val);
+  z->cpus.W=res;
+  setHL(z, getHL(z)-1);
   
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
+  set_F(z, res & (fU1 | fU2));
+  setflags(z, (int)(res>>7),
            res==0 ? 1 : 0,
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0,
-	   oddp8(((val+cpus.r[rL])&7)^res),
+	   ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0,
+	   oddp8(((val+z->cpus.r[rL])&7)^res),
 	   (int)(val>>7),
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0);
+	   ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0);
    
-  cpus.r[rB]=res;
-  z80_clock_inc(16);
+  z->cpus.r[rB]=res;
+  z80_clock_inc(z, 16);
 }
 
-static void ei_otdr(void) {
+static void ei_otdr(z80_t *z) {
   uint8_t res;
   uint8_t val;
   uint16_t bc;
-  
-  res=cpus.r[rB]-1;
-  bc = ((uint16_t)res << 8) | cpus.r[rC];
-  val = _iHL8();
-  _out8(bc,val);
-  cpus.W=res;
-  setHL(getHL()-1);
-  
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
-           res==0 ? 1 : 0,
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0,
-	   oddp8(((val+cpus.r[rL])&7)^res),
-	   (int)(val>>7),
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0);
-  
-  cpus.r[rB]=res;
-  if(res==0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+
+  for(;;) {
+    res=z->cpus.r[rB]-1;
+    bc = ((uint16_t)res << 8) | z->cpus.r[rC];
+    val = _iHL8(z);
+    _out8(z, bc,val);
+    z->cpus.W=res;
+    setHL(z, getHL(z)-1);
+
+    set_F(z, res & (fU1 | fU2));
+    setflags(z, (int)(res>>7),
+             res==0 ? 1 : 0,
+	     ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0,
+	     oddp8(((val+z->cpus.r[rL])&7)^res),
+	     (int)(val>>7),
+	     ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0);
+
+    z->cpus.r[rB]=res;
+
+    if(res==0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
   }
 }
 
-static void ei_outi(void) {
+static void ei_outi(z80_t *z) {
   uint8_t res;
   uint8_t val;
   uint16_t bc;
   
-  res=cpus.r[rB]-1;
-  bc = ((uint16_t)res << 8) | cpus.r[rC];
-  val = _iHL8();
-  _out8(bc,val);
-  cpus.W=res;
-  setHL(getHL()+1);
+  res=z->cpus.r[rB]-1;
+  bc = ((uint16_t)res << 8) | z->cpus.r[rC];
+  val = _iHL8(z);
+  _out8(z, bc,val);
+  z->cpus.W=res;
+  setHL(z, getHL(z)+1);
   
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
+  set_F(z, res & (fU1 | fU2));
+  setflags(z, (int)(res>>7),
            res==0 ? 1 : 0,
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0,
-	   oddp8(((val+cpus.r[rL])&7)^res),
+	   ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0,
+	   oddp8(((val+z->cpus.r[rL])&7)^res),
 	   (int)(val>>7),
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0);
+	   ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0);
    
-  cpus.r[rB]=res;
-  z80_clock_inc(16);
+  z->cpus.r[rB]=res;
+  z80_clock_inc(z, 16);
 }
 
-static void ei_otir(void) {
+static void ei_otir(z80_t *z) {
   uint8_t res;
   uint8_t val;
   uint16_t bc;
-  
-  res=cpus.r[rB]-1;
-  bc = ((uint16_t)res << 8) | cpus.r[rC];
-  val = _iHL8();
-  _out8(bc,val);
-  cpus.W=res;
-  setHL(getHL()+1);
-  
-  cpus.F = res & (fU1 | fU2);
-  setflags((int)(res>>7),
-           res==0 ? 1 : 0,
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0,
-	   oddp8(((val+cpus.r[rL])&7)^res),
-	   (int)(val>>7),
-	   ((uint16_t)val+cpus.r[rL])>0xff ? 1 : 0);
-  
-  cpus.r[rB]=res;
-  if(res==0) {
-    z80_clock_inc(16);
-  } else {
-    z80_clock_inc(21);
-    cpus.PC-=2;
+
+  for(;;) {
+    res=z->cpus.r[rB]-1;
+    bc = ((uint16_t)res << 8) | z->cpus.r[rC];
+    val = _iHL8(z);
+    _out8(z, bc,val);
+    z->cpus.W=res;
+    setHL(z, getHL(z)+1);
+
+    set_F(z, res & (fU1 | fU2));
+    setflags(z, (int)(res>>7),
+             res==0 ? 1 : 0,
+	     ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0,
+	     oddp8(((val+z->cpus.r[rL])&7)^res),
+	     (int)(val>>7),
+	     ((uint16_t)val+z->cpus.r[rL])>0xff ? 1 : 0);
+
+    z->cpus.r[rB]=res;
+
+    if(res==0) {
+      z80_clock_inc(z, 16);
+      break;
+    }
+    z80_clock_inc(z, 21);
+    if(!z80_rep_next(z)) {
+      z->cpus.PC-=2;
+      break;
+    }
   }
 }
 
 
 /************************************************************************/
 
-static void ei_pop_AF(void) {
-  setAF(_pop16());
-  z80_clock_inc(10);
+static void ei_pop_AF(z80_t *z) {
+  setAF(z, _pop16(z));
+  z80_clock_inc(z, 10);
 }
 
-static void ei_pop_BC(void) {
-  setBC(_pop16());
-  z80_clock_inc(10);
+static void ei_pop_BC(z80_t *z) {
+  setBC(z, _pop16(z));
+  z80_clock_inc(z, 10);
 }
 
-static void ei_pop_DE(void) {
-  setDE(_pop16());
-  z80_clock_inc(10);
+static void ei_pop_DE(z80_t *z) {
+  setDE(z, _pop16(z));
+  z80_clock_inc(z, 10);
 }
 
-static void ei_pop_HL(void) {
-  setHL(_pop16());
-  z80_clock_inc(10);
+static void ei_pop_HL(z80_t *z) {
+  setHL(z, _pop16(z));
+  z80_clock_inc(z, 10);
 }
 
-static void ei_pop_IX(void) {
-  cpus.IX=_pop16();
-  z80_clock_inc(10);
+static void ei_pop_IX(z80_t *z) {
+  z->cpus.IX=_pop16(z);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_pop_IY(void) {
-  cpus.IY=_pop16();
-  z80_clock_inc(10);
+static void ei_pop_IY(z80_t *z) {
+  z->cpus.IY=_pop16(z);
+  z80_clock_inc(z, 10);
 }
 
-static void ei_push_AF(void) {
-  _push16(getAF());
-  z80_clock_inc(11);
+static void ei_push_AF(z80_t *z) {
+  _push16(z, getAF(z));
+  z80_clock_inc(z, 11);
 }
 
-static void ei_push_BC(void) {
-  _push16(getBC());
-  z80_clock_inc(11);
+static void ei_push_BC(z80_t *z) {
+  _push16(z, getBC(z));
+  z80_clock_inc(z, 11);
 }
 
-static void ei_push_DE(void) {
-  _push16(getDE());
-  z80_clock_inc(11);
+static void ei_push_DE(z80_t *z) {
+  _push16(z, getDE(z));
+  z80_clock_inc(z, 11);
 }
 
-static void ei_push_HL(void) {
-  _push16(getHL());
-  z80_clock_inc(11);
+static void ei_push_HL(z80_t *z) {
+  _push16(z, getHL(z));
+  z80_clock_inc(z, 11);
 }
 
-static void ei_push_IX(void) {
-  _push16(cpus.IX);
-  z80_clock_inc(11);
+static void ei_push_IX(z80_t *z) {
+  _push16(z, z->cpus.IX);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_push_IY(void) {
-  _push16(cpus.IY);
-  z80_clock_inc(11);
+static void ei_push_IY(z80_t *z) {
+  _push16(z, z->cpus.IY);
+  z80_clock_inc(z, 11);
 }
 
 /************************************************************************/
 
-static void ei_res_b_r(void) {
+static void ei_res_b_r(z80_t *z) {
   uint8_t res;
 
-  res=_res8((opcode>>3)&0x07,cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_res8((z->opcode>>3)&0x07,z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_res_b_iHL(void) {
+static void ei_res_b_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_res8((opcode>>3)&0x07,_iHL8());
-  s_iHL8(res);
+  res=_res8((z->opcode>>3)&0x07,_iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB ! */
-static void ei_res_b_iIXN(void) {
+static void ei_res_b_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_res8((opcode>>3)&0x07,_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_res8((z->opcode>>3)&0x07,_iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB ! */
-static void ei_res_b_iIYN(void) {
+static void ei_res_b_iIYN(z80_t *z) {
    uint8_t res;
 
-  res=_res8((opcode>>3)&0x07,_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_res8((z->opcode>>3)&0x07,_iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /************************************************************************/
 
-static void ei_ret(void) {
-  cpus.PC=_pop16();
-  cpus.W=cpus.PC>>8;
-  z80_clock_inc(10);
+static void ei_ret(z80_t *z) {
+  z->cpus.PC=_pop16(z);
+  z->cpus.W=z->cpus.PC>>8;
+  z80_clock_inc(z, 10);
 }
 
-static void ei_ret_C(void) {
-  if((cpus.F & fC) != 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_C(z80_t *z) {
+  if(flag_C(z) != 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
-static void ei_ret_NC(void) {
-  if((cpus.F & fC) == 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_NC(z80_t *z) {
+  if(flag_C(z) == 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
-static void ei_ret_M(void) {
-  if((cpus.F & fS) != 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_M(z80_t *z) {
+  if(flag_S(z) != 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
-static void ei_ret_P(void) {
-  if((cpus.F & fS) == 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_P(z80_t *z) {
+  if(flag_S(z) == 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
 
-static void ei_ret_Z(void) {
-  if((cpus.F & fZ) != 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_Z(z80_t *z) {
+  if(flag_Z(z) != 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
-static void ei_ret_NZ(void) {
-  if((cpus.F & fZ) == 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_NZ(z80_t *z) {
+  if(flag_Z(z) == 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
-static void ei_ret_PE(void) {
-  if((cpus.F & fPV) != 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_PE(z80_t *z) {
+  if((get_F(z) & fPV) != 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
-static void ei_ret_PO(void) {
-  if((cpus.F & fPV) == 0) {
-    cpus.PC=_pop16();
-    z80_clock_inc(11);
-  } else z80_clock_inc(5);
+static void ei_ret_PO(z80_t *z) {
+  if((get_F(z) & fPV) == 0) {
+    z->cpus.PC=_pop16(z);
+    z80_clock_inc(z, 11);
+  } else z80_clock_inc(z, 5);
 }
 
 /************************************************************************/
 
-static void ei_reti(void) {
-  cpus.IFF1=cpus.IFF2;
-  cpus.PC=_pop16();
-  cpus.W=cpus.PC>>8;
-  z80_clock_inc(14);
+static void ei_reti(z80_t *z) {
+  z->cpus.IFF1=z->cpus.IFF2;
+  z->cpus.PC=_pop16(z);
+  z->cpus.W=z->cpus.PC>>8;
+  z80_clock_inc(z, 14);
 }
 
 
-static void ei_retn(void) {
-  cpus.IFF1=cpus.IFF2;
-  cpus.PC=_pop16();
-  cpus.W=cpus.PC>>8;
-  z80_clock_inc(14);
+static void ei_retn(z80_t *z) {
+  z->cpus.IFF1=z->cpus.IFF2;
+  z->cpus.PC=_pop16(z);
+  z->cpus.W=z->cpus.PC>>8;
+  z80_clock_inc(z, 14);
 }
 
 /************************************************************************/
 
-static void ei_rla(void) {
+static void ei_rla(z80_t *z) {
   uint8_t res;
 
-  res=_rla8(cpus.r[rA]);
-  cpus.r[rA]=res;
+  res=_rla8(z, z->cpus.r[rA]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_rl_r(void) {
+static void ei_rl_r(z80_t *z) {
   uint8_t res;
 
-  res=_rl8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_rl8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_rl_iHL(void) {
+static void ei_rl_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_rl8(_iHL8());
-  s_iHL8(res);
+  res=_rl8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_rl_iIXN(void) {
+static void ei_rl_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rl8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_rl8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_rl_iIYN(void) {
+static void ei_rl_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rl8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_rl8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_rlca(void) {
+static void ei_rlca(z80_t *z) {
   uint8_t res;
 
-  res=_rlca8(cpus.r[rA]);
-  cpus.r[rA]=res;
+  res=_rlca8(z, z->cpus.r[rA]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_rlc_r(void) {
+static void ei_rlc_r(z80_t *z) {
   uint8_t res;
 
-  res=_rlc8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_rlc8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_rlc_iHL(void) {
+static void ei_rlc_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_rlc8(_iHL8());
-  s_iHL8(res);
+  res=_rlc8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_rlc_iIXN(void) {
+static void ei_rlc_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rlc8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_rlc8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_rlc_iIYN(void) {
+static void ei_rlc_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rlc8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_rlc8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_rld(void) {
+static void ei_rld(z80_t *z) {
   uint8_t tmp,tmp2,tmp3;
 
-  tmp=cpus.r[rA] & 0x0f;
-  tmp2=_iHL8();
+  tmp=z->cpus.r[rA] & 0x0f;
+  tmp2=_iHL8(z);
   tmp3=tmp2>>4;
   tmp2=(tmp2<<4)|tmp;
-  cpus.r[rA]=(cpus.r[rA] & 0xf0)| tmp3;
-  s_iHL8(tmp2);
+  z->cpus.r[rA]=(z->cpus.r[rA] & 0xf0)| tmp3;
+  s_iHL8(z, tmp2);
   
-  cpus.F=(cpus.F&fC)|ox_tab[cpus.r[rA]];
-  cpus.flags_aff=1;
+  set_F(z, flag_C(z)|ox_tab[z->cpus.r[rA]]);
+  z->cpus.flags_aff=1;
 
-  z80_clock_inc(18);
+  z80_clock_inc(z, 18);
 }
 
-static void ei_rra(void) {
+static void ei_rra(z80_t *z) {
   uint8_t res;
 
-  res=_rra8(cpus.r[rA]);
-  cpus.r[rA]=res;
+  res=_rra8(z, z->cpus.r[rA]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_rr_r(void) {
+static void ei_rr_r(z80_t *z) {
   uint8_t res;
 
-  res=_rr8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_rr8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_rr_iHL(void) {
+static void ei_rr_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_rr8(_iHL8());
-  s_iHL8(res);
+  res=_rr8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_rr_iIXN(void) {
+static void ei_rr_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rr8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_rr8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_rr_iIYN(void) {
+static void ei_rr_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rr8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_rr8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_rrca(void) {
+static void ei_rrca(z80_t *z) {
   uint8_t res;
 
-  res=_rrca8(cpus.r[rA]);
-  cpus.r[rA]=res;
+  res=_rrca8(z, z->cpus.r[rA]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_rrc_r(void) {
+static void ei_rrc_r(z80_t *z) {
   uint8_t res;
 
-  res=_rrc8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_rrc8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_rrc_iHL(void) {
+static void ei_rrc_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_rrc8(_iHL8());
-  s_iHL8(res);
+  res=_rrc8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_rrc_iIXN(void) {
+static void ei_rrc_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rrc8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_rrc8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_rrc_iIYN(void) {
+static void ei_rrc_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rrc8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_rrc8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_rrd(void) {
+static void ei_rrd(z80_t *z) {
   uint8_t tmp,tmp2,tmp3;
 
-  tmp=cpus.r[rA] & 0x0f;
-  tmp2=_iHL8();
+  tmp=z->cpus.r[rA] & 0x0f;
+  tmp2=_iHL8(z);
   tmp3=tmp2 & 0x0f;
   tmp2=(tmp2>>4)|(tmp<<4);
-  cpus.r[rA]=(cpus.r[rA] & 0xf0)| tmp3;
-  s_iHL8(tmp2);
+  z->cpus.r[rA]=(z->cpus.r[rA] & 0xf0)| tmp3;
+  s_iHL8(z, tmp2);
   
-  cpus.F=(cpus.F&fC)|ox_tab[cpus.r[rA]];
-  cpus.flags_aff=1;
+  set_F(z, flag_C(z)|ox_tab[z->cpus.r[rA]]);
+  z->cpus.flags_aff=1;
 
-  z80_clock_inc(18);
+  z80_clock_inc(z, 18);
 }
 
 /************************************************************************/
 
-static void ei_rst_0(void) {
-  _call16(0x0000);
-  z80_clock_inc(11);
+static void ei_rst_0(z80_t *z) {
+  _call16(z, 0x0000);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_8(void) {
-  _call16(0x0008);
-  z80_clock_inc(11);
+static void ei_rst_8(z80_t *z) {
+  _call16(z, 0x0008);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_10(void) {
-  _call16(0x0010);
-  z80_clock_inc(11);
+static void ei_rst_10(z80_t *z) {
+  _call16(z, 0x0010);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_18(void) {
-  _call16(0x0018);
-  z80_clock_inc(11);
+static void ei_rst_18(z80_t *z) {
+  _call16(z, 0x0018);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_20(void) {
-  _call16(0x0020);
-  z80_clock_inc(11);
+static void ei_rst_20(z80_t *z) {
+  _call16(z, 0x0020);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_28(void) {
-  _call16(0x0028);
-  z80_clock_inc(11);
+static void ei_rst_28(z80_t *z) {
+  _call16(z, 0x0028);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_30(void) {
-  _call16(0x0030);
-  z80_clock_inc(11);
+static void ei_rst_30(z80_t *z) {
+  _call16(z, 0x0030);
+  z80_clock_inc(z, 11);
 }
 
-static void ei_rst_38(void) {
-  _call16(0x0038);
-  z80_clock_inc(11);
+static void ei_rst_38(z80_t *z) {
+  _call16(z, 0x0038);
+  z80_clock_inc(z, 11);
 }
 
 /************************************************************************/
 
-static void ei_sbc_A_r(void) {
+static void ei_sbc_A_r(z80_t *z) {
   uint8_t res;
 
-  res=_sbc8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_sbc_A_N(void) {
+static void ei_sbc_A_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_sbc8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_sbc_A_iHL(void) {
+static void ei_sbc_A_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_sbc8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_sbc_A_iIXN(void) {
+static void ei_sbc_A_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_sbc8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_sbc_A_iIYN(void) {
+static void ei_sbc_A_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_sbc8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_sbc_HL_BC(void) {
+static void ei_sbc_HL_BC(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_sbc16(getHL(),getBC());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_sbc16(z, getHL(z),getBC(z));
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_sbc_HL_DE(void) {
+static void ei_sbc_HL_DE(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_sbc16(getHL(),getDE());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_sbc16(z, getHL(z),getDE(z));
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_sbc_HL_HL(void) {
+static void ei_sbc_HL_HL(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_sbc16(getHL(),getHL());
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_sbc16(z, getHL(z),getHL(z));
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_sbc_HL_SP(void) {
+static void ei_sbc_HL_SP(z80_t *z) {
   uint16_t res;
 
-  cpus.W=cpus.r[rH];
-  res=_sbc16(getHL(),cpus.SP);
-  setHL(res);
+  z->cpus.W=z->cpus.r[rH];
+  res=_sbc16(z, getHL(z),z->cpus.SP);
+  setHL(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 
 /************************************************************************/
 
-static void ei_scf(void) {
-  setflags(-1,-1,0,-1,0,1);
+static void ei_scf(z80_t *z) {
+  setflags(z, -1,-1,0,-1,0,1);
   /*
    * As found by Patrik Rak in 2012, if the previous instruction affected
    * flags, then SCF/CCF moves flags 3,5 from A. If it did not affect flags,
    * it ORs F with bits 3,5 from A.
    */
-  if (cpus.pflags_aff != 0)
-    cpus.F &= ~fU;
-  setundocflags8(cpus.r[rA] | cpus.F);
-  z80_clock_inc(4);
+  if (z->cpus.pflags_aff != 0)
+    z->cpus.F &= ~fU;
+  setundocflags8(z, z->cpus.r[rA] | z->cpus.F);
+  z80_clock_inc(z, 4);
 }
 
 /************************************************************************/
 
-static void ei_set_b_r(void) {
+static void ei_set_b_r(z80_t *z) {
   uint8_t res;
 
-  res=_set8((opcode>>3)&0x07,cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_set8((z->opcode>>3)&0x07,z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_set_b_iHL(void) {
+static void ei_set_b_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_set8((opcode>>3)&0x07,_iHL8());
-  s_iHL8(res);
+  res=_set8((z->opcode>>3)&0x07,_iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB ! */
-static void ei_set_b_iIXN(void) {
+static void ei_set_b_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_set8((opcode>>3)&0x07,_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_set8((z->opcode>>3)&0x07,_iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB ! */
-static void ei_set_b_iIYN(void) {
+static void ei_set_b_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_set8((opcode>>3)&0x07,_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_set8((z->opcode>>3)&0x07,_iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /************************************************************************/
 
-static void ei_sla_r(void) {
+static void ei_sla_r(z80_t *z) {
   uint8_t res;
 
-  res=_sla8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_sla8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_sla_iHL(void) {
+static void ei_sla_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_sla8(_iHL8());
-  s_iHL8(res);
+  res=_sla8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_sla_iIXN(void) {
+static void ei_sla_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_sla8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_sla8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_sla_iIYN(void) {
+static void ei_sla_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_sla8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_sla8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
-static void ei_sra_r(void) {
+static void ei_sra_r(z80_t *z) {
   uint8_t res;
 
-  res=_sra8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_sra8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_sra_iHL(void) {
+static void ei_sra_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_sra8(_iHL8());
-  s_iHL8(res);
+  res=_sra8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_sra_iIXN(void) {
+static void ei_sra_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_sra8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_sra8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_sra_iIYN(void) {
+static void ei_sra_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_sra8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_sra8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /************************************************************************/
 
 #ifndef NO_Z80UNDOC
 
-static void Ui_sll_r(void) {
+static void Ui_sll_r(z80_t *z) {
   uint8_t res;
 
-  res=_sll8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_sll8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  uoc++;
-  z80_clock_inc(8);
+  z->uoc++;
+  z80_clock_inc(z, 8);
 }
 
-static void Ui_sll_iHL(void) {
+static void Ui_sll_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_sll8(_iHL8());
-  s_iHL8(res);
+  res=_sll8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  uoc++;
-  z80_clock_inc(15);
+  z->uoc++;
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void Ui_sll_iIXN(void) {
+static void Ui_sll_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_sll8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_sll8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  uoc++;
-  z80_clock_inc(19);
+  z->uoc++;
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void Ui_sll_iIYN(void) {
+static void Ui_sll_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_sll8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_sll8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  uoc++;
-  z80_clock_inc(19);
+  z->uoc++;
+  z80_clock_inc(z, 19);
 }
 
 #else
@@ -3983,149 +4406,149 @@ static void Ui_sll_iIYN(void) {
 
 #endif
 
-static void ei_srl_r(void) {
+static void ei_srl_r(z80_t *z) {
   uint8_t res;
 
-  res=_srl8(cpus.r[opcode & 0x07]);
-  cpus.r[opcode & 0x07]=res;
+  res=_srl8(z, z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(8);
+  z80_clock_inc(z, 8);
 }
 
-static void ei_srl_iHL(void) {
+static void ei_srl_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_srl8(_iHL8());
-  s_iHL8(res);
+  res=_srl8(z, _iHL8(z));
+  s_iHL8(z, res);
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /* DDCB */
-static void ei_srl_iIXN(void) {
+static void ei_srl_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_srl8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
+  res=_srl8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /* FDCB */
-static void ei_srl_iIYN(void) {
+static void ei_srl_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_srl8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
+  res=_srl8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
 
-  z80_clock_inc(19);
+  z80_clock_inc(z, 19);
 }
 
 /************************************************************************/
 
-static void ei_sub_r(void) {
+static void ei_sub_r(z80_t *z) {
   uint8_t res;
 
-  res=_sub8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_sub_N(void) {
+static void ei_sub_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_sub8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_sub_iHL(void) {
+static void ei_sub_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_sub8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_sub_iIXN(void) {
+static void ei_sub_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_sub8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_sub_iIYN(void) {
+static void ei_sub_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_sub8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 
 /************************************************************************/
 
-static void ei_xor_r(void) {
+static void ei_xor_r(z80_t *z) {
   uint8_t res;
 
-  res=_xor8(cpus.r[rA],cpus.r[opcode & 0x07]);
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],z->cpus.r[z->opcode & 0x07]);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4);
+  z80_clock_inc(z, 4);
 }
 
-static void ei_xor_N(void) {
+static void ei_xor_N(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_xor8(cpus.r[rA],op);
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],op);
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_xor_iHL(void) {
+static void ei_xor_iHL(z80_t *z) {
   uint8_t res;
 
-  res=_xor8(cpus.r[rA],_iHL8());
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],_iHL8(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(7);
+  z80_clock_inc(z, 7);
 }
 
-static void ei_xor_iIXN(void) {
+static void ei_xor_iIXN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_xor8(cpus.r[rA],_iIXN8(op));
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],_iIXN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
-static void ei_xor_iIYN(void) {
+static void ei_xor_iIYN(z80_t *z) {
   uint8_t res,op;
 
-  op=z80_iget8();
+  op=z80_iget8(z);
 
-  res=_xor8(cpus.r[rA],_iIYN8(op));
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],_iIYN8(z, op));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(15);
+  z80_clock_inc(z, 15);
 }
 
 /************************ undocumented opcodes ****************************/
@@ -4133,1144 +4556,1144 @@ static void ei_xor_iIYN(void) {
 
 #ifndef NO_Z80UNDOC
 
-static void Ui_inc_IXh(void) {
+static void Ui_inc_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(getIXh());
-  setIXh(res);
+  res=_inc8(z, getIXh(z));
+  setIXh(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from inc_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from inc_A */
+  z->uoc++;
 }
 
-static void Ui_dec_IXh(void) {
+static void Ui_dec_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(getIXh());
-  setIXh(res);
+  res=_dec8(z, getIXh(z));
+  setIXh(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from dec_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from dec_A */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_N(void) {
+static void Ui_ld_IXh_N(z80_t *z) {
   uint8_t res;
 
-  res=z80_iget8();
-  setIXh(res);
+  res=z80_iget8(z);
+  setIXh(z, res);
 
-  z80_clock_inc(7); /* timing&flags taken from ld_A_N */
-  uoc++;
+  z80_clock_inc(z, 7); /* timing&flags taken from ld_A_N */
+  z->uoc++;
 }
 
-static void Ui_inc_IXl(void) {
+static void Ui_inc_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(getIXl());
-  setIXl(res);
+  res=_inc8(z, getIXl(z));
+  setIXl(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from inc_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from inc_A */
+  z->uoc++;
 }
 
-static void Ui_dec_IXl(void) {
+static void Ui_dec_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(getIXl());
-  setIXl(res);
+  res=_dec8(z, getIXl(z));
+  setIXl(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from dec_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from dec_A */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_N(void) {
+static void Ui_ld_IXl_N(z80_t *z) {
   uint8_t res;
 
-  res=z80_iget8();
-  setIXl(res);
+  res=z80_iget8(z);
+  setIXl(z, res);
 
-  z80_clock_inc(7); /* timing&flags taken from ld_A_N */
-  uoc++;
+  z80_clock_inc(z, 7); /* timing&flags taken from ld_A_N */
+  z->uoc++;
 }
 
-static void Ui_ld_B_IXh(void) {
+static void Ui_ld_B_IXh(z80_t *z) {
 
-  cpus.r[rB]=getIXh();
+  z->cpus.r[rB]=getIXh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_B_IXl(void) {
+static void Ui_ld_B_IXl(z80_t *z) {
 
-  cpus.r[rB]=getIXl();
+  z->cpus.r[rB]=getIXl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_C_IXh(void) {
+static void Ui_ld_C_IXh(z80_t *z) {
 
-  cpus.r[rC]=getIXh();
+  z->cpus.r[rC]=getIXh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_C_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_C_r */
+  z->uoc++;
 }
 
-static void Ui_ld_C_IXl(void) {
+static void Ui_ld_C_IXl(z80_t *z) {
 
-  cpus.r[rC]=getIXl();
+  z->cpus.r[rC]=getIXl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_C_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_C_r */
+  z->uoc++;
 }
 
-static void Ui_ld_D_IXh(void) {
+static void Ui_ld_D_IXh(z80_t *z) {
 
-  cpus.r[rD]=getIXh();
+  z->cpus.r[rD]=getIXh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_D_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_D_r */
+  z->uoc++;
 }
 
-static void Ui_ld_D_IXl(void) {
+static void Ui_ld_D_IXl(z80_t *z) {
 
-  cpus.r[rD]=getIXl();
+  z->cpus.r[rD]=getIXl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_D_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_D_r */
+  z->uoc++;
 }
 
-static void Ui_ld_E_IXh(void) {
+static void Ui_ld_E_IXh(z80_t *z) {
 
-  cpus.r[rE]=getIXh();
+  z->cpus.r[rE]=getIXh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_E_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_E_r */
+  z->uoc++;
 }
 
-static void Ui_ld_E_IXl(void) {
+static void Ui_ld_E_IXl(z80_t *z) {
 
-  cpus.r[rE]=getIXl();
+  z->cpus.r[rE]=getIXl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_E_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_E_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_B(void) {
+static void Ui_ld_IXh_B(z80_t *z) {
 
-  setIXh(cpus.r[rB]);
+  setIXh(z, z->cpus.r[rB]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_C(void) {
+static void Ui_ld_IXh_C(z80_t *z) {
 
-  setIXh(cpus.r[rC]);
+  setIXh(z, z->cpus.r[rC]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_D(void) {
+static void Ui_ld_IXh_D(z80_t *z) {
 
-  setIXh(cpus.r[rD]);
+  setIXh(z, z->cpus.r[rD]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_E(void) {
+static void Ui_ld_IXh_E(z80_t *z) {
 
-  setIXh(cpus.r[rE]);
+  setIXh(z, z->cpus.r[rE]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_IXh(void) {
+static void Ui_ld_IXh_IXh(z80_t *z) {
 
   /* does nothing */
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_IXl(void) {
+static void Ui_ld_IXh_IXl(z80_t *z) {
 
-  setIXh(getIXl());
+  setIXh(z, getIXl(z));
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXh_A(void) {
+static void Ui_ld_IXh_A(z80_t *z) {
 
-  setIXh(cpus.r[rA]);
+  setIXh(z, z->cpus.r[rA]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_B(void) {
+static void Ui_ld_IXl_B(z80_t *z) {
 
-  setIXl(cpus.r[rB]);
+  setIXl(z, z->cpus.r[rB]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_C(void) {
+static void Ui_ld_IXl_C(z80_t *z) {
 
-  setIXl(cpus.r[rC]);
+  setIXl(z, z->cpus.r[rC]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_D(void) {
+static void Ui_ld_IXl_D(z80_t *z) {
 
-  setIXl(cpus.r[rD]);
+  setIXl(z, z->cpus.r[rD]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_E(void) {
+static void Ui_ld_IXl_E(z80_t *z) {
 
-  setIXl(cpus.r[rE]);
+  setIXl(z, z->cpus.r[rE]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_IXh(void) {
+static void Ui_ld_IXl_IXh(z80_t *z) {
 
-  setIXl(getIXh());
+  setIXl(z, getIXh(z));
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_IXl(void) {
+static void Ui_ld_IXl_IXl(z80_t *z) {
 
   /* does nothing */
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IXl_A(void) {
+static void Ui_ld_IXl_A(z80_t *z) {
 
-  setIXl(cpus.r[rA]);
+  setIXl(z, z->cpus.r[rA]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_A_IXh(void) {
+static void Ui_ld_A_IXh(z80_t *z) {
 
-  cpus.r[rA]=getIXh();
+  z->cpus.r[rA]=getIXh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_A_IXl(void) {
+static void Ui_ld_A_IXl(z80_t *z) {
 
-  cpus.r[rA]=getIXl();
+  z->cpus.r[rA]=getIXl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
 /***********************************************************************/
 
-static void Ui_add_A_IXh(void) {
+static void Ui_add_A_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_add8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from add_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from add_A_r */
+  z->uoc++;
 }
 
-static void Ui_add_A_IXl(void) {
+static void Ui_add_A_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_add8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from add_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from add_A_r */
+  z->uoc++;
 }
 
-static void Ui_adc_A_IXh(void) {
+static void Ui_adc_A_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_adc8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from adc_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from adc_A_r */
+  z->uoc++;
 }
 
-static void Ui_adc_A_IXl(void) {
+static void Ui_adc_A_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_adc8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from adc_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from adc_A_r */
+  z->uoc++;
 }
 
-static void Ui_sub_IXh(void) {
+static void Ui_sub_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_sub8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sub_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sub_r */
+  z->uoc++;
 }
 
-static void Ui_sub_IXl(void) {
+static void Ui_sub_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_sub8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sub_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sub_r */
+  z->uoc++;
 }
 
-static void Ui_sbc_IXh(void) {
+static void Ui_sbc_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_sbc8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sbc_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sbc_r */
+  z->uoc++;
 }
 
-static void Ui_sbc_IXl(void) {
+static void Ui_sbc_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_sbc8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sbc_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sbc_r */
+  z->uoc++;
 }
 
-static void Ui_and_IXh(void) {
+static void Ui_and_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_and8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from and_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from and_r */
+  z->uoc++;
 }
 
-static void Ui_and_IXl(void) {
+static void Ui_and_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_and8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from and_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from and_r */
+  z->uoc++;
 }
 
-static void Ui_xor_IXh(void) {
+static void Ui_xor_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_xor8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from xor_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from xor_r */
+  z->uoc++;
 }
 
-static void Ui_xor_IXl(void) {
+static void Ui_xor_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_xor8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from xor_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from xor_r */
+  z->uoc++;
 }
 
-static void Ui_or_IXh(void) {
+static void Ui_or_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_or8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from or_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from or_r */
+  z->uoc++;
 }
 
-static void Ui_or_IXl(void) {
+static void Ui_or_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_or8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from or_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from or_r */
+  z->uoc++;
 }
 
-static void Ui_cp_IXh(void) {
+static void Ui_cp_IXh(z80_t *z) {
   uint8_t res;
 
-  res=_cp8(cpus.r[rA],getIXh());
-  cpus.r[rA]=res;
+  res=_cp8(z, z->cpus.r[rA],getIXh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from cp_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from cp_r */
+  z->uoc++;
 }
 
-static void Ui_cp_IXl(void) {
+static void Ui_cp_IXl(z80_t *z) {
   uint8_t res;
 
-  res=_cp8(cpus.r[rA],getIXl());
-  cpus.r[rA]=res;
+  res=_cp8(z, z->cpus.r[rA],getIXl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from cp_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from cp_r */
+  z->uoc++;
 }
 
 /**** FD .. ***************************************************************/
 
-static void Ui_inc_IYh(void) {
+static void Ui_inc_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(getIYh());
-  setIYh(res);
+  res=_inc8(z, getIYh(z));
+  setIYh(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from inc_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from inc_A */
+  z->uoc++;
 }
 
-static void Ui_dec_IYh(void) {
+static void Ui_dec_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(getIYh());
-  setIYh(res);
+  res=_dec8(z, getIYh(z));
+  setIYh(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from dec_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from dec_A */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_N(void) {
+static void Ui_ld_IYh_N(z80_t *z) {
   uint8_t res;
 
-  res=z80_iget8();
-  setIYh(res);
+  res=z80_iget8(z);
+  setIYh(z, res);
 
-  z80_clock_inc(7); /* timing&flags taken from ld_A_N */
-  uoc++;
+  z80_clock_inc(z, 7); /* timing&flags taken from ld_A_N */
+  z->uoc++;
 }
 
-static void Ui_inc_IYl(void) {
+static void Ui_inc_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_inc8(getIYl());
-  setIYl(res);
+  res=_inc8(z, getIYl(z));
+  setIYl(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from inc_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from inc_A */
+  z->uoc++;
 }
 
-static void Ui_dec_IYl(void) {
+static void Ui_dec_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_dec8(getIYl());
-  setIYl(res);
+  res=_dec8(z, getIYl(z));
+  setIYl(z, res);
 
-  z80_clock_inc(4); /* timing&flags taken from dec_A */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from dec_A */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_N(void) {
+static void Ui_ld_IYl_N(z80_t *z) {
   uint8_t res;
 
-  res=z80_iget8();
-  setIYl(res);
+  res=z80_iget8(z);
+  setIYl(z, res);
 
-  z80_clock_inc(7); /* timing&flags taken from ld_A_N */
-  uoc++;
+  z80_clock_inc(z, 7); /* timing&flags taken from ld_A_N */
+  z->uoc++;
 }
 
-static void Ui_ld_B_IYh(void) {
+static void Ui_ld_B_IYh(z80_t *z) {
 
-  cpus.r[rB]=getIYh();
+  z->cpus.r[rB]=getIYh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_B_IYl(void) {
+static void Ui_ld_B_IYl(z80_t *z) {
 
-  cpus.r[rB]=getIYl();
+  z->cpus.r[rB]=getIYl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_C_IYh(void) {
+static void Ui_ld_C_IYh(z80_t *z) {
 
-  cpus.r[rC]=getIYh();
+  z->cpus.r[rC]=getIYh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_C_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_C_r */
+  z->uoc++;
 }
 
-static void Ui_ld_C_IYl(void) {
+static void Ui_ld_C_IYl(z80_t *z) {
 
-  cpus.r[rC]=getIYl();
+  z->cpus.r[rC]=getIYl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_C_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_C_r */
+  z->uoc++;
 }
 
-static void Ui_ld_D_IYh(void) {
+static void Ui_ld_D_IYh(z80_t *z) {
 
-  cpus.r[rD]=getIYh();
+  z->cpus.r[rD]=getIYh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_D_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_D_r */
+  z->uoc++;
 }
 
-static void Ui_ld_D_IYl(void) {
+static void Ui_ld_D_IYl(z80_t *z) {
 
-  cpus.r[rD]=getIYl();
+  z->cpus.r[rD]=getIYl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_D_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_D_r */
+  z->uoc++;
 }
 
-static void Ui_ld_E_IYh(void) {
+static void Ui_ld_E_IYh(z80_t *z) {
 
-  cpus.r[rE]=getIYh();
+  z->cpus.r[rE]=getIYh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_E_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_E_r */
+  z->uoc++;
 }
 
-static void Ui_ld_E_IYl(void) {
+static void Ui_ld_E_IYl(z80_t *z) {
 
-  cpus.r[rE]=getIYl();
+  z->cpus.r[rE]=getIYl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_E_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_E_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_B(void) {
+static void Ui_ld_IYh_B(z80_t *z) {
 
-  setIYh(cpus.r[rB]);
+  setIYh(z, z->cpus.r[rB]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_C(void) {
+static void Ui_ld_IYh_C(z80_t *z) {
 
-  setIYh(cpus.r[rC]);
+  setIYh(z, z->cpus.r[rC]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_D(void) {
+static void Ui_ld_IYh_D(z80_t *z) {
 
-  setIYh(cpus.r[rD]);
+  setIYh(z, z->cpus.r[rD]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_E(void) {
+static void Ui_ld_IYh_E(z80_t *z) {
 
-  setIYh(cpus.r[rE]);
+  setIYh(z, z->cpus.r[rE]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_IYh(void) {
+static void Ui_ld_IYh_IYh(z80_t *z) {
 
   /* does nothing */
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_IYl(void) {
+static void Ui_ld_IYh_IYl(z80_t *z) {
 
-  setIYh(getIYl());
+  setIYh(z, getIYl(z));
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYh_A(void) {
+static void Ui_ld_IYh_A(z80_t *z) {
 
-  setIYh(cpus.r[rA]);
+  setIYh(z, z->cpus.r[rA]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_B(void) {
+static void Ui_ld_IYl_B(z80_t *z) {
 
-  setIYl(cpus.r[rB]);
+  setIYl(z, z->cpus.r[rB]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_C(void) {
+static void Ui_ld_IYl_C(z80_t *z) {
 
-  setIYl(cpus.r[rC]);
+  setIYl(z, z->cpus.r[rC]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_D(void) {
+static void Ui_ld_IYl_D(z80_t *z) {
 
-  setIYl(cpus.r[rD]);
+  setIYl(z, z->cpus.r[rD]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_E(void) {
+static void Ui_ld_IYl_E(z80_t *z) {
 
-  setIYl(cpus.r[rE]);
+  setIYl(z, z->cpus.r[rE]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_IYh(void) {
+static void Ui_ld_IYl_IYh(z80_t *z) {
 
-  setIYl(getIYh());
+  setIYl(z, getIYh(z));
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_IYl(void) {
+static void Ui_ld_IYl_IYl(z80_t *z) {
 
   /* does nothing */
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_IYl_A(void) {
+static void Ui_ld_IYl_A(z80_t *z) {
 
-  setIYl(cpus.r[rA]);
+  setIYl(z, z->cpus.r[rA]);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_A_IYh(void) {
+static void Ui_ld_A_IYh(z80_t *z) {
 
-  cpus.r[rA]=getIYh();
+  z->cpus.r[rA]=getIYh(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
-static void Ui_ld_A_IYl(void) {
+static void Ui_ld_A_IYl(z80_t *z) {
 
-  cpus.r[rA]=getIYl();
+  z->cpus.r[rA]=getIYl(z);
 
-  z80_clock_inc(4); /* timing&flags taken from ld_B_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from ld_B_r */
+  z->uoc++;
 }
 
 /***********************************************************************/
 
-static void Ui_add_A_IYh(void) {
+static void Ui_add_A_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_add8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from add_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from add_A_r */
+  z->uoc++;
 }
 
-static void Ui_add_A_IYl(void) {
+static void Ui_add_A_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_add8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_add8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from add_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from add_A_r */
+  z->uoc++;
 }
 
-static void Ui_adc_A_IYh(void) {
+static void Ui_adc_A_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_adc8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from adc_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from adc_A_r */
+  z->uoc++;
 }
 
-static void Ui_adc_A_IYl(void) {
+static void Ui_adc_A_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_adc8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_adc8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from adc_A_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from adc_A_r */
+  z->uoc++;
 }
 
-static void Ui_sub_IYh(void) {
+static void Ui_sub_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_sub8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sub_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sub_r */
+  z->uoc++;
 }
 
-static void Ui_sub_IYl(void) {
+static void Ui_sub_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_sub8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_sub8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sub_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sub_r */
+  z->uoc++;
 }
 
-static void Ui_sbc_IYh(void) {
+static void Ui_sbc_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_sbc8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sbc_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sbc_r */
+  z->uoc++;
 }
 
-static void Ui_sbc_IYl(void) {
+static void Ui_sbc_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_sbc8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_sbc8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from sbc_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from sbc_r */
+  z->uoc++;
 }
 
-static void Ui_and_IYh(void) {
+static void Ui_and_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_and8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from and_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from and_r */
+  z->uoc++;
 }
 
-static void Ui_and_IYl(void) {
+static void Ui_and_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_and8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_and8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from and_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from and_r */
+  z->uoc++;
 }
 
-static void Ui_xor_IYh(void) {
+static void Ui_xor_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_xor8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from xor_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from xor_r */
+  z->uoc++;
 }
 
-static void Ui_xor_IYl(void) {
+static void Ui_xor_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_xor8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_xor8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from xor_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from xor_r */
+  z->uoc++;
 }
 
-static void Ui_or_IYh(void) {
+static void Ui_or_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_or8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from or_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from or_r */
+  z->uoc++;
 }
 
-static void Ui_or_IYl(void) {
+static void Ui_or_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_or8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_or8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from or_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from or_r */
+  z->uoc++;
 }
 
-static void Ui_cp_IYh(void) {
+static void Ui_cp_IYh(z80_t *z) {
   uint8_t res;
 
-  res=_cp8(cpus.r[rA],getIYh());
-  cpus.r[rA]=res;
+  res=_cp8(z, z->cpus.r[rA],getIYh(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from cp_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from cp_r */
+  z->uoc++;
 }
 
-static void Ui_cp_IYl(void) {
+static void Ui_cp_IYl(z80_t *z) {
   uint8_t res;
 
-  res=_cp8(cpus.r[rA],getIYl());
-  cpus.r[rA]=res;
+  res=_cp8(z, z->cpus.r[rA],getIYl(z));
+  z->cpus.r[rA]=res;
 
-  z80_clock_inc(4); /* timing&flags taken from cp_r */
-  uoc++;
+  z80_clock_inc(z, 4); /* timing&flags taken from cp_r */
+  z->uoc++;
 }
 
 /**** ED .. ***************************************************************/
 
-static void Ui_ednop(void) { /* different from ei_nop! */
-  z80_clock_inc(8); /* according to Sean it's like 2 NOPs */
-  uoc++;
+static void Ui_ednop(z80_t *z) { /* different from ei_nop! */
+  z80_clock_inc(z, 8); /* according to Sean it's like 2 NOPs */
+  z->uoc++;
 }
 
-static void Ui_neg(void) {               /* A <- neg(A) .. two's complement */
+static void Ui_neg(z80_t *z) {               /* A <- neg(A) .. two's complement */
   uint8_t oldA;
   uint8_t res;
 
-  oldA = cpus.r[rA];
+  oldA = z->cpus.r[rA];
   res = (oldA ^ 0xff)+1;
 
-  setflags((int)(res>>7),
+  setflags(z, (int)(res>>7),
 	   res==0 ? 1 : 0,
 	   (oldA&0x0f)!=0 ? 1 : 0,
 	   oldA==0x80 ? 1 : 0,     /* 127 -> -128 */
 	   1,
 	   oldA != 0x00 ? 1 : 0);
 
-  cpus.r[rA] = res;
-  setundocflags8(res);
-  z80_clock_inc(8);
-  uoc++;
+  z->cpus.r[rA] = res;
+  setundocflags8(z, res);
+  z80_clock_inc(z, 8);
+  z->uoc++;
 }
 
-static void Ui_im_0(void) { /* probably ..*/
+static void Ui_im_0(z80_t *z) { /* probably ..*/
 //  printf("IM 0\n");
-  cpus.int_mode=0;
-  z80_clock_inc(8); /* timing taken from ei_im_0 */
-  uoc++;
+  z->cpus.int_mode=0;
+  z80_clock_inc(z, 8); /* timing taken from ei_im_0 */
+  z->uoc++;
 }
 
-static void Ui_im_1(void) { /* probably ..*/
+static void Ui_im_1(z80_t *z) { /* probably ..*/
 //  printf("IM 1\n");
-  cpus.int_mode=1;
-  z80_clock_inc(8); /* timing taken from ei_im_1 */
-  uoc++;
+  z->cpus.int_mode=1;
+  z80_clock_inc(z, 8); /* timing taken from ei_im_1 */
+  z->uoc++;
 }
 
-static void Ui_im_2(void) { /* probably ..*/
+static void Ui_im_2(z80_t *z) { /* probably ..*/
 //  printf("IM 2\n");
-  cpus.int_mode=2;
-  z80_clock_inc(8); /* timing taken from ei_im_2 */
-  uoc++;
+  z->cpus.int_mode=2;
+  z80_clock_inc(z, 8); /* timing taken from ei_im_2 */
+  z->uoc++;
 }
 
-static void Ui_reti(void) { /* undoc RETI behaves like RETN actually.. */
-  cpus.IFF1=cpus.IFF2;
-  cpus.PC=_pop16();
-  cpus.W=cpus.PC>>8;
-  z80_clock_inc(14); /* timing taken from ei_reti */
-  uoc++;
+static void Ui_reti(z80_t *z) { /* undoc RETI behaves like RETN actually.. */
+  z->cpus.IFF1=z->cpus.IFF2;
+  z->cpus.PC=_pop16(z);
+  z->cpus.W=z->cpus.PC>>8;
+  z80_clock_inc(z, 14); /* timing taken from ei_reti */
+  z->uoc++;
 }
 
-static void Ui_retn(void) {
-  cpus.IFF1=cpus.IFF2;
-  cpus.PC=_pop16();
-  cpus.W=cpus.PC>>8;
-  z80_clock_inc(14);  /* timing taken from ei_retn */
-  uoc++;
+static void Ui_retn(z80_t *z) {
+  z->cpus.IFF1=z->cpus.IFF2;
+  z->cpus.PC=_pop16(z);
+  z->cpus.W=z->cpus.PC>>8;
+  z80_clock_inc(z, 14);  /* timing taken from ei_retn */
+  z->uoc++;
 }
 
 /**** DD CB dd .. ***************************************************************/
 
-static void Ui_ld_r_rlc_iIXN(void) {
+static void Ui_ld_r_rlc_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rlc8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rlc8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rlc_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rlc_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_rrc_iIXN(void) {
+static void Ui_ld_r_rrc_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rrc8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rrc8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rrc_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rrc_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_rl_iIXN(void) {
+static void Ui_ld_r_rl_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rl8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rl8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rl_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rl_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_rr_iIXN(void) {
+static void Ui_ld_r_rr_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_rr8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rr8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rr_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rr_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_sla_iIXN(void) {
+static void Ui_ld_r_sla_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_sla8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_sla8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_sla_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_sla_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_sra_iIXN(void) {
+static void Ui_ld_r_sra_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_sra8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_sra8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_sra_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_sra_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_sll_iIXN(void) {
+static void Ui_ld_r_sll_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_sll8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_sll8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_sll_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_sll_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_srl_iIXN(void) {
+static void Ui_ld_r_srl_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_srl8(_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_srl8(z, _iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_srl_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_srl_iIXN */
+  z->uoc++;
 }
 
 /************************************************************************/
 
-static void Ui_bit_b_iIXN(void) {
+static void Ui_bit_b_iIXN(z80_t *z) {
 
-  (void)_bit8((opcode>>3)&0x07,_iIXN8(cbop));
-  setundocflags8(cpus.W);
+  (void)_bit8(z, (z->opcode>>3)&0x07,_iIXN8(z, z->cbop));
+  setundocflags8(z, z->cpus.W);
 
-  z80_clock_inc(16); /* timing&flags taken from ei_bit_b_iIXN */
-  uoc++;
+  z80_clock_inc(z, 16); /* timing&flags taken from ei_bit_b_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_res_b_iIXN(void) {
+static void Ui_ld_r_res_b_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_res8((opcode>>3)&0x07,_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_res8((z->opcode>>3)&0x07,_iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_res_b_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_res_b_iIXN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_set_b_iIXN(void) {
+static void Ui_ld_r_set_b_iIXN(z80_t *z) {
   uint8_t res;
 
-  res=_set8((opcode>>3)&0x07,_iIXN8(cbop));
-  s_iIXN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_set8((z->opcode>>3)&0x07,_iIXN8(z, z->cbop));
+  s_iIXN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_set_b_iIXN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_set_b_iIXN */
+  z->uoc++;
 }
 
 /**** FD CB dd .. ***************************************************************/
 
-static void Ui_ld_r_rlc_iIYN(void) {
+static void Ui_ld_r_rlc_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rlc8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rlc8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rlc_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rlc_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_rrc_iIYN(void) {
+static void Ui_ld_r_rrc_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rrc8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rrc8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rrc_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rrc_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_rl_iIYN(void) {
+static void Ui_ld_r_rl_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rl8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rl8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rl_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rl_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_rr_iIYN(void) {
+static void Ui_ld_r_rr_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_rr8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_rr8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_rr_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_rr_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_sla_iIYN(void) {
+static void Ui_ld_r_sla_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_sla8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_sla8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_sla_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_sla_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_sra_iIYN(void) {
+static void Ui_ld_r_sra_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_sra8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_sra8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_sra_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_sra_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_sll_iIYN(void) {
+static void Ui_ld_r_sll_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_sll8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_sll8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_sll_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_sll_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_srl_iIYN(void) {
+static void Ui_ld_r_srl_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_srl8(_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_srl8(z, _iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_srl_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_srl_iIYN */
+  z->uoc++;
 }
 
 /************************************************************************/
 
-static void Ui_bit_b_iIYN(void) {
+static void Ui_bit_b_iIYN(z80_t *z) {
 
-  (void)_bit8((opcode>>3)&0x07,_iIYN8(cbop));
-  setundocflags8(cpus.W);
+  (void)_bit8(z, (z->opcode>>3)&0x07,_iIYN8(z, z->cbop));
+  setundocflags8(z, z->cpus.W);
 
-  z80_clock_inc(16); /* timing&flags taken from ei_bit_b_iIYN */
-  uoc++;
+  z80_clock_inc(z, 16); /* timing&flags taken from ei_bit_b_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_res_b_iIYN(void) {
+static void Ui_ld_r_res_b_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_res8((opcode>>3)&0x07,_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_res8((z->opcode>>3)&0x07,_iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_res_b_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_res_b_iIYN */
+  z->uoc++;
 }
 
-static void Ui_ld_r_set_b_iIYN(void) {
+static void Ui_ld_r_set_b_iIYN(z80_t *z) {
   uint8_t res;
 
-  res=_set8((opcode>>3)&0x07,_iIYN8(cbop));
-  s_iIYN8(cbop,res);
-  cpus.r[opcode & 0x07]=res;
+  res=_set8((z->opcode>>3)&0x07,_iIYN8(z, z->cbop));
+  s_iIYN8(z, z->cbop,res);
+  z->cpus.r[z->opcode & 0x07]=res;
 
-  z80_clock_inc(19); /* timing&flags taken from ei_set_b_iIYN */
-  uoc++;
+  z80_clock_inc(z, 19); /* timing&flags taken from ei_set_b_iIYN */
+  z->uoc++;
 }
 
 #else
@@ -5403,235 +5826,354 @@ static void Ui_ld_r_set_b_iIYN(void) {
 /************************************************************************/
 /************************************************************************/
 
-static void Si_stray(void);
-static void Mi_dd(void);
-static void Mi_fd(void);
+static void Si_stray(z80_t *z);
+static void Mi_dd(z80_t *z);
+static void Mi_fd(z80_t *z);
 
 #include "z80itab.c"
 
-static void (*const *(ei_opm  [3]))(void) = { ei_op,   ei_ddop,   ei_fdop   };
-static void (*const *(ei_cbopm[3]))(void) = { ei_cbop, ei_ddcbop, ei_fdcbop };
+static void (*const *(ei_opm  [3]))(z80_t *) = { ei_op,   ei_ddop,   ei_fdop   };
+#ifndef Z80_THREADED
+static void (*const *(ei_cbopm[3]))(z80_t *) = { ei_cbop, ei_ddcbop, ei_fdcbop };
+#endif
 
-static void Mi_dd(void) {
-  z80_clock_inc(4);  /* according to Sean: 4T(as NOP), 1R */
-  cpus.int_lock=1; /* no interrupts! */
-  cpus.modifier=1; /* DD */
+static void Mi_dd(z80_t *z) {
+  z80_clock_inc(z, 4);  /* according to Sean: 4T(as NOP), 1R */
+  z->cpus.int_lock=1; /* no interrupts! */
+  z->cpus.modifier=1; /* DD */
 }
 
-static void Mi_fd(void) {
-  z80_clock_inc(4);  /* according to Sean: 4T(as NOP), 1R */
-  cpus.int_lock=1; /* no interrupts! */
-  cpus.modifier=2; /* FD */
+static void Mi_fd(z80_t *z) {
+  z80_clock_inc(z, 4);  /* according to Sean: 4T(as NOP), 1R */
+  z->cpus.int_lock=1; /* no interrupts! */
+  z->cpus.modifier=2; /* FD */
 }
 
-static void Si_stray(void) {  /* DD/FD was stray.. another DD/FD or unprefixed
+static void Si_stray(z80_t *z) {  /* DD/FD was stray.. another DD/FD or unprefixed
                          instruction followed */
-  smc++;
-  ei_opm[0][opcode](); /* execute the instruction(without modifiers) */
+  z->smc++;
+  ei_opm[0][z->opcode](z); /* execute the instruction(without modifiers) */
 }
 
-void z80_resetstat(void) {
-#ifndef NO_Z80STAT
+void z80_resetstat(z80_t *z) {
   int i,j;
   
   for(i=0;i<7;i++)
     for(j=0;j<256;j++)
-      stat_tab[i][j]=0;
-#endif
+      z->stat[i][j]=0;
 }
 
-unsigned z80_getstat(int tab, uint8_t opc)
+unsigned z80_getstat(z80_t *z, int tab, uint8_t opc)
 {
-#ifndef NO_Z80STAT
-	return stat_tab[tab][opc];
+	return z->stat[tab][opc];
+}
+
+#ifdef NO_Z80CLOCK
+/** Clock ticks per instruction executed while halted */
+#define Z80_HALT_TICKS 12
 #else
-	return 0;
+#define Z80_HALT_TICKS 4
 #endif
-}
 
-static void z80_readinstr(void) {
+/** Fast-forward halted CPU until the deadline.
+ *
+ * A halted CPU executes NOPs until an interrupt arrives. Instead of
+ * executing them one by one, update the clock and R by the number
+ * of NOPs that would execute until the deadline.
+ *
+ * @param z CPU context
+ * @param deadline Clock value at which to stop
+ */
+static void z80_halt_skip(z80_t *z, unsigned long deadline)
+{
+	unsigned long n;
+
+	if (z->cpus.halted == 0 || z->cpus.int_pending != 0 ||
+	    z->cpus.nmi_pending != 0 || (long)(z->clock - deadline) >= 0 ||
+	    z80_code_break(z, z->cpus.PC))
+		return;
+
+	n = (deadline - z->clock + Z80_HALT_TICKS - 1) / Z80_HALT_TICKS;
+	z->instr_clock = z->clock + (n - 1) * Z80_HALT_TICKS;
+	z->clock += n * Z80_HALT_TICKS;
+	incr_R(z, n);
 
-  opcode=z80_iget8();
+	/* HALT and the NOPs do not affect flags */
+	z->cpus.pflags_aff = 0;
+	z->cpus.flags_aff = 0;
+	z->cpus.int_lock = 0;
+}
 
-  if(opcode==0xed) {
-    incr_R(1);
-    opcode=z80_iget8();
-    ei_tab=ei_edop;
-#ifndef NO_Z80STAT
-    stat_i=6;
+#ifdef Z80_THREADED
+/*
+ * Threaded-code instruction dispatch.
+ *
+ * Every entry of every decode table gets its own label, which calls
+ * the handler from the (constant) decode table directly. The compiler
+ * can thus resolve the handler at compile time and make a direct call
+ * (or inline the opcode body), instead of making an indirect call.
+ * A DD/FD prefix is consumed inline together with the instruction
+ * that follows it.
+ */
+
+#define Z80_TD16(m, t, h) \
+	m(t, h, 0) m(t, h, 1) m(t, h, 2) m(t, h, 3) \
+	m(t, h, 4) m(t, h, 5) m(t, h, 6) m(t, h, 7) \
+	m(t, h, 8) m(t, h, 9) m(t, h, a) m(t, h, b) \
+	m(t, h, c) m(t, h, d) m(t, h, e) m(t, h, f)
+
+#define Z80_TD256(m, t) \
+	Z80_TD16(m, t, 0) Z80_TD16(m, t, 1) Z80_TD16(m, t, 2) \
+	Z80_TD16(m, t, 3) Z80_TD16(m, t, 4) Z80_TD16(m, t, 5) \
+	Z80_TD16(m, t, 6) Z80_TD16(m, t, 7) Z80_TD16(m, t, 8) \
+	Z80_TD16(m, t, 9) Z80_TD16(m, t, a) Z80_TD16(m, t, b) \
+	Z80_TD16(m, t, c) Z80_TD16(m, t, d) Z80_TD16(m, t, e) \
+	Z80_TD16(m, t, f)
+
+/** Address of the label for decode table entry */
+#define Z80_TD_LABEL(t, h, l) &&t##_##h##l,
+/** Code for decode table entry */
+#define Z80_TD_CODE(t, h, l) t##_##h##l: ei_##t[0x##h##l](z); goto done;
 #endif
-//    prefix2=0xed;    
-    return;
-  }
 
-  if(opcode==0xcb) {
-    if(cpus.modifier!=0) {
-      cbop=z80_iget8();
-    } else {
-      incr_R(1);
-    }
-    opcode=z80_iget8();
-    ei_tab=ei_cbopm[cpus.modifier];
-#ifndef NO_Z80STAT
-    stat_i=cpus.modifier+3;
+#ifdef Z80_JIT
+#include "z80jit.c"
 #endif
-//    prefix2=0xcb;
-    return;
-  }
 
-  /* one-byte opcode */
-//  prefix2=0;
-  ei_tab=ei_opm[cpus.modifier];
-#ifndef NO_Z80STAT
-  stat_i=cpus.modifier;
+/* Lean core */
+#define Z80_EXEC_INSTRUMENTED 0
+#define Z80_EXEC(name) name##_lean
+#include "z80exec.c"
+#undef Z80_EXEC_INSTRUMENTED
+#undef Z80_EXEC
+
+/* Instrumented core */
+#define Z80_EXEC_INSTRUMENTED 1
+#define Z80_EXEC(name) name##_instr
+#include "z80exec.c"
+#undef Z80_EXEC_INSTRUMENTED
+#undef Z80_EXEC
+
+/** Initialize CPU context.
+ *
+ * The page tables are owned by the caller, who keeps them up to date.
+ * The same page tables and callbacks can be used by several contexts.
+ * The caller should also mark the pages that contain break addresses
+ * (see z80_set_break_page()).
+ *
+ * @param z CPU context
+ * @param ops Memory and I/O access callbacks
+ * @param arg Argument for the callbacks
+ * @param rdpg Page table for reading memory
+ * @param wrpg Page table for writing memory
+ */
+void z80_init(z80_t *z, const z80_ops_t *ops, void *arg, uint8_t **rdpg,
+    uint8_t **wrpg)
+{
+	memset(z, 0, sizeof(z80_t));
+	z->rcpus = &z->cpus;
+	z->ops = ops;
+	z->arg = arg;
+	z->rdpg = rdpg;
+	z->wrpg = wrpg;
+	/* Until told otherwise, any page can contain break addresses */
+	memset(z->brkpg, 1, sizeof(z->brkpg));
+	z->jit_enabled = 1;
+}
+
+/** Free resources of CPU context.
+ *
+ * @param z CPU context
+ */
+void z80_fini(z80_t *z)
+{
+#ifdef Z80_JIT
+	if (z->jit != NULL) {
+		z80_jit_destroy(z->jit);
+		z->jit = NULL;
+	}
+#else
+	(void)z;
 #endif
-  return;
 }
 
-void z80_execinstr(void) {
-  unsigned long lastuoc;
-
-  cpus.pflags_aff=cpus.flags_aff;
-  cpus.flags_aff=0;
+/** Enable or disable translation of hot code to native code.
+ *
+ * Only has an effect if the core was built with Z80JIT. Translation
+ * is enabled by default.
+ *
+ * @param z CPU context
+ * @param enable Non-zero to enable translation
+ */
+void z80_set_jit(z80_t *z, int enable)
+{
+	z->jit_enabled = enable;
+}
 
-  /* Process pending NMI or interrupt */
-  z80_check_nmi();
-  z80_check_int();
+/** Select lean or instrumented core.
+ *
+ * The instrumented core counts executed instructions (see z80_getstat())
+ * and calls the trace_instr callback before each instruction. The lean
+ * core does neither and is faster.
+ *
+ * @param z CPU context
+ * @param enable Non-zero to select the instrumented core
+ */
+void z80_set_instrumented(z80_t *z, int enable)
+{
+	z->instrumented = enable;
+}
 
-  cpus.int_lock=0;
+/** Mark page as containing addresses where execution must stop.
+ *
+ * The code_break callback is only called for addresses in marked
+ * pages, so that a run of instructions does not have to make a call
+ * for each instruction. Initially all pages are marked.
+ *
+ * The callback can be asked in advance (when translating code) and
+ * its answer for a given address and page contents must not change
+ * until this function is called again.
+ *
+ * @param z CPU context
+ * @param pg Page number (address >> Z80_PG_SHIFT)
+ * @param enable Nonzero if the page contains break addresses
+ */
+void z80_set_break_page(z80_t *z, unsigned pg, int enable)
+{
+	z->brkpg[pg] = enable != 0;
+#ifdef Z80_JIT
+	if (z->jit != NULL)
+		z80_jit_brk_update(z->jit);
+#endif
+}
 
-  if(cpus.halted != 0) { /* NOP */
-    z80_clock_inc(4);
-    incr_R(1);
-  } else {
-    //printf("read instr..\n");
-    z80_readinstr();
+/** Execute one instruction.
+ *
+ * @param z CPU context
+ */
+void z80_execinstr(z80_t *z)
+{
+	if (z->instrumented)
+		z80_execinstr_instr(z);
+	else
+		z80_execinstr_lean(z);
+}
 
-    //printf("exec instr..\n");
-#ifndef NO_Z80STAT
-    stat_tab[stat_i][opcode]++;
-#endif
-    
-    lastuoc=uoc;
-    ((void (*)(void))pgm_read_ptr(&ei_tab[opcode]))(); /* FAST branch .. execute the instruction */
-    
-    (void)lastuoc;
-    (void) prefix1;
-    (void) prefix2;
-/*    switch(cpus.modifier) {
-      case 0: prefix1=0;    break;
-      case 1: prefix1=0xdd; break;
-      case 2: prefix1=0xfd; break;
-    }  
-    if(uoc>lastuoc) fprintf(logfi,"undoc opcode %02x\n",(prefix1<<16)|(prefix2<<8)|opcode);
-*/
-    incr_R(1);
-    
-    /* turn off old modifier prefix (unless set just now) */
-    if(opcode!=0xdd && opcode!=0xfd) cpus.modifier=0;
-  }
-#ifdef NO_Z80CLOCK
-	z80_clock += 12;
-#endif
+/** Execute instructions until the deadline.
+ *
+ * Executes at least one instruction. Stops as soon as the Z80 clock
+ * reaches the deadline or before executing an instruction at an address
+ * for which the code_break callback is true.
+ *
+ * @param z CPU context
+ * @param deadline Clock value at which to stop
+ */
+void z80_run(z80_t *z, unsigned long deadline)
+{
+	if (z->instrumented)
+		z80_run_instr(z, deadline);
+	else
+		z80_run_lean(z, deadline);
 }
 
-static void z80_check_int(void) {
+static void z80_check_int(z80_t *z) {
   uint16_t addr;
   uint8_t data;
 //  printf("interrupt->DI\n");
 
-  if(cpus.int_pending == 0) return;
-  if(cpus.int_lock != 0) return; /* after EI or DI or inside an instruction */
+  if(z->cpus.int_pending == 0) return;
+  if(z->cpus.int_lock != 0) return; /* after EI or DI or inside an instruction */
 
   /* Clear interrupt pending flag */
-  cpus.int_pending=0;
+  z->cpus.int_pending=0;
 
   /* If interrupts are disabled, just drop the interrupt */
-  if(cpus.IFF1 == 0) return; /* IFF2 just tells the NMI service routine
+  if(z->cpus.IFF1 == 0) return; /* IFF2 just tells the NMI service routine
                                whether the interrupted program disabled
 			       maskable interrupts */
-  cpus.halted=0;
-  cpus.IFF1=cpus.IFF2=0;
+  z->cpus.halted=0;
+  z->cpus.IFF1=z->cpus.IFF2=0;
 
-  switch(cpus.int_mode) {
+  switch(z->cpus.int_mode) {
     case 0: /* this is not quite right yet ..*/
       /* the actual instruction should be read from the data bus */
       /* but if that instruction were longer than 1 byte? */
-      incr_R(2);
-      _push16(cpus.PC);
-      cpus.PC=0x0038;
-      z80_clock_inc(13);
+      incr_R_int(z, 2);
+      _push16(z, z->cpus.PC);
+      z->cpus.PC=0x0038;
+      z80_clock_inc(z, 13);
       break;
     case 1:
-      incr_R(2);
-      _push16(cpus.PC);
-      cpus.PC=0x0038;
-      z80_clock_inc(13);
+      incr_R_int(z, 2);
+      _push16(z, z->cpus.PC);
+      z->cpus.PC=0x0038;
+      z80_clock_inc(z, 13);
       break;
     case 2:
-      incr_R(2);
-      _push16(cpus.PC);
-      data = z80_snoop8();
-      addr=((uint16_t)cpus.I<<8) | (uint16_t)data;
-      cpus.PC=z80_memget16(addr);
+      incr_R_int(z, 2);
+      _push16(z, z->cpus.PC);
+      data = z80_snoop8(z);
+      addr=((uint16_t)z->cpus.I<<8) | (uint16_t)data;
+      z->cpus.PC=z80_memget16(z, addr);
 //      printf("IM 2 INT: I=%02x D8=%02x tabi=%04x dst=%04x\n",cpus.I,data,addr,cpus.PC);
-      z80_clock_inc(19);
+      z80_clock_inc(z, 19);
       break;
   }
 }
 
-static void z80_check_nmi(void) {
+static void z80_check_nmi(z80_t *z) {
 
-  if(cpus.nmi_pending == 0) return;
-  if(cpus.int_lock != 0) return;
+  if(z->cpus.nmi_pending == 0) return;
+  if(z->cpus.int_lock != 0) return;
 //  printf("NMI!\n");
   
-  cpus.nmi_pending=0;
-  cpus.halted=0;
-  cpus.IFF1=0;
+  z->cpus.nmi_pending=0;
+  z->cpus.halted=0;
+  z->cpus.IFF1=0;
 
-  _push16(cpus.PC);
-  cpus.PC=0x0066;
+  _push16(z, z->cpus.PC);
+  z->cpus.PC=0x0066;
   
-  incr_R(2);
-  z80_clock_inc(11);
+  incr_R_int(z, 2);
+  z80_clock_inc(z, 11);
 }
 
-void z80_int(void)
+void z80_int(z80_t *z)
 {
-  cpus.int_pending = 1;
+  z->cpus.int_pending = 1;
 }
 
-void z80_nmi(void)
+void z80_nmi(z80_t *z)
 {
-  cpus.nmi_pending = 1;
+  z->cpus.nmi_pending = 1;
 }
 
-void z80_reset(void) {
-  cpus.IFF1=cpus.IFF2=0;
-  cpus.int_mode=0;
-  cpus.int_pending=0;
-  cpus.nmi_pending=0;
-  cpus.PC=0;
+void z80_reset(z80_t *z) {
+  z->cpus.IFF1=z->cpus.IFF2=0;
+  z->cpus.int_mode=0;
+  z->cpus.int_pending=0;
+  z->cpus.nmi_pending=0;
+  z->cpus.PC=0;
 
-  cpus.SP=0;
-  cpus.I=0;
-  cpus.R=0;
-  cpus.W=0;
+  z->cpus.SP=0;
+  z->cpus.I=0;
+  z->cpus.R=0;
+  z->cpus.W=0;
   
-  cpus.halted=0;
-  cpus.int_lock=0;
-  cpus.modifier=0;
-  cpus.flags_aff=0;
-  cpus.pflags_aff=0;
+  z->cpus.halted=0;
+  z->cpus.int_lock=0;
+  z->cpus.modifier=0;
+  z->cpus.flags_aff=0;
+  z->cpus.pflags_aff=0;
   
-  cpus.r[rA]=0;  cpus.F=0;
-  cpus.r[rB]=0;  cpus.r[rC]=0;
-  cpus.r[rD]=0;  cpus.r[rE]=0;
-  cpus.r[rH]=0;  cpus.r[rL]=0;
-  cpus.IX=0;     cpus.IY=0;
-  cpus.r_[rA]=0; cpus.F_=0;
-  cpus.r_[rB]=0; cpus.r_[rC]=0;
-  cpus.r_[rD]=0; cpus.r_[rE]=0;
-  cpus.r_[rH]=0; cpus.r_[rL]=0;
+  z->cpus.r[rA]=0;  z->cpus.F=0;
+  z->cpus.lf_op=lf_none;
+  z->cpus.r[rB]=0;  z->cpus.r[rC]=0;
+  z->cpus.r[rD]=0;  z->cpus.r[rE]=0;
+  z->cpus.r[rH]=0;  z->cpus.r[rL]=0;
+  z->cpus.IX=0;     z->cpus.IY=0;
+  z->cpus.r_[rA]=0; z->cpus.F_=0;
+  z->cpus.r_[rB]=0; z->cpus.r_[rC]=0;
+  z->cpus.r_[rD]=0; z->cpus.r_[rE]=0;
+  z->cpus.r_[rH]=0; z->cpus.r_[rL]=0;
 }
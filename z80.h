@@ -101,30 +101,133 @@ typedef struct _z80s {
 	int pflags_aff;
 	/** Halted by the HALT instruction? */
 	int halted;
+
+	/** Operation whose flags have not been computed into F yet */
+	int lf_op;
+	/** First operand of the lazy flags operation */
+	uint8_t lf_a;
+	/** Second operand of the lazy flags operation */
+	uint8_t lf_b;
+	/** Carry input of the lazy flags operation */
+	uint8_t lf_c;
+	/** Result of the lazy flags operation (including carry out) */
+	uint16_t lf_res;
 } z80s;
 
-extern z80s cpus;
-extern z80s *rcpus;
-extern unsigned long z80_clock;
-extern unsigned long uoc;
-extern unsigned long smc;
+struct z80;
+
+/** Memory page size shift */
+#define Z80_PG_SHIFT 13
+/** Memory page size */
+#define Z80_PG_SIZE (1 << Z80_PG_SHIFT)
+/** Number of memory pages in the address space */
+#define Z80_NPG (0x10000 >> Z80_PG_SHIFT)
+
+/** Memory and I/O access callbacks
+ *
+ * All callbacks get the argument passed to z80_init().
+ */
+typedef struct {
+	/** Write byte to a page whose write page table entry is NULL */
+	void (*memset8)(void *, uint16_t, uint8_t);
+	/** Get pointer for direct access to memory or NULL (see memio.c) */
+	uint8_t *(*mem_direct)(void *, uint16_t, uint16_t, int);
+	/** Read byte from I/O port */
+	uint8_t (*in8)(void *, uint16_t);
+	/** Write byte to I/O port */
+	void (*out8)(void *, uint16_t, uint8_t);
+	/** Read byte from data bus during interrupt acknowledge */
+	uint8_t (*snoop8)(void *);
+	/** Determine if execution must stop before address (only called
+	 * for pages marked with z80_set_break_page()) */
+	int (*code_break)(void *, uint16_t);
+	/** Called by the instrumented core before each instruction */
+	void (*trace_instr)(void *);
+} z80_ops_t;
+
+struct z80_jit;
+
+/** Z80 CPU context
+ *
+ * Everything the core needs to execute instructions. Independent
+ * contexts can be used at the same time, e.g. from different threads.
+ */
+typedef struct z80 {
+	/** CPU state */
+	z80s cpus;
+	/** CPU state used to read memory addresses from. Used by Spec256. */
+	const z80s *rcpus;
+	/** Clock (in T states) */
+	unsigned long clock;
+	/** Value of clock at the start of the current instruction */
+	unsigned long instr_clock;
+	/** Opcode fetches (R register increments, except by interrupts) */
+	unsigned long fetches;
+
+	/** Page table for reading memory (Z80_NPG entries) */
+	uint8_t **rdpg;
+	/** Page table for writing memory, NULL entries use ops->memset8 */
+	uint8_t **wrpg;
+	/** Nonzero for pages (Z80_NPG entries) where code_break is called */
+	uint8_t brkpg[Z80_NPG];
+	/** Memory and I/O access callbacks */
+	const z80_ops_t *ops;
+	/** Argument for the callbacks */
+	void *arg;
+
+	/** Opcode of the current instruction */
+	uint8_t opcode;
+	/** Displacement of the current DD CB / FD CB instruction */
+	uint8_t cbop;
+	/** Decode table of the current instruction */
+	void (*const *ei_tab)(struct z80 *);
+
+	/** Unsupported opcode counter */
+	unsigned long uoc;
+	/** Stray modifier counter */
+	unsigned long smc;
+	/** Instruction statistics */
+	unsigned stat[7][256];
+	/** Statistics table of the current instruction */
+	int stat_i;
+	/** Non-zero if the instrumented core is selected */
+	int instrumented;
+
+	/** Nonzero while executing instructions in z80_run() */
+	int running;
+	/** Deadline of the current z80_run() */
+	unsigned long run_deadline;
+
+	/** Translator state (only with Z80JIT) or NULL */
+	struct z80_jit *jit;
+	/** Non-zero if hot code is translated to native code */
+	int jit_enabled;
+} z80_t;
 
 void z80_init_tables(void);
-void z80_execinstr(void);
-void z80_reset(void);
-void z80_nmi(void);
-void z80_int(void);
-
-void z80_resetstat(void);
-unsigned z80_getstat(int, uint8_t);
-
-uint16_t z80_getAF(void);
-uint16_t z80_getBC(void);
-uint16_t z80_getDE(void);
-uint16_t z80_getHL(void);
-uint16_t z80_getAF_(void);
-uint16_t z80_getBC_(void);
-uint16_t z80_getDE_(void);
-uint16_t z80_getHL_(void);
+void z80_init(z80_t *, const z80_ops_t *, void *, uint8_t **, uint8_t **);
+void z80_fini(z80_t *);
+void z80_set_instrumented(z80_t *, int);
+void z80_set_jit(z80_t *, int);
+void z80_set_break_page(z80_t *, unsigned, int);
+void z80_execinstr(z80_t *);
+void z80_run(z80_t *, unsigned long);
+void z80_reset(z80_t *);
+void z80_nmi(z80_t *);
+void z80_int(z80_t *);
+
+void z80_resetstat(z80_t *);
+unsigned z80_getstat(z80_t *, int, uint8_t);
+
+void z80_sync_flags(z80s *);
+
+uint16_t z80_getAF(z80_t *);
+uint16_t z80_getBC(z80_t *);
+uint16_t z80_getDE(z80_t *);
+uint16_t z80_getHL(z80_t *);
+uint16_t z80_getAF_(z80_t *);
+uint16_t z80_getBC_(z80_t *);
+uint16_t z80_getDE_(z80_t *);
+uint16_t z80_getHL_(z80_t *);
 
 #endif
@@ -31,34 +31,80 @@
 
 #include <stdint.h>
 #include "memio.h"
+#include "romtrap.h"
+#include "xmap.h"
+#include "xtrace.h"
 #include "z80dep.h"
+#include "zx.h"
 
-uint8_t z80_memget8(uint16_t addr)
+static void z80_dep_memset8(void *arg, uint16_t addr, uint8_t val)
 {
-	return zx_memget8(addr);
+	zx_memset8_slow((zx_machine_t *)arg, addr, val);
 }
 
-uint8_t z80_imemget8(uint16_t addr)
+static uint8_t *z80_dep_mem_direct(void *arg, uint16_t addr, uint16_t len,
+    int write)
 {
-	return zx_imemget8(addr);
+	return zx_mem_direct((zx_machine_t *)arg, addr, len, write);
 }
 
-void z80_memset8(uint16_t addr, uint8_t val)
+static uint8_t z80_dep_in8(void *arg, uint16_t a)
 {
-	zx_memset8(addr, val);
+	return zx_in8((zx_machine_t *)arg, a);
 }
 
-uint8_t z80_in8(uint16_t a)
+static void z80_dep_out8(void *arg, uint16_t addr, uint8_t val)
 {
-	return zx_in8(a);
+	zx_out8((zx_machine_t *)arg, addr, val);
 }
 
-void z80_out8(uint16_t addr, uint8_t val)
+static uint8_t z80_dep_snoop8(void *arg)
 {
-	zx_out8(addr, val);
+	return 0xff;
 }
 
-uint8_t z80_snoop8(void)
+/** Determine if the emulator needs control before an address.
+ *
+ * The emulator needs to get control before executing the instruction
+ * at this address (e.g. to trap a ROM routine or to end a headless run
+ * at the stop address). Runs of instructions end before such
+ * an address.
+ *
+ * @param arg Machine (zx_machine_t *)
+ * @param addr Address
+ * @return Nonzero if execution must stop before @a addr
+ */
+static int z80_dep_code_break(void *arg, uint16_t addr)
 {
-	return 0xff;
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	return romtrap_at(zx, addr) ||
+	    (zx->stop_pc_enabled && addr == zx->stop_pc);
+}
+
+/** Process an instruction that is about to be executed.
+ *
+ * Called by the instrumented core before each instruction.
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void z80_dep_trace_instr(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	if (zx->xmap_enabled)
+		xmap_mark(zx);
+	if (zx->xtrace_enabled)
+		xtrace_instr(zx);
 }
+
+/** Memory and I/O of the Spectrum (and of the Spec256 GPUs) */
+const z80_ops_t z80_dep_ops = {
+	.memset8 = z80_dep_memset8,
+	.mem_direct = z80_dep_mem_direct,
+	.in8 = z80_dep_in8,
+	.out8 = z80_dep_out8,
+	.snoop8 = z80_dep_snoop8,
+	.code_break = z80_dep_code_break,
+	.trace_instr = z80_dep_trace_instr
+};
@@ -37,17 +37,11 @@
 #define Z80DEP_H
 
 #include <stdint.h>
+#include "z80.h"
 
 #define PROGMEM
 #define pgm_read_ptr(x) (*(x))
 
-uint8_t z80_memget8(uint16_t addr);
-uint8_t z80_imemget8(uint16_t addr);
-void z80_memset8(uint16_t addr, uint8_t val);
-
-void z80_out8(uint16_t addr, uint8_t val);
-uint8_t z80_in8(uint16_t addr);
-
-uint8_t z80_snoop8(void);
+extern const z80_ops_t z80_dep_ops;
 
 #endif
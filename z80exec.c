@@ -0,0 +1,277 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Z80 instruction dispatch
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Instruction dispatch and run loops
+ *
+ * This file is included from z80.c twice, to build two variants
+ * of the core from the same source. Z80_EXEC(name) gives each
+ * function a variant-specific name.
+ *
+ * The lean variant (Z80_EXEC_INSTRUMENTED is 0) does nothing beyond
+ * executing instructions. The instrumented variant (Z80_EXEC_INSTRUMENTED
+ * is 1) also counts executed instructions and calls z80_trace_instr()
+ * before each instruction. It executes every instruction individually,
+ * i.e. repeated block instructions repeat one iteration at a time
+ * and a halted CPU is not fast-forwarded.
+ */
+
+#ifndef Z80_THREADED
+
+static void Z80_EXEC(z80_readinstr)(z80_t *z) {
+
+  z->opcode=z80_iget8(z);
+
+  if(z->opcode==0xed) {
+    incr_R(z, 1);
+    z->opcode=z80_iget8(z);
+    z->ei_tab=ei_edop;
+#if Z80_EXEC_INSTRUMENTED
+    z->stat_i=6;
+#endif
+//    prefix2=0xed;    
+    return;
+  }
+
+  if(z->opcode==0xcb) {
+    if(z->cpus.modifier!=0) {
+      z->cbop=z80_iget8(z);
+    } else {
+      incr_R(z, 1);
+    }
+    z->opcode=z80_iget8(z);
+    z->ei_tab=ei_cbopm[z->cpus.modifier];
+#if Z80_EXEC_INSTRUMENTED
+    z->stat_i=z->cpus.modifier+3;
+#endif
+//    prefix2=0xcb;
+    return;
+  }
+
+  /* one-byte opcode */
+//  prefix2=0;
+  z->ei_tab=ei_opm[z->cpus.modifier];
+#if Z80_EXEC_INSTRUMENTED
+  z->stat_i=z->cpus.modifier;
+#endif
+  return;
+}
+
+static void Z80_EXEC(z80_execinstr)(z80_t *z) {
+  unsigned long lastuoc;
+
+#if Z80_EXEC_INSTRUMENTED
+  z80_trace_instr(z);
+#endif
+  z->instr_clock=z->clock;
+  z->cpus.pflags_aff=z->cpus.flags_aff;
+  z->cpus.flags_aff=0;
+
+  /* Process pending NMI or interrupt */
+  z80_check_nmi(z);
+  z80_check_int(z);
+
+  z->cpus.int_lock=0;
+
+  if(z->cpus.halted != 0) { /* NOP */
+    z80_clock_inc(z, 4);
+    incr_R(z, 1);
+  } else {
+    //printf("read instr..\n");
+    Z80_EXEC(z80_readinstr)(z);
+
+    //printf("exec instr..\n");
+#if Z80_EXEC_INSTRUMENTED
+    z->stat[z->stat_i][z->opcode]++;
+#endif
+    
+    lastuoc=z->uoc;
+    ((void (*)(z80_t *))pgm_read_ptr(&z->ei_tab[z->opcode]))(z); /* FAST branch .. execute the instruction */
+    
+    (void)lastuoc;
+    (void) prefix1;
+    (void) prefix2;
+/*    switch(cpus.modifier) {
+      case 0: prefix1=0;    break;
+      case 1: prefix1=0xdd; break;
+      case 2: prefix1=0xfd; break;
+    }  
+    if(uoc>lastuoc) fprintf(logfi,"undoc opcode %02x\n",(prefix1<<16)|(prefix2<<8)|opcode);
+*/
+    incr_R(z, 1);
+    
+    /* turn off old modifier prefix (unless set just now) */
+    if(z->opcode!=0xdd && z->opcode!=0xfd) z->cpus.modifier=0;
+  }
+#ifdef NO_Z80CLOCK
+	z->clock += 12;
+#endif
+}
+
+#else
+
+static void Z80_EXEC(z80_execinstr)(z80_t *z)
+{
+	static void *const td_op[256] = { Z80_TD256(Z80_TD_LABEL, op) };
+	static void *const td_ddop[256] = { Z80_TD256(Z80_TD_LABEL, ddop) };
+	static void *const td_fdop[256] = { Z80_TD256(Z80_TD_LABEL, fdop) };
+	static void *const td_cbop[256] = { Z80_TD256(Z80_TD_LABEL, cbop) };
+	static void *const td_ddcbop[256] =
+	    { Z80_TD256(Z80_TD_LABEL, ddcbop) };
+	static void *const td_fdcbop[256] =
+	    { Z80_TD256(Z80_TD_LABEL, fdcbop) };
+	static void *const td_edop[256] = { Z80_TD256(Z80_TD_LABEL, edop) };
+	static void *const *const td_opm[3] = { td_op, td_ddop, td_fdop };
+	static void *const *const td_cbopm[3] =
+	    { td_cbop, td_ddcbop, td_fdcbop };
+	void *const *td_tab;
+
+#if Z80_EXEC_INSTRUMENTED
+	z80_trace_instr(z);
+#endif
+	z->instr_clock = z->clock;
+	z->cpus.pflags_aff = z->cpus.flags_aff;
+	z->cpus.flags_aff = 0;
+
+	/* Process pending NMI or interrupt */
+	z80_check_nmi(z);
+	z80_check_int(z);
+
+	z->cpus.int_lock = 0;
+
+	if (z->cpus.halted != 0) { /* NOP */
+		z80_clock_inc(z, 4);
+		incr_R(z, 1);
+		goto out;
+	}
+
+	z->opcode = z80_iget8(z);
+
+	if (z->cpus.modifier == 0 && (z->opcode == 0xdd || z->opcode == 0xfd)) {
+		/*
+		 * Execute the prefix as a separate instruction (4T, 1R),
+		 * but continue straight with the instruction it modifies.
+		 * Interrupts cannot be accepted in between anyway.
+		 */
+#if Z80_EXEC_INSTRUMENTED
+		z->stat[0][z->opcode]++;
+#endif
+		z80_clock_inc(z, 4);
+		incr_R(z, 1);
+		z->cpus.modifier = (z->opcode == 0xdd) ? 1 : 2;
+		z->cpus.pflags_aff = z->cpus.flags_aff;
+
+		z->opcode = z80_iget8(z);
+	}
+
+	if (z->opcode == 0xed) {
+		incr_R(z, 1);
+		z->opcode = z80_iget8(z);
+		td_tab = td_edop;
+#if Z80_EXEC_INSTRUMENTED
+		z->stat_i = 6;
+#endif
+	} else if (z->opcode == 0xcb) {
+		if (z->cpus.modifier != 0)
+			z->cbop = z80_iget8(z);
+		else
+			incr_R(z, 1);
+		z->opcode = z80_iget8(z);
+		td_tab = td_cbopm[z->cpus.modifier];
+#if Z80_EXEC_INSTRUMENTED
+		z->stat_i = z->cpus.modifier + 3;
+#endif
+	} else {
+		td_tab = td_opm[z->cpus.modifier];
+#if Z80_EXEC_INSTRUMENTED
+		z->stat_i = z->cpus.modifier;
+#endif
+	}
+
+#if Z80_EXEC_INSTRUMENTED
+	z->stat[z->stat_i][z->opcode]++;
+#endif
+	goto *td_tab[z->opcode];
+
+	Z80_TD256(Z80_TD_CODE, op)
+	Z80_TD256(Z80_TD_CODE, ddop)
+	Z80_TD256(Z80_TD_CODE, fdop)
+	Z80_TD256(Z80_TD_CODE, cbop)
+	Z80_TD256(Z80_TD_CODE, ddcbop)
+	Z80_TD256(Z80_TD_CODE, fdcbop)
+	Z80_TD256(Z80_TD_CODE, edop)
+
+done:
+	incr_R(z, 1);
+
+	/* turn off old modifier prefix (unless set just now) */
+	if (z->opcode != 0xdd && z->opcode != 0xfd)
+		z->cpus.modifier = 0;
+out:
+#ifdef NO_Z80CLOCK
+	z->clock += 12;
+#endif
+	return;
+}
+
+#endif
+
+/** Execute instructions until the deadline.
+ *
+ * Executes at least one instruction. Stops as soon as the Z80 clock
+ * reaches the deadline or before executing an instruction at an address
+ * for which z80_code_break() is true. In the lean variant a halted CPU
+ * is fast-forwarded to the deadline.
+ *
+ * @param deadline Clock value at which to stop
+ */
+static void Z80_EXEC(z80_run)(z80_t *z, unsigned long deadline)
+{
+#if !Z80_EXEC_INSTRUMENTED
+	z->running = 1;
+	z->run_deadline = deadline;
+#endif
+	do {
+#if !Z80_EXEC_INSTRUMENTED && defined(Z80_JIT)
+		if (z80_jit_exec(z, deadline))
+			continue;
+#endif
+		Z80_EXEC(z80_execinstr)(z);
+#if !Z80_EXEC_INSTRUMENTED
+		z80_halt_skip(z, deadline);
+#endif
+	} while ((long)(z->clock - deadline) < 0 &&
+	    !z80_code_break(z, z->cpus.PC));
+#if !Z80_EXEC_INSTRUMENTED
+	z->running = 0;
+#endif
+}
+
@@ -32,236 +32,195 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "memio.h"
+#include "sys_all.h"
+#include "z80dep.h"
 #include "z80g.h"
+#include "zx.h"
 #include "zx_scr.h"
 
-/** Allow probing for GFX and turning on GPU when needed */
-bool gpu_allow = true;
+/** GPU writes to ROM go here (shared, never read) */
+static uint8_t gfx_discard[Z80_PG_SIZE];
 
-z80s gpus[NGP];	/* GPUs */
-z80s tmps;	/* temporary place to store the CPU */
-
-uint8_t *gfxrom[NGP];
-uint8_t *gfxram[NGP];
-uint8_t *gfxscr[NGP];
-static uint8_t *gfxbnk[NGP][4];
-static bool gpu_on;
+void gpu_set_allow(zx_machine_t *zx, bool allow)
+{
+	zx->gpu.allow = allow;
+	if (!allow && gpu_is_on(zx))
+		gpu_disable(zx);
+}
 
-void gpu_set_allow(bool allow)
+void gpu_init(zx_machine_t *zx)
 {
-	gpu_allow = allow;
-	if (!allow && gpu_on)
-		gpu_disable();
+	zx->gpu.planes = NULL;
+	zx->gpu.planes_size = 0;
 }
 
-void gpu_init(void)
+/** Turn on GPUs.
+ *
+ * The GPUs and their memory planes are only allocated while they are
+ * on, most machines never need them.
+ *
+ * @param zx Machine
+ * @return Zero on success, -1 on error
+ */
+int gpu_enable(zx_machine_t *zx)
 {
+	zx_gpu_planes_t *gp;
+	size_t size;
 	int i;
 
-	for (i = 0; i < NGP; i++) {
-		gfxrom[i] = NULL;
-		gfxram[i] = NULL;
-	}
+	if (zx->mem.model != ZXM_48K)
+		return -1;
 
-	gpu_on = false;
-}
+	if (zx->gpu.planes == NULL) {
+		size = sizeof(zx_gpu_planes_t);
+		gp = sys_mem_alloc(&size);
+		if (gp == NULL)
+			return -1;
+
+		for (i = 0; i < NGP; i++) {
+			/* GPUs read memory addresses from the CPU registers */
+			z80_init(&gp->gpus[i], &z80_dep_ops, zx, gp->rdpg[i],
+			    gp->wrpg[i]);
+			gp->gpus[i].rcpus = &zx->cpu.cpus;
+		}
+
+		zx->gpu.planes = gp;
+		zx->gpu.planes_size = size;
+		zx->video.spec256.gfxscr = gp->scr;
+	}
 
-int gpu_enable(void)
-{
-	if (mem_model != ZXM_48K)
-		return -1;
-	gfx_select_memmodel(ZXM_48K);
-	if (zx_scr_init_spec256_pal() < 0)
+	gfx_select_memmodel(zx, ZXM_48K);
+	if (zx_scr_init_spec256_pal(zx) < 0) {
+		gpu_disable(zx);
 		return -1;
-	gfxrom_load("roms/rom0.gfx", 0);
-	gpu_on = true;
+	}
+
+	gfxrom_load(zx, "roms/rom0.gfx", 0);
 	return 0;
 }
 
-void gpu_disable(void)
+/** Turn off GPUs and free their memory planes.
+ *
+ * @param zx Machine
+ */
+void gpu_disable(zx_machine_t *zx)
 {
-	int i;
-
-	for (i = 0; i < NGP; i++) {
-		free(gfxrom[i]);
-		gfxrom[i] = NULL;
-		free(gfxram[i]);
-		gfxram[i] = NULL;
-	}
-
-	gpu_on = false;
-	zx_scr_mode(0);
+	sys_mem_free(zx->gpu.planes, zx->gpu.planes_size);
+	zx->gpu.planes = NULL;
+	zx->gpu.planes_size = 0;
+	zx->video.spec256.gfxscr = NULL;
+	zx_scr_mode(zx, 0);
 }
 
-bool gpu_is_on(void)
+bool gpu_is_on(zx_machine_t *zx)
 {
-	return gpu_on;
+	return zx->gpu.planes != NULL;
 }
 
-void gfx_select_memmodel(int model)
+/** Set up GPU memory planes.
+ *
+ * Each plane starts with a copy of the machine ROM and power-on RAM
+ * contents. The page tables of each GPU map its plane the same way
+ * the 48K memory is mapped for the CPU. Writes to ROM are discarded.
+ *
+ * @param model Memory model (only ZXM_48K is supported)
+ */
+void gfx_select_memmodel(zx_machine_t *zx, int model)
 {
-	int i;
-	uint8_t *tmpram, *tmprom, *tmpscr;
-	uint8_t *tmpbnk[4];
-
-	tmprom = zxrom;
-	tmpram = zxram;
-	tmpscr = zxscr;
-
-	tmpbnk[0] = zxbnk[0];
-	tmpbnk[1] = zxbnk[1];
-	tmpbnk[2] = zxbnk[2];
-	tmpbnk[3] = zxbnk[3];
+	zx_gpu_planes_t *gp = zx->gpu.planes;
+	uint8_t *p;
+	int i, j;
 
 	for (i = 0; i < NGP; i++) {
-		zxrom = gfxrom[i];
-		zxram = gfxram[i];
-		zxscr = gfxscr[i];
-
-		zx_select_memmodel(model);
-
-		gfxrom[i] = zxrom;
-		gfxram[i] = zxram;
-		gfxscr[i] = zxscr;
-
-		gfxbnk[i][0] = zxbnk[0];
-		gfxbnk[i][1] = zxbnk[1];
-		gfxbnk[i][2] = zxbnk[2];
-		gfxbnk[i][3] = zxbnk[3];
+		memcpy(gp->rom[i], zx->mem.rom, GPU_ROM_SIZE);
+		zx_mem_ram_init(gp->ram[i], GPU_RAM_SIZE);
+
+		gp->scr[i] = gp->ram[i];
+
+		for (j = 0; j < Z80_NPG; j++) {
+			if (j < 0x4000 >> Z80_PG_SHIFT) {
+				p = gp->rom[i] + (j << Z80_PG_SHIFT);
+				gp->wrpg[i][j] = gfx_discard;
+			} else {
+				p = gp->ram[i] +
+				    ((j << Z80_PG_SHIFT) - 0x4000);
+				gp->wrpg[i][j] = p;
+			}
+
+			gp->rdpg[i][j] = p;
+		}
 	}
-
-	zxrom = tmprom;
-	zxram = tmpram;
-	zxscr = tmpscr;
-
-	zxbnk[0] = tmpbnk[0];
-	zxbnk[1] = tmpbnk[1];
-	zxbnk[2] = tmpbnk[2];
-	zxbnk[3] = tmpbnk[3];
 }
 
 #define GRANU 1
 
 /* execute instruction using both CPU and GPU */
-void z80_g_execinstr(void)
+void z80_g_execinstr(zx_machine_t *zx)
 {
+	z80s *cpus = &zx->cpu.cpus;
+	z80s *gpus;
 	int i, j;
-	unsigned long tmp_clock;
-	uint8_t *tmpbnk[4];
-
-	tmp_clock = z80_clock;
 
 	/*
 	 * Synchronize GPUs with CPU
 	 *
 	 * Synchronize everything but Gfx registers
 	 */
+	z80_sync_flags(cpus);
 	for (i = 0; i < NGP; i++) {
-		gpus[i].PC = cpus.PC;
-		gpus[i].SP = cpus.SP;
-		gpus[i].I = cpus.I;
-		gpus[i].R = cpus.R;
-		gpus[i].IFF1 = cpus.IFF1;
-		gpus[i].IFF2 = cpus.IFF2;
-		gpus[i].modifier = cpus.modifier;
-		gpus[i].int_lock = cpus.int_lock;
-		gpus[i].halted = cpus.halted;
-		gpus[i].int_mode = cpus.int_mode;
+		gpus = &zx->gpu.planes->gpus[i].cpus;
+		z80_sync_flags(gpus);
+		gpus->PC = cpus->PC;
+		gpus->SP = cpus->SP;
+		gpus->I = cpus->I;
+		gpus->R = cpus->R;
+		gpus->IFF1 = cpus->IFF1;
+		gpus->IFF2 = cpus->IFF2;
+		gpus->modifier = cpus->modifier;
+		gpus->int_lock = cpus->int_lock;
+		gpus->halted = cpus->halted;
+		gpus->int_mode = cpus->int_mode;
 		/* Sync all flags but Carry */
-		gpus[i].F = (gpus[i].F & fC) | (cpus.F & ~fC);
+		gpus->F = (gpus->F & fC) | (cpus->F & ~fC);
 	}
 
-	/* execute instrucion on all GPUs */
-	tmps = cpus; /* save CPU for a while */
-	rcpus = &tmps;
-
-	tmpbnk[0] = zxbnk[0];
-	tmpbnk[1] = zxbnk[1];
-	tmpbnk[2] = zxbnk[2];
-	tmpbnk[3] = zxbnk[3];
-
+	/* execute instrucion on all GPUs (each in its own memory plane) */
 	for (i = 0; i < NGP; i++) {
-		zxbnk[0] = gfxbnk[i][0];
-		zxbnk[1] = gfxbnk[i][1];
-		zxbnk[2] = gfxbnk[i][2];
-		zxbnk[3] = gfxbnk[i][3];
-
-		cpus = gpus[i];
-
 		for (j = 0; j < GRANU; j++)
-			z80_execinstr();
-
-		gpus[i] = cpus;
+			z80_execinstr(&zx->gpu.planes->gpus[i]);
 	}
-	cpus = tmps; /* restore CPU */
-	rcpus = &cpus;
-
-	zxbnk[0] = tmpbnk[0];
-	zxbnk[1] = tmpbnk[1];
-	zxbnk[2] = tmpbnk[2];
-	zxbnk[3] = tmpbnk[3];
-
-	z80_clock = tmp_clock;
 
 	/* execute on CPU */
 	for (j = 0; j < GRANU; j++)
-		z80_execinstr();
+		z80_execinstr(&zx->cpu);
 }
 
 /* execute instruction using both CPU and GPU */
-void z80_g_int(void)
+void z80_g_int(zx_machine_t *zx)
 {
 	int i;
-	unsigned long tmp_clock;
-	uint8_t *tmpbnk[4];
-
-	tmp_clock = z80_clock;
 
 	/* execute int on all GPUs */
-	tmps = cpus; /* save CPU for a while */
-
-	tmpbnk[0] = zxbnk[0];
-	tmpbnk[1] = zxbnk[1];
-	tmpbnk[2] = zxbnk[2];
-	tmpbnk[3] = zxbnk[3];
-
-	for (i = 0; i < NGP; i++) {
-		zxbnk[0] = gfxbnk[i][0];
-		zxbnk[1] = gfxbnk[i][1];
-		zxbnk[2] = gfxbnk[i][2];
-		zxbnk[3] = gfxbnk[i][3];
-
-		cpus = gpus[i];
-
-		z80_int();
-
-		gpus[i] = cpus;
-	}
-	cpus = tmps; /* restore CPU */
-
-	zxbnk[0] = tmpbnk[0];
-	zxbnk[1] = tmpbnk[1];
-	zxbnk[2] = tmpbnk[2];
-	zxbnk[3] = tmpbnk[3];
-
-	z80_clock = tmp_clock;
+	for (i = 0; i < NGP; i++)
+		z80_int(&zx->gpu.planes->gpus[i]);
 
 	/* execute on CPU */
-	z80_int();
+	z80_int(&zx->cpu);
 }
 
-int gpu_reset(void)
+int gpu_reset(zx_machine_t *zx)
 {
 	int i;
 
 	/* set power on defaults */
-	z80_reset();
+	z80_reset(&zx->cpu);
 
 	/* store to all gpus */
 	for (i = 0; i < NGP; i++)
-		gpus[i] = cpus;
+		zx->gpu.planes->gpus[i].cpus = zx->cpu.cpus;
 
 	return 0;
 }
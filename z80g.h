@@ -34,26 +34,17 @@
 
 #include <stdbool.h>
 #include <stdint.h>
-#include "z80.h"
+#include "types/z80g.h"
+#include "types/zx.h"
 
-/* Number of graphical planes */
-#define NGP 8
-
-extern bool gpu_allow;
-extern z80s gpus[NGP];
-
-extern uint8_t *gfxrom[NGP];
-extern uint8_t *gfxram[NGP];
-extern uint8_t *gfxscr[NGP];
-
-void gpu_set_allow(bool);
-void gpu_init(void);
-int gpu_enable(void);
-void gpu_disable(void);
-int gpu_reset(void);
-bool gpu_is_on(void);
-void z80_g_execinstr(void); /* execute both on CPU and GPU */
-void z80_g_int(void);       /* INT both on CPU and GPU */
-void gfx_select_memmodel(int model);
+void gpu_set_allow(zx_machine_t *, bool);
+void gpu_init(zx_machine_t *);
+int gpu_enable(zx_machine_t *);
+void gpu_disable(zx_machine_t *);
+int gpu_reset(zx_machine_t *);
+bool gpu_is_on(zx_machine_t *);
+void z80_g_execinstr(zx_machine_t *); /* execute both on CPU and GPU */
+void z80_g_int(zx_machine_t *);       /* INT both on CPU and GPU */
+void gfx_select_memmodel(zx_machine_t *, int model);
 
 #endif
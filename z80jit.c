@@ -0,0 +1,2286 @@
+/*
+ * GZX - George's ZX Spectrum Emulator
+ * Z80 to x86-64 code translator
+ *
+ * Copyright (c) 1999-2026 Jiri Svoboda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Translation of hot code to x86-64 machine code
+ *
+ * This file is included from z80.c.
+ *
+ * When z80_run() of the lean core arrives at the same address often
+ * enough, the code starting there is translated to a native function.
+ * A block is a run of instructions within one memory page. It ends
+ * before an instruction that cannot be translated (I/O, interrupt
+ * control, HALT, repeated block instructions...), after an unconditional
+ * jump, call or return, or when it becomes too long. A taken jump to an
+ * instruction of the block, forward or back, stays in native code.
+ * Other taken jumps leave the block.
+ *
+ * Common instructions are translated inline, with F computed eagerly
+ * from the host flags. The others call their handler. Like the
+ * interpreter, the native code checks the deadline after each
+ * instruction (and after a DD/FD prefix). R, the fetch counter, PC,
+ * instr_clock and the flags affected state are updated when leaving
+ * the block, from a table of exits built at translation time. Timing
+ * is thus the same as with the interpreter.
+ *
+ * The function starts by comparing the code of the block with the code
+ * that was translated. If it has changed, the block is translated again.
+ * A write to the code of the running block makes it exit after the
+ * writing instruction. After a call to the memset8 callback, the block
+ * also exits if an interrupt became pending or its page was marked
+ * for breaks.
+ *
+ * The code buffer is only writable while a block is being translated.
+ * When it is full, all translations are discarded.
+ *
+ * Register usage in native code:
+ *
+ *	rbx	CPU context
+ *	rbp	ox_tab
+ *	r12	clock - deadline
+ *	r13	deadline
+ *	r14	host address of the code of the block
+ *	r15	opcode fetches not counted by the exit (jumps within the block)
+ *	[rsp]	nonzero if the block must exit after the current instruction
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+/** Size of the native code buffer */
+#define Z80_JIT_BUF_SIZE (4 * 1024 * 1024)
+/** Number of entries in the block table (power of two) */
+#define Z80_JIT_NENT 4096
+/** Translate code once its address has been reached this many times */
+#define Z80_JIT_HOT 8
+/** Hit count after failure to translate (delays the next attempt) */
+#define Z80_JIT_COLD (-1024)
+/** Maximum number of instructions in a block */
+#define Z80_JIT_MAX_INSTR 48
+/** Maximum number of bytes of Z80 code in a block */
+#define Z80_JIT_MAX_BYTES 128
+/** Maximum number of exits of a block */
+#define Z80_JIT_MAX_EXITS (3 * Z80_JIT_MAX_INSTR + 1)
+/** Maximum number of jump fix-ups in a block */
+#define Z80_JIT_MAX_FIX 1024
+/** Upper bound on the size of the native code for one instruction */
+#define Z80_JIT_INSTR_SIZE 768
+/** Maximum size of a translated block (including the exits table) */
+#define Z80_JIT_BLOCK_SIZE (64 * 1024)
+/** Exit number returned by a block whose code has changed */
+#define Z80_JIT_STALE 0xff
+
+/** Offset of a field of the CPU context */
+#define Z80_JIT_CTX(f) offsetof(z80_t, f)
+/** Offset of a field of the CPU state */
+#define Z80_JIT_CPUS(f) (offsetof(z80_t, cpus) + offsetof(z80s, f))
+/** Offset of a 8-bit register (r field of an opcode) */
+#define Z80_JIT_R(i) (Z80_JIT_CPUS(r) + (i))
+/** Offset of an alternate 8-bit register */
+#define Z80_JIT_R_(i) (Z80_JIT_CPUS(r_) + (i))
+
+/** Emit bytes */
+#define Z80_JIT_E(t, ...) z80_jit_emit((t), (const uint8_t []) \
+	{ __VA_ARGS__ }, sizeof((const uint8_t []) { __VA_ARGS__ }))
+
+/** Block exit */
+typedef struct {
+	/** Value of PC (unless stored by the native code) */
+	uint16_t pc;
+	/** Nonzero if the native code stored PC */
+	uint8_t dynpc;
+	/** Opcode fetches from the start of the block */
+	uint8_t fetches;
+	/** T states of the last instruction (zero if instr_clock is set) */
+	uint8_t lastcyc;
+	/** Modifier after the exit (after a DD/FD prefix) */
+	uint8_t mod;
+	/** Value of flags_aff, -1 if set by the native code */
+	int8_t aff;
+	/** Value of pflags_aff, -1 to take flags_aff of the CPU state */
+	int8_t paff;
+} z80_jit_exit_t;
+
+/** Native block function, returns exit | (loop iterations << 8) */
+typedef uint64_t (*z80_jit_fn_t)(z80_t *, unsigned long);
+
+/** Block table entry */
+typedef struct {
+	/** Host address of the code */
+	const uint8_t *code;
+	/** Native function or NULL if not translated */
+	z80_jit_fn_t fn;
+	/** Exits of the block */
+	const z80_jit_exit_t *exits;
+	/** Z80 address of the code */
+	uint16_t pc;
+	/** Number of times the address was reached while not translated */
+	int16_t hits;
+	/** Value of brkgen when the break addresses were last checked */
+	unsigned brkgen;
+	/** Offsets of the instructions in the block (bit map) */
+	uint64_t instr[2];
+} z80_jit_ent_t;
+
+/** Kind of jump fix-up */
+enum {
+	/** Jump to exit */
+	z80_jit_fx_exit,
+	/** Call of the code check */
+	z80_jit_fx_verify,
+	/** Size of the Z80 code (imm32) */
+	z80_jit_fx_len
+};
+
+/** Jump fix-up */
+typedef struct {
+	/** Offset of the rel32/imm32 field from the start of the function */
+	uint32_t pos;
+	/** Kind (z80_jit_fx_*) */
+	uint8_t kind;
+	/** Exit number */
+	uint8_t exit;
+} z80_jit_fix_t;
+
+/** Instruction of a block being translated */
+typedef struct {
+	/** Offset of the native code from the start of the function */
+	uint32_t pos;
+	/** Opcode fetches from the start of the block */
+	uint8_t fetches;
+	/** flags_aff of the previous instruction, -1 if in the CPU state */
+	int8_t paff;
+} z80_jit_lbl_t;
+
+/** Jump forward within a block being translated */
+typedef struct {
+	/** Destination address */
+	uint16_t dst;
+	/** Offset of the rel32 field of the jump */
+	uint32_t jmp;
+	/** Offset of the imm32 field of the fetch count adjustment */
+	uint32_t adj;
+	/** Opcode fetches from the start of the block, including the jump */
+	uint8_t fetches;
+	/** Exit taken if the destination is not translated */
+	uint8_t exit;
+} z80_jit_fwd_t;
+
+/** Translation of one block */
+typedef struct {
+	/** CPU context */
+	z80_t *z;
+	/** Start of the native function */
+	uint8_t *start;
+	/** Current native code position */
+	uint8_t *p;
+	/** Z80 code being translated */
+	const uint8_t *code;
+	/** Z80 address of the start of the block */
+	uint16_t pc0;
+	/** Z80 address of the current instruction */
+	uint16_t pc;
+	/** Page containing the block */
+	unsigned pg;
+	/** Number of bytes translated */
+	unsigned len;
+	/** Opcode fetches from the start of the block */
+	uint8_t fetches;
+	/** flags_aff of the previous instruction, -1 if not known */
+	int8_t paff;
+	/** Exit after the last translated instruction */
+	unsigned last;
+	/** Offsets of the instructions in the block (bit map) */
+	uint64_t instr[2];
+	/** Instructions by offset (pos is zero if not translated) */
+	z80_jit_lbl_t lbl[Z80_JIT_MAX_BYTES];
+	/** Jumps forward */
+	z80_jit_fwd_t fwd[Z80_JIT_MAX_INSTR];
+	/** Number of jumps forward */
+	unsigned nfwd;
+	/** Exits */
+	z80_jit_exit_t exits[Z80_JIT_MAX_EXITS];
+	/** Number of exits */
+	unsigned nexits;
+	/** Fix-ups */
+	z80_jit_fix_t fix[Z80_JIT_MAX_FIX];
+	/** Number of fix-ups */
+	unsigned nfix;
+} z80_jit_tr_t;
+
+/** Translator state of a CPU context */
+struct z80_jit {
+	/** Block table */
+	z80_jit_ent_t ent[Z80_JIT_NENT];
+	/** Native code buffer */
+	uint8_t *buf;
+	/** Number of bytes used in the native code buffer */
+	size_t used;
+	/** Incremented when pages are marked for breaks */
+	unsigned brkgen;
+	/** Set when pages are marked for breaks while running a block */
+	int brkchg;
+	/** Translation in progress */
+	z80_jit_tr_t tr;
+	/** Native code of the block being translated */
+	uint8_t scratch[Z80_JIT_BLOCK_SIZE];
+};
+
+static void z80_jit_emit(z80_jit_tr_t *t, const uint8_t *b, size_t n)
+{
+	memcpy(t->p, b, n);
+	t->p += n;
+}
+
+static void z80_jit_emit16(z80_jit_tr_t *t, uint16_t w)
+{
+	memcpy(t->p, &w, sizeof(w));
+	t->p += sizeof(w);
+}
+
+static void z80_jit_emit32(z80_jit_tr_t *t, uint32_t d)
+{
+	memcpy(t->p, &d, sizeof(d));
+	t->p += sizeof(d);
+}
+
+static void z80_jit_emit64(z80_jit_tr_t *t, uint64_t q)
+{
+	memcpy(t->p, &q, sizeof(q));
+	t->p += sizeof(q);
+}
+
+/** Emit ModR/M byte and displacement for [rbx + off].
+ *
+ * @param t Translation
+ * @param reg ModR/M reg field (register or opcode extension)
+ * @param off Offset in the CPU context
+ */
+static void z80_jit_mem(z80_jit_tr_t *t, unsigned reg, size_t off)
+{
+	Z80_JIT_E(t, 0x83 | (reg << 3));
+	z80_jit_emit32(t, off);
+}
+
+/** Emit ModR/M byte and displacement for [r14 + off].
+ *
+ * @param t Translation
+ * @param reg ModR/M reg field (register or opcode extension)
+ * @param off Offset in the Z80 code
+ */
+static void z80_jit_code(z80_jit_tr_t *t, unsigned reg, size_t off)
+{
+	Z80_JIT_E(t, 0x86 | (reg << 3));
+	z80_jit_emit32(t, off);
+}
+
+/** Record fix-up of the rel32/imm32 field that was just emitted. */
+static void z80_jit_fix(z80_jit_tr_t *t, uint8_t kind, unsigned exit)
+{
+	z80_jit_fix_t *f = &t->fix[t->nfix++];
+
+	f->pos = t->p - 4 - t->start;
+	f->kind = kind;
+	f->exit = exit;
+}
+
+/** Emit jump to exit.
+ *
+ * @param t Translation
+ * @param cc Second opcode byte of the near Jcc or zero for JMP
+ * @param exit Exit number
+ */
+static void z80_jit_jx(z80_jit_tr_t *t, uint8_t cc, unsigned exit)
+{
+	if (cc != 0)
+		Z80_JIT_E(t, 0x0f, cc);
+	else
+		Z80_JIT_E(t, 0xe9);
+	z80_jit_emit32(t, 0);
+	z80_jit_fix(t, z80_jit_fx_exit, exit);
+}
+
+/** Emit short forward jump, to be resolved with z80_jit_here().
+ *
+ * @param t Translation
+ * @param op Opcode (0x70 + cc for Jcc, 0xeb for JMP)
+ * @return Position of the jump
+ */
+static uint8_t *z80_jit_jfwd(z80_jit_tr_t *t, uint8_t op)
+{
+	Z80_JIT_E(t, op, 0);
+	return t->p - 2;
+}
+
+/** Resolve short forward jump to the current position. */
+static void z80_jit_here(z80_jit_tr_t *t, uint8_t *j)
+{
+	j[1] = t->p - (j + 2);
+}
+
+/** Emit near forward jump, to be resolved with z80_jit_here32().
+ *
+ * @param t Translation
+ * @param cc Second opcode byte of the near Jcc
+ * @return Position of the rel32 field
+ */
+static uint8_t *z80_jit_jfwd32(z80_jit_tr_t *t, uint8_t cc)
+{
+	Z80_JIT_E(t, 0x0f, cc);
+	z80_jit_emit32(t, 0);
+	return t->p - 4;
+}
+
+/** Resolve near forward jump to the current position. */
+static void z80_jit_here32(z80_jit_tr_t *t, uint8_t *rel)
+{
+	uint32_t d = t->p - (rel + 4);
+
+	memcpy(rel, &d, sizeof(d));
+}
+
+/** Add exit after the current instruction.
+ *
+ * @param t Translation
+ * @param pc Value of PC
+ * @param dynpc Nonzero if the native code stores PC
+ * @param lastcyc T states of the instruction or zero if the native code
+ *                sets instr_clock
+ * @param aff flags_aff of the instruction, -1 if set by the native code
+ * @return Exit number
+ */
+static unsigned z80_jit_exit(z80_jit_tr_t *t, uint16_t pc, int dynpc,
+    unsigned lastcyc, int aff)
+{
+	z80_jit_exit_t *x = &t->exits[t->nexits];
+
+	x->pc = pc;
+	x->dynpc = dynpc;
+	x->fetches = t->fetches;
+	x->lastcyc = lastcyc;
+	x->mod = 0;
+	x->aff = aff;
+	x->paff = t->paff;
+	return t->nexits++;
+}
+
+/* mov r8, [rbx + off] */
+static void z80_jit_ld8(z80_jit_tr_t *t, unsigned reg, size_t off)
+{
+	Z80_JIT_E(t, 0x8a);
+	z80_jit_mem(t, reg, off);
+}
+
+/* mov [rbx + off], r8 */
+static void z80_jit_st8(z80_jit_tr_t *t, unsigned reg, size_t off)
+{
+	Z80_JIT_E(t, 0x88);
+	z80_jit_mem(t, reg, off);
+}
+
+/* mov byte [rbx + off], imm8 */
+static void z80_jit_st8i(z80_jit_tr_t *t, size_t off, uint8_t val)
+{
+	Z80_JIT_E(t, 0xc6);
+	z80_jit_mem(t, 0, off);
+	Z80_JIT_E(t, val);
+}
+
+/* mov dword [rbx + off], imm32 */
+static void z80_jit_st32i(z80_jit_tr_t *t, size_t off, uint32_t val)
+{
+	Z80_JIT_E(t, 0xc7);
+	z80_jit_mem(t, 0, off);
+	z80_jit_emit32(t, val);
+}
+
+/** Get offset of a 16-bit register stored in host byte order.
+ *
+ * @param rp Register pair (3 = SP, 4 = IX, 5 = IY)
+ * @return Offset in the CPU context
+ */
+static size_t z80_jit_rp16(unsigned rp)
+{
+	if (rp == 3)
+		return Z80_JIT_CPUS(SP);
+	return rp == 4 ? Z80_JIT_CPUS(IX) : Z80_JIT_CPUS(IY);
+}
+
+/** Emit load of a register pair into eax (reg 0) or ecx (reg 1).
+ *
+ * @param t Translation
+ * @param reg Host register
+ * @param rp Register pair (0 = BC, 1 = DE, 2 = HL, 3 = SP, 4 = IX,
+ *           5 = IY)
+ */
+static void z80_jit_ldrp(z80_jit_tr_t *t, unsigned reg, unsigned rp)
+{
+	/* movzx reg, word [rbx + off] */
+	Z80_JIT_E(t, 0x0f, 0xb7);
+	if (rp >= 3) {
+		z80_jit_mem(t, reg, z80_jit_rp16(rp));
+	} else {
+		z80_jit_mem(t, reg, Z80_JIT_R(2 * rp));
+		/* rol reg16, 8 (high register comes first) */
+		Z80_JIT_E(t, 0x66, 0xc1, 0xc0 | reg, 8);
+	}
+}
+
+/** Emit store of ax (reg 0) or cx (reg 1) to a register pair.
+ *
+ * @param t Translation
+ * @param reg Host register
+ * @param rp Register pair (0 = BC, 1 = DE, 2 = HL, 3 = SP, 4 = IX,
+ *           5 = IY)
+ */
+static void z80_jit_strp(z80_jit_tr_t *t, unsigned reg, unsigned rp)
+{
+	if (rp < 3)
+		Z80_JIT_E(t, 0x66, 0xc1, 0xc0 | reg, 8);
+	Z80_JIT_E(t, 0x66, 0x89);
+	z80_jit_mem(t, reg, rp >= 3 ? z80_jit_rp16(rp) : Z80_JIT_R(2 * rp));
+}
+
+/** Emit load of the address of a memory operand into ecx.
+ *
+ * @param t Translation
+ * @param rp Register pair (2 = HL, 4 = IX, 5 = IY)
+ * @param d Displacement (for IX and IY)
+ * @param w Nonzero to store the high byte of an indexed address in W
+ */
+static void z80_jit_addr(z80_jit_tr_t *t, unsigned rp, uint8_t d, int w)
+{
+	z80_jit_ldrp(t, 1, rp);
+	if (rp == 2)
+		return;
+	/* add cx, d */
+	Z80_JIT_E(t, 0x66, 0x83, 0xc1, d);
+	if (w) {
+		/* mov [rbx + W], ch */
+		z80_jit_st8(t, 5, Z80_JIT_CPUS(W));
+	}
+}
+
+/** Emit load of SP + 1 into ecx. */
+static void z80_jit_sp1(z80_jit_tr_t *t)
+{
+	z80_jit_ldrp(t, 1, 3);
+	/* inc cx */
+	Z80_JIT_E(t, 0x66, 0xff, 0xc1);
+}
+
+/** Emit load of r14 from the read page table. */
+static void z80_jit_code_ptr(z80_jit_tr_t *t)
+{
+	/* mov rax, [rbx + rdpg] */
+	Z80_JIT_E(t, 0x48, 0x8b);
+	z80_jit_mem(t, 0, Z80_JIT_CTX(rdpg));
+	/* mov rax, [rax + pg * 8] */
+	Z80_JIT_E(t, 0x48, 0x8b, 0x80);
+	z80_jit_emit32(t, t->pg * sizeof(uint8_t *));
+	/* add rax, off */
+	Z80_JIT_E(t, 0x48, 0x05);
+	z80_jit_emit32(t, t->pc0 & (Z80_PG_SIZE - 1));
+	/* mov r14, rax */
+	Z80_JIT_E(t, 0x49, 0x89, 0xc6);
+}
+
+/** Emit check of the code, leaving nonzero in [rsp] if it has changed. */
+static void z80_jit_recheck(z80_jit_tr_t *t)
+{
+	z80_jit_code_ptr(t);
+	/* call verify */
+	Z80_JIT_E(t, 0xe8);
+	z80_jit_emit32(t, 0);
+	z80_jit_fix(t, z80_jit_fx_verify, 0);
+	/* or [rsp], al */
+	Z80_JIT_E(t, 0x08, 0x04, 0x24);
+}
+
+/** Emit memory read.
+ *
+ * Reads the byte at the address in ecx (bits 16 and up must be zero)
+ * into eax. Clobbers ecx and edx.
+ */
+static void z80_jit_read8(z80_jit_tr_t *t)
+{
+	/* mov eax, ecx; shr eax, Z80_PG_SHIFT */
+	Z80_JIT_E(t, 0x89, 0xc8, 0xc1, 0xe8, Z80_PG_SHIFT);
+	/* mov rdx, [rbx + rdpg] */
+	Z80_JIT_E(t, 0x48, 0x8b);
+	z80_jit_mem(t, 2, Z80_JIT_CTX(rdpg));
+	/* mov rdx, [rdx + rax * 8] */
+	Z80_JIT_E(t, 0x48, 0x8b, 0x14, 0xc2);
+	/* and ecx, Z80_PG_SIZE - 1 */
+	Z80_JIT_E(t, 0x81, 0xe1);
+	z80_jit_emit32(t, Z80_PG_SIZE - 1);
+	/* movzx eax, byte [rdx + rcx] */
+	Z80_JIT_E(t, 0x0f, 0xb6, 0x04, 0x0a);
+}
+
+static int z80_jit_memset8(z80_t *, uint16_t, uint8_t, unsigned long);
+
+/** Emit memory write.
+ *
+ * Writes al to the address in ecx (bits 16 and up must be zero).
+ * Clobbers all caller-saved registers.
+ */
+static void z80_jit_write8(z80_jit_tr_t *t)
+{
+	uint8_t *slow;
+	uint8_t *done1;
+	uint8_t *done2;
+
+	/* mov edx, ecx; shr edx, Z80_PG_SHIFT */
+	Z80_JIT_E(t, 0x89, 0xca, 0xc1, 0xea, Z80_PG_SHIFT);
+	/* mov rsi, [rbx + wrpg] */
+	Z80_JIT_E(t, 0x48, 0x8b);
+	z80_jit_mem(t, 6, Z80_JIT_CTX(wrpg));
+	/* mov rsi, [rsi + rdx * 8]; test rsi, rsi */
+	Z80_JIT_E(t, 0x48, 0x8b, 0x34, 0xd6, 0x48, 0x85, 0xf6);
+	slow = z80_jit_jfwd(t, 0x74);
+	/* and ecx, Z80_PG_SIZE - 1 */
+	Z80_JIT_E(t, 0x81, 0xe1);
+	z80_jit_emit32(t, Z80_PG_SIZE - 1);
+	/* add rsi, rcx; mov [rsi], al */
+	Z80_JIT_E(t, 0x48, 0x01, 0xce, 0x88, 0x06);
+	/* sub rsi, r14; cmp rsi, len */
+	Z80_JIT_E(t, 0x4c, 0x29, 0xf6, 0x48, 0x81, 0xfe);
+	z80_jit_emit32(t, 0);
+	z80_jit_fix(t, z80_jit_fx_len, 0);
+	done1 = z80_jit_jfwd(t, 0x73);
+	/* mov byte [rsp], 1 */
+	Z80_JIT_E(t, 0xc6, 0x04, 0x24, 0x01);
+	done2 = z80_jit_jfwd(t, 0xeb);
+
+	z80_jit_here(t, slow);
+	/* mov rdi, rbx; mov esi, ecx; movzx edx, al */
+	Z80_JIT_E(t, 0x48, 0x89, 0xdf, 0x89, 0xce, 0x0f, 0xb6, 0xd0);
+	/* lea rcx, [r12 + r13] */
+	Z80_JIT_E(t, 0x4b, 0x8d, 0x0c, 0x2c);
+	/* mov rax, z80_jit_memset8; call rax; or [rsp], al */
+	Z80_JIT_E(t, 0x48, 0xb8);
+	z80_jit_emit64(t, (uintptr_t)z80_jit_memset8);
+	Z80_JIT_E(t, 0xff, 0xd0, 0x08, 0x04, 0x24);
+	z80_jit_recheck(t);
+
+	z80_jit_here(t, done1);
+	z80_jit_here(t, done2);
+}
+
+/** Emit end of an inline instruction.
+ *
+ * Counts the T states of the instruction and leaves the block if
+ * the deadline has been reached, or if @a chk is nonzero and the
+ * instruction asked for it.
+ *
+ * @param t Translation
+ * @param cyc T states
+ * @param exit Exit after the instruction
+ * @param chk Nonzero to check [rsp]
+ */
+static void z80_jit_end(z80_jit_tr_t *t, unsigned cyc, unsigned exit,
+    int chk)
+{
+	/* add r12, cyc */
+	Z80_JIT_E(t, 0x49, 0x83, 0xc4, cyc);
+	/* jns exit */
+	z80_jit_jx(t, 0x89, exit);
+	if (chk) {
+		/* cmp byte [rsp], 0; jne exit */
+		Z80_JIT_E(t, 0x80, 0x3c, 0x24, 0x00);
+		z80_jit_jx(t, 0x85, exit);
+	}
+}
+
+/** Emit test of a condition.
+ *
+ * Sets ZF of the host if the condition is false for odd @a cc and if it
+ * is true for even @a cc.
+ *
+ * @param t Translation
+ * @param cc Condition (NZ, Z, NC, C, PO, PE, P, M)
+ * @return Second opcode byte of the near Jcc that jumps if the condition
+ *         is true
+ */
+static uint8_t z80_jit_cond(z80_jit_tr_t *t, unsigned cc)
+{
+	static const uint8_t mask[4] = { fZ, fC, fPV, fS };
+
+	/* test byte [rbx + F], mask */
+	Z80_JIT_E(t, 0xf6);
+	z80_jit_mem(t, 0, Z80_JIT_CPUS(F));
+	Z80_JIT_E(t, mask[cc >> 1]);
+	return (cc & 1) != 0 ? 0x85 : 0x84;
+}
+
+/** Emit push of a 16-bit value.
+ *
+ * @param t Translation
+ * @param rp Register pair (0 = BC, 1 = DE, 2 = HL, 3 = AF, 4 = IX,
+ *           5 = IY) or -1 for an immediate value
+ * @param val Immediate value
+ */
+static void z80_jit_push(z80_jit_tr_t *t, int rp, uint16_t val)
+{
+	/* sub word [rbx + SP], 2 */
+	Z80_JIT_E(t, 0x66, 0x83);
+	z80_jit_mem(t, 5, Z80_JIT_CPUS(SP));
+	Z80_JIT_E(t, 2);
+
+	/* low byte to (SP) */
+	z80_jit_ldrp(t, 1, 3);
+	if (rp < 0)
+		Z80_JIT_E(t, 0xb0, val & 0xff);
+	else if (rp == 3)
+		z80_jit_ld8(t, 0, Z80_JIT_CPUS(F));
+	else if (rp > 3)
+		z80_jit_ld8(t, 0, z80_jit_rp16(rp));
+	else
+		z80_jit_ld8(t, 0, Z80_JIT_R(2 * rp + 1));
+	z80_jit_write8(t);
+
+	/* high byte to (SP + 1) */
+	z80_jit_sp1(t);
+	if (rp < 0)
+		Z80_JIT_E(t, 0xb0, val >> 8);
+	else if (rp == 3)
+		z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+	else if (rp > 3)
+		z80_jit_ld8(t, 0, z80_jit_rp16(rp) + 1);
+	else
+		z80_jit_ld8(t, 0, Z80_JIT_R(2 * rp));
+	z80_jit_write8(t);
+}
+
+/** Emit pop of a 16-bit value into ax. */
+static void z80_jit_pop(z80_jit_tr_t *t)
+{
+	z80_jit_ldrp(t, 1, 3);
+	z80_jit_read8(t);
+	/* mov [rsp + 8], al */
+	Z80_JIT_E(t, 0x88, 0x44, 0x24, 0x08);
+	z80_jit_sp1(t);
+	z80_jit_read8(t);
+	/* mov ah, al; mov al, [rsp + 8] */
+	Z80_JIT_E(t, 0x88, 0xc4, 0x8a, 0x44, 0x24, 0x08);
+	/* add word [rbx + SP], 2 */
+	Z80_JIT_E(t, 0x66, 0x83);
+	z80_jit_mem(t, 0, Z80_JIT_CPUS(SP));
+	Z80_JIT_E(t, 2);
+}
+
+/** Emit 8-bit arithmetic or logic operation of A with dl.
+ *
+ * @param t Translation
+ * @param op Operation (ADD, ADC, SUB, SBC, AND, XOR, OR, CP)
+ */
+static void z80_jit_alu(z80_jit_tr_t *t, unsigned op)
+{
+	/* x86 opcodes of op al, dl */
+	static const uint8_t x86op[8] = {
+		0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38
+	};
+
+	if (op == 1 || op == 3) {
+		/* mov cl, [rbx + F]; shr cl, 1 (CF = carry) */
+		z80_jit_ld8(t, 1, Z80_JIT_CPUS(F));
+		Z80_JIT_E(t, 0xd0, 0xe9);
+	}
+
+	z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+	Z80_JIT_E(t, x86op[op], 0xd0);
+
+	if (op >= 4 && op <= 6) {
+		z80_jit_st8(t, 0, Z80_JIT_R(rA));
+		/* movzx ecx, al; mov cl, [rbp + rcx] */
+		Z80_JIT_E(t, 0x0f, 0xb6, 0xc8, 0x8a, 0x4c, 0x0d, 0x00);
+		if (op == 4) {
+			/* or cl, fHC */
+			Z80_JIT_E(t, 0x80, 0xc9, fHC);
+		}
+		z80_jit_st8(t, 1, Z80_JIT_CPUS(F));
+		return;
+	}
+
+	/* lahf; seto cl */
+	Z80_JIT_E(t, 0x9f, 0x0f, 0x90, 0xc1);
+	if (op != 7)
+		z80_jit_st8(t, 0, Z80_JIT_R(rA));
+	else
+		Z80_JIT_E(t, 0x88, 0xd0);	/* mov al, dl */
+	/* and ah, S | Z | H | C; shl cl, 2; or ah, cl */
+	Z80_JIT_E(t, 0x80, 0xe4, fS | fZ | fHC | fC, 0xc0, 0xe1, 2,
+	    0x08, 0xcc);
+	/* and al, fU; or ah, al */
+	Z80_JIT_E(t, 0x24, fU, 0x08, 0xc4);
+	if (op >= 2) {
+		/* or ah, fN */
+		Z80_JIT_E(t, 0x80, 0xcc, fN);
+	}
+	/* mov [rbx + F], ah */
+	z80_jit_st8(t, 4, Z80_JIT_CPUS(F));
+}
+
+/** Emit 8-bit increment or decrement.
+ *
+ * @param t Translation
+ * @param r Register (6 for a memory operand)
+ * @param rp Address register pair of a memory operand (2 = HL, 4 = IX,
+ *           5 = IY)
+ * @param d Displacement of a memory operand (for IX and IY)
+ * @param dec Nonzero for decrement
+ */
+static void z80_jit_incdec(z80_jit_tr_t *t, unsigned r, unsigned rp,
+    uint8_t d, int dec)
+{
+	if (r == 6) {
+		z80_jit_addr(t, rp, d, 1);
+		z80_jit_read8(t);
+	} else {
+		z80_jit_ld8(t, 0, Z80_JIT_R(r));
+	}
+	/* inc/dec al; lahf; seto cl; mov dl, al */
+	Z80_JIT_E(t, 0xfe, dec ? 0xc8 : 0xc0, 0x9f, 0x0f, 0x90, 0xc1,
+	    0x88, 0xc2);
+	/* and ah, S | Z | H; shl cl, 2; or ah, cl; and al, fU; or ah, al */
+	Z80_JIT_E(t, 0x80, 0xe4, fS | fZ | fHC, 0xc0, 0xe1, 2, 0x08, 0xcc,
+	    0x24, fU, 0x08, 0xc4);
+	if (dec) {
+		/* or ah, fN */
+		Z80_JIT_E(t, 0x80, 0xcc, fN);
+	}
+	/* mov al, [rbx + F]; and al, fC; or ah, al; mov [rbx + F], ah */
+	z80_jit_ld8(t, 0, Z80_JIT_CPUS(F));
+	Z80_JIT_E(t, 0x24, fC, 0x08, 0xc4);
+	z80_jit_st8(t, 4, Z80_JIT_CPUS(F));
+
+	if (r == 6) {
+		/* mov al, dl */
+		Z80_JIT_E(t, 0x88, 0xd0);
+		z80_jit_addr(t, rp, d, 0);
+		z80_jit_write8(t);
+	} else {
+		z80_jit_st8(t, 2, Z80_JIT_R(r));
+	}
+}
+
+/** Emit RLCA, RRCA, RLA or RRA.
+ *
+ * @param t Translation
+ * @param op Opcode
+ */
+static void z80_jit_rota(z80_jit_tr_t *t, uint8_t op)
+{
+	/* x86 ModR/M bytes of rol/ror/rcl/rcr al, 1 */
+	static const uint8_t x86op[4] = { 0xc0, 0xc8, 0xd0, 0xd8 };
+
+	z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+	if (op >= 0x10) {
+		/* mov cl, [rbx + F]; shr cl, 1 (CF = carry) */
+		z80_jit_ld8(t, 1, Z80_JIT_CPUS(F));
+		Z80_JIT_E(t, 0xd0, 0xe9);
+	}
+	/* op al, 1; setc dl */
+	Z80_JIT_E(t, 0xd0, x86op[op >> 3], 0x0f, 0x92, 0xc2);
+	z80_jit_st8(t, 0, Z80_JIT_R(rA));
+	/* and al, fU; or dl, al */
+	Z80_JIT_E(t, 0x24, fU, 0x08, 0xc2);
+	/* mov al, [rbx + F]; and al, S | Z | PV; or al, dl */
+	z80_jit_ld8(t, 0, Z80_JIT_CPUS(F));
+	Z80_JIT_E(t, 0x24, fS | fZ | fPV, 0x08, 0xd0);
+	z80_jit_st8(t, 0, Z80_JIT_CPUS(F));
+}
+
+/** Emit SCF or CCF.
+ *
+ * If the previous instruction affected flags, bits 3 and 5 are taken
+ * from A, otherwise they are ORed to F, as in ei_scf() and ei_ccf().
+ *
+ * @param t Translation
+ * @param ccf Nonzero for CCF
+ * @param paff flags_aff of the previous instruction
+ */
+static void z80_jit_scf(z80_jit_tr_t *t, int ccf, int paff)
+{
+	z80_jit_ld8(t, 1, Z80_JIT_CPUS(F));
+	if (ccf) {
+		/* mov dl, cl; and dl, fC; shl dl, 4 (H = old C) */
+		Z80_JIT_E(t, 0x88, 0xca, 0x80, 0xe2, fC, 0xc0, 0xe2, 4);
+	} else {
+		/* mov dl, fC */
+		Z80_JIT_E(t, 0xb2, fC);
+	}
+	z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+	if (paff == 0) {
+		/* or al, cl */
+		Z80_JIT_E(t, 0x08, 0xc8);
+	}
+	/* and al, fU; and cl, S | Z | PV | C */
+	Z80_JIT_E(t, 0x24, fU, 0x80, 0xe1, fS | fZ | fPV | fC);
+	if (ccf) {
+		/* xor cl, fC */
+		Z80_JIT_E(t, 0x80, 0xf1, fC);
+	} else {
+		/* and cl, ~fC */
+		Z80_JIT_E(t, 0x80, 0xe1, (uint8_t)~fC);
+	}
+	/* or cl, dl; or cl, al */
+	Z80_JIT_E(t, 0x08, 0xd1, 0x08, 0xc1);
+	z80_jit_st8(t, 1, Z80_JIT_CPUS(F));
+}
+
+/** Emit CB-prefixed instruction.
+ *
+ * DD CB and FD CB instructions are only supported with a memory operand.
+ *
+ * @param t Translation
+ * @param op Opcode following the prefix (and displacement)
+ * @param rp Address register pair of a memory operand (2 = HL, 4 = IX,
+ *           5 = IY)
+ * @param d Displacement of a memory operand (for IX and IY)
+ * @param wr Place to store nonzero if the instruction writes memory
+ * @return T states (after the DD/FD prefix)
+ */
+static unsigned z80_jit_cb(z80_jit_tr_t *t, uint8_t op, unsigned rp,
+    uint8_t d, int *wr)
+{
+	/* x86 ModR/M bytes of rol/ror/rcl/rcr/shl/sar/shl/shr al, 1 */
+	static const uint8_t x86op[8] = {
+		0xc0, 0xc8, 0xd0, 0xd8, 0xe0, 0xf8, 0xe0, 0xe8
+	};
+	unsigned r = op & 0x07;
+	unsigned b = (op >> 3) & 0x07;
+	unsigned ix = rp != 2 ? 4 : 0;
+
+	if (r == 6) {
+		z80_jit_addr(t, rp, d, 1);
+		z80_jit_read8(t);
+	} else {
+		z80_jit_ld8(t, 0, Z80_JIT_R(r));
+	}
+
+	switch (op >> 6) {
+	case 0:
+		/* Rotations and shifts */
+		if (b == 2 || b == 3) {
+			/* mov cl, [rbx + F]; shr cl, 1 (CF = carry) */
+			z80_jit_ld8(t, 1, Z80_JIT_CPUS(F));
+			Z80_JIT_E(t, 0xd0, 0xe9);
+		}
+		/* op al, 1; setc dl */
+		Z80_JIT_E(t, 0xd0, x86op[b], 0x0f, 0x92, 0xc2);
+		if (b == 6) {
+			/* or al, 1 (SLL) */
+			Z80_JIT_E(t, 0x0c, 0x01);
+		}
+		/* movzx ecx, al; mov cl, [rbp + rcx]; or cl, dl */
+		Z80_JIT_E(t, 0x0f, 0xb6, 0xc8, 0x8a, 0x4c, 0x0d, 0x00,
+		    0x08, 0xd1);
+		z80_jit_st8(t, 1, Z80_JIT_CPUS(F));
+		break;
+	case 1:
+		/* BIT b, r: bits 3 and 5 from the operand or from W */
+		if (r == 6)
+			z80_jit_ld8(t, 2, Z80_JIT_CPUS(W));
+		else
+			Z80_JIT_E(t, 0x88, 0xc2);	/* mov dl, al */
+		/* and al, 1 << b; movzx ecx, al; mov cl, [rbp + rcx] */
+		Z80_JIT_E(t, 0x24, 1 << b, 0x0f, 0xb6, 0xc8,
+		    0x8a, 0x4c, 0x0d, 0x00);
+		/* and cl, fD; or cl, fHC; and dl, fU; or cl, dl */
+		Z80_JIT_E(t, 0x80, 0xe1, fD, 0x80, 0xc9, fHC,
+		    0x80, 0xe2, fU, 0x08, 0xd1);
+		/* mov al, [rbx + F]; and al, fC; or cl, al */
+		z80_jit_ld8(t, 0, Z80_JIT_CPUS(F));
+		Z80_JIT_E(t, 0x24, fC, 0x08, 0xc1);
+		z80_jit_st8(t, 1, Z80_JIT_CPUS(F));
+		*wr = 0;
+		return r == 6 ? 12 + ix : 8;
+	case 2:
+		/* RES b, r: and al, ~(1 << b) */
+		Z80_JIT_E(t, 0x24, (uint8_t)~(1 << b));
+		break;
+	default:
+		/* SET b, r: or al, 1 << b */
+		Z80_JIT_E(t, 0x0c, 1 << b);
+		break;
+	}
+
+	if (r == 6) {
+		z80_jit_addr(t, rp, d, 0);
+		z80_jit_write8(t);
+		*wr = 1;
+		return 15 + ix;
+	}
+
+	z80_jit_st8(t, 0, Z80_JIT_R(r));
+	*wr = 0;
+	return 8;
+}
+
+/** Emit exchange of a register with its alternate.
+ *
+ * @param t Translation
+ * @param off Offset of the register in the CPU context
+ * @param alt Offset of the alternate register
+ * @param size Size (1, 2 or 4 bytes)
+ */
+static void z80_jit_exch(z80_jit_tr_t *t, size_t off, size_t alt,
+    unsigned size)
+{
+	static const uint8_t ld[5] = { 0, 0x8a, 0x8b, 0, 0x8b };
+	static const uint8_t st[5] = { 0, 0x88, 0x89, 0, 0x89 };
+
+	if (size == 2)
+		Z80_JIT_E(t, 0x66);
+	Z80_JIT_E(t, ld[size]);
+	z80_jit_mem(t, 0, off);
+	if (size == 2)
+		Z80_JIT_E(t, 0x66);
+	Z80_JIT_E(t, ld[size]);
+	z80_jit_mem(t, 1, alt);
+	if (size == 2)
+		Z80_JIT_E(t, 0x66);
+	Z80_JIT_E(t, st[size]);
+	z80_jit_mem(t, 1, off);
+	if (size == 2)
+		Z80_JIT_E(t, 0x66);
+	Z80_JIT_E(t, st[size]);
+	z80_jit_mem(t, 0, alt);
+}
+
+/** Emit ADD HL, rr; ADD IX, rr or ADD IY, rr.
+ *
+ * @param t Translation
+ * @param dst Destination register pair (2 = HL, 4 = IX, 5 = IY)
+ * @param rp Register pair (0 = BC, 1 = DE, 2 = destination, 3 = SP)
+ */
+static void z80_jit_add16(z80_jit_tr_t *t, unsigned dst, unsigned rp)
+{
+	z80_jit_ldrp(t, 0, dst);
+	/* mov [rbx + W], ah */
+	z80_jit_st8(t, 4, Z80_JIT_CPUS(W));
+	z80_jit_ldrp(t, 1, rp == 2 ? dst : rp);
+	/*
+	 * Half carry is computed from the high bytes without the carry
+	 * from the low bytes, as in _add16().
+	 *
+	 * movzx edx, ah; and edx, 0x0f; movzx esi, ch; and esi, 0x0f;
+	 * add edx, esi; and edx, fHC
+	 */
+	Z80_JIT_E(t, 0x0f, 0xb6, 0xd4, 0x83, 0xe2, 0x0f,
+	    0x0f, 0xb6, 0xf5, 0x83, 0xe6, 0x0f,
+	    0x01, 0xf2, 0x83, 0xe2, fHC);
+	/* add ax, cx; adc edx, 0 (C) */
+	Z80_JIT_E(t, 0x66, 0x01, 0xc8, 0x83, 0xd2, 0x00);
+	/* mov cl, ah; and cl, fU; or dl, cl */
+	Z80_JIT_E(t, 0x88, 0xe1, 0x80, 0xe1, fU, 0x08, 0xca);
+	z80_jit_strp(t, 0, dst);
+	/* mov cl, [rbx + F]; and cl, S | Z | PV; or cl, dl */
+	z80_jit_ld8(t, 1, Z80_JIT_CPUS(F));
+	Z80_JIT_E(t, 0x80, 0xe1, fS | fZ | fPV, 0x08, 0xd1);
+	z80_jit_st8(t, 1, Z80_JIT_CPUS(F));
+}
+
+static int z80_jit_call(z80_t *, uint32_t, uint8_t, void (*)(z80_t *));
+
+/** Emit call of an instruction handler.
+ *
+ * @param t Translation
+ * @param h Handler
+ * @param opc Opcode
+ * @param cbop Displacement of DD CB / FD CB instruction
+ * @param pc Address of the operands (as after reading the opcode)
+ * @param mod Modifier (0, 1 = DD, 2 = FD)
+ * @param pre T states of a prefix executed within the same step
+ * @param wr Nonzero if the instruction can write memory
+ * @param next Address of the next instruction
+ * @return Exit after the instruction
+ */
+static unsigned z80_jit_handler(z80_jit_tr_t *t, void (*h)(z80_t *),
+    uint8_t opc, uint8_t cbop, uint16_t pc, unsigned mod, unsigned pre,
+    int wr, uint16_t next)
+{
+	unsigned x;
+
+	/* lea rax, [r12 + r13]; mov [rbx + instr_clock], rax */
+	Z80_JIT_E(t, 0x4b, 0x8d, 0x04, 0x2c, 0x48, 0x89);
+	z80_jit_mem(t, 0, Z80_JIT_CTX(instr_clock));
+	if (pre != 0) {
+		/* add r12, pre; lea rax, [r12 + r13] */
+		Z80_JIT_E(t, 0x49, 0x83, 0xc4, pre, 0x4b, 0x8d, 0x04, 0x2c);
+	}
+	/* mov [rbx + clock], rax */
+	Z80_JIT_E(t, 0x48, 0x89);
+	z80_jit_mem(t, 0, Z80_JIT_CTX(clock));
+
+	if (t->paff >= 0) {
+		z80_jit_st32i(t, Z80_JIT_CPUS(pflags_aff), t->paff);
+	} else {
+		/* mov eax, [rbx + flags_aff]; mov [rbx + pflags_aff], eax */
+		Z80_JIT_E(t, 0x8b);
+		z80_jit_mem(t, 0, Z80_JIT_CPUS(flags_aff));
+		Z80_JIT_E(t, 0x89);
+		z80_jit_mem(t, 0, Z80_JIT_CPUS(pflags_aff));
+	}
+	z80_jit_st32i(t, Z80_JIT_CPUS(flags_aff), 0);
+
+	/* mov rdi, rbx; mov esi, arg; mov edx, mod */
+	Z80_JIT_E(t, 0x48, 0x89, 0xdf, 0xbe);
+	z80_jit_emit32(t, pc | (uint32_t)opc << 16 | (uint32_t)cbop << 24);
+	Z80_JIT_E(t, 0xba);
+	z80_jit_emit32(t, mod);
+	/* mov rcx, h; mov rax, z80_jit_call; call rax; or [rsp], al */
+	Z80_JIT_E(t, 0x48, 0xb9);
+	z80_jit_emit64(t, (uintptr_t)h);
+	Z80_JIT_E(t, 0x48, 0xb8);
+	z80_jit_emit64(t, (uintptr_t)z80_jit_call);
+	Z80_JIT_E(t, 0xff, 0xd0, 0x08, 0x04, 0x24);
+	if (wr)
+		z80_jit_recheck(t);
+
+	/* mov r12, [rbx + clock]; sub r12, r13 */
+	Z80_JIT_E(t, 0x4c, 0x8b);
+	z80_jit_mem(t, 4, Z80_JIT_CTX(clock));
+	Z80_JIT_E(t, 0x4d, 0x29, 0xec);
+
+	x = z80_jit_exit(t, next, 0, 0, -1);
+	z80_jit_jx(t, 0x89, x);
+	/* cmp byte [rsp], 0; jne exit */
+	Z80_JIT_E(t, 0x80, 0x3c, 0x24, 0x00);
+	z80_jit_jx(t, 0x85, x);
+
+	t->paff = -1;
+	return x;
+}
+
+/** Determine if ED-prefixed instruction can be translated.
+ *
+ * @param h Handler
+ * @param wr Place to store nonzero if the instruction can write memory
+ * @return Nonzero if the instruction can be translated
+ */
+static int z80_jit_ed_ok(void (*h)(z80_t *), int *wr)
+{
+	*wr = h == ei_ldi || h == ei_ldd || h == ei_rld || h == ei_rrd ||
+	    h == ei_ld_iNN_BC || h == ei_ld_iNN_DE || h == ei_ld_iNN_HL ||
+	    h == ei_ld_iNN_SP;
+
+	return *wr || h == ei_adc_HL_BC || h == ei_adc_HL_DE ||
+	    h == ei_adc_HL_HL || h == ei_adc_HL_SP || h == ei_sbc_HL_BC ||
+	    h == ei_sbc_HL_DE || h == ei_sbc_HL_HL || h == ei_sbc_HL_SP ||
+	    h == ei_neg || h == Ui_neg || h == ei_cpi || h == ei_cpd ||
+	    h == ei_ld_BC_iNN || h == ei_ld_DE_iNN || h == ei_ld_HL_iNN_x ||
+	    h == ei_ld_SP_iNN || h == ei_ld_I_A || h == ei_im_0 ||
+	    h == ei_im_1 || h == ei_im_2 || h == Ui_im_0 || h == Ui_im_1 ||
+	    h == Ui_im_2 || h == Ui_ednop;
+}
+
+/** Get length of DD/FD-prefixed instruction (not DD CB / FD CB).
+ *
+ * @param op Opcode following the prefix
+ * @return Length including the prefix
+ */
+static unsigned z80_jit_ddlen(uint8_t op)
+{
+	if (op == 0x21 || op == 0x22 || op == 0x2a || op == 0x36)
+		return 4;
+	if (op == 0x26 || op == 0x2e || op == 0x34 || op == 0x35 ||
+	    ((op & 0xc7) == 0x46 && op != 0x76) ||
+	    ((op & 0xf8) == 0x70 && op != 0x76) || (op & 0xc7) == 0x86)
+		return 3;
+	return 2;
+}
+
+/** Emit DD/FD-prefixed instruction inline, if supported.
+ *
+ * @param t Translation
+ * @param c Code of the instruction
+ * @param cyc Place to store T states (after the prefix)
+ * @param wr Place to store nonzero if the instruction writes memory
+ * @param aff Place to store flags_aff of the instruction
+ * @return Nonzero if the instruction was emitted
+ */
+static int z80_jit_ddin(z80_jit_tr_t *t, const uint8_t *c, unsigned *cyc,
+    int *wr, int *aff)
+{
+	unsigned rp = c[0] == 0xdd ? 4 : 5;
+	uint8_t op = c[1];
+
+	*cyc = 15;
+	*wr = 0;
+	*aff = 0;
+
+	if (op == 0xcb) {
+		if ((c[3] & 0x07) != 0x06)
+			return 0;
+		*cyc = z80_jit_cb(t, c[3], rp, c[2], wr);
+		*aff = (c[3] & 0xc0) < 0x80;
+		return 1;
+	}
+
+	if ((op & 0xc7) == 0x46 && op != 0x76) {
+		/* LD r, (IX + d) */
+		z80_jit_addr(t, rp, c[2], 1);
+		z80_jit_read8(t);
+		z80_jit_st8(t, 0, Z80_JIT_R((op >> 3) & 0x07));
+	} else if ((op & 0xf8) == 0x70 && op != 0x76) {
+		/* LD (IX + d), r */
+		z80_jit_addr(t, rp, c[2], 1);
+		z80_jit_ld8(t, 0, Z80_JIT_R(op & 0x07));
+		z80_jit_write8(t);
+		*wr = 1;
+	} else if (op == 0x36) {
+		/* LD (IX + d), n */
+		z80_jit_addr(t, rp, c[2], 1);
+		Z80_JIT_E(t, 0xb0, c[3]);
+		z80_jit_write8(t);
+		*wr = 1;
+	} else if ((op & 0xc7) == 0x86) {
+		/* ALU A, (IX + d) */
+		z80_jit_addr(t, rp, c[2], 1);
+		z80_jit_read8(t);
+		/* mov dl, al */
+		Z80_JIT_E(t, 0x88, 0xc2);
+		z80_jit_alu(t, (op >> 3) & 0x07);
+		*aff = 1;
+	} else if (op == 0x34 || op == 0x35) {
+		/* INC (IX + d); DEC (IX + d) */
+		z80_jit_incdec(t, 6, rp, c[2], op & 0x01);
+		*cyc = 19;
+		*wr = 1;
+		*aff = 1;
+	} else if ((op & 0xcf) == 0x09) {
+		/* ADD IX, rr */
+		z80_jit_add16(t, rp, op >> 4);
+		*cyc = 11;
+		*aff = 1;
+	} else if (op == 0x21) {
+		/* LD IX, nn */
+		Z80_JIT_E(t, 0x66, 0xc7);
+		z80_jit_mem(t, 0, z80_jit_rp16(rp));
+		z80_jit_emit16(t, c[2] | c[3] << 8);
+		*cyc = 10;
+	} else if (op == 0x23 || op == 0x2b) {
+		/* INC IX; DEC IX: inc/dec word [rbx + IX] */
+		Z80_JIT_E(t, 0x66, 0xff);
+		z80_jit_mem(t, op == 0x2b ? 1 : 0, z80_jit_rp16(rp));
+		*cyc = 6;
+	} else if (op == 0xe5) {
+		/* PUSH IX */
+		z80_jit_push(t, rp, 0);
+		*cyc = 11;
+		*wr = 1;
+	} else if (op == 0xe1) {
+		/* POP IX */
+		z80_jit_pop(t);
+		z80_jit_strp(t, 0, rp);
+		*cyc = 10;
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+/** Translate DD/FD-prefixed instruction.
+ *
+ * @param t Translation
+ * @param c Code of the instruction
+ * @param n Bytes of code available in the page
+ * @return Number of bytes translated, zero if not translated
+ */
+static unsigned z80_jit_dd(z80_jit_tr_t *t, const uint8_t *c, unsigned n)
+{
+	void (*h)(z80_t *);
+	unsigned mod = c[0] == 0xdd ? 1 : 2;
+	unsigned len;
+	uint8_t cbop = 0;
+	uint8_t opc;
+	unsigned pre;
+	unsigned cyc;
+	int aff;
+	int wr;
+#ifndef Z80_THREADED
+	unsigned x;
+#endif
+
+	if (n < 2)
+		return 0;
+
+	if (c[1] == 0xcb) {
+		if (n < 4)
+			return 0;
+		len = 4;
+		cbop = c[2];
+		opc = c[3];
+		h = (mod == 1 ? ei_ddcbop : ei_fdcbop)[opc];
+		wr = (opc & 0xc0) != 0x40;
+	} else {
+		opc = c[1];
+		len = z80_jit_ddlen(opc);
+		if (n < len)
+			return 0;
+		h = (mod == 1 ? ei_ddop : ei_fdop)[opc];
+		if (h == NULL || h == Si_stray || h == Mi_dd || h == Mi_fd ||
+		    h == ei_jp_IX || h == ei_jp_IY)
+			return 0;
+		wr = opc == 0x22 || opc == 0x34 || opc == 0x35 ||
+		    opc == 0x36 || opc == 0xe3 || opc == 0xe5 ||
+		    (opc & 0xf8) == 0x70;
+	}
+
+#ifndef Z80_THREADED
+	/* The prefix is executed as an instruction of its own */
+	t->fetches += 1;
+	x = z80_jit_exit(t, t->pc + 1, 0, 4, 0);
+	t->exits[x].mod = mod;
+	z80_jit_end(t, 4, x, 0);
+	t->paff = 0;
+	t->fetches += 1;
+	pre = 0;
+#else
+	/* The prefix is executed together with the instruction */
+	t->fetches += 2;
+	t->paff = 0;
+	pre = 4;
+#endif
+	if (z80_jit_ddin(t, c, &cyc, &wr, &aff)) {
+		t->last = z80_jit_exit(t, t->pc + len, 0, pre + cyc, aff);
+		z80_jit_end(t, pre + cyc, t->last, wr);
+		t->paff = aff;
+		return len;
+	}
+
+	t->last = z80_jit_handler(t, h, opc, cbop,
+	    t->pc + (c[1] == 0xcb ? 4 : 2), mod, pre, wr, t->pc + len);
+	return len;
+}
+
+/** Emit unconditional exit after counting the T states of the instruction.
+ *
+ * @param t Translation
+ * @param cyc T states
+ * @param exit Exit
+ */
+static void z80_jit_leave(z80_jit_tr_t *t, unsigned cyc, unsigned exit)
+{
+	/* add r12, cyc; jmp exit */
+	Z80_JIT_E(t, 0x49, 0x83, 0xc4, cyc);
+	z80_jit_jx(t, 0, exit);
+}
+
+/** Emit jump to an instruction of the block.
+ *
+ * The block is left if the deadline has been reached. The fetch count
+ * adjustment is the difference between the opcode fetches at the jump
+ * and at the destination.
+ *
+ * @param t Translation
+ * @param cyc T states of the jump
+ * @param exit Exit taken when the deadline has been reached
+ * @param adj Fetch count adjustment
+ * @param pos Offset of the destination from the start of the function
+ */
+static void z80_jit_jlbl(z80_jit_tr_t *t, unsigned cyc, unsigned exit,
+    int adj, uint32_t pos)
+{
+	z80_jit_end(t, cyc, exit, 0);
+	/* The jump does not affect flags */
+	z80_jit_st32i(t, Z80_JIT_CPUS(flags_aff), 0);
+	/* add r15, adj; jmp pos */
+	Z80_JIT_E(t, 0x49, 0x81, 0xc7);
+	z80_jit_emit32(t, adj);
+	Z80_JIT_E(t, 0xe9);
+	z80_jit_emit32(t, pos - (t->p + 4 - t->start));
+}
+
+/** Emit taken branch.
+ *
+ * A jump back to an instruction of the block, or a jump forward if
+ * the block continues after the branch, stays in native code. Code
+ * at the destination must not depend on flags_aff of the previous
+ * instruction being nonzero, as the jump does not affect flags.
+ *
+ * @param t Translation
+ * @param cyc T states
+ * @param dst Destination address
+ * @param cond Nonzero if the branch is conditional
+ * @return Nonzero if it jumps back to the start of the block
+ */
+static int z80_jit_taken(z80_jit_tr_t *t, unsigned cyc, uint16_t dst,
+    int cond)
+{
+	unsigned x = z80_jit_exit(t, dst, 0, cyc, 0);
+	uint16_t off = dst - t->pc0;
+	z80_jit_lbl_t *l = &t->lbl[off];
+	z80_jit_fwd_t *f;
+
+	if (off <= t->len && l->pos != 0 && l->paff <= 0) {
+		z80_jit_jlbl(t, cyc, x, t->fetches - l->fetches, l->pos);
+		return off == 0;
+	}
+
+	if (cond && dst > t->pc && off < Z80_JIT_MAX_BYTES &&
+	    (dst & ~(Z80_PG_SIZE - 1)) == (t->pc0 & ~(Z80_PG_SIZE - 1))) {
+		/* Resolved by z80_jit_label() or in z80_jit_translate() */
+		f = &t->fwd[t->nfwd++];
+		f->dst = dst;
+		f->fetches = t->fetches;
+		f->exit = x;
+		z80_jit_jlbl(t, cyc, x, 0, 0);
+		f->jmp = t->p - 4 - t->start;
+		f->adj = f->jmp - 5;
+		return 0;
+	}
+
+	z80_jit_leave(t, cyc, x);
+	return 0;
+}
+
+/** Record start of an instruction as a possible jump destination.
+ *
+ * If a jump forward arrives here, flags_aff of the previous instruction
+ * is stored in the CPU state, where the jump leaves its own.
+ *
+ * @param t Translation
+ */
+static void z80_jit_label(z80_jit_tr_t *t)
+{
+	z80_jit_lbl_t *l = &t->lbl[t->len];
+	unsigned i;
+
+	for (i = 0; i < t->nfwd; i++) {
+		if (t->fwd[i].dst == t->pc)
+			break;
+	}
+
+	if (i < t->nfwd && t->paff > 0) {
+		z80_jit_st32i(t, Z80_JIT_CPUS(flags_aff), t->paff);
+		t->paff = -1;
+	}
+
+	l->pos = t->p - t->start;
+	l->fetches = t->fetches;
+	l->paff = t->paff;
+}
+
+/** Translate one instruction.
+ *
+ * @param t Translation
+ * @return Zero if translated and the block continues, 1 if translated
+ *         and the block ends, -1 if not translated
+ */
+static int z80_jit_instr(z80_jit_tr_t *t)
+{
+	const uint8_t *c = t->code + t->len;
+	unsigned n = Z80_PG_SIZE - (t->pc & (Z80_PG_SIZE - 1));
+	void (*h)(z80_t *);
+	uint8_t op = c[0];
+	unsigned len = 1;
+	unsigned cyc = 4;
+	int aff = 0;
+	int wr = 0;
+	int end = 0;
+	uint16_t next;
+	uint16_t dst;
+	unsigned k;
+	uint8_t *nt;
+	uint8_t jcc;
+
+	if (n > Z80_JIT_MAX_BYTES - t->len)
+		n = Z80_JIT_MAX_BYTES - t->len;
+	if (n == 0)
+		return -1;
+
+	/* A run must stop before a break address */
+	if (t->z->brkpg[t->pg] != 0 && z80_code_break(t->z, t->pc))
+		return -1;
+	z80_jit_label(t);
+	t->instr[t->len / 64] |= (uint64_t)1 << (t->len % 64);
+
+	if (op == 0xdd || op == 0xfd) {
+		len = z80_jit_dd(t, c, n);
+		if (len == 0)
+			return -1;
+		t->pc += len;
+		t->len += len;
+		return 0;
+	}
+
+	if (op == 0xed) {
+		if (n < 2)
+			return -1;
+		h = ei_edop[c[1]];
+		if (!z80_jit_ed_ok(h, &wr))
+			return -1;
+		len = (c[1] & 0xc7) == 0x43 ? 4 : 2;
+		if (n < len)
+			return -1;
+		t->fetches += 2;
+		t->last = z80_jit_handler(t, h, c[1], 0, t->pc + 2, 0, 0, wr,
+		    t->pc + len);
+		t->pc += len;
+		t->len += len;
+		return 0;
+	}
+
+	switch (op) {
+	case 0x37:
+	case 0x3f:
+		/* SCF and CCF depend on flags_aff of previous instruction */
+		if (t->paff >= 0)
+			break;
+		/* fall through */
+	case 0x22:
+	case 0x2a:
+	case 0x27:
+	case 0xe3:
+	case 0xf9:
+		if (op == 0x22 || op == 0x2a)
+			len = 3;
+		if (n < len)
+			return -1;
+		wr = op == 0x22 || op == 0xe3;
+		t->fetches += 1;
+		t->last = z80_jit_handler(t, ei_op[op], op, 0, t->pc + 1, 0, 0,
+		    wr, t->pc + len);
+		t->pc += len;
+		t->len += len;
+		return 0;
+	}
+
+	/* Length of the instruction */
+	if ((op & 0xc7) == 0x06 || (op & 0xc7) == 0xc6 || op == 0x10 ||
+	    op == 0x18 || (op & 0xe7) == 0x20 || op == 0xcb)
+		len = 2;
+	else if ((op & 0xcf) == 0x01 || op == 0x32 || op == 0x3a ||
+	    (op & 0xc7) == 0xc2 || op == 0xc3 || (op & 0xc7) == 0xc4 ||
+	    op == 0xcd)
+		len = 3;
+	if (n < len)
+		return -1;
+
+	next = t->pc + len;
+	t->fetches += 1;
+
+	switch (op) {
+	case 0x00:
+		/* NOP */
+		break;
+	case 0x01:
+	case 0x11:
+	case 0x21:
+	case 0x31:
+		/* LD rr, nn */
+		k = op >> 4;
+		Z80_JIT_E(t, 0x66, 0xc7);
+		if (k == 3) {
+			z80_jit_mem(t, 0, Z80_JIT_CPUS(SP));
+			z80_jit_emit16(t, c[1] | c[2] << 8);
+		} else {
+			z80_jit_mem(t, 0, Z80_JIT_R(2 * k));
+			z80_jit_emit16(t, c[2] | c[1] << 8);
+		}
+		cyc = 10;
+		break;
+	case 0x02:
+	case 0x12:
+		/* LD (BC), A; LD (DE), A */
+		z80_jit_ldrp(t, 1, op >> 4);
+		z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+		z80_jit_write8(t);
+		cyc = 7;
+		wr = 1;
+		break;
+	case 0x07:
+	case 0x0f:
+	case 0x17:
+	case 0x1f:
+		/* RLCA; RRCA; RLA; RRA */
+		z80_jit_rota(t, op);
+		aff = 1;
+		break;
+	case 0x08:
+		/* EX AF, AF' */
+		z80_jit_exch(t, Z80_JIT_R(rA), Z80_JIT_R_(rA), 1);
+		z80_jit_exch(t, Z80_JIT_CPUS(F), Z80_JIT_CPUS(F_), 1);
+		break;
+	case 0x2f:
+		/* CPL */
+		z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+		/* xor al, 0xff; mov [rbx + A], al; and al, fU; mov dl, al */
+		Z80_JIT_E(t, 0x34, 0xff);
+		z80_jit_st8(t, 0, Z80_JIT_R(rA));
+		Z80_JIT_E(t, 0x24, fU, 0x88, 0xc2);
+		/* mov al, [rbx + F]; and al, S | Z | PV | C; or al, H | N */
+		z80_jit_ld8(t, 0, Z80_JIT_CPUS(F));
+		Z80_JIT_E(t, 0x24, fS | fZ | fPV | fC, 0x0c, fHC | fN);
+		/* or al, dl */
+		Z80_JIT_E(t, 0x08, 0xd0);
+		z80_jit_st8(t, 0, Z80_JIT_CPUS(F));
+		aff = 1;
+		break;
+	case 0x34:
+	case 0x35:
+		/* INC (HL); DEC (HL) */
+		z80_jit_incdec(t, 6, 2, 0, op & 0x01);
+		cyc = 11;
+		aff = 1;
+		wr = 1;
+		break;
+	case 0x37:
+	case 0x3f:
+		/* SCF; CCF */
+		z80_jit_scf(t, op == 0x3f, t->paff);
+		aff = 1;
+		break;
+	case 0xcb:
+		t->fetches += 1;
+		cyc = z80_jit_cb(t, c[1], 2, 0, &wr);
+		aff = (c[1] & 0xc0) < 0x80;
+		break;
+	case 0xd9:
+		/* EXX */
+		z80_jit_exch(t, Z80_JIT_R(rB), Z80_JIT_R_(rB), 4);
+		z80_jit_exch(t, Z80_JIT_R(rH), Z80_JIT_R_(rH), 2);
+		break;
+	case 0x0a:
+	case 0x1a:
+		/* LD A, (BC); LD A, (DE) */
+		z80_jit_ldrp(t, 1, op >> 4);
+		z80_jit_read8(t);
+		z80_jit_st8(t, 0, Z80_JIT_R(rA));
+		z80_jit_ld8(t, 0, Z80_JIT_R(2 * (op >> 4)));
+		z80_jit_st8(t, 0, Z80_JIT_CPUS(W));
+		cyc = 7;
+		break;
+	case 0x03:
+	case 0x13:
+	case 0x23:
+	case 0x33:
+	case 0x0b:
+	case 0x1b:
+	case 0x2b:
+	case 0x3b:
+		/* INC rr; DEC rr */
+		z80_jit_ldrp(t, 0, op >> 4);
+		/* inc ax / dec ax */
+		Z80_JIT_E(t, 0x66, 0xff, (op & 0x08) != 0 ? 0xc8 : 0xc0);
+		z80_jit_strp(t, 0, op >> 4);
+		cyc = 6;
+		break;
+	case 0x09:
+	case 0x19:
+	case 0x29:
+	case 0x39:
+		/* ADD HL, rr */
+		z80_jit_add16(t, 2, op >> 4);
+		cyc = 11;
+		aff = 1;
+		break;
+	case 0x10:
+		/* DJNZ e */
+		dst = next + (int8_t)c[1];
+		/* dec byte [rbx + B] */
+		Z80_JIT_E(t, 0xfe);
+		z80_jit_mem(t, 1, Z80_JIT_R(rB));
+		nt = z80_jit_jfwd32(t, 0x84);
+		z80_jit_st8i(t, Z80_JIT_CPUS(W), dst >> 8);
+		end = z80_jit_taken(t, 13, dst, 1);
+		z80_jit_here32(t, nt);
+		cyc = 8;
+		break;
+	case 0x18:
+		/* JR e */
+		dst = next + (int8_t)c[1];
+		z80_jit_st8i(t, Z80_JIT_CPUS(W), dst >> 8);
+		z80_jit_taken(t, 12, dst, 0);
+		end = 2;
+		break;
+	case 0x20:
+	case 0x28:
+	case 0x30:
+	case 0x38:
+		/* JR cc, e */
+		dst = next + (int8_t)c[1];
+		jcc = z80_jit_cond(t, (op >> 3) & 0x03);
+		nt = z80_jit_jfwd32(t, jcc ^ 1);
+		z80_jit_st8i(t, Z80_JIT_CPUS(W), dst >> 8);
+		end = z80_jit_taken(t, 12, dst, 1);
+		z80_jit_here32(t, nt);
+		cyc = 7;
+		break;
+	case 0x32:
+		/* LD (nn), A */
+		Z80_JIT_E(t, 0xb9);
+		z80_jit_emit32(t, c[1] | c[2] << 8);
+		z80_jit_ld8(t, 0, Z80_JIT_R(rA));
+		z80_jit_write8(t);
+		cyc = 13;
+		wr = 1;
+		break;
+	case 0x3a:
+		/* LD A, (nn) */
+		Z80_JIT_E(t, 0xb9);
+		z80_jit_emit32(t, c[1] | c[2] << 8);
+		z80_jit_read8(t);
+		z80_jit_st8(t, 0, Z80_JIT_R(rA));
+		z80_jit_st8i(t, Z80_JIT_CPUS(W), c[2]);
+		cyc = 13;
+		break;
+	case 0x36:
+		/* LD (HL), n */
+		z80_jit_ldrp(t, 1, 2);
+		Z80_JIT_E(t, 0xb0, c[1]);
+		z80_jit_write8(t);
+		cyc = 10;
+		wr = 1;
+		break;
+	case 0xc3:
+		/* JP nn */
+		dst = c[1] | c[2] << 8;
+		z80_jit_st8i(t, Z80_JIT_CPUS(W), c[2]);
+		z80_jit_taken(t, 10, dst, 0);
+		end = 2;
+		break;
+	case 0xcd:
+		/* CALL nn */
+		z80_jit_push(t, -1, next);
+		z80_jit_st8i(t, Z80_JIT_CPUS(W), c[2]);
+		z80_jit_leave(t, 17, z80_jit_exit(t, c[1] | c[2] << 8, 0, 17,
+		    0));
+		end = 2;
+		break;
+	case 0xc9:
+		/* RET */
+		z80_jit_pop(t);
+		/* mov [rbx + PC], ax; mov [rbx + W], ah */
+		Z80_JIT_E(t, 0x66, 0x89);
+		z80_jit_mem(t, 0, Z80_JIT_CPUS(PC));
+		z80_jit_st8(t, 4, Z80_JIT_CPUS(W));
+		z80_jit_leave(t, 10, z80_jit_exit(t, 0, 1, 10, 0));
+		end = 2;
+		break;
+	case 0xe9:
+		/* JP (HL) */
+		z80_jit_ldrp(t, 0, 2);
+		Z80_JIT_E(t, 0x66, 0x89);
+		z80_jit_mem(t, 0, Z80_JIT_CPUS(PC));
+		z80_jit_leave(t, 4, z80_jit_exit(t, 0, 1, 4, 0));
+		end = 2;
+		break;
+	case 0xeb:
+		/* EX DE, HL */
+		Z80_JIT_E(t, 0x0f, 0xb7);
+		z80_jit_mem(t, 0, Z80_JIT_R(rD));
+		Z80_JIT_E(t, 0x0f, 0xb7);
+		z80_jit_mem(t, 1, Z80_JIT_R(rH));
+		Z80_JIT_E(t, 0x66, 0x89);
+		z80_jit_mem(t, 1, Z80_JIT_R(rD));
+		Z80_JIT_E(t, 0x66, 0x89);
+		z80_jit_mem(t, 0, Z80_JIT_R(rH));
+		break;
+	default:
+		if ((op & 0xc7) == 0x04 || (op & 0xc7) == 0x05) {
+			/* INC r; DEC r */
+			z80_jit_incdec(t, (op >> 3) & 0x07, 2, 0, op & 0x01);
+			aff = 1;
+		} else if ((op & 0xc7) == 0x06) {
+			/* LD r, n */
+			z80_jit_st8i(t, Z80_JIT_R((op >> 3) & 0x07), c[1]);
+			cyc = 7;
+		} else if ((op & 0xc0) == 0x40 && op != 0x76) {
+			/* LD r, r' */
+			if ((op & 0x07) == 0x06) {
+				z80_jit_ldrp(t, 1, 2);
+				z80_jit_read8(t);
+				z80_jit_st8(t, 0, Z80_JIT_R((op >> 3) & 0x07));
+				cyc = 7;
+			} else if ((op & 0x38) == 0x30) {
+				z80_jit_ldrp(t, 1, 2);
+				z80_jit_ld8(t, 0, Z80_JIT_R(op & 0x07));
+				z80_jit_write8(t);
+				cyc = 7;
+				wr = 1;
+			} else {
+				z80_jit_ld8(t, 0, Z80_JIT_R(op & 0x07));
+				z80_jit_st8(t, 0, Z80_JIT_R((op >> 3) & 0x07));
+			}
+		} else if ((op & 0xc0) == 0x80 || (op & 0xc7) == 0xc6) {
+			/* ALU A, r; ALU A, n */
+			if ((op & 0xc0) != 0x80) {
+				/* mov dl, n */
+				Z80_JIT_E(t, 0xb2, c[1]);
+				cyc = 7;
+			} else if ((op & 0x07) == 0x06) {
+				z80_jit_ldrp(t, 1, 2);
+				z80_jit_read8(t);
+				/* mov dl, al */
+				Z80_JIT_E(t, 0x88, 0xc2);
+				cyc = 7;
+			} else {
+				z80_jit_ld8(t, 2, Z80_JIT_R(op & 0x07));
+			}
+			z80_jit_alu(t, (op >> 3) & 0x07);
+			aff = 1;
+		} else if ((op & 0xcb) == 0xc1) {
+			/* POP rr; PUSH rr */
+			k = (op >> 4) & 0x03;
+			if ((op & 0x04) != 0) {
+				z80_jit_push(t, k, 0);
+				cyc = 11;
+				wr = 1;
+			} else {
+				z80_jit_pop(t);
+				if (k == 3) {
+					z80_jit_st8(t, 0, Z80_JIT_CPUS(F));
+					z80_jit_st8(t, 4, Z80_JIT_R(rA));
+				} else {
+					z80_jit_strp(t, 0, k);
+				}
+				cyc = 10;
+			}
+		} else if ((op & 0xc7) == 0xc2) {
+			/* JP cc, nn */
+			dst = c[1] | c[2] << 8;
+			z80_jit_st8i(t, Z80_JIT_CPUS(W), c[2]);
+			jcc = z80_jit_cond(t, (op >> 3) & 0x07);
+			nt = z80_jit_jfwd32(t, jcc ^ 1);
+			end = z80_jit_taken(t, 10, dst, 1);
+			z80_jit_here32(t, nt);
+			cyc = 10;
+		} else if ((op & 0xc7) == 0xc4) {
+			/* CALL cc, nn */
+			jcc = z80_jit_cond(t, (op >> 3) & 0x07);
+			nt = z80_jit_jfwd32(t, jcc ^ 1);
+			z80_jit_push(t, -1, next);
+			z80_jit_st8i(t, Z80_JIT_CPUS(W), c[2]);
+			z80_jit_leave(t, 17, z80_jit_exit(t, c[1] | c[2] << 8,
+			    0, 17, 0));
+			z80_jit_here32(t, nt);
+			cyc = 10;
+		} else if ((op & 0xc7) == 0xc0) {
+			/* RET cc */
+			jcc = z80_jit_cond(t, (op >> 3) & 0x07);
+			nt = z80_jit_jfwd32(t, jcc ^ 1);
+			z80_jit_pop(t);
+			Z80_JIT_E(t, 0x66, 0x89);
+			z80_jit_mem(t, 0, Z80_JIT_CPUS(PC));
+			z80_jit_leave(t, 11, z80_jit_exit(t, 0, 1, 11, 0));
+			z80_jit_here32(t, nt);
+			cyc = 5;
+		} else if ((op & 0xc7) == 0xc7) {
+			/* RST n */
+			z80_jit_push(t, -1, next);
+			z80_jit_st8i(t, Z80_JIT_CPUS(W), 0);
+			z80_jit_leave(t, 11, z80_jit_exit(t, op & 0x38, 0, 11,
+			    0));
+			end = 2;
+		} else {
+			t->fetches -= 1;
+			return -1;
+		}
+		break;
+	}
+
+	if (end == 1) {
+		/* Loop back at a conditional branch, leave if not taken */
+		z80_jit_leave(t, cyc, z80_jit_exit(t, next, 0, cyc, aff));
+	} else if (end == 0) {
+		t->last = z80_jit_exit(t, next, 0, cyc, aff);
+		z80_jit_end(t, cyc, t->last, wr);
+	}
+	t->paff = aff;
+	t->pc = next;
+	t->len += len;
+	return end != 0;
+}
+
+/** Emit comparison of the code of the block with the translated code.
+ *
+ * Emits a subroutine that returns zero in eax if the code at [r14]
+ * is unchanged, one otherwise.
+ *
+ * @param t Translation
+ * @return Entry point of the subroutine
+ */
+static uint8_t *z80_jit_verify(z80_jit_tr_t *t)
+{
+	const uint8_t *c = t->code;
+	uint8_t *bad;
+	uint64_t q;
+	uint32_t d;
+	uint16_t w;
+	uint32_t rel;
+	uint8_t *entry;
+	unsigned off = 0;
+	unsigned o;
+
+	/* bad: mov eax, 1; ret */
+	bad = t->p;
+	Z80_JIT_E(t, 0xb8, 1, 0, 0, 0, 0xc3);
+	entry = t->p;
+
+	while (off < t->len) {
+		if (t->len >= 8) {
+			/* The last chunk can overlap the previous one */
+			o = off + 8 <= t->len ? off : t->len - 8;
+			memcpy(&q, c + o, sizeof(q));
+			/* mov rax, imm64; cmp [r14 + o], rax */
+			Z80_JIT_E(t, 0x48, 0xb8);
+			z80_jit_emit64(t, q);
+			Z80_JIT_E(t, 0x49, 0x39);
+			z80_jit_code(t, 0, o);
+			off += 8;
+		} else if (t->len - off >= 4) {
+			memcpy(&d, c + off, sizeof(d));
+			/* cmp dword [r14 + off], imm32 */
+			Z80_JIT_E(t, 0x41, 0x81);
+			z80_jit_code(t, 7, off);
+			z80_jit_emit32(t, d);
+			off += 4;
+		} else if (t->len - off >= 2) {
+			memcpy(&w, c + off, sizeof(w));
+			/* cmp word [r14 + off], imm16 */
+			Z80_JIT_E(t, 0x66, 0x41, 0x81);
+			z80_jit_code(t, 7, off);
+			z80_jit_emit16(t, w);
+			off += 2;
+		} else {
+			/* cmp byte [r14 + off], imm8 */
+			Z80_JIT_E(t, 0x41, 0x80);
+			z80_jit_code(t, 7, off);
+			Z80_JIT_E(t, c[off]);
+			off += 1;
+		}
+
+		/* jne bad */
+		Z80_JIT_E(t, 0x0f, 0x85);
+		rel = bad - (t->p + 4);
+		z80_jit_emit32(t, rel);
+	}
+
+	/* xor eax, eax; ret */
+	Z80_JIT_E(t, 0x31, 0xc0, 0xc3);
+	return entry;
+}
+
+/** Discard all translations. */
+static void z80_jit_flush(struct z80_jit *j)
+{
+	unsigned i;
+
+	for (i = 0; i < Z80_JIT_NENT; i++) {
+		j->ent[i].fn = NULL;
+		j->ent[i].hits = 0;
+	}
+
+	j->used = 0;
+}
+
+/** Translate block.
+ *
+ * The native code is built in the scratch buffer and only copied to
+ * the code buffer if the translation succeeds.
+ *
+ * @param z CPU context
+ * @param e Block table entry
+ * @return Zero on success, EINVAL if the code cannot be translated,
+ *         ENOMEM if the code buffer cannot be made writable
+ */
+static int z80_jit_translate(z80_t *z, z80_jit_ent_t *e)
+{
+	struct z80_jit *j = z->jit;
+	z80_jit_tr_t *t = &j->tr;
+	uint32_t stub[Z80_JIT_MAX_EXITS];
+	uint8_t *epi;
+	uint32_t verify;
+	uint32_t exits;
+	uint32_t d;
+	uint8_t *jstale;
+	z80_jit_fwd_t *f;
+	uint16_t off;
+	int32_t adj;
+	size_t size;
+	unsigned ninstr = 0;
+	unsigned i;
+	int end = 0;
+	int rc;
+
+	t->z = z;
+	t->start = t->p = j->scratch;
+	t->code = e->code;
+	t->pc0 = t->pc = e->pc;
+	t->pg = e->pc >> Z80_PG_SHIFT;
+	t->len = 0;
+	t->fetches = 0;
+	t->paff = -1;
+	t->last = 0;
+	t->instr[0] = t->instr[1] = 0;
+	memset(t->lbl, 0, sizeof(t->lbl));
+	t->nfwd = 0;
+	t->nexits = 0;
+	t->nfix = 0;
+
+	/*
+	 * push rbx; push rbp; push r12; push r13; push r14; push r15;
+	 * sub rsp, 24; mov rbx, rdi; mov r13, rsi
+	 */
+	Z80_JIT_E(t, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56,
+	    0x41, 0x57, 0x48, 0x83, 0xec, 24, 0x48, 0x89, 0xfb,
+	    0x49, 0x89, 0xf5);
+	/* mov r12, [rbx + clock]; sub r12, r13 */
+	Z80_JIT_E(t, 0x4c, 0x8b);
+	z80_jit_mem(t, 4, Z80_JIT_CTX(clock));
+	Z80_JIT_E(t, 0x4d, 0x29, 0xec);
+	/* mov rbp, ox_tab; xor r15d, r15d; mov byte [rsp], 0 */
+	Z80_JIT_E(t, 0x48, 0xbd);
+	z80_jit_emit64(t, (uintptr_t)ox_tab);
+	Z80_JIT_E(t, 0x45, 0x31, 0xff, 0xc6, 0x04, 0x24, 0x00);
+	/* Check that the code has not changed */
+	z80_jit_code_ptr(t);
+	Z80_JIT_E(t, 0xe8);
+	z80_jit_emit32(t, 0);
+	z80_jit_fix(t, z80_jit_fx_verify, 0);
+	/* test eax, eax; jnz stale */
+	Z80_JIT_E(t, 0x85, 0xc0);
+	jstale = z80_jit_jfwd32(t, 0x85);
+
+	while (ninstr < Z80_JIT_MAX_INSTR &&
+	    t->nexits + 3 <= Z80_JIT_MAX_EXITS &&
+	    t->p - t->start + Z80_JIT_INSTR_SIZE < Z80_JIT_BLOCK_SIZE / 2 &&
+	    t->nfix + 16 <= Z80_JIT_MAX_FIX) {
+		rc = z80_jit_instr(t);
+		if (rc < 0)
+			break;
+		++ninstr;
+		if (rc > 0) {
+			end = 1;
+			break;
+		}
+	}
+
+	if (ninstr == 0)
+		return EINVAL;
+
+	if (!end)
+		z80_jit_jx(t, 0, t->last);
+
+	/*
+	 * epi: lea rcx, [r12 + r13]; mov [rbx + clock], rcx;
+	 * shl r15, 8; or rax, r15; add rsp, 24;
+	 * pop r15; pop r14; pop r13; pop r12; pop rbp; pop rbx; ret
+	 */
+	epi = t->p;
+	Z80_JIT_E(t, 0x4b, 0x8d, 0x0c, 0x2c, 0x48, 0x89);
+	z80_jit_mem(t, 1, Z80_JIT_CTX(clock));
+	Z80_JIT_E(t, 0x49, 0xc1, 0xe7, 8, 0x4c, 0x09, 0xf8,
+	    0x48, 0x83, 0xc4, 24, 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d,
+	    0x41, 0x5c, 0x5d, 0x5b, 0xc3);
+
+	/* Exit stubs: mov eax, exit; jmp epi (the first one for stale code) */
+	z80_jit_here32(t, jstale);
+	for (i = 0; i <= t->nexits; i++) {
+		if (i > 0)
+			stub[i - 1] = t->p - t->start;
+		Z80_JIT_E(t, 0xb8);
+		z80_jit_emit32(t, i > 0 ? i - 1 : Z80_JIT_STALE);
+		Z80_JIT_E(t, 0xe9);
+		d = epi - (t->p + 4);
+		z80_jit_emit32(t, d);
+	}
+
+	/* Jumps forward go to the destination if it was translated */
+	for (i = 0; i < t->nfwd; i++) {
+		f = &t->fwd[i];
+		off = f->dst - t->pc0;
+		if (off < t->len && t->lbl[off].pos != 0) {
+			d = t->lbl[off].pos - (f->jmp + 4);
+			adj = f->fetches - t->lbl[off].fetches;
+		} else {
+			d = stub[f->exit] - (f->jmp + 4);
+			adj = 0;
+		}
+		memcpy(t->start + f->jmp, &d, sizeof(d));
+		memcpy(t->start + f->adj, &adj, sizeof(adj));
+	}
+
+	verify = z80_jit_verify(t) - t->start;
+
+	/* Exits table */
+	while (((t->p - t->start) & 7) != 0)
+		Z80_JIT_E(t, 0xcc);
+	exits = t->p - t->start;
+	z80_jit_emit(t, (const uint8_t *)t->exits,
+	    t->nexits * sizeof(z80_jit_exit_t));
+
+	for (i = 0; i < t->nfix; i++) {
+		switch (t->fix[i].kind) {
+		case z80_jit_fx_exit:
+			d = stub[t->fix[i].exit] - (t->fix[i].pos + 4);
+			break;
+		case z80_jit_fx_verify:
+			d = verify - (t->fix[i].pos + 4);
+			break;
+		default:
+			d = t->len;
+			break;
+		}
+		memcpy(t->start + t->fix[i].pos, &d, sizeof(d));
+	}
+
+	size = t->p - t->start;
+	if (j->used + size > Z80_JIT_BUF_SIZE)
+		z80_jit_flush(j);
+
+	if (mprotect(j->buf, Z80_JIT_BUF_SIZE, PROT_READ | PROT_WRITE) != 0)
+		return ENOMEM;
+	memcpy(j->buf + j->used, t->start, size);
+	if (mprotect(j->buf, Z80_JIT_BUF_SIZE, PROT_READ | PROT_EXEC) != 0) {
+		/* The buffer must never be left writable */
+		z80_jit_flush(j);
+		return ENOMEM;
+	}
+	__builtin___clear_cache((char *)j->buf + j->used,
+	    (char *)j->buf + j->used + size);
+
+	e->fn = (z80_jit_fn_t)(uintptr_t)(j->buf + j->used);
+	e->exits = (const z80_jit_exit_t *)(j->buf + j->used + exits);
+	e->brkgen = j->brkgen;
+	e->instr[0] = t->instr[0];
+	e->instr[1] = t->instr[1];
+	j->used = (j->used + size + 15) & ~(size_t)15;
+	return 0;
+}
+
+/** Call instruction handler from native code.
+ *
+ * @param z CPU context
+ * @param arg Address of the operands | opcode << 16 | cbop << 24
+ * @param mod Modifier
+ * @param h Handler
+ * @return Nonzero if the block must exit after the instruction
+ */
+static int z80_jit_call(z80_t *z, uint32_t arg, uint8_t mod,
+    void (*h)(z80_t *))
+{
+	z->cpus.PC = arg & 0xffff;
+	z->opcode = (arg >> 16) & 0xff;
+	z->cbop = arg >> 24;
+	z->cpus.modifier = mod;
+	h(z);
+	z->cpus.modifier = 0;
+	flags_sync(z);
+
+	return z->cpus.int_pending != 0 || z->cpus.nmi_pending != 0 ||
+	    z->jit->brkchg != 0;
+}
+
+/** Write memory through the memset8 callback from native code.
+ *
+ * @param z CPU context
+ * @param addr Address
+ * @param val Value
+ * @param clock Clock at the start of the instruction
+ * @return Nonzero if the block must exit after the instruction
+ */
+static int z80_jit_memset8(z80_t *z, uint16_t addr, uint8_t val,
+    unsigned long clock)
+{
+	z->clock = clock;
+	z->instr_clock = clock;
+	z->ops->memset8(z->arg, addr, val);
+
+	return z->cpus.int_pending != 0 || z->cpus.nmi_pending != 0 ||
+	    z->jit->brkchg != 0;
+}
+
+/** Create translator state.
+ *
+ * @return Translator state or NULL if out of memory or if the host
+ *         does not allow executable mappings
+ */
+static struct z80_jit *z80_jit_create(void)
+{
+	struct z80_jit *j;
+
+	j = calloc(1, sizeof(struct z80_jit));
+	if (j == NULL)
+		return NULL;
+
+	j->buf = mmap(NULL, Z80_JIT_BUF_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (j->buf == MAP_FAILED) {
+		free(j);
+		return NULL;
+	}
+
+	if (mprotect(j->buf, Z80_JIT_BUF_SIZE, PROT_READ | PROT_EXEC) != 0) {
+		munmap(j->buf, Z80_JIT_BUF_SIZE);
+		free(j);
+		return NULL;
+	}
+
+	return j;
+}
+
+/** Destroy translator state. */
+static void z80_jit_destroy(struct z80_jit *j)
+{
+	munmap(j->buf, Z80_JIT_BUF_SIZE);
+	free(j);
+}
+
+/** Check that a block does not contain break addresses.
+ *
+ * Called when pages have been marked for breaks since the block
+ * was translated or last checked.
+ *
+ * @param z CPU context
+ * @param e Block table entry
+ * @return Nonzero if the block can be used, zero if it was discarded
+ */
+static int z80_jit_brk_check(z80_t *z, z80_jit_ent_t *e)
+{
+	unsigned i;
+
+	if (z->brkpg[e->pc >> Z80_PG_SHIFT] != 0) {
+		for (i = 0; i < Z80_JIT_MAX_BYTES; i++) {
+			if ((e->instr[i / 64] & (uint64_t)1 << (i % 64)) != 0 &&
+			    z80_code_break(z, e->pc + i)) {
+				e->fn = NULL;
+				e->hits = 0;
+				return 0;
+			}
+		}
+	}
+
+	e->brkgen = z->jit->brkgen;
+	return 1;
+}
+
+/** Note that pages have been marked for breaks. */
+static void z80_jit_brk_update(struct z80_jit *j)
+{
+	++j->brkgen;
+	j->brkchg = 1;
+}
+
+/** Execute translated code, if there is any for the current address.
+ *
+ * Called by the lean core before each instruction. Translates the code
+ * once the address is hot.
+ *
+ * @param z CPU context
+ * @param deadline Clock value at which to stop
+ * @return Nonzero if native code was executed, zero if the interpreter
+ *         should execute the next instruction
+ */
+static int z80_jit_exec(z80_t *z, unsigned long deadline)
+{
+	uint16_t pc = z->cpus.PC;
+	unsigned pg = pc >> Z80_PG_SHIFT;
+	const z80_jit_exit_t *x;
+	const uint8_t *code;
+	z80_jit_ent_t *e;
+	uintptr_t hash;
+	uint64_t rc;
+	int rv;
+
+	if (z->jit_enabled == 0 || z->rcpus != &z->cpus ||
+	    z->cpus.halted != 0 || z->cpus.modifier != 0 ||
+	    z->cpus.int_pending != 0 || z->cpus.nmi_pending != 0)
+		return 0;
+
+	if (z->jit == NULL) {
+		z->jit = z80_jit_create();
+		if (z->jit == NULL) {
+			z->jit_enabled = 0;
+			return 0;
+		}
+	}
+
+	code = z->rdpg[pg] + (pc & (Z80_PG_SIZE - 1));
+	hash = (uintptr_t)code ^ ((uintptr_t)code >> 12);
+	e = &z->jit->ent[hash & (Z80_JIT_NENT - 1)];
+	if (e->code != code || e->pc != pc) {
+		e->code = code;
+		e->pc = pc;
+		e->fn = NULL;
+		e->hits = 0;
+	}
+
+	if (e->fn == NULL) {
+		if (++e->hits < Z80_JIT_HOT)
+			return 0;
+		rv = z80_jit_translate(z, e);
+		if (rv != 0) {
+			if (rv == ENOMEM)
+				z->jit_enabled = 0;
+			e->hits = Z80_JIT_COLD;
+			return 0;
+		}
+	}
+
+	if (e->brkgen != z->jit->brkgen && !z80_jit_brk_check(z, e))
+		return 0;
+
+	z80_sync_flags(&z->cpus);
+	z->jit->brkchg = 0;
+	rc = e->fn(z, deadline);
+	if ((rc & 0xff) == Z80_JIT_STALE) {
+		e->fn = NULL;
+		e->hits = 0;
+		return 0;
+	}
+
+	x = &e->exits[rc & 0xff];
+	incr_R(z, x->fetches + ((int64_t)rc >> 8));
+	if (x->dynpc == 0)
+		z->cpus.PC = x->pc;
+	if (x->lastcyc != 0)
+		z->instr_clock = z->clock - x->lastcyc;
+	if (x->aff >= 0) {
+		z->cpus.pflags_aff = x->paff >= 0 ? x->paff :
+		    z->cpus.flags_aff;
+		z->cpus.flags_aff = x->aff;
+	}
+	z->cpus.modifier = x->mod;
+	z->cpus.int_lock = x->mod != 0;
+	return 1;
+}
@@ -1,6 +1,6 @@
 /*
  * GZX - George's ZX Spectrum Emulator
- * ZX machine state
+ * ZX machine
  *
  * Copyright (c) 1999-2017 Jiri Svoboda
  * All rights reserved.
@@ -29,37 +29,857 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ * ZX machine
+ *
+ * The machine state lives in a zx_machine_t. This module creates
+ * the machine, schedules device events and executes code. It is shared
+ * by all front ends (interactive, headless, batch and the library),
+ * which drive it a field at a time using zx_dispatch() and zx_exec().
+ */
+
+#include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ay.h"
+#include "clock.h"
 #include "debug.h"
+#include "evsched.h"
+#include "iorec.h"
 #include "joystick/kempston.h"
+#include "memio.h"
+#include "midi.h"
+#include "romtrap.h"
 #include "rs232.h"
+#include "rzx.h"
+#include "state.h"
+#include "sysmidi.h"
 #include "tape/deck.h"
+#include "tape/quick.h"
+#include "tape/tape.h"
+#include "xmap.h"
+#include "xtrace.h"
+#include "z80.h"
+#include "z80dep.h"
+#include "z80g.h"
 #include "zx.h"
 #include "zx_kbd.h"
+#include "zx_scr.h"
+#include "zx_sound.h"
+
+static void zx_snd_event(void *);
+static void zx_tape_event(void *);
+static void zx_field_event(void *);
+static void zx_disp_event(void *);
+
+/** Log file */
+FILE *logfi;
+
+/* Start up working directory */
+/* ... used as base for finding the ROM files */
+char *start_dir;
+
+/** MIDI device specification */
+const char *midi_dev;
+
+/** Number of fields per field shown in warp mode */
+#define WARP_FIELD_SKIP 16
+
+/** Notify on 48K mode change.
+ *
+ * 48K mode is on if we're Spectrum 48K (or lower) or if we are Spectrum
+ * 128K or higher locked in 48K emulation mode.
+ */
+void zx_notify_mode_48k(zx_machine_t *zx, bool mode48k)
+{
+	/* Tape needs to know to handle Stop the tape if in 48K mode */
+	if (zx->tape_deck != NULL)
+		tape_deck_set_48k(zx->tape_deck, mode48k);
+}
+
+/** LD-BYTES trap (quick load).
+ *
+ * The tape traps do nothing while running speculatively. Only the tape
+ * position is part of the machine state, so a block added to the tape
+ * would survive restoring the canonical timeline. The ROM routine runs
+ * instead and the trap fires once the canonical timeline gets there.
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_ldbytes_trap(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	if (zx->slow_load || zx->rzx != NULL || zx->speculative)
+		return;
+
+	fprintf(logfi, "Load trapped.\n");
+	tape_quick_ldbytes(zx);
+}
+
+/** SA-BYTES trap (quick save).
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_sabytes_trap(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	if (zx->slow_load || zx->rzx != NULL || zx->speculative)
+		return;
+
+	fprintf(logfi, "Save trapped!\n");
+	tape_quick_sabytes(zx);
+}
+
+/** Add ROM traps for the current memory model.
+ *
+ * Called whenever ROM is loaded. The tape routines of the 48K BASIC ROM
+ * are used by all Spectrum models (the 128K editor pages in the 48K ROM
+ * to load and save).
+ */
+void zx_add_rom_traps(zx_machine_t *zx)
+{
+	int rom;
+
+	rom = zx_mem_basic48_rom(zx);
+	if (rom < 0)
+		return;
+
+	(void) romtrap_add(zx, rom, TAPE_LDBYTES_TRAP, zx_ldbytes_trap, zx);
+	(void) romtrap_add(zx, rom, TAPE_SABYTES_TRAP, zx_sabytes_trap, zx);
+	zx_code_break_update(zx);
+}
+
+/** Mark memory pages that contain addresses where runs must stop.
+ *
+ * Runs of instructions only check for ROM traps and the stop address
+ * in marked pages. Must be called whenever memory is paged, ROM traps
+ * are added or the stop address changes.
+ */
+void zx_code_break_update(zx_machine_t *zx)
+{
+	unsigned i;
+
+	for (i = 0; i < ZX_MEM_NPG; i++) {
+		z80_set_break_page(&zx->cpu, i, romtrap_in_page(zx, i) ||
+		    (zx->stop_pc_enabled &&
+		    zx->stop_pc >> ZX_MEM_PG_SHIFT == i));
+	}
+}
+
+/** Select the lean or instrumented CPU core.
+ *
+ * Only pay for instrumentation if somebody looks at the results, i.e.
+ * statistics, execution map or trace are enabled or the debugger is
+ * single-stepping or waiting for a stop address. Must be called when
+ * any of these is switched on or off.
+ */
+void zx_update_instrumented(zx_machine_t *zx)
+{
+	z80_set_instrumented(&zx->cpu, zx->stat_enabled ||
+	    zx->xmap_enabled || zx->xtrace_enabled || zx->dbg.stop_enabled ||
+	    zx->dbg.itrap_enabled);
+}
+
+/** Enter the debugger.
+ *
+ * The instrumented core is used while the debugger is active.
+ */
+void zx_debugger_run(zx_machine_t *zx)
+{
+	z80_set_instrumented(&zx->cpu, 1);
+	debugger_run(&zx->dbg);
+	zx_update_instrumented(zx);
+}
+
+/** Value was written to AY I/O port.
+ *
+ * @param arg Machine (zx_machine_t *)
+ * @param val Value
+ */
+static void zx_ay_ioport_write(void *arg, uint8_t val)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	rs232_write(&zx->rs232, val);
+}
+
+/** Character was sent via RS-232 port */
+static void zx_rs232_sendchar(void *arg, uint8_t val)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	midi_port_write(&zx->midi, val);
+}
+
+/** Midi event was sent via MIDI port */
+static void zx_midi_msg(void *arg, midi_msg_t *msg)
+{
+#ifdef WITH_MIDI
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	/* Only the canonical timeline produces MIDI output */
+	if (!zx->speculative)
+		sysmidi_send_msg(zx->cpu.clock, msg);
+#endif
+}
+
+/** Stop RZX recording or playback. */
+void zx_rzx_stop(zx_machine_t *zx)
+{
+	if (zx->rzx == NULL)
+		return;
+
+	if (rzx_close(zx->rzx) != 0)
+		printf("Error writing RZX file.\n");
+	zx->rzx = NULL;
+}
+
+/** End RZX frame.
+ *
+ * Called at each video field interrupt. Recording or playback is
+ * stopped at the end of the recording or on loss of synchronization.
+ */
+static void zx_rzx_int(zx_machine_t *zx)
+{
+	if (zx->rzx == NULL)
+		return;
+
+	zx->rzx_rc = rzx_int(zx->rzx);
+	if (zx->rzx_rc == 0)
+		return;
+
+	if (zx->rzx_rc == ENOENT)
+		printf("RZX playback finished.\n");
+	else if (zx->rzx->playing)
+		printf("RZX playback lost synchronization.\n");
+	else
+		printf("RZX recording failed.\n");
+
+	zx_rzx_stop(zx);
+}
+
+/** Start RZX recording or playback.
+ *
+ * @param play_fname RZX file to play back or @c NULL
+ * @param rec_fname RZX file to record to or @c NULL (ignored if
+ *                  @a play_fname is given)
+ * @return Zero on success, -1 on error
+ */
+int zx_rzx_start(zx_machine_t *zx, const char *play_fname,
+    const char *rec_fname)
+{
+	uint32_t tstates;
+	int rc;
+
+	if (play_fname != NULL) {
+		rc = rzx_play_open(zx, play_fname, &zx->rzx);
+		if (rc != 0) {
+			printf("Error opening RZX file '%s'.\n", play_fname);
+			return -1;
+		}
+	} else if (rec_fname != NULL) {
+		tstates = zx->cpu.clock + ULA_FIELD_TICKS -
+		    zx->field_ev.clock;
+		rc = rzx_rec_create(zx, rec_fname, tstates, &zx->rzx);
+		if (rc != 0) {
+			printf("Error starting RZX recording to '%s'.\n",
+			    rec_fname);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void zx_reset(zx_machine_t *zx)
+{
+	zx_rzx_stop(zx);
+	if (zx->xtrace_enabled)
+		xtrace_reset(zx);
+	if (gpu_is_on(zx)) {
+		gpu_reset(zx);
+		gpu_disable(zx);
+	}
+	zx_scr_reset(zx);
+	z80_reset(&zx->cpu);
+	ay_reset(&zx->ay);
+	zx_mem_page_reset(zx);
+}
+
+/** Create a machine.
+ *
+ * ROMs are loaded relative to start_dir (or the current directory
+ * if it is @c NULL). Each machine is independent of any other machine.
+ *
+ * @param host_video Display video output on the host (otherwise it is
+ *                   drawn into an image in memory)
+ * @param sound_out Enable audio output to the host
+ * @param rzx Place to store pointer to the new machine
+ * @return Zero on success, -1 on error
+ */
+int zx_create(bool host_video, bool sound_out, zx_machine_t **rzx)
+{
+	zx_machine_t *zx;
+	int rc;
+
+	fprintf(logfi, "Start initialization.\n");
+
+	zx = calloc(1, sizeof(zx_machine_t));
+	if (zx == NULL) {
+		printf("Out of memory.\n");
+		return -1;
+	}
+
+	zx->dbg.zx = zx;
+	zx->ay_enable = true;
+	zx->kjoy_enable = true;
+	zx->gpu.allow = true;
+	zx->warp_auto = true;
+
+	z80_init_tables();
+	z80_init(&zx->cpu, &z80_dep_ops, zx, zx->mem.rdpg, zx->mem.wrpg);
+
+	if (zx_select_memmodel(zx, ZXM_48K) < 0) {
+		printf("Error initializing memory.\n");
+		goto error;
+	}
+
+	fprintf(logfi, "Initialize GPU.\n");
+	gpu_init(zx);
+
+	fprintf(logfi, "Initialize screen.\n");
+	rc = zx_scr_init(zx, 0, host_video);
+	if (rc < 0) {
+		printf("Error initializing screen.\n");
+		goto error;
+	}
+
+	fprintf(logfi, "Initialize keyboard.\n");
+	zx_keys_init(&zx->keys);
+	if (zx_sound_init(zx, sound_out) < 0) {
+		printf("Error initializing sound.\n");
+		goto error;
+	}
+
+	fprintf(logfi, "Initialize AY.\n");
+	ay_init(&zx->ay, ZX_SOUND_TICKS_SMP);
+
+	zx->ay.ioport_write = zx_ay_ioport_write;
+	zx->ay.ioport_write_arg = zx;
+
+	rs232_init(&zx->rs232, Z80_CLOCK / MIDI_BAUD);
+	zx->rs232.sendchar = zx_rs232_sendchar;
+	zx->rs232.sendchar_arg = zx;
+
+	midi_port_init(&zx->midi);
+	zx->midi.midi_msg = zx_midi_msg;
+	zx->midi.midi_msg_arg = zx;
+
+	kempston_joy_init(&zx->kjoy);
+
+	fprintf(logfi, "Create tape deck.\n");
+	if (tape_deck_create(&zx->tape_deck, ZX_TAPE_TICKS_SMP, true) != 0) {
+		printf("Error creating tape deck.\n");
+		goto error;
+	}
+
+	zx_reset(zx);
+
+	evsched_init(&zx->sched);
+	evsched_event_init(&zx->snd_ev, zx_snd_event, zx);
+	evsched_event_init(&zx->tape_ev, zx_tape_event, zx);
+	evsched_event_init(&zx->field_ev, zx_field_event, zx);
+	evsched_event_init(&zx->disp_ev, zx_disp_event, zx);
+	zx->snd_clock = ZX_SOUND_TICKS_SMP;
+	evsched_at(&zx->sched, &zx->snd_ev, ULA_FIELD_TICKS);
+	/*
+	 * The ULA catches up in 4T steps and raises the interrupt after
+	 * the last step of the field, i.e. as soon as the Z80 clock
+	 * is past the start of that step.
+	 */
+	evsched_at(&zx->sched, &zx->field_ev,
+	    zx->video.ula.cbase + ULA_FIELD_TICKS - 3);
+	evsched_at(&zx->sched, &zx->disp_ev, ULA_FIELD_TICKS);
+	zx_tape_attach(zx);
+
+	zx->mem.border = 7;
+
+	fprintf(logfi, "Initialization done.\n");
+	*rzx = zx;
+	return 0;
+error:
+	zx_destroy(zx);
+	return -1;
+}
+
+/** Destroy a machine.
+ *
+ * RZX recording and I/O recording are stopped and all resources
+ * of the machine are freed.
+ *
+ * @param zx Machine
+ */
+void zx_destroy(zx_machine_t *zx)
+{
+	zx_rzx_stop(zx);
+	if (zx->iorec != NULL) {
+		iorec_close(zx->iorec);
+		zx->iorec = NULL;
+	}
+
+	if (zx->tape_deck != NULL)
+		tape_deck_destroy(zx->tape_deck);
+	if (gpu_is_on(zx))
+		gpu_disable(zx);
+	zx_sound_done(zx);
+	zx_scr_fini(zx);
+	zx_mem_fini(zx);
+	z80_fini(&zx->cpu);
+	free(zx->xmap);
+	free(zx);
+}
+
+/** Create a copy of a machine.
+ *
+ * The copy has no host video or sound output. It shares memory with
+ * @a zx until either machine writes to it (see zx_mem_share()), so
+ * cloning is cheap in time and memory. The tape inserted in @a zx is
+ * read again from its file. @a zx must not be running in another thread
+ * while it is being cloned.
+ *
+ * @param zx Machine
+ * @param rzx Place to store pointer to the new machine
+ * @return Zero on success, ENOMEM if out of memory, ENOTSUP if the machine
+ *         cannot be copied (Spec256), EIO if the tape cannot be read
+ *         again or the machine cannot be created
+ */
+int zx_clone(zx_machine_t *zx, zx_machine_t **rzx)
+{
+	zx_machine_t *nzx;
+	int rc;
+
+	if (gpu_is_on(zx))
+		return ENOTSUP;
 
-/** First AY */
-ay_t ay0;
-/** First AY enabled */
-bool ay0_enable = true;
+	if (zx_create(false, false, &nzx) < 0)
+		return EIO;
 
-/** First Kempston joystick */
-kempston_joy_t kjoy0;
-/** First Kempston joystick enabled */
-bool kjoy0_enable = true;
+	nzx->ay_enable = zx->ay_enable;
+	nzx->kjoy_enable = zx->kjoy_enable;
+	nzx->gpu.allow = zx->gpu.allow;
+	nzx->slow_load = zx->slow_load;
+	nzx->warp_mode = zx->warp_mode;
+	nzx->warp_auto = zx->warp_auto;
+	nzx->field_skip = zx->field_skip;
 
-/** Debugger */
-debugger_t dbg;
+	if (tape_first(zx->tape_deck->tape) != NULL &&
+	    tape_deck_open(nzx->tape_deck, zx->tape_deck->fname) != 0) {
+		zx_destroy(nzx);
+		return EIO;
+	}
 
-/** MIDI port */
-midi_port_t midi;
+	rc = zx_state_copy(nzx, zx);
+	if (rc != 0) {
+		zx_destroy(nzx);
+		return rc;
+	}
 
-/** RS-232 port */
-rs232_t rs232;
+	zx_update_warp(nzx);
+	nzx->warp_field = zx->warp_field;
+	nzx->warp_drawn = zx->warp_drawn;
+	*rzx = nzx;
+	return 0;
+}
 
-/** Virtual tape deck */
-tape_deck_t *tape_deck;
+/** Bring video output up to date with the CPU.
+ *
+ * @param clock Z80 clock value
+ */
+static void zx_video_catchup(zx_machine_t *zx, unsigned long clock)
+{
+	if (!gpu_is_on(zx) && zx->warp_on) {
+		/* Only draw every WARP_FIELD_SKIP-th field */
+		while (zx_scr_warp(zx, clock, zx->warp_field == 0)) {
+			if (zx->warp_field == 0)
+				zx->warp_drawn = true;
+			zx->warp_field = (zx->warp_field + 1) %
+			    WARP_FIELD_SKIP;
+		}
+	} else if (!gpu_is_on(zx) && zx->field_skip) {
+		(void) zx_scr_warp(zx, clock, false);
+	} else if (!gpu_is_on(zx)) {
+		while (CLOCK_LT(zx_scr_get_clock(zx), clock)) {
+			zx_scr_disp(zx);
+		}
+	} else {
+		while (CLOCK_LT(zx_scr_get_clock(zx), clock)) {
+			zx_scr_disp_fast(zx);
+		}
+	}
+}
+
+/** Bring video output up to date with the current instruction.
+ *
+ * While running instructions with z80_run(&cpu0, ), devices are only brought
+ * up to date between runs. This is called before the CPU changes anything
+ * that affects video output or reads anything produced by it.
+ */
+void zx_video_sync(zx_machine_t *zx)
+{
+	zx_video_catchup(zx, zx->cpu.instr_clock);
+}
+
+/** Generate audio samples up to a point in time.
+ *
+ * Audio samples are generated lazily, in batches. Anything that
+ * changes the sound output must first generate the samples that are
+ * due before the change.
+ *
+ * @param clock Generate all samples due at or before this clock value
+ */
+static void zx_snd_catchup(zx_machine_t *zx, unsigned long clock)
+{
+	while (CLOCK_GE(clock, zx->snd_clock)) {
+		zx_sound_smp(zx, ay_get_sample(&zx->ay) +
+		    (zx->tape_smp ? +16 : -16));
+		zx->snd_clock += ZX_SOUND_TICKS_SMP;
+	}
+}
+
+/** Generate audio samples due before the current instruction.
+ *
+ * Called before an I/O write changes the sound output.
+ */
+void zx_snd_sync(zx_machine_t *zx)
+{
+	zx_snd_catchup(zx, zx->cpu.instr_clock);
+}
+
+/** Generate a batch of audio samples.
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_snd_event(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	zx_snd_catchup(zx, zx->snd_ev.clock);
+	evsched_at(&zx->sched, &zx->snd_ev, zx->snd_ev.clock + ULA_FIELD_TICKS);
+}
+
+/** Get a new sample from the tape.
+ *
+ * The event is only scheduled while the tape is running, so that
+ * it does not cut runs of instructions short needlessly.
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_tape_event(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	zx_snd_catchup(zx, zx->tape_ev.clock);
+	tape_deck_getsmp(zx->tape_deck, &zx->tape_smp);
+	zx->mem.ear = zx->tape_smp;
+	if (tape_deck_is_playing(zx->tape_deck) &&
+	    !tape_deck_is_paused(zx->tape_deck)) {
+		evsched_at(&zx->sched, &zx->tape_ev,
+		    zx->tape_ev.clock + ZX_TAPE_TICKS_SMP);
+	}
+}
+
+/** Start or stop sampling the tape when the tape deck state changes.
+ *
+ * When sampling starts again, the next sample is taken at the same
+ * clock value as if the tape event had been running all the time.
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_tape_state_change(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+	unsigned long t;
+
+	if (!tape_deck_is_playing(zx->tape_deck) ||
+	    tape_deck_is_paused(zx->tape_deck)) {
+		/* Pick up the final sample, then stop */
+		zx_snd_catchup(zx, zx->cpu.clock);
+		tape_deck_getsmp(zx->tape_deck, &zx->tape_smp);
+		zx->mem.ear = zx->tape_smp;
+		evsched_cancel(&zx->sched, &zx->tape_ev);
+		return;
+	}
+
+	if (evsched_is_scheduled(&zx->tape_ev))
+		return;
+
+	t = zx->tape_ev.clock;
+	if (CLOCK_GE(zx->cpu.clock, t)) {
+		t += ((zx->cpu.clock - t) / ZX_TAPE_TICKS_SMP + 1) *
+		    ZX_TAPE_TICKS_SMP;
+	}
+
+	evsched_at(&zx->sched, &zx->tape_ev, t);
+}
+
+/** Attach the current tape deck to the machine.
+ *
+ * Must be called whenever tape_deck is set.
+ */
+void zx_tape_attach(zx_machine_t *zx)
+{
+	zx->tape_deck->state_change = zx_tape_state_change;
+	zx->tape_deck->state_change_arg = zx;
+	zx_tape_state_change(zx);
+}
+
+/** Finish video field (and raise the interrupt).
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_field_event(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	zx_video_catchup(zx, zx->cpu.clock);
+	zx_rzx_int(zx);
+	evsched_at(&zx->sched, &zx->field_ev,
+	    zx->field_ev.clock + ULA_FIELD_TICKS);
+}
+
+/** Request host display update (every 50th of a second).
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_disp_event(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
+
+	zx->disp_due = true;
+	evsched_at(&zx->sched, &zx->disp_ev,
+	    zx->disp_ev.clock + ULA_FIELD_TICKS);
+}
+
+/** Get event scheduled by the machine.
+ *
+ * @param zx Machine
+ * @param i Event index (less than ZX_NEVENTS)
+ * @return Event
+ */
+static evsched_event_t *zx_event(zx_machine_t *zx, int i)
+{
+	evsched_event_t *const ev[ZX_NEVENTS] = {
+		&zx->snd_ev, &zx->tape_ev, &zx->field_ev, &zx->disp_ev
+	};
+
+	return ev[i];
+}
+
+/** Save event scheduling state.
+ *
+ * @param st Place to store state
+ */
+void zx_run_state_save(zx_machine_t *zx, zx_run_state_t *st)
+{
+	int i, j;
+
+	assert(zx->sched.nev <= ZX_NEVENTS);
+	st->nev = zx->sched.nev;
+	for (i = 0; i < zx->sched.nev; i++) {
+		for (j = 0; j < ZX_NEVENTS; j++) {
+			if (zx->sched.heap[i] == zx_event(zx, j))
+				break;
+		}
+
+		assert(j < ZX_NEVENTS);
+		st->ev_heap[i] = j;
+		st->ev_clock[i] = zx->sched.heap[i]->clock;
+	}
+
+	st->disp_due = zx->disp_due;
+	st->tape_smp = zx->tape_smp;
+	st->tape_clock = zx->tape_ev.clock;
+	st->snd_clock = zx->snd_clock;
+}
+
+/** Restore event scheduling state.
+ *
+ * The events are scheduled again in their saved heap order, which
+ * reproduces the same heap (and thus the same order of simultaneous
+ * events).
+ *
+ * @param st State previously saved with zx_run_state_save()
+ */
+void zx_run_state_load(zx_machine_t *zx, const zx_run_state_t *st)
+{
+	int i;
+
+	for (i = 0; i < ZX_NEVENTS; i++) {
+		if (evsched_is_scheduled(zx_event(zx, i)))
+			evsched_cancel(&zx->sched, zx_event(zx, i));
+	}
+
+	for (i = 0; i < st->nev; i++) {
+		evsched_at(&zx->sched, zx_event(zx, st->ev_heap[i]),
+		    st->ev_clock[i]);
+	}
+
+	zx->disp_due = st->disp_due;
+	zx->tape_smp = st->tape_smp;
+	if (!evsched_is_scheduled(&zx->tape_ev))
+		zx->tape_ev.clock = st->tape_clock;
+	zx->snd_clock = st->snd_clock;
+}
+
+/** Engage or disengage warp mode as needed.
+ *
+ * In warp mode audio output is muted, so that emulation is not
+ * throttled to real time, and only some fields are drawn and shown.
+ */
+void zx_update_warp(zx_machine_t *zx)
+{
+	bool warp;
+
+	warp = zx->warp_mode || (zx->warp_auto && zx->slow_load &&
+	    tape_deck_is_playing(zx->tape_deck));
+	if (warp == zx->warp_on)
+		return;
+
+	zx->warp_on = warp;
+	zx->warp_field = 0;
+	zx->warp_drawn = false;
+	zx_sound_mute(zx, warp);
+}
+
+/** Determine whether the field that has just ended should be shown.
+ *
+ * @return @c true if the field was drawn and has not been shown yet
+ */
+bool zx_field_drawn(zx_machine_t *zx)
+{
+	bool drawn;
+
+	drawn = zx->warp_on ? zx->warp_drawn : !zx->field_skip;
+	zx->warp_drawn = false;
+	return drawn;
+}
+
+/** Process due device events and ROM traps. */
+static void zx_proc_dev(zx_machine_t *zx)
+{
+	evsched_dispatch(&zx->sched, zx->cpu.clock);
+
+	romtrap_proc(zx, zx->cpu.cpus.PC);
+}
+
+/** Process an instruction and anything that we check for every instruction.
+ *
+ * This is only used when something needs to look at each individual
+ * instruction, otherwise see zx_run().
+ */
+static void zx_proc_instr(zx_machine_t *zx)
+{
+	/* The Spec256 video is not tied to the field event */
+	zx_video_catchup(zx, zx->cpu.clock);
+	zx_proc_dev(zx);
+
+	if (zx->dbg.stop_enabled && zx->cpu.cpus.PC == zx->dbg.stop_addr) {
+		zx_debugger_run(zx);
+	}
+
+	if (gpu_is_on(zx)) {
+		/* The GPU core is not instrumented */
+		if (zx->xmap_enabled)
+			xmap_mark(zx);
+		if (zx->xtrace_enabled)
+			xtrace_instr(zx);
+		z80_g_execinstr(zx);
+	} else {
+		z80_execinstr(&zx->cpu);
+	}
+
+	/* Instruction trap? */
+	if (zx->dbg.itrap_enabled) {
+		/*
+		 * Normally we don't want to break into debugger during int_lock
+		 * (i.e. after DD/CB prefix. However, if there are more DD/CB
+		 * prefixes in sequence, we will break into debugger.
+		 */
+		if (!zx->cpu.cpus.int_lock || zx->dbg.prev_int_lock)
+			zx_debugger_run(zx);
+		zx->dbg.prev_int_lock = zx->cpu.cpus.int_lock;
+	}
+}
+
+/** Determine if code can be executed in runs of instructions.
+ *
+ * Instructions must be executed one by one when anything needs to look
+ * at each individual instruction.
+ */
+bool zx_run_allowed(zx_machine_t *zx)
+{
+	return !gpu_is_on(zx) && !zx->dbg.stop_enabled &&
+	    !zx->dbg.itrap_enabled;
+}
+
+/** Determine the clock value of the next device event.
+ *
+ * @return Clock value of the next event
+ */
+static unsigned long zx_next_event(zx_machine_t *zx)
+{
+	return evsched_next(&zx->sched, zx->cpu.clock + ULA_FIELD_TICKS);
+}
+
+/** Execute instructions until the next device event.
+ *
+ * Due device events are processed before the run. The run also
+ * stops at ROM trap addresses so that the traps are processed in time.
+ */
+static void zx_run(zx_machine_t *zx)
+{
+	zx_proc_dev(zx);
+
+	z80_run(&zx->cpu, zx_next_event(zx));
+}
+
+/** Process due device events.
+ *
+ * @return @c true if a field has ended (the host display update is due)
+ */
+bool zx_dispatch(zx_machine_t *zx)
+{
+	evsched_dispatch(&zx->sched, zx->cpu.clock);
+	if (!zx->disp_due)
+		return false;
+
+	zx->disp_due = false;
+	return true;
+}
+
+/** Execute code.
+ *
+ * Executes instructions until the next device event or a single
+ * instruction if something needs to look at each instruction.
+ */
+void zx_exec(zx_machine_t *zx)
+{
+	if (zx_run_allowed(zx))
+		zx_run(zx);
+	else
+		zx_proc_instr(zx);
+}
 
-/** Keyboard */
-zx_keys_t keys;
+/** Emulate until the end of the current field. */
+void zx_run_field(zx_machine_t *zx)
+{
+	while (!zx_dispatch(zx))
+		zx_exec(zx);
+}
@@ -1,6 +1,6 @@
 /*
  * GZX - George's ZX Spectrum Emulator
- * ZX machine state
+ * ZX machine
  *
  * Copyright (c) 1999-2017 Jiri Svoboda
  * All rights reserved.
@@ -33,23 +33,36 @@
 #define ZX_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
-#include "ay.h"
-#include "debug.h"
-#include "joystick/kempston.h"
-#include "midi.h"
-#include "rs232.h"
-#include "tape/deck.h"
-#include "zx_kbd.h"
+#include "types/zx.h"
 
-extern ay_t ay0;
-extern bool ay0_enable;
-extern debugger_t dbg;
-extern kempston_joy_t kjoy0;
-extern bool kjoy0_enable;
-extern midi_port_t midi;
-extern rs232_t rs232;
-extern tape_deck_t *tape_deck;
-extern zx_keys_t keys;
+extern FILE *logfi;
+extern char *start_dir;
+extern const char *midi_dev;
+
+extern int zx_create(bool, bool, zx_machine_t **);
+extern void zx_destroy(zx_machine_t *);
+extern int zx_clone(zx_machine_t *, zx_machine_t **);
+extern void zx_reset(zx_machine_t *);
+extern void zx_notify_mode_48k(zx_machine_t *, bool);
+extern void zx_add_rom_traps(zx_machine_t *);
+extern void zx_code_break_update(zx_machine_t *);
+extern void zx_update_instrumented(zx_machine_t *);
+extern void zx_debugger_run(zx_machine_t *);
+extern int zx_rzx_start(zx_machine_t *, const char *, const char *);
+extern void zx_rzx_stop(zx_machine_t *);
+extern void zx_video_sync(zx_machine_t *);
+extern void zx_snd_sync(zx_machine_t *);
+extern void zx_tape_attach(zx_machine_t *);
+extern void zx_run_state_save(zx_machine_t *, zx_run_state_t *);
+extern void zx_run_state_load(zx_machine_t *, const zx_run_state_t *);
+extern void zx_update_warp(zx_machine_t *);
+extern bool zx_field_drawn(zx_machine_t *);
+extern bool zx_run_allowed(zx_machine_t *);
+extern bool zx_dispatch(zx_machine_t *);
+extern void zx_exec(zx_machine_t *);
+extern void zx_run_field(zx_machine_t *);
 
 #endif
@@ -29,136 +29,204 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include "video/defs.h"
 #include "video/display.h"
 #include "video/spec256.h"
 #include "video/ula.h"
 #include "mgfx.h"
-#include "zx_scr.h"
+#include "xtrace.h"
+#include "z80.h"
 #include "z80g.h"
+#include "zx_scr.h"
 
-static void g_scr_disp_fast(void);
-
-static void n_scr_disp_fast(void);
-static void n_scr_disp(void);
-
-void (*zx_scr_disp_fast)(void) = n_scr_disp_fast;
-void (*zx_scr_disp)(void)      = n_scr_disp;
-static int video_mode = 0;
-
-static video_out_t video_out;
-video_area_t video_out_area = varea_320x200;
+/** End of video field.
+ *
+ * Raise the interrupt.
+ *
+ * @param arg Machine (zx_machine_t *)
+ */
+static void zx_scr_field_end(void *arg)
+{
+	zx_machine_t *zx = (zx_machine_t *)arg;
 
-video_ula_t video_ula;
+	if (zx->xtrace_enabled)
+		xtrace_int(zx);
+	z80_int(&zx->cpu);
 
-static video_spec256_t video_spec256;
+	if (gpu_is_on(zx))
+		z80_g_int(zx);
+}
 
-/* crude and fast display routine, called 50 times a second */
-static void n_scr_disp_fast(void)
+/** Crude and fast display routine, called 50 times a second.
+ *
+ * @param zx Machine
+ */
+void zx_scr_disp_fast(zx_machine_t *zx)
 {
-	video_ula_disp_fast(&video_ula);
+	if (zx->video.mode)
+		video_spec256_disp_fast(&zx->video.spec256);
+	else
+		video_ula_disp_fast(&zx->video.ula);
 }
 
-static void g_scr_disp_fast(void)
+/** Slow and fine display routine, called after each instruction!
+ *
+ * @param zx Machine
+ */
+void zx_scr_disp(zx_machine_t *zx)
 {
-	video_spec256_disp_fast(&video_spec256);
+	video_ula_disp(&zx->video.ula);
 }
 
-/* slow and fine display routine, called after each instruction! */
-static void n_scr_disp(void)
+/** Fast-forward video output in warp mode.
+ *
+ * @param zx Machine
+ * @param clock Z80 clock value
+ * @param draw Draw the field if it has ended
+ * @return @c true iff the end of field was reached
+ */
+bool zx_scr_warp(zx_machine_t *zx, unsigned long clock, bool draw)
 {
-	video_ula_disp(&video_ula);
+	return video_ula_warp(&zx->video.ula, clock, draw);
 }
 
-void zx_scr_mode(int mode)
+void zx_scr_mode(zx_machine_t *zx, int mode)
 {
-	if (mode && gpu_is_on()) {
-		zx_scr_disp_fast = g_scr_disp_fast;
-		video_spec256_setpal(&video_spec256);
-		video_mode = 1;
+	if (mode && gpu_is_on(zx)) {
+		video_spec256_setpal(&zx->video.spec256);
+		zx->video.mode = 1;
 	} else {
-		zx_scr_disp_fast = n_scr_disp_fast;
-		video_ula_setpal(&video_ula);
-		video_mode = 0;
+		video_ula_setpal(&zx->video.ula);
+		zx->video.mode = 0;
 	}
 }
 
-void zx_scr_update_pal(void)
+void zx_scr_update_pal(zx_machine_t *zx)
 {
-	if (!video_mode)
-		video_ula_setpal(&video_ula);
+	if (!zx->video.mode)
+		video_ula_setpal(&zx->video.ula);
 }
 
-int zx_scr_init(unsigned long clock)
+/** Initialize video.
+ *
+ * The video output goes either to the host display or to an image
+ * of the machine that is the size of the display area.
+ *
+ * @param zx Machine
+ * @param clock Initial clock value
+ * @param host @c true to render to the host display
+ * @return Zero on success, -1 on error
+ */
+int zx_scr_init(zx_machine_t *zx, unsigned long clock, bool host)
 {
 	int w, h;
 
-	video_area_size(video_out_area, &w, &h);
+	zx->video.area = varea_320x200;
+	video_area_size(zx->video.area, &w, &h);
 
-	if (mgfx_init(w, h))
-		return -1;
+	if (host) {
+		if (mgfx_init(w, h))
+			return -1;
 
-	video_out.x0 = scr_xs / 2 - zx_field_w / 2;
-	video_out.y0 = scr_ys / 2 - zx_field_h / 2;
+		zx->video.out.x0 = scr_xs / 2 - zx_field_w / 2;
+		zx->video.out.y0 = scr_ys / 2 - zx_field_h / 2;
+	} else {
+		zx->video.out.image = calloc(w * h, 1);
+		if (zx->video.out.image == NULL)
+			return -1;
+
+		zx->video.out.image_w = w;
+		zx->video.out.image_h = h;
+		zx->video.out.x0 = w / 2 - zx_field_w / 2;
+		zx->video.out.y0 = h / 2 - zx_field_h / 2;
+	}
 
-	if (video_ula_init(&video_ula, clock, &video_out))
+	if (video_ula_init(&zx->video.ula, clock, &zx->video.out, &zx->mem,
+	    zx_scr_field_end, zx))
 		return -1;
 
-	if (video_spec256_init(&video_spec256, &video_out))
+	/* GPU memory planes are attached by gpu_enable() */
+	if (video_spec256_init(&zx->video.spec256, &zx->video.out, &zx->mem,
+	    NULL, zx_scr_field_end, zx))
 		return -1;
 
 	return 0;
 }
 
-int zx_scr_set_area(video_area_t area)
+/** Free video resources.
+ *
+ * @param zx Machine
+ */
+void zx_scr_fini(zx_machine_t *zx)
+{
+	video_spec256_clear_bg(&zx->video.spec256);
+	free(zx->video.spec256.gfxpal);
+	zx->video.spec256.gfxpal = NULL;
+	free(zx->video.out.image);
+	zx->video.out.image = NULL;
+}
+
+/** Change the display area (host display only).
+ *
+ * @param zx Machine
+ * @param area Display area
+ * @return Zero on success, -1 on error
+ */
+int zx_scr_set_area(zx_machine_t *zx, video_area_t area)
 {
 	int w, h;
 
+	if (zx->video.out.image != NULL)
+		return -1;
+
 	video_area_size(area, &w, &h);
 	if (mgfx_set_disp_size(w, h) < 0)
 		return -1;
 
-	video_out_area = area;
-	video_out.x0 = scr_xs / 2 - zx_field_w / 2;
-	video_out.y0 = scr_ys / 2 - zx_field_h / 2;
+	zx->video.area = area;
+	zx->video.out.x0 = scr_xs / 2 - zx_field_w / 2;
+	zx->video.out.y0 = scr_ys / 2 - zx_field_h / 2;
 
 	return 0;
 }
 
-void zx_scr_reset(void)
+void zx_scr_reset(zx_machine_t *zx)
 {
-	video_ula_reset(&video_ula);
+	video_ula_reset(&zx->video.ula);
 }
 
-int zx_scr_init_spec256_pal(void)
+int zx_scr_init_spec256_pal(zx_machine_t *zx)
 {
-	return video_spec256_init_pal(&video_spec256);
+	return video_spec256_init_pal(&zx->video.spec256);
 }
 
-int zx_scr_load_bg(const char *fname, int idx)
+int zx_scr_load_bg(zx_machine_t *zx, const char *fname, int idx)
 {
-	return video_spec256_load_bg(&video_spec256, fname, idx);
+	return video_spec256_load_bg(&zx->video.spec256, fname, idx);
 }
 
-void zx_scr_prev_bg(void)
+void zx_scr_prev_bg(zx_machine_t *zx)
 {
-	video_spec256_prev_bg(&video_spec256);
+	video_spec256_prev_bg(&zx->video.spec256);
 }
 
-void zx_scr_next_bg(void)
+void zx_scr_next_bg(zx_machine_t *zx)
 {
-	video_spec256_next_bg(&video_spec256);
+	video_spec256_next_bg(&zx->video.spec256);
 }
 
-void zx_scr_clear_bg(void)
+void zx_scr_clear_bg(zx_machine_t *zx)
 {
-	video_spec256_clear_bg(&video_spec256);
+	video_spec256_clear_bg(&zx->video.spec256);
 }
 
-unsigned long zx_scr_get_clock(void)
+unsigned long zx_scr_get_clock(zx_machine_t *zx)
 {
-	if (video_mode)
-		return video_spec256_get_clock(&video_spec256);
+	if (zx->video.mode)
+		return video_spec256_get_clock(&zx->video.spec256);
 	else
-		return video_ula_get_clock(&video_ula);
+		return video_ula_get_clock(&zx->video.ula);
 }
@@ -31,25 +31,24 @@
 #ifndef ZX_SCR_H
 #define ZX_SCR_H
 
+#include <stdbool.h>
 #include "types/video/display.h"
-#include "types/video/ula.h"
+#include "types/zx.h"
 
-extern video_ula_t video_ula;
-extern video_area_t video_out_area;
-
-extern int zx_scr_init(unsigned long);
-extern void zx_scr_reset(void);
-extern int zx_scr_init_spec256_pal(void);
-extern int zx_scr_load_bg(const char *, int);
-extern void zx_scr_prev_bg(void);
-extern void zx_scr_next_bg(void);
-extern void zx_scr_clear_bg(void);
-extern void zx_scr_mode(int mode);
-extern void zx_scr_update_pal(void);
-extern unsigned long zx_scr_get_clock(void);
-extern int zx_scr_set_area(video_area_t);
-
-extern void (*zx_scr_disp)(void);
-extern void (*zx_scr_disp_fast)(void);
+extern int zx_scr_init(zx_machine_t *, unsigned long, bool);
+extern void zx_scr_fini(zx_machine_t *);
+extern void zx_scr_reset(zx_machine_t *);
+extern int zx_scr_init_spec256_pal(zx_machine_t *);
+extern int zx_scr_load_bg(zx_machine_t *, const char *, int);
+extern void zx_scr_prev_bg(zx_machine_t *);
+extern void zx_scr_next_bg(zx_machine_t *);
+extern void zx_scr_clear_bg(zx_machine_t *);
+extern void zx_scr_mode(zx_machine_t *, int mode);
+extern void zx_scr_update_pal(zx_machine_t *);
+extern unsigned long zx_scr_get_clock(zx_machine_t *);
+extern bool zx_scr_warp(zx_machine_t *, unsigned long, bool);
+extern int zx_scr_set_area(zx_machine_t *, video_area_t);
+extern void zx_scr_disp(zx_machine_t *);
+extern void zx_scr_disp_fast(zx_machine_t *);
 
 #endif
@@ -29,86 +29,180 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "hash.h"
 #include "memio.h"
 #include "sndw.h"
 #include "zx_sound.h"
 #include "wav/rwave.h"
 #include "zx.h"
 
-static uint8_t *snd_buf;
-static int snd_bufs, snd_bff;
-static rwavew_t *rwave;
+/** Target audio output latency in milliseconds */
+int zx_sound_latency = ZX_SOUND_LATENCY_DEF;
 
-int zx_sound_init(void)
+/** Initialize sound.
+ *
+ * @param output @c true to open the audio output device, @c false
+ *               to only generate audio for capture
+ * @return Zero on success, -1 on error
+ */
+int zx_sound_init(zx_machine_t *zx, bool output)
 {
-	snd_bufs = 560 * 2;
+	/* 20 ms blocks */
+	zx->snd.bufs = 560;
 
-	if (sndw_init(snd_bufs) < 0)
-		return -1;
+	if (output) {
+		if (sndw_init(zx->snd.bufs, zx_sound_latency * 28) < 0)
+			return -1;
+		zx->snd.output = true;
+	}
 
-	snd_bff = 0;
-	snd_buf = malloc(snd_bufs);
+	zx->snd.bff = 0;
+	zx->snd.hash = HASH_FNV1A_INIT;
+	zx->snd.buf = malloc(zx->snd.bufs);
 
-	if (!snd_buf) {
+	if (!zx->snd.buf) {
 		fprintf(stderr, "malloc failed\n");
 		return -1;
 	}
 	return 0;
 }
 
-void zx_sound_done(void)
+void zx_sound_done(zx_machine_t *zx)
 {
-	sndw_done();
-	if (rwave != NULL)
-		rwave_wclose(rwave);
-	free(snd_buf);
+	if (zx->snd.output)
+		sndw_done();
+	zx->snd.output = false;
+	if (zx->snd.rwave != NULL)
+		rwave_wclose(zx->snd.rwave);
+	zx->snd.rwave = NULL;
+	free(zx->snd.buf);
+	zx->snd.buf = NULL;
 }
 
-void zx_sound_smp(int ay_out)
+void zx_sound_smp(zx_machine_t *zx, int ay_out)
 {
+	if (zx->snd.discard)
+		return;
+
 	/* Mixing */
 
-	snd_buf[snd_bff++] = 128 + (ay0_enable ? ay_out : 0) +
-	    (spk ? -16 : +16) + (mic ? -16 : +16);
+	zx->snd.buf[zx->snd.bff++] = 128 + (zx->ay_enable ? ay_out : 0) +
+	    (zx->mem.spk ? -16 : +16) + (zx->mem.mic ? -16 : +16);
 
-	if (snd_bff >= snd_bufs) {
-		snd_bff = 0;
+	if (zx->snd.bff >= zx->snd.bufs) {
+		zx->snd.bff = 0;
+		zx->snd.hash = hash_fnv1a(zx->snd.hash, zx->snd.buf,
+		    zx->snd.bufs);
 
-		sndw_write(snd_buf);
+		if (zx->snd.sink != NULL)
+			zx->snd.sink(zx->snd.sink_arg, zx->snd.buf,
+			    zx->snd.bufs);
 
-		if (rwave != NULL)
-			(void) rwave_write_samples(rwave, snd_buf, snd_bufs);
+		if (zx->snd.output && !zx->snd.mute)
+			sndw_write(zx->snd.buf);
+
+		if (zx->snd.rwave != NULL)
+			(void) rwave_write_samples(zx->snd.rwave, zx->snd.buf,
+			    zx->snd.bufs);
 	}
 }
 
-int zx_sound_start_capture(const char *fname)
+/** Mute audio output.
+ *
+ * While muted, audio is not sent to the output device. Audio capture
+ * is not affected.
+ *
+ * @param mute @c true to mute, @c false to unmute
+ */
+void zx_sound_mute(zx_machine_t *zx, bool mute)
+{
+	zx->snd.mute = mute;
+}
+
+/** Discard audio samples.
+ *
+ * While discarding, generated samples are neither output nor captured.
+ * This is used while emulating speculatively, so that audio only comes
+ * from the canonical timeline.
+ *
+ * @param discard @c true to discard samples, @c false to stop discarding
+ */
+void zx_sound_discard(zx_machine_t *zx, bool discard)
+{
+	zx->snd.discard = discard;
+}
+
+/** Set function receiving generated samples.
+ *
+ * The function is called with each complete block of samples (and with
+ * the partial block on zx_sound_flush()).
+ *
+ * @param sink Function receiving samples or @c NULL
+ * @param arg Argument to @a sink
+ */
+void zx_sound_set_sink(zx_machine_t *zx, zx_sound_sink_t sink, void *arg)
+{
+	zx->snd.sink = sink;
+	zx->snd.sink_arg = arg;
+}
+
+/** Pass samples of the incomplete block to the sink.
+ *
+ * The next block starts empty. This is used to deliver exactly
+ * the samples generated so far, e.g. at the end of each field. The samples
+ * are not sent to the output device or to the capture file.
+ */
+void zx_sound_flush(zx_machine_t *zx)
+{
+	if (zx->snd.bff == 0)
+		return;
+
+	if (zx->snd.sink != NULL)
+		zx->snd.sink(zx->snd.sink_arg, zx->snd.buf, zx->snd.bff);
+	zx->snd.bff = 0;
+}
+
+/** Get hash of generated audio.
+ *
+ * The hash covers all complete 20 ms blocks generated since
+ * initialization (except discarded samples).
+ *
+ * @return FNV-1a hash of the samples
+ */
+uint32_t zx_sound_hash(zx_machine_t *zx)
+{
+	return zx->snd.hash;
+}
+
+int zx_sound_start_capture(zx_machine_t *zx, const char *fname)
 {
 	rwave_params_t params;
 	int rc;
 
-	if (rwave != NULL) {
-		rwave_wclose(rwave);
-		rwave = NULL;
+	if (zx->snd.rwave != NULL) {
+		rwave_wclose(zx->snd.rwave);
+		zx->snd.rwave = NULL;
 	}
 
 	params.channels = 1;
 	params.bits_smp = 8;
 	params.smp_freq = 28000;
 
-	rc = rwave_wopen(fname, &params, &rwave);
+	rc = rwave_wopen(fname, &params, &zx->snd.rwave);
 	if (rc != 0)
 		return -1;
 
 	return 0;
 }
 
-void zx_sound_stop_capture(void)
+void zx_sound_stop_capture(zx_machine_t *zx)
 {
-	if (rwave != NULL) {
-		rwave_wclose(rwave);
-		rwave = NULL;
+	if (zx->snd.rwave != NULL) {
+		rwave_wclose(zx->snd.rwave);
+		zx->snd.rwave = NULL;
 	}
 }
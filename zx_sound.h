@@ -32,10 +32,25 @@
 #ifndef ZX_SOUND_H
 #define ZX_SOUND_H
 
-int zx_sound_init(void);
-int zx_sound_start_capture(const char *);
-void zx_sound_stop_capture(void);
-void zx_sound_done(void);
-void zx_sound_smp(int ay_out);
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "types/zx.h"
+
+/** Default target audio output latency in milliseconds */
+#define ZX_SOUND_LATENCY_DEF 50
+
+extern int zx_sound_latency;
+
+int zx_sound_init(zx_machine_t *, bool);
+int zx_sound_start_capture(zx_machine_t *, const char *);
+void zx_sound_stop_capture(zx_machine_t *);
+void zx_sound_done(zx_machine_t *);
+void zx_sound_smp(zx_machine_t *, int ay_out);
+void zx_sound_mute(zx_machine_t *, bool);
+void zx_sound_discard(zx_machine_t *, bool);
+uint32_t zx_sound_hash(zx_machine_t *);
+void zx_sound_set_sink(zx_machine_t *, zx_sound_sink_t, void *);
+void zx_sound_flush(zx_machine_t *);
 
 #endif